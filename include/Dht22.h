@@ -0,0 +1,87 @@
+// DHT22 (AM2302) reader for sensorTask, replacing the Adafruit DHT library.
+//
+// The library bit-bangs the single-wire protocol: it disables interrupts and
+// busy-waits ~5 ms per reading, and a failed reading just returns NaN. Dht22
+// never waits:
+//   - request() pulls the line low and arms an esp_timer; the timer releases
+//     the line ~1 ms later and starts the RMT receiver on the pin
+//   - the RMT peripheral times every pulse of the reply in hardware
+//   - service() picks the finished frame out of the RMT ring buffer and
+//     decodes it, or gives up after DHT22_RESPONSE_TIMEOUT
+// Readings are at least DHT22_MIN_INTERVAL apart, as the sensor requires.
+// After a failure, retries follow on their own with a doubling backoff. The
+// last good value stays available with its age.
+#pragma once
+
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+
+#define DHT22_MIN_INTERVAL 2000UL     // sensor minimum between two readings
+#define DHT22_START_US 1100           // host start signal, low (datasheet: >= 1 ms)
+#define DHT22_IDLE_US 200             // line high this long after the last bit ends the frame
+#define DHT22_BIT_ONE_US 48           // high pulse of a bit: ~27 us = 0, ~70 us = 1
+#define DHT22_RESPONSE_TIMEOUT 100UL  // a frame takes ~5 ms; nothing after this is a failure
+#define DHT22_RETRY_MAX 60000UL       // backoff doubles from DHT22_MIN_INTERVAL up to this
+#define DHT22_RMT_CHANNEL RMT_CHANNEL_2
+
+class Dht22
+{
+public:
+    enum Error
+    {
+        DHT22_OK,
+        DHT22_NO_RESPONSE, // no frame within DHT22_RESPONSE_TIMEOUT (wiring, power)
+        DHT22_SHORT_FRAME, // fewer than 40 bits
+        DHT22_CHECKSUM,
+        DHT22_RANGE        // checksum fine, value outside the sensor's range
+    };
+
+    explicit Dht22(uint8_t pin, rmt_channel_t channel = DHT22_RMT_CHANNEL) : pin(pin), channel(channel) {}
+
+    bool begin(); // false if the RMT channel or the timer cannot be set up
+    // Starts a reading unless the last one is under DHT22_MIN_INTERVAL ago or
+    // retries are backing off; false then, and the cached value stands
+    bool request();
+    void service(); // collects or times out a transfer, starts due retries; never blocks
+    bool busy() const { return state != DHT22_IDLE; }
+
+    bool hasValue() const { return valid; }
+    float temperature() const { return lastTemperature; }
+    float humidity() const { return lastHumidity; }
+    unsigned long age() const { return millis() - lastGood; } // ms since the last good reading
+    uint32_t failures() const { return consecutiveFailures; }  // since the last good reading
+    uint32_t errors() const { return totalFailures; }          // since boot
+    Error lastError() const { return error; }
+
+private:
+    enum State
+    {
+        DHT22_IDLE,
+        DHT22_TRANSFER // start signal sent, waiting for the frame
+    };
+
+    static void releaseLine(void *arg); // esp_timer callback: end of the start signal
+    void start(unsigned long now);
+    void finish(Error result, unsigned long now);
+    Error decode(const rmt_item32_t *items, size_t count);
+
+    uint8_t pin;
+    rmt_channel_t channel;
+    RingbufHandle_t ring = nullptr;
+    esp_timer_handle_t timer = nullptr;
+
+    State state = DHT22_IDLE;
+    unsigned long lastStart = 0;
+    unsigned long retryAt = 0; // consecutiveFailures > 0: next attempt
+    bool started = false;      // lastStart is set
+
+    bool valid = false;
+    float lastTemperature = 0.0f;
+    float lastHumidity = 0.0f;
+    unsigned long lastGood = 0;
+    uint32_t consecutiveFailures = 0;
+    uint32_t totalFailures = 0;
+    Error error = DHT22_OK;
+};
@@ -0,0 +1,182 @@
+// Event-driven HTTP/1.1 server for loop(), replacing the ESP32 WebServer.
+//
+// WebServer serves one client at a time and writes every response with
+// blocking socket calls, so a phone slowly pulling /data/download held up
+// /pump and controlPump() until it finished. HttpServer instead keeps up to
+// HTTP_MAX_CLIENTS connections open and services each of them a little per
+// handleClient():
+//   - requests are read without blocking and parsed once complete
+//   - connections stay open between requests (keep-alive) and every request
+//     has its own timeouts
+//   - responses are written with non-blocking sends; what the socket cannot
+//     take yet stays queued on the connection
+//   - long bodies (sendBody(), streamFile()) are produced one slice per
+//     handleClient(), only as fast as the client reads them
+//   - a body may also wait for data (HTTP_BODY_LATER), e.g. an event stream;
+//     the connection is closed as soon as the client goes away
+//
+// The request/response calls have the same names and meaning as WebServer's,
+// so route handlers move over unchanged.
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define HTTP_MAX_CLIENTS 8             // connections served at once, open event streams included; more wait in the listen backlog
+#define HTTP_REQUEST_MAX 4096          // request line + headers + form body (POST /settings is ~2.5 KB)
+#define HTTP_REQUEST_TIMEOUT 5000UL    // a started request must be complete within this
+#define HTTP_KEEPALIVE_TIMEOUT 10000UL // an idle kept-alive connection is closed after this
+#define HTTP_SILENT_EVICT 1000UL       // a new connection silent this long may give its slot to the next one
+#define HTTP_SEND_TIMEOUT 10000UL      // a client that takes no bytes for this long is dropped
+#define HTTP_SLICE_SIZE 1024           // long bodies: bytes produced per connection per handleClient()
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+#define HTTP_BODY_LATER ((size_t)-1) // BodyFiller: nothing to send yet, ask again next round
+
+class HttpServer
+{
+public:
+    typedef std::function<void()> THandlerFunction;
+    // Writes the next part of a body into `buffer` (at most `size` bytes) and
+    // returns its length; 0 ends the body, HTTP_BODY_LATER skips this round
+    typedef std::function<size_t(uint8_t *buffer, size_t size)> BodyFiller;
+
+    explicit HttpServer(uint16_t port = 80) : listener(port) {}
+
+    void begin();
+    void handleClient(); // accepts, reads, runs handlers and moves bodies along; never blocks
+    void enableCORS(bool enable = true) { cors = enable; }
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+
+    void on(const char *uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const char *uri, HTTPMethod method, THandlerFunction handler);
+    void onNotFound(THandlerFunction handler) { notFound = handler; }
+
+    // ---- request (inside a handler) ----
+    HTTPMethod method() const { return currentMethod; }
+    String uri() const { return currentUri; }
+    int args() const { return currentArgs.size(); }
+    bool hasArg(const String &name) const;
+    String arg(const String &name) const;
+    bool hasHeader(const String &name) const;
+    String header(const String &name) const;
+
+    // ---- response (inside a handler) ----
+    // CONTENT_LENGTH_UNKNOWN before send(): the body follows in sendContent()
+    // calls, chunked, and sendContent("") ends it
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void setContentLength(const size_t contentLength) { contentLength_ = contentLength; }
+    void send(int code, const char *contentType = nullptr, const String &content = String());
+    void send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+    void send_P(int code, const char *contentType, const char *content, size_t contentLength);
+    void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+    void sendContent(const char *content, size_t contentLength);
+
+    // Sends the headers now and the body after the handler returns, `fill`
+    // being called whenever the client has taken the previous slice.
+    // `length` is the exact body size, or CONTENT_LENGTH_UNKNOWN (chunked).
+    void sendBody(int code, const char *contentType, size_t length, BodyFiller fill);
+
+    // Like WebServer: a *.gz file goes out as is, with Content-Encoding: gzip.
+    // The file is read cooperatively and closed when sent; the handler must not
+    // close it.
+    template <typename T>
+    size_t streamFile(T &file, const String &contentType, int code = 200)
+    {
+        if (String(file.name()).endsWith(".gz"))
+            sendHeader("Content-Encoding", "gzip");
+        size_t size = file.size();
+        T source = file;
+        sendBody(code, contentType.c_str(), size, [source](uint8_t *buffer, size_t length) mutable
+                 {
+                     size_t got = source.read(buffer, length);
+                     if (got == 0)
+                         source.close();
+                     return got;
+                 });
+        return size;
+    }
+
+private:
+    enum ConnectionState
+    {
+        HTTP_FREE,
+        HTTP_READING, // waiting for (the rest of) a request
+        HTTP_SENDING  // response queued or body still being produced
+    };
+
+    struct Connection
+    {
+        WiFiClient client;
+        ConnectionState state = HTTP_FREE;
+        unsigned long since = 0; // request start, last byte sent, or start of idle time
+        std::string in;          // received, not yet handled bytes
+        std::string out;         // queued response bytes, out[outSent..] still to send
+        size_t outSent = 0;
+        BodyFiller fill;         // long body still being produced
+        size_t fillRemaining = 0;
+        bool fillChunked = false;
+        bool fillWaiting = false; // the last fill() had nothing to send
+        bool keepAlive = false;
+        bool served = false; // a response was completed, so an empty `in` means idle
+        bool failed = false; // send error: queued bytes dropped, closed once the handler is done
+    };
+
+    struct Route
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+
+    void accept();
+    void service(Connection &c);
+    bool readRequest(Connection &c);
+    void handleRequest(Connection &c, size_t headerLength, size_t bodyLength);
+    void finishResponse(Connection &c);
+    void produceSlice(Connection &c);
+    void flush(Connection &c);
+    void close(Connection &c);
+    void reject(Connection &c, int code);
+
+    void beginResponse(int code, const char *contentType, size_t contentLength);
+    void queue(const char *data, size_t length);
+    void parseArgs(const char *data, size_t length);
+
+    WiFiServer listener;
+    Connection connections[HTTP_MAX_CLIENTS];
+    std::vector<Route> routes;
+    THandlerFunction notFound;
+    std::vector<String> collected;
+    bool cors = false;
+
+    // Request being handled and its response
+    Connection *current = nullptr;
+    HTTPMethod currentMethod = HTTP_GET;
+    String currentUri;
+    bool http10 = false;
+    std::vector<std::pair<String, String>> currentArgs;
+    std::vector<std::pair<String, String>> currentHeaders;
+    String responseHeaders;
+    size_t contentLength_ = CONTENT_LENGTH_NOT_SET;
+    bool responded = false;
+    bool chunked = false;
+};
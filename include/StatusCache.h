@@ -0,0 +1,14 @@
+// The rendered /status body, shared by main.cpp and the native checks.
+//
+// handleStatus() serves the body from a static buffer of STATUS_CACHE_SIZE
+// bytes and renders it again only when something it shows has changed. A
+// body that does not fit is answered with 500, so `program status` checks
+// the longest body against this same constant.
+#pragma once
+
+// Longest /status JSON (every number at its longest): ~840 bytes + ~150 per
+// enabled zone, ~1420 bytes with 4 zones
+#define STATUS_CACHE_SIZE 1536
+
+// Drops the rendered body; the next request renders it again
+void invalidateStatusCache();
@@ -0,0 +1,141 @@
+# Builds the LittleFS image contents (data/) from the dashboard source in web/.
+#
+# The inline <style> and <script> of web/index.html are minified and moved to
+# data/assets/app.<hash>.css and app.<hash>.js, named by the hash of their
+# content, so the firmware can let browsers cache them forever. Every file is
+# written twice: plain, and .gz for clients that send Accept-Encoding: gzip.
+#
+# PlatformIO runs this before every build (extra_scripts = pre:...), so
+# `pio run -t uploadfs` always uploads current assets. It also runs on its own:
+#
+#   python3 scripts/build_web.py
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+HASH_LENGTH = 8
+
+
+def minify_css(css):
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    # Selectors (and @media preludes) end at "{", declarations at ";" or "}".
+    # Only a declaration loses the spaces around ":"; in a selector the space
+    # is a descendant combinator: ".card :hover" is not ".card:hover".
+    out = []
+    for text, end in re.findall(r"([^{};]*)([{};]|$)", css):
+        text = text.strip()
+        if end == "{":
+            text = re.sub(r"\s*([,>])\s*", r"\1", text)
+        else:
+            text = re.sub(r"\s*:\s*", ":", text, count=1)
+            text = re.sub(r"\s*,\s*", ",", text)
+        out.append(text + end)
+    return "".join(out).replace(";}", "}")
+
+
+def js_open_quote(line, quote):
+    # What is still open at the end of `line`, given what was open before it:
+    # None, "`" (template literal) or "/*". Strings in ' and " end on their
+    # line; ${...} inside a template is not followed.
+    i = 0
+    while i < len(line):
+        if quote == "/*":
+            if line.startswith("*/", i):
+                quote = None
+                i += 1
+        elif quote:
+            if line[i] == "\\":
+                i += 1
+            elif line[i] == quote:
+                quote = None
+        elif line[i] in "'\"`":
+            quote = line[i]
+        elif line.startswith("/*", i):
+            quote = "/*"
+            i += 1
+        elif line.startswith("//", i):
+            break
+        i += 1
+    return quote if quote in ("`", "/*") else None
+
+
+def minify_js(js):
+    # Line-based only: indentation, blank lines and whole-line // comments.
+    # Lines inside a template literal are its text and stay as they are.
+    # Anything smarter needs a real JS parser; gzip removes most of the rest.
+    lines = []
+    quote = None
+    for line in js.splitlines():
+        end = js_open_quote(line, quote)
+        if quote == "`":
+            lines.append(line)
+        else:
+            line = line.lstrip() if end == "`" else line.strip()
+            if line and not line.startswith("//"):
+                lines.append(line)
+        quote = end
+    return "\n".join(lines)
+
+
+def minify_html(html):
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    return "\n".join(line.strip() for line in html.splitlines() if line.strip())
+
+
+def write(out_dir, name, text):
+    data = text.encode("utf-8")
+    path = os.path.join(out_dir, name)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(data)
+    # mtime=0: the same source always gives the same .gz
+    with open(path + ".gz", "wb") as raw, gzip.GzipFile(filename="", mode="wb", fileobj=raw, compresslevel=9, mtime=0) as f:
+        f.write(data)
+    return len(data), os.path.getsize(path + ".gz")
+
+
+def fingerprint(text, extension):
+    digest = hashlib.sha256(text.encode("utf-8")).hexdigest()[:HASH_LENGTH]
+    return "assets/app.%s.%s" % (digest, extension)
+
+
+def build(project_dir):
+    source = os.path.join(project_dir, "web", "index.html")
+    out_dir = os.path.join(project_dir, "data")
+    with open(source, encoding="utf-8") as f:
+        html = f.read()
+
+    style = re.search(r"<style>(.*?)</style>", html, flags=re.S)
+    script = re.search(r"<script>(.*?)</script>", html, flags=re.S)
+    if not style or not script:
+        raise SystemExit("build_web: web/index.html needs one inline <style> and one inline <script>")
+
+    css = minify_css(style.group(1))
+    js = minify_js(script.group(1))
+    css_name = fingerprint(css, "css")
+    js_name = fingerprint(js, "js")
+
+    shell = html.replace(style.group(0), '<link rel="stylesheet" href="/%s">' % css_name, 1)
+    shell = shell.replace(script.group(0), '<script src="/%s"></script>' % js_name, 1)
+    shell = minify_html(shell)
+
+    # Old fingerprints would only waste flash
+    shutil.rmtree(os.path.join(out_dir, "assets"), ignore_errors=True)
+    total_source = len(html.encode("utf-8"))
+    total_plain = total_gzip = 0
+    for name, text in (("index.html", shell), (css_name, css), (js_name, js)):
+        plain, packed = write(out_dir, name, text)
+        total_plain += plain
+        total_gzip += packed
+        print("build_web: /%-28s %6d B, gzip %6d B" % (name, plain, packed))
+    print("build_web: %d B source -> %d B minified -> %d B gzip" % (total_source, total_plain, total_gzip))
+
+
+if "Import" in globals():
+    Import("env")  # noqa: F821 (PlatformIO/SCons)
+    build(env.subst("$PROJECT_DIR"))  # noqa: F821
+elif __name__ == "__main__":
+    build(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
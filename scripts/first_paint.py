@@ -0,0 +1,205 @@
+# Times the dashboard's first paint in a headless browser on a slow link,
+# for the page as it was before scripts/build_web.py (one 69 KB index.html)
+# and for the current gzip + fingerprinted assets in data/.
+#
+# For each page, `program serve` runs the firmware's web server on
+# 127.0.0.1. The browser reaches it through a proxy here that plays the
+# link: every byte waits for the shared --rate in each direction, and every
+# chunk gets half of --rtt on top. Each run uses a fresh, empty cache, as a
+# phone's first visit would. Printed per page (median of --runs):
+#   - first-contentful-paint, DOMContentLoaded and load, from the page's own
+#     Performance entries (ms after navigation start)
+#   - bytes the server had sent when the load event fired, headers included
+#
+# The browser is Qt WebEngine (Chromium), rendering offscreen:
+#
+#   pip install pyside6-webengine
+#   pio run -e native
+#   python3 scripts/first_paint.py
+#   python3 scripts/first_paint.py --rate 250 --rtt 100 --runs 10
+import argparse
+import json
+import os
+import queue
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+OLD_PAGE_REV = "0cb2160^"  # last commit with the hand-written data/index.html
+CHUNK_SIZE = 1460  # one TCP segment
+
+
+class Link:
+    """One direction of the throttled link, shared by every connection."""
+
+    def __init__(self, rate, delay):
+        self.rate = rate
+        self.delay = delay
+        self.free_at = 0.0
+        self.bytes = 0
+        self.lock = threading.Lock()
+
+    def arrival(self, size):
+        with self.lock:
+            start = max(time.monotonic(), self.free_at)
+            self.free_at = start + size / self.rate
+            self.bytes += size
+            return self.free_at + self.delay
+
+
+def pipe(source, target, link):
+    # The reader stamps each chunk with its arrival time and reads on; the
+    # writer hands it over then. The delay overlaps, as on a real link.
+    chunks = queue.Queue()
+
+    def write():
+        while True:
+            arrival, chunk = chunks.get()
+            if chunk is None:
+                break
+            wait = arrival - time.monotonic()
+            if wait > 0:
+                time.sleep(wait)
+            try:
+                target.sendall(chunk)
+            except OSError:
+                break
+        for s in (source, target):
+            try:
+                s.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+    writer = threading.Thread(target=write, daemon=True)
+    writer.start()
+    try:
+        while True:
+            chunk = source.recv(CHUNK_SIZE)
+            if not chunk:
+                break
+            chunks.put((link.arrival(len(chunk)), chunk))
+    except OSError:
+        pass
+    chunks.put((0, None))
+
+
+def start_proxy(server_port, up, down):
+    listener = socket.socket()
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("127.0.0.1", 0))
+    listener.listen(16)
+
+    def accept():
+        while True:
+            client, _ = listener.accept()
+            server = socket.create_connection(("127.0.0.1", server_port))
+            for s in (client, server):
+                s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            threading.Thread(target=pipe, args=(client, server, up), daemon=True).start()
+            threading.Thread(target=pipe, args=(server, client, down), daemon=True).start()
+
+    threading.Thread(target=accept, daemon=True).start()
+    return listener.getsockname()[1]
+
+
+def serve(program, web_dir, fs_dir):
+    process = subprocess.Popen([program, "serve", "--web", web_dir, "--fs", fs_dir],
+                               stdout=subprocess.PIPE, text=True)
+    url = process.stdout.readline().strip()
+    if not url.startswith("http://"):
+        process.kill()
+        raise SystemExit("first_paint: `program serve` did not start")
+    return process, int(url.rsplit(":", 1)[1].strip("/"))
+
+
+TIMING_JS = """JSON.stringify((() => {
+    const nav = performance.getEntriesByType('navigation')[0];
+    const fcp = performance.getEntriesByName('first-contentful-paint')[0];
+    return [fcp ? fcp.startTime : -1, nav.domContentLoadedEventEnd, nav.loadEventEnd];
+})())"""
+
+
+def measure(url, timeout, on_load):
+    from PySide6.QtCore import QEventLoop, QTimer, QUrl
+    from PySide6.QtWebEngineCore import QWebEnginePage, QWebEngineProfile
+    from PySide6.QtWebEngineWidgets import QWebEngineView
+    import shiboken6
+
+    profile = QWebEngineProfile()  # off the record: empty memory cache
+    page = QWebEnginePage(profile)
+    view = QWebEngineView()
+    view.setPage(page)
+    view.resize(412, 915)  # a phone in portrait
+    view.show()
+
+    result = []
+    wait = QEventLoop()
+
+    def loaded(ok):
+        on_load()
+        # loadEventEnd is only set once the load handler returned
+        QTimer.singleShot(200, lambda: page.runJavaScript(TIMING_JS, lambda r: (result.append(r), wait.quit())))
+
+    page.loadFinished.connect(loaded)
+    QTimer.singleShot(timeout * 1000, wait.quit)
+    page.load(QUrl(url))
+    wait.exec()
+    view.close()
+    # The page must go before its profile
+    shiboken6.delete(view)
+    shiboken6.delete(page)
+    shiboken6.delete(profile)
+    if not result or not result[0]:
+        raise SystemExit("first_paint: %s did not load within %d s" % (url, timeout))
+    return json.loads(result[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Dashboard first paint on a throttled link")
+    parser.add_argument("--program", default=".pio/build/native/program")
+    parser.add_argument("--rate", type=float, default=50, help="link rate in KB/s, each direction (default 50)")
+    parser.add_argument("--rtt", type=float, default=200, help="round-trip time in ms (default 200)")
+    parser.add_argument("--runs", type=int, default=5, help="cold loads per page (default 5)")
+    parser.add_argument("--timeout", type=int, default=60, help="seconds per load (default 60)")
+    args = parser.parse_args()
+
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    os.chdir(project_dir)
+    os.environ.setdefault("QT_QPA_PLATFORM", "offscreen")
+    os.environ.setdefault("QTWEBENGINE_CHROMIUM_FLAGS", "--no-sandbox")
+    from PySide6.QtWidgets import QApplication
+    app = QApplication(sys.argv[:1])  # noqa: F841 (must outlive every view)
+
+    subprocess.check_call([sys.executable, os.path.join("scripts", "build_web.py")], stdout=subprocess.DEVNULL)
+    old_dir = tempfile.mkdtemp(prefix="first_paint_old_")
+    with open(os.path.join(old_dir, "index.html"), "wb") as f:
+        f.write(subprocess.check_output(["git", "show", OLD_PAGE_REV + ":data/index.html"]))
+
+    print("link: %.0f KB/s each way, %.0f ms RTT; median of %d cold loads" % (args.rate, args.rtt, args.runs))
+    print("%-34s %8s %8s %8s %10s" % ("page", "FCP ms", "DCL ms", "load ms", "bytes"))
+    for label, web_dir, fs_dir in (("before: index.html, 1 file", old_dir, "sim_fs/serve-old"),
+                                   ("after: gzip + /assets/, 3 files", "data", "sim_fs/serve")):
+        process, port = serve(args.program, web_dir, fs_dir)
+        try:
+            runs = []
+            bytes_down = []
+            for _ in range(args.runs):
+                up = Link(args.rate * 1024, args.rtt / 2000)
+                down = Link(args.rate * 1024, args.rtt / 2000)
+                proxy_port = start_proxy(port, up, down)
+                # /events and /status keep going after load; count up to load only
+                runs.append(measure("http://127.0.0.1:%d/" % proxy_port, args.timeout,
+                                    lambda: bytes_down.append(down.bytes)))
+            fcp, dcl, load = (statistics.median(r[i] for r in runs) for i in range(3))
+            print("%-34s %8.0f %8.0f %8.0f %10d" % (label, fcp, dcl, load, statistics.median(bytes_down)))
+        finally:
+            process.kill()
+            process.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+#include "Dht22.h"
+
+bool Dht22::begin()
+{
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)pin, channel);
+    config.clk_div = 80;                        // 1 us per tick
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = 100; // APB cycles: drops glitches under 1.25 us
+    config.rx_config.idle_threshold = DHT22_IDLE_US;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 512, 0) != ESP_OK ||
+        rmt_get_ringbuf_handle(channel, &ring) != ESP_OK)
+        return false;
+
+    // Open drain: the pin pulls the line low for the start signal and keeps
+    // feeding the RMT receiver while released
+    gpio_set_pull_mode((gpio_num_t)pin, GPIO_PULLUP_ONLY);
+    gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level((gpio_num_t)pin, 1);
+
+    esp_timer_create_args_t args = {};
+    args.callback = releaseLine;
+    args.arg = this;
+    args.name = "dht22";
+    return esp_timer_create(&args, &timer) == ESP_OK;
+}
+
+bool Dht22::request()
+{
+    unsigned long now = millis();
+    if (!timer || busy() || (started && now - lastStart < DHT22_MIN_INTERVAL) ||
+        (consecutiveFailures > 0 && (long)(now - retryAt) < 0))
+        return false;
+    start(now);
+    return true;
+}
+
+void Dht22::service()
+{
+    unsigned long now = millis();
+    if (state == DHT22_TRANSFER)
+    {
+        size_t length = 0;
+        rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(ring, &length, 0);
+        if (items)
+        {
+            Error result = decode(items, length / sizeof(rmt_item32_t));
+            vRingbufferReturnItem(ring, items);
+            finish(result, now);
+        }
+        else if (now - lastStart >= DHT22_RESPONSE_TIMEOUT)
+            finish(DHT22_NO_RESPONSE, now);
+        return;
+    }
+
+    if (consecutiveFailures > 0 && (long)(now - retryAt) >= 0 && now - lastStart >= DHT22_MIN_INTERVAL)
+        start(now);
+}
+
+void Dht22::releaseLine(void *arg)
+{
+    Dht22 *self = (Dht22 *)arg;
+    gpio_set_level((gpio_num_t)self->pin, 1);
+    rmt_rx_start(self->channel, true);
+}
+
+void Dht22::start(unsigned long now)
+{
+    // A frame left over from a timed-out transfer would be taken for this one
+    size_t length;
+    while (void *stale = xRingbufferReceive(ring, &length, 0))
+        vRingbufferReturnItem(ring, stale);
+
+    state = DHT22_TRANSFER;
+    lastStart = now;
+    started = true;
+    gpio_set_level((gpio_num_t)pin, 0);
+    esp_timer_start_once(timer, DHT22_START_US);
+}
+
+void Dht22::finish(Error result, unsigned long now)
+{
+    esp_timer_stop(timer); // only still armed if this round never got going
+    rmt_rx_stop(channel);
+    gpio_set_level((gpio_num_t)pin, 1);
+    state = DHT22_IDLE;
+    error = result;
+
+    if (result == DHT22_OK)
+    {
+        valid = true;
+        lastGood = now;
+        consecutiveFailures = 0;
+        return;
+    }
+
+    totalFailures++;
+    consecutiveFailures++;
+    unsigned long backoff = DHT22_MIN_INTERVAL << min(consecutiveFailures - 1, (uint32_t)5);
+    retryAt = now + min(backoff, DHT22_RETRY_MAX);
+}
+
+// The reply is an 80 us low/high preamble, then per bit a ~50 us low and a
+// high whose length is the bit, and a final low. Only the high pulses carry
+// data, so the last 40 of them are the bits, whether or not the receiver
+// caught the line before the preamble.
+Dht22::Error Dht22::decode(const rmt_item32_t *items, size_t count)
+{
+    uint16_t highs[48];
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t levels[2] = {items[i].level0, items[i].level1};
+        const uint32_t durations[2] = {items[i].duration0, items[i].duration1};
+        for (int half = 0; half < 2; half++)
+        {
+            if (durations[half] == 0)
+                break; // end of frame
+            if (levels[half] == 1 && durations[half] < DHT22_IDLE_US)
+            {
+                if (found == sizeof(highs) / sizeof(highs[0]))
+                {
+                    memmove(highs, highs + 1, sizeof(highs) - sizeof(highs[0]));
+                    found--;
+                }
+                highs[found++] = durations[half];
+            }
+        }
+    }
+    if (found < 40)
+        return DHT22_SHORT_FRAME;
+
+    uint8_t bytes[5] = {0};
+    const uint16_t *bits = highs + found - 40;
+    for (int i = 0; i < 40; i++)
+        bytes[i / 8] = (bytes[i / 8] << 1) | (bits[i] > DHT22_BIT_ONE_US ? 1 : 0);
+    if ((uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]) != bytes[4])
+        return DHT22_CHECKSUM;
+
+    float humidity = ((bytes[0] << 8) | bytes[1]) / 10.0f;
+    float temperature = (((bytes[2] & 0x7F) << 8) | bytes[3]) / 10.0f;
+    if (bytes[2] & 0x80)
+        temperature = -temperature;
+    if (humidity > 100.0f || temperature < -40.0f || temperature > 80.0f)
+        return DHT22_RANGE;
+
+    lastHumidity = humidity;
+    lastTemperature = temperature;
+    return DHT22_OK;
+}
@@ -0,0 +1,610 @@
+#include "HttpServer.h"
+
+#include <errno.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+    const char *reasonPhrase(int code)
+    {
+        switch (code)
+        {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 416: return "Range Not Satisfiable";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "";
+        }
+    }
+
+    bool parseMethod(const char *name, size_t length, HTTPMethod &method)
+    {
+        static const struct
+        {
+            const char *name;
+            HTTPMethod method;
+        } methods[] = {{"GET", HTTP_GET}, {"HEAD", HTTP_HEAD}, {"POST", HTTP_POST}, {"PUT", HTTP_PUT},
+                       {"PATCH", HTTP_PATCH}, {"DELETE", HTTP_DELETE}, {"OPTIONS", HTTP_OPTIONS}};
+        for (const auto &m : methods)
+        {
+            if (strlen(m.name) == length && strncmp(m.name, name, length) == 0)
+            {
+                method = m.method;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // %XX escapes, and '+' as space in form fields
+    String urlDecode(const char *data, size_t length, bool plusIsSpace)
+    {
+        String out;
+        out.reserve(length);
+        for (size_t i = 0; i < length; i++)
+        {
+            char c = data[i];
+            if (c == '%' && i + 2 < length && hexDigit(data[i + 1]) >= 0 && hexDigit(data[i + 2]) >= 0)
+            {
+                c = (char)(hexDigit(data[i + 1]) * 16 + hexDigit(data[i + 2]));
+                i += 2;
+            }
+            else if (c == '+' && plusIsSpace)
+                c = ' ';
+            out += c;
+        }
+        return out;
+    }
+
+    // Value of header `name` in the header block in[0..end), false if absent
+    bool findHeader(const std::string &in, size_t end, const char *name, String &value)
+    {
+        size_t nameLength = strlen(name);
+        size_t line = in.find("\r\n") + 2;
+        while (line < end)
+        {
+            size_t lineEnd = in.find("\r\n", line);
+            if (lineEnd == std::string::npos || lineEnd > end)
+                lineEnd = end;
+            if (lineEnd - line > nameLength && in[line + nameLength] == ':' &&
+                strncasecmp(in.c_str() + line, name, nameLength) == 0)
+            {
+                size_t start = line + nameLength + 1;
+                while (start < lineEnd && (in[start] == ' ' || in[start] == '\t'))
+                    start++;
+                value = String(in.substr(start, lineEnd - start).c_str());
+                value.trim();
+                return true;
+            }
+            line = lineEnd + 2;
+        }
+        return false;
+    }
+}
+
+void HttpServer::begin()
+{
+    listener.begin();
+}
+
+void HttpServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+    collected.clear();
+    for (size_t i = 0; i < headerKeysCount; i++)
+        collected.push_back(headerKeys[i]);
+}
+
+void HttpServer::on(const char *uri, HTTPMethod method, THandlerFunction handler)
+{
+    routes.push_back({uri, method, handler});
+}
+
+bool HttpServer::hasArg(const String &name) const
+{
+    for (const auto &arg : currentArgs)
+        if (arg.first == name)
+            return true;
+    return false;
+}
+
+String HttpServer::arg(const String &name) const
+{
+    for (const auto &arg : currentArgs)
+        if (arg.first == name)
+            return arg.second;
+    return String();
+}
+
+bool HttpServer::hasHeader(const String &name) const
+{
+    for (const auto &header : currentHeaders)
+        if (strcasecmp(header.first.c_str(), name.c_str()) == 0)
+            return true;
+    return false;
+}
+
+String HttpServer::header(const String &name) const
+{
+    for (const auto &header : currentHeaders)
+        if (strcasecmp(header.first.c_str(), name.c_str()) == 0)
+            return header.second;
+    return String();
+}
+
+// ========== Connections ==========
+void HttpServer::handleClient()
+{
+    accept();
+    for (Connection &c : connections)
+        if (c.state != HTTP_FREE)
+            service(c);
+}
+
+void HttpServer::accept()
+{
+    for (;;)
+    {
+        // A free slot, else the kept-alive connection idle the longest. With
+        // neither, new connections wait in the listen backlog.
+        unsigned long now = millis();
+        Connection *slot = nullptr;
+        for (Connection &c : connections)
+        {
+            if (c.state == HTTP_FREE)
+            {
+                slot = &c;
+                break;
+            }
+            bool idle = c.state == HTTP_READING && c.in.empty() && (c.served || now - c.since >= HTTP_SILENT_EVICT);
+            if (idle && (!slot || now - c.since > now - slot->since))
+                slot = &c;
+        }
+        if (!slot)
+            return;
+
+        WiFiClient incoming = listener.available();
+        if (!incoming)
+            return;
+        if (slot->state != HTTP_FREE)
+            close(*slot);
+
+        slot->client = incoming;
+        slot->state = HTTP_READING;
+        slot->since = now;
+        slot->served = false;
+    }
+}
+
+void HttpServer::service(Connection &c)
+{
+    if (c.state == HTTP_READING)
+        readRequest(c);
+    if (c.state != HTTP_SENDING)
+        return;
+
+    flush(c);
+    // Nothing is sent while a body waits for data, so a closed client would
+    // only show up once there is something to send again
+    if (c.fillWaiting && !c.client.connected())
+    {
+        close(c);
+        return;
+    }
+    if (c.fill && c.outSent == c.out.size() && !c.failed)
+    {
+        produceSlice(c);
+        flush(c);
+    }
+
+    if (c.failed || (c.outSent < c.out.size() && millis() - c.since >= HTTP_SEND_TIMEOUT))
+    {
+        close(c);
+        return;
+    }
+    if (c.outSent < c.out.size() || c.fill)
+        return;
+
+    // Response complete
+    if (!c.keepAlive)
+    {
+        close(c);
+        return;
+    }
+    c.state = HTTP_READING;
+    c.since = millis();
+    c.served = true;
+}
+
+bool HttpServer::readRequest(Connection &c)
+{
+    char buffer[512];
+    while (c.in.size() < HTTP_REQUEST_MAX)
+    {
+        ssize_t got = ::recv(c.client.fd(), buffer, min(sizeof(buffer), HTTP_REQUEST_MAX - c.in.size()), MSG_DONTWAIT);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            close(c); // closed by the client, or reset
+            return false;
+        }
+        if (got < 0)
+            break;
+        if (c.in.empty())
+            c.since = millis(); // idle time over, request time starts
+        c.in.append(buffer, got);
+    }
+
+    unsigned long elapsed = millis() - c.since;
+    if (c.in.empty())
+    {
+        if (elapsed >= HTTP_KEEPALIVE_TIMEOUT)
+            close(c);
+        return false;
+    }
+
+    size_t end = c.in.find("\r\n\r\n");
+    if (end == std::string::npos)
+    {
+        if (c.in.size() >= HTTP_REQUEST_MAX)
+            reject(c, 431);
+        else if (elapsed >= HTTP_REQUEST_TIMEOUT)
+            reject(c, 408);
+        return false;
+    }
+
+    // Request bodies must come with Content-Length (browsers always send one)
+    String value;
+    if (findHeader(c.in, end, "Transfer-Encoding", value))
+    {
+        reject(c, 501);
+        return false;
+    }
+    size_t headerLength = end + 4;
+    size_t bodyLength = findHeader(c.in, end, "Content-Length", value) ? strtoul(value.c_str(), NULL, 10) : 0;
+    if (bodyLength > HTTP_REQUEST_MAX - headerLength)
+    {
+        reject(c, 413);
+        return false;
+    }
+    if (c.in.size() < headerLength + bodyLength)
+    {
+        if (elapsed >= HTTP_REQUEST_TIMEOUT)
+            reject(c, 408);
+        return false;
+    }
+
+    handleRequest(c, headerLength, bodyLength);
+    return true;
+}
+
+void HttpServer::handleRequest(Connection &c, size_t headerLength, size_t bodyLength)
+{
+    // ---------- Request line: METHOD target HTTP/1.x ----------
+    size_t lineEnd = c.in.find("\r\n");
+    size_t methodEnd = c.in.find(' ');
+    size_t targetEnd = methodEnd < lineEnd ? c.in.find(' ', methodEnd + 1) : std::string::npos;
+    if (targetEnd >= lineEnd || c.in.compare(targetEnd + 1, 7, "HTTP/1.") != 0)
+    {
+        reject(c, 400);
+        return;
+    }
+    HTTPMethod method;
+    if (!parseMethod(c.in.c_str(), methodEnd, method))
+    {
+        reject(c, 501);
+        return;
+    }
+
+    currentMethod = method;
+    http10 = c.in.compare(targetEnd + 1, 8, "HTTP/1.0") == 0;
+    currentArgs.clear();
+    currentHeaders.clear();
+
+    const char *target = c.in.c_str() + methodEnd + 1;
+    size_t targetLength = targetEnd - methodEnd - 1;
+    const char *query = (const char *)memchr(target, '?', targetLength);
+    size_t pathLength = query ? query - target : targetLength;
+    currentUri = urlDecode(target, pathLength, false);
+    if (query)
+        parseArgs(query + 1, targetLength - pathLength - 1);
+
+    // ---------- Headers ----------
+    String value;
+    String connection = findHeader(c.in, headerLength - 4, "Connection", value) ? value : String();
+    connection.toLowerCase();
+    c.keepAlive = http10 ? connection.indexOf("keep-alive") >= 0 : connection.indexOf("close") < 0;
+    for (const String &key : collected)
+        if (findHeader(c.in, headerLength - 4, key.c_str(), value))
+            currentHeaders.push_back({key, value});
+
+    // ---------- Body: form fields become args, anything else is "plain" ----------
+    if (bodyLength > 0)
+    {
+        const char *body = c.in.c_str() + headerLength;
+        String type = findHeader(c.in, headerLength - 4, "Content-Type", value) ? value : String();
+        if (type.length() == 0 || type.startsWith("application/x-www-form-urlencoded"))
+            parseArgs(body, bodyLength);
+        else
+        {
+            String plain;
+            plain.reserve(bodyLength);
+            for (size_t i = 0; i < bodyLength; i++)
+                plain += body[i];
+            currentArgs.push_back({"plain", plain});
+        }
+    }
+    c.in.erase(0, headerLength + bodyLength); // a pipelined request stays for the next round
+
+    // ---------- Run the handler ----------
+    THandlerFunction handler = notFound;
+    for (const Route &route : routes)
+    {
+        if (route.uri == currentUri && (route.method == HTTP_ANY || route.method == method))
+        {
+            handler = route.handler;
+            break;
+        }
+    }
+
+    current = &c;
+    c.state = HTTP_SENDING;
+    c.since = millis();
+    responseHeaders = "";
+    contentLength_ = CONTENT_LENGTH_NOT_SET;
+    responded = false;
+    chunked = false;
+
+    if (handler)
+        handler();
+    else
+        send(404, "text/plain", "Not found");
+    finishResponse(c);
+
+    current = nullptr;
+    currentArgs.clear();
+    currentHeaders.clear();
+}
+
+void HttpServer::finishResponse(Connection &c)
+{
+    if (!responded)
+        c.keepAlive = false; // nothing was sent, so closing is the only answer
+    if (chunked)
+        sendContent("", 0); // handler left the chunked body open
+    flush(c);
+}
+
+void HttpServer::parseArgs(const char *data, size_t length)
+{
+    const char *end = data + length;
+    while (data < end)
+    {
+        const char *next = (const char *)memchr(data, '&', end - data);
+        if (!next)
+            next = end;
+        const char *eq = (const char *)memchr(data, '=', next - data);
+        const char *nameEnd = eq ? eq : next;
+        if (nameEnd > data)
+        {
+            String value = eq ? urlDecode(eq + 1, next - eq - 1, true) : String();
+            currentArgs.push_back({urlDecode(data, nameEnd - data, true), value});
+        }
+        data = next + 1;
+    }
+}
+
+// Fills the queue with the next slice of a long body. Chunk sizes are
+// written into the space left in front of the data, so a slice is one send().
+void HttpServer::produceSlice(Connection &c)
+{
+    const size_t headRoom = 8; // "400\r\n" for HTTP_SLICE_SIZE, with room to spare
+    size_t room = c.fillChunked ? HTTP_SLICE_SIZE : min((size_t)HTTP_SLICE_SIZE, c.fillRemaining);
+    c.out.resize(headRoom + room + 2);
+    size_t got = room ? c.fill((uint8_t *)&c.out[headRoom], room) : 0;
+    c.fillWaiting = got == HTTP_BODY_LATER;
+    if (c.fillWaiting)
+    {
+        c.out.clear();
+        c.outSent = 0;
+        return;
+    }
+    if (got > room)
+        got = room;
+
+    if (c.fillChunked)
+    {
+        if (got == 0)
+        {
+            c.out.assign("0\r\n\r\n");
+            c.outSent = 0;
+            c.fill = nullptr;
+            return;
+        }
+        char head[headRoom];
+        int headLength = snprintf(head, sizeof(head), "%x\r\n", (unsigned)got);
+        memcpy(&c.out[headRoom - headLength], head, headLength);
+        c.outSent = headRoom - headLength;
+        c.out.resize(headRoom + got);
+        c.out.append("\r\n");
+        return;
+    }
+
+    c.outSent = headRoom;
+    c.out.resize(headRoom + got);
+    c.fillRemaining -= got;
+    if (got == 0 || c.fillRemaining == 0)
+    {
+        if (c.fillRemaining > 0)
+            c.keepAlive = false; // body ended early: only closing tells the client
+        c.fill = nullptr;
+    }
+}
+
+void HttpServer::flush(Connection &c)
+{
+    while (!c.failed && c.outSent < c.out.size())
+    {
+        ssize_t sent = ::send(c.client.fd(), c.out.data() + c.outSent, c.out.size() - c.outSent,
+                              MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return; // socket buffer full; the rest goes out on a later round
+            c.failed = true;
+            c.fill = nullptr;
+            break;
+        }
+        c.outSent += sent;
+        c.since = millis();
+    }
+    c.out.clear();
+    c.outSent = 0;
+}
+
+void HttpServer::close(Connection &c)
+{
+    c.client.stop();
+    c.state = HTTP_FREE;
+    std::string().swap(c.in);
+    std::string().swap(c.out);
+    c.outSent = 0;
+    c.fill = nullptr;
+    c.fillWaiting = false;
+    c.failed = false;
+}
+
+void HttpServer::reject(Connection &c, int code)
+{
+    char response[96];
+    int length = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nConnection: close\r\nContent-Length: 0\r\n\r\n",
+                          code, reasonPhrase(code));
+    c.in.clear();
+    c.out.assign(response, length);
+    c.outSent = 0;
+    c.keepAlive = false;
+    c.state = HTTP_SENDING;
+    c.since = millis();
+    flush(c);
+}
+
+// ========== Response ==========
+void HttpServer::sendHeader(const String &name, const String &value, bool first)
+{
+    String line = name + ": " + value + "\r\n";
+    if (first)
+        responseHeaders = line + responseHeaders;
+    else
+        responseHeaders += line;
+}
+
+void HttpServer::beginResponse(int code, const char *contentType, size_t contentLength)
+{
+    responded = true;
+    chunked = false;
+
+    char line[48];
+    snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+    String head = line;
+    if (contentType && *contentType)
+        head += String("Content-Type: ") + contentType + "\r\n";
+    if (contentLength == CONTENT_LENGTH_UNKNOWN)
+    {
+        if (http10)
+            current->keepAlive = false; // no chunked encoding: the end of the body is the end of the connection
+        else
+        {
+            head += "Transfer-Encoding: chunked\r\n";
+            chunked = true;
+        }
+    }
+    else
+        head += "Content-Length: " + String((unsigned long)contentLength) + "\r\n";
+    if (cors)
+        head += "Access-Control-Allow-Origin: *\r\n"
+                "Access-Control-Allow-Methods: *\r\n"
+                "Access-Control-Allow-Headers: *\r\n";
+    head += responseHeaders;
+    head += current->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    queue(head.c_str(), head.length());
+}
+
+void HttpServer::queue(const char *data, size_t length)
+{
+    if (current && !current->failed)
+        current->out.append(data, length);
+}
+
+void HttpServer::send(int code, const char *contentType, const String &content)
+{
+    send_P(code, contentType, content.c_str(), content.length());
+}
+
+void HttpServer::send_P(int code, const char *contentType, const char *content, size_t contentLength)
+{
+    if (!current || responded)
+        return;
+    beginResponse(code, contentType, contentLength_ == CONTENT_LENGTH_NOT_SET ? contentLength : contentLength_);
+    if (contentLength > 0)
+        sendContent(content, contentLength);
+    flush(*current); // headers and a short body leave in one segment, before the handler goes on
+}
+
+void HttpServer::sendContent(const char *content, size_t contentLength)
+{
+    if (!current)
+        return;
+    if (!chunked)
+        queue(content, contentLength);
+    else if (contentLength == 0)
+    {
+        queue("0\r\n\r\n", 5);
+        chunked = false;
+    }
+    else
+    {
+        char head[12];
+        int headLength = snprintf(head, sizeof(head), "%x\r\n", (unsigned)contentLength);
+        queue(head, headLength);
+        queue(content, contentLength);
+        queue("\r\n", 2);
+    }
+    if (current->out.size() - current->outSent >= HTTP_SLICE_SIZE)
+        flush(*current);
+}
+
+void HttpServer::sendBody(int code, const char *contentType, size_t length, BodyFiller fill)
+{
+    if (!current || responded)
+        return;
+    beginResponse(code, contentType, length);
+    current->fill = fill;
+    current->fillChunked = chunked;
+    current->fillRemaining = length;
+    chunked = false; // the framing is produceSlice()'s job from here on
+    flush(*current);
+}
@@ -1,17 +1,23 @@
 #include <Arduino.h>
-#include <DHT.h>
 #include <RTClib.h>
 #include <Wire.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <esp_task_wdt.h>
 #include <BH1750.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "Dht22.h"
+#include "HttpServer.h"
+#include "StatusCache.h"
 
 // ========== PIN CONFIGURATION ==========
 #define DHTPIN 4
-#define DHTTYPE DHT22
 #define SOIL1_MOISTURE_PIN 12
 #define SOIL2_MOISTURE_PIN 25
 #define SOIL3_MOISTURE_PIN 26
@@ -23,7 +29,10 @@
 #define SOIL9_MOISTURE_PIN 36
 #define SOIL10_MOISTURE_PIN 39
 #define PUMP_PIN 19
-#define SOLENOID_PIN 18
+#define ZONE1_VALVE_PIN 18 // solenoid lama; satu zona berisi semua sensor = perilaku sebelum ada zona
+#define ZONE2_VALVE_PIN 17
+#define ZONE3_VALVE_PIN 16
+#define ZONE4_VALVE_PIN 23
 
 // ========== RELAY CONTROL ==========
 #define PUMP_ON LOW
@@ -33,50 +42,261 @@
 
 // ========== SYSTEM CONFIGURATION ==========
 #define CONFIG_FILE "/config.json"
+#define CONFIG_TEMP_FILE "/config.json.tmp" // saveConfig() writes here, then renames over CONFIG_FILE
+#define CONFIG_BAD_FILE "/config.bad"       // a config.json that failed its CRC, kept for inspection
+#define CONFIG_VERSION 2                    // 1 = before "version" (two fixed irrigation times), 2 = field table + CRC
+#define CONFIG_CRC_TRAILER_SIZE 18          // ,"crc":"xxxxxxxx"}
 #define SERIAL_BUFFER_SIZE 100
 #define WDT_TIMEOUT 180 // 3 minutes watchdog timeout
 #define MINIMUM_INTERVAL 1000UL
+#ifndef COOLDOWN_TIME
 #define COOLDOWN_TIME 300000UL // 5 minutes
+#endif
 #define DATA_LOG_INTERVAL 3600000
-#define DATA_LOG_FILE "/data_log.csv"
+#define DATA_LOG_FILE "/data_log.csv" // format lama, dikonversi sekali ke DATA_DIR saat boot
+#define DATA_DIR "/tsdb"
+#define DATA_SEGMENT_RECORDS 1024      // 24 KB per segment, ~6 minggu data per jam
+#define DATA_SEGMENT_MAGIC 0x4C44534EUL // "NSDL"
+#define DATA_FORMAT_VERSION 1
+#define FS_BLOCK_SIZE 4096             // LittleFS mengalokasikan file per blok 4 KB
+#define DOWNLOAD_INDEX_STRIDE 64       // /data/download: panjang CSV dicatat per 64 record (dasar Range dan Content-Length)
+#define DOWNLOAD_INDEX_BLOCKS (DATA_SEGMENT_RECORDS / DOWNLOAD_INDEX_STRIDE)
+#define QUERY_MAX_BUCKETS 1000         // /data/query: step diperbesar jika rentang menghasilkan lebih banyak bucket
+#define QUERY_DEFAULT_BUCKETS 200      // /data/query tanpa step
+#define QUERY_FIELD_COUNT 15
+#define LOG_FILE_PREFIX "log_"         // log harian: /log_YYYYMMDD.txt
+#define LOG_STAGE_SIZE 2048            // ukuran tiap buffer staging log harian (ada 2, bergantian)
+#define LOG_FLUSH_INTERVAL 60000UL     // baris log paling lama 60 detik di RAM sebelum ditulis ke flash
+#define DATA_CSV_HEADER "DateTime,Temperature(C),Humidity(%),Lux,SoilMoisture1(%),SoilMoisture2(%),SoilMoisture3(%),SoilMoisture4(%),SoilMoisture5(%),SoilMoisture6(%),SoilMoisture7(%),SoilMoisture8(%),SoilMoisture9(%),SoilMoisture10(%),WateringCountToday"
+
+// ========== ADAPTIVE CONTROL ==========
+#define LEARN_FILE "/learn.json"         // gain hasil belajar per zona, terpisah dari config.json
+#define LEARN_TEMP_FILE "/learn.json.tmp"
+#define ADAPTIVE_SETTLE_MS 120000UL      // air perlu menyebar dulu sebelum kenaikan kelembaban diukur
+#define ADAPTIVE_GAIN_ALPHA 0.3f         // bobot siklus terbaru pada rata-rata gain
+#define ADAPTIVE_MIN_RUN_MS 5000UL
+#define ADAPTIVE_MAX_RUN_FACTOR 3        // siklus terpanjang = 3x durasi zona
+
+// ========== IRRIGATION SCHEDULE ==========
+#define SCHEDULE_SLOT_MAX 8
+#define SCHEDULE_ALL_DAYS 0x7F // bit 0 = Minggu ... bit 6 = Sabtu (DateTime::dayOfTheWeek)
+#define SCHEDULE_GRACE_S 900   // slot yang terlewat (loop macet, RTC maju, listrik padam) masih dijalankan sampai 15 menit kemudian
+#define SCHEDULE_STATE_FILE "/schedule.json" // waktu event terakhir per slot, agar slot yang jatuh saat mati listrik tidak hilang
+#define SCHEDULE_STATE_TEMP_FILE "/schedule.json.tmp"
+
+// ========== IRRIGATION ZONES ==========
+#define ZONE_COUNT_MAX 4
+#define ZONE_ALL_SENSORS 0x03FF // bit 0 = SOIL1 ... bit 9 = SOIL10
+
+// ========== SOIL SAMPLER ==========
+#define SOIL_CHANNEL_COUNT 10
+#define SOIL_SAMPLE_PERIOD_MS 50    // satu sampel per channel tiap 50 ms, terus-menerus di sensorTask
+#define SOIL_FILTER_WINDOW 10       // ring per channel: window mean/median maks. 10 sampel
+#define SOIL_OVERSAMPLE_MAX 16      // analogRead berturut-turut yang dirata-rata menjadi satu sampel
+#define SOIL_EMA_SHIFT_MAX 6        // EMA alpha = 1/2^shift (1/64 = ~3 s pada 50 ms)
+#define SOIL_PERCENT_MAX 50         // kelembapan tanah dilaporkan 0..50 (basah penuh = 50)
+
+// ========== SOIL CALIBRATION ==========
+#define SOIL_CAL_POINTS 4 // titik kurva per probe: kering, 2 titik tengah, basah
+#define SOIL_LUT_SHIFT 4  // LUT per 16 hitungan ADC: 4096 >> 4 = 256 entri per channel
+#define SOIL_LUT_SIZE (4096 >> SOIL_LUT_SHIFT)
+
+// ========== SOIL HEALTH ==========
+#define SOIL_FAULT_RAIL 0x01    // ADC di ujung rentang: probe lepas atau kabel short
+#define SOIL_FAULT_STUCK 0x02   // rata-rata ADC sama persis selama SOIL_STUCK_CYCLES pengukuran
+#define SOIL_FAULT_RATE 0x04    // lompatan > SOIL_RATE_MAX_STEP dari nilai terakhir, ditahan satu pengukuran
+#define SOIL_FAULT_OUTLIER 0x08 // jauh dari median probe lain di zona yang sama
+#define SOIL_RAIL_LOW 32        // ADC <= ini dianggap menempel GND
+#define SOIL_RAIL_HIGH 4063     // ADC >= ini dianggap menempel 3.3V
+#define SOIL_STUCK_CYCLES 20    // probe hidup tidak pernah memberi rata-rata yang sama 20x berturut-turut
+#define SOIL_RATE_MAX_STEP 10   // % per pengukuran (skala 0..50)
+#define SOIL_OUTLIER_MAD_SCALE 4    // ~3 sigma: 3 x 1.4826 x MAD
+#define SOIL_OUTLIER_MIN_SPREAD 8   // % minimum, karena MAD = 0 saat semua probe sama
+#define SOIL_OUTLIER_MIN_CHANNELS 3 // median butuh minimal 3 probe sehat
+
+// ========== SENSOR TASK ==========
+#define SENSOR_TASK_CORE 0 // loop() (HTTP + pompa) tetap di core 1
+#define SENSOR_TASK_STACK 4096
+#define SENSOR_TASK_PRIORITY 1
+
+// ========== I2C BUS ==========
+#define RTC_SYNC_INTERVAL 60000UL // DS3231 dibaca sekali per menit; di antaranya waktu diinterpolasi dengan millis()
+#define RTC_ERROR_RETRY 5000UL    // setelah error I2C, sync berikutnya dicoba lebih cepat
+#define RTC_DRIFT_LIMIT_S 1       // selisih cache vs DS3231 di atas ini bukan lagi fase sub-detik: dicatat dan waktu diloncatkan
+#define I2C_TX_PROBE 1            // rtc.begin() / lightMeter.begin(): satu transaksi tulis
+#define I2C_TX_RTC_READ 2         // rtc.now(): tulis pointer register + baca 7 byte
+#define I2C_TX_RTC_LOST_POWER 2   // rtc.lostPower(): baca register status
+#define I2C_TX_RTC_ADJUST 4       // rtc.adjust(): tulis 7 byte + baca/tulis register status (flag OSF)
+#define I2C_TX_LUX_READ 1         // readLightLevel() mode continuous: baca 2 byte
+
+// ========== STATIC ASSETS ==========
+#define ASSET_PREFIX "/assets/" // app.<hash>.css/.js dari scripts/build_web.py: nama berubah jika isinya berubah
+#define ASSET_CACHE_CONTROL "public, max-age=31536000, immutable"
+
+// ========== SERVER-SENT EVENTS ==========
+#define SSE_MAX_CLIENTS 4              // stream /events terbuka sekaligus; masing-masing memakai satu koneksi HTTP_MAX_CLIENTS
+#define SSE_KEEPALIVE_INTERVAL 15000UL // comment line to detect dead clients
 
 // ========== GLOBAL OBJECTS ==========
-DHT dht(DHTPIN, DHTTYPE);
+Dht22 dht(DHTPIN);
 RTC_DS3231 rtc;
 BH1750 lightMeter;
-WebServer server(80);
+HttpServer server(80);
+
+// ========== I2C BUS ==========
+// Wire is shared by the DS3231 and the BH1750 and used from both cores, so
+// every transaction goes through i2cBegin()/i2cEnd(). Nothing reads the
+// DS3231 on demand: the time is a cache that serviceI2cBus() (sensorTask)
+// resyncs once per RTC_SYNC_INTERVAL and clockEpoch() moves on with millis().
+struct I2cBus
+{
+    SemaphoreHandle_t lock = nullptr;
+    uint32_t transactions = 0; // since boot
+    uint32_t errors = 0;       // failed DS3231/BH1750 transfers since boot
+    uint32_t lastHour = 0;     // transactions in the last full hour of uptime
+    uint32_t hourStartCount = 0;
+    unsigned long hourStart = 0;
+
+    // Time cache: the DS3231 said `syncEpoch` at millis() `syncMillis`
+    uint32_t syncEpoch = 0;
+    unsigned long syncMillis = 0;
+    unsigned long lastSync = 0; // millis() of the last sync attempt
+    bool synced = false;        // the cache holds a real time; until then nothing is stamped or scheduled
+    bool syncFailed = false;    // last read was an I2C error: retry after RTC_ERROR_RETRY
+    int32_t lastDrift = 0;      // DS3231 minus cache at the last sync, in s
+    uint32_t driftSteps = 0;    // syncs that had to step the time by more than RTC_DRIFT_LIMIT_S
+} i2cBus;
+portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED; // the time cache and sync results are shared by both cores
 
 // ========== SENSOR DATA ==========
+// `data` is the working copy owned by sensorTask (core 0). Everything running
+// from loop() reads the published copy through readSensorSnapshot().
 struct SensorData
 {
     float temperature = 0.0f;
     float humidity = 0.0f;
     float lux = 0.0f;
-    int soilMoisture1 = 0;
-    int soilMoisture2 = 0;
-    int soilMoisture3 = 0;
-    int soilMoisture4 = 0;
-    int soilMoisture5 = 0;
-    int soilMoisture6 = 0;
-    int soilMoisture7 = 0;
-    int soilMoisture8 = 0;
-    int soilMoisture9 = 0;
-    int soilMoisture10 = 0;
+    int soilMoisture[SOIL_CHANNEL_COUNT] = {0}; // SOIL1..SOIL10 (%)
+    uint16_t soilRaw[SOIL_CHANNEL_COUNT] = {0}; // rata-rata ADC siklus terakhir, untuk kalibrasi
+    uint8_t soilFault[SOIL_CHANNEL_COUNT] = {0}; // SOIL_FAULT_*; channel dengan flag tidak dipakai kontrol
+    int32_t dhtAge = -1;      // detik sejak pembacaan DHT22 valid terakhir saat pengukuran, -1 = belum pernah
+    uint32_t dhtFailures = 0; // kegagalan DHT22 berturut-turut
+    uint32_t dhtErrors = 0;   // kegagalan DHT22 sejak boot
     unsigned long lastMeasurement = 0;
-    unsigned long lastDataLog = 0;
 } data;
 
+// Sequence lock: odd seq = sensorTask is writing, readers retry until they
+// copy the value under a stable, even sequence number.
+struct SensorSnapshot
+{
+    std::atomic<uint32_t> seq{0};
+    SensorData value;
+} sensorSnapshot;
+
+unsigned long lastDataLog = 0; // owned by loop()
+
+const uint8_t soilPins[SOIL_CHANNEL_COUNT] = {
+    SOIL1_MOISTURE_PIN, SOIL2_MOISTURE_PIN, SOIL3_MOISTURE_PIN, SOIL4_MOISTURE_PIN,
+    SOIL5_MOISTURE_PIN, SOIL6_MOISTURE_PIN, SOIL7_MOISTURE_PIN, SOIL8_MOISTURE_PIN,
+    SOIL9_MOISTURE_PIN, SOIL10_MOISTURE_PIN
+};
+
+// Streaming ADC filter of one channel: window stage (mean or median of the
+// newest samples in the ring), then an EMA. `value` is always the latest output.
+struct SoilFilter
+{
+    uint16_t ring[SOIL_FILTER_WINDOW];
+    uint8_t head;  // next slot to write
+    uint8_t count; // valid samples in the ring
+    int32_t ema;   // ADC << 8: keeps the resolution gained by oversampling
+    uint16_t value;
+};
+
+// Background soil sampler: sensorTask feeds every channel's filter each
+// SOIL_SAMPLE_PERIOD_MS, so a measurement never waits for the ADC.
+struct SoilSampler
+{
+    unsigned long lastRound = 0;
+    SoilFilter filters[SOIL_CHANNEL_COUNT] = {};
+} soilSampler;
+
+// Per-channel history for the health checks, owned by sensorTask. A few bytes
+// per channel, updated once per measurement.
+struct SoilHealth
+{
+    uint16_t lastRaw = 0;
+    uint8_t sameCount = 0;   // consecutive cycles with an identical raw average
+    bool held = false;       // previous reading was rejected by the rate check
+    int8_t lastPercent = -1; // last accepted %, -1 = none since boot or a rail fault
+    uint8_t fault = 0;       // flags of the previous cycle, to log changes only
+} soilHealth[SOIL_CHANNEL_COUNT];
+
 // ========== WATERING MODE ==========
 enum WateringMode
 {
     MODE_SCHEDULE = 0, // only run on schedule (07:00 & 16:00)
     MODE_MOISTURE = 1, // only run based on soil moisture threshold
-    MODE_BOTH = 2      // moisture first, schedule as fallback
+    MODE_BOTH = 2,     // moisture first, schedule as fallback
+    MODE_ADAPTIVE = 3  // moisture band; run length from the learned soil response
 };
 
 // ========== CONFIGURATION ==========
+// One solenoid valve and the soil channels behind it. The pump feeds one zone
+// at a time. A 0 in threshold/duration/cooldown/debounce means "use the global
+// value", so zone 1 with every sensor behaves like the old single solenoid.
+struct ZoneConfig
+{
+    bool enabled;
+    uint8_t valvePin;
+    uint16_t sensors;       // ZONE_ALL_SENSORS bitmask
+    int threshold;          // %, 0 = config.threshold
+    unsigned long duration; // ms, 0 = config.pumpDuration
+    unsigned long cooldown; // ms, 0 = COOLDOWN_TIME
+    uint8_t debounce;       // pemeriksaan berturut-turut, 0 = MOISTURE_DEBOUNCE_COUNT
+};
+
+// One row of the irrigation schedule
+struct ScheduleSlot
+{
+    bool enabled;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t days;           // SCHEDULE_ALL_DAYS bitmask
+    unsigned long duration; // ms per zone, 0 = zone duration
+    uint8_t zones;          // bitmask, bit 0 = zona 1; 0 = semua zona aktif
+};
+
+// Piecewise-linear curve of one soil probe. Fewer than 2 points = the global
+// config.dry/config.wet pair. Points are kept sorted from dry (high ADC) to wet.
+struct SoilCalibration
+{
+    uint8_t points;
+    uint16_t raw[SOIL_CAL_POINTS];
+    uint8_t percent[SOIL_CAL_POINTS]; // 0..SOIL_PERCENT_MAX
+};
+
+enum SoilFilterMode : uint8_t
+{
+    SOIL_FILTER_MEAN = 0,  // boxcar, like the old 10-sample average
+    SOIL_FILTER_MEDIAN = 1 // drops single-sample ADC spikes
+};
+
+// Per-channel filter settings, see SoilFilter
+struct SoilFilterConfig
+{
+    uint8_t mode = SOIL_FILTER_MEDIAN;
+    uint8_t window = 5;     // samples in the mean/median, 1 = no window stage
+    uint8_t emaShift = 2;   // EMA alpha = 1/2^emaShift, 0 = no EMA
+    uint8_t oversample = 4; // analogRead()s averaged into one sample
+};
+
+// Output pins that may drive a zone valve (no strapping, ADC or I2C pins)
+const uint8_t zoneValvePinChoices[] = {18, 17, 16, 23, 5, 13, 14};
+
 struct Config
 {
+    int version = CONFIG_VERSION; // schema of the file this was loaded from, see migrateConfig()
     // Moisture threshold (%) for automatic watering mode
     int threshold = 30;
     // Active watering strategy (see WateringMode)
@@ -86,24 +306,228 @@ struct Config
     int pumpDuration = 60000;
     int measurementInterval = 60000;
     int dataLogInterval = 3600000;
-    int irrigationHour1 = 7;   // Jadwal penyiraman 1 - jam
-    int irrigationMinute1 = 0; // Jadwal penyiraman 1 - menit
-    int irrigationSecond1 = 0; // Jadwal penyiraman 1 - detik
-    int irrigationHour2 = 16;  // Jadwal penyiraman 2 - jam
-    int irrigationMinute2 = 0; // Jadwal penyiraman 2 - menit
-    int irrigationSecond2 = 0; // Jadwal penyiraman 2 - detik
+    int storageBudgetKB = 768; // Batas total segment data + log harian di LittleFS
+    int retentionDays = 365;   // Data dan log harian yang lebih tua dihapus
+    int moistureBand = 10;     // MODE_ADAPTIVE: target = threshold .. threshold + band (%)
+    ZoneConfig zones[ZONE_COUNT_MAX] = {
+        {true, ZONE1_VALVE_PIN, ZONE_ALL_SENSORS, 0, 0, 0, 0},
+        {false, ZONE2_VALVE_PIN, 0, 0, 0, 0, 0},
+        {false, ZONE3_VALVE_PIN, 0, 0, 0, 0, 0},
+        {false, ZONE4_VALVE_PIN, 0, 0, 0, 0, 0}};
+    ScheduleSlot schedule[SCHEDULE_SLOT_MAX] = {
+        {true, 7, 0, 0, SCHEDULE_ALL_DAYS, 0, 0},   // Jadwal penyiraman 1
+        {true, 16, 0, 0, SCHEDULE_ALL_DAYS, 0, 0}}; // Jadwal penyiraman 2
+    SoilCalibration soilCalibration[SOIL_CHANNEL_COUNT] = {}; // semua 0 = pakai dry/wet global
+    SoilFilterConfig soilFilter[SOIL_CHANNEL_COUNT];
 } config;
 
+// ADC -> % per channel, rebuilt by buildSoilLut() whenever the calibration changes.
+// sensorTask reads single bytes while loop() rewrites them: a conversion during a
+// rebuild gives the old or the new value of that bin, never a torn one.
+uint8_t soilLut[SOIL_CHANNEL_COUNT][SOIL_LUT_SIZE];
+
+// ========== CONFIG FIELDS ==========
+// One row per persisted setting. The tables drive config.json parsing and
+// writing, /config and /settings, so a new setting is one CONFIG_FIELD line
+// (plus its member in Config, ZoneConfig or ScheduleSlot).
+enum ConfigFieldType : uint8_t
+{
+    FIELD_BOOL,
+    FIELD_U8,
+    FIELD_U16,
+    FIELD_INT,
+    FIELD_ULONG
+};
+
+template <class T> struct ConfigFieldTypeOf;
+template <> struct ConfigFieldTypeOf<bool> { static constexpr uint8_t value = FIELD_BOOL; };
+template <> struct ConfigFieldTypeOf<uint8_t> { static constexpr uint8_t value = FIELD_U8; };
+template <> struct ConfigFieldTypeOf<uint16_t> { static constexpr uint8_t value = FIELD_U16; };
+template <> struct ConfigFieldTypeOf<int> { static constexpr uint8_t value = FIELD_INT; };
+template <> struct ConfigFieldTypeOf<unsigned long> { static constexpr uint8_t value = FIELD_ULONG; };
+
+// Flags
+#define FIELD_LEGACY 0x01     // read from old files and clients, never written
+#define FIELD_INDEX_LIST 0x02 // /settings takes "1-5,7" instead of a bitmask
+#define FIELD_CLAMP 0x04      // /settings clamps values outside the range instead of ignoring them
+
+// Groups: which "Update ..." line handleSettings() logs when the field changes
+#define CFG_THRESHOLD 0x0001
+#define CFG_MODE 0x0002
+#define CFG_PUMP_DURATION 0x0004
+#define CFG_MEASUREMENT 0x0008
+#define CFG_DATA_LOG 0x0010
+#define CFG_CALIBRATION 0x0020
+#define CFG_STORAGE 0x0040
+#define CFG_ZONES 0x0080
+#define CFG_SCHEDULE 0x0100
+#define CFG_FILTER 0x0200
+
+struct ConfigField
+{
+    const char *key;   // config.json / "/config"
+    const char *arg;   // "/settings" argument (suffix after zoneN / slotN), nullptr = not settable
+    uint16_t offset;
+    uint8_t type;
+    uint8_t flags;
+    long min;          // loaded values are clamped, /settings values outside are ignored (or clamped, FIELD_CLAMP)
+    long max;
+    uint16_t argScale; // /settings unit -> stored unit, e.g. 1000 for seconds -> ms
+    uint16_t group;
+};
+
+#define CONFIG_FIELD(S, member, key, arg, min, max, argScale, group, flags) \
+    {key, arg, (uint16_t)offsetof(S, member),                                        \
+     ConfigFieldTypeOf<std::remove_reference<decltype(S::member)>::type>::value, flags, min, max, argScale, group}
+
+const ConfigField configFields[] = {
+    CONFIG_FIELD(Config, version, "version", nullptr, 1, 255, 1, 0, 0),
+    CONFIG_FIELD(Config, threshold, "threshold", "threshold", 0, SOIL_PERCENT_MAX, 1, CFG_THRESHOLD, 0),
+    CONFIG_FIELD(Config, wateringMode, "wateringMode", "wateringMode", MODE_SCHEDULE, MODE_ADAPTIVE, 1, CFG_MODE, 0),
+    CONFIG_FIELD(Config, dry, "dry", "dry", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(Config, wet, "wet", "wet", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(Config, pumpDuration, "pumpDuration", "pumpDuration", 1000, 600000, 1, CFG_PUMP_DURATION, 0),
+    CONFIG_FIELD(Config, measurementInterval, "measurementInterval", "measurementInterval", MINIMUM_INTERVAL, 3600000, 1000, CFG_MEASUREMENT, FIELD_CLAMP),
+    // Records are written at most once per snapshot, so anything under MINIMUM_INTERVAL means "every snapshot"
+    CONFIG_FIELD(Config, dataLogInterval, "dataLogInterval", "dataLogInterval", MINIMUM_INTERVAL, 86400000, 1000, CFG_DATA_LOG, FIELD_CLAMP),
+    CONFIG_FIELD(Config, storageBudgetKB, "storageBudgetKB", "storageBudgetKB", 64, 4096, 1, CFG_STORAGE, 0),
+    CONFIG_FIELD(Config, retentionDays, "retentionDays", "retentionDays", 1, 3650, 1, CFG_STORAGE, 0),
+    CONFIG_FIELD(Config, moistureBand, "moistureBand", "moistureBand", 1, 50, 1, CFG_THRESHOLD, 0),
+    // Before the schedule table there were two daily times
+    CONFIG_FIELD(Config, schedule[0].hour, "irrigationHour1", "irrigationHour1", 0, 23, 1, CFG_SCHEDULE, FIELD_LEGACY),
+    CONFIG_FIELD(Config, schedule[0].minute, "irrigationMinute1", "irrigationMinute1", 0, 59, 1, CFG_SCHEDULE, FIELD_LEGACY),
+    CONFIG_FIELD(Config, schedule[0].second, "irrigationSecond1", "irrigationSecond1", 0, 59, 1, CFG_SCHEDULE, FIELD_LEGACY),
+    CONFIG_FIELD(Config, schedule[1].hour, "irrigationHour2", "irrigationHour2", 0, 23, 1, CFG_SCHEDULE, FIELD_LEGACY),
+    CONFIG_FIELD(Config, schedule[1].minute, "irrigationMinute2", "irrigationMinute2", 0, 59, 1, CFG_SCHEDULE, FIELD_LEGACY),
+    CONFIG_FIELD(Config, schedule[1].second, "irrigationSecond2", "irrigationSecond2", 0, 59, 1, CFG_SCHEDULE, FIELD_LEGACY),
+};
+
+const ConfigField zoneFields[] = {
+    CONFIG_FIELD(ZoneConfig, enabled, "enabled", "Enabled", 0, 1, 1, CFG_ZONES, 0),
+    CONFIG_FIELD(ZoneConfig, valvePin, "valvePin", "Pin", 0, 39, 1, CFG_ZONES, 0),
+    CONFIG_FIELD(ZoneConfig, sensors, "sensors", "Sensors", 0, ZONE_ALL_SENSORS, 1, CFG_ZONES, FIELD_INDEX_LIST),
+    CONFIG_FIELD(ZoneConfig, threshold, "threshold", "Threshold", 0, SOIL_PERCENT_MAX, 1, CFG_ZONES, 0),
+    CONFIG_FIELD(ZoneConfig, duration, "duration", "Duration", 0, 600000, 1000, CFG_ZONES, 0),
+    CONFIG_FIELD(ZoneConfig, cooldown, "cooldown", "Cooldown", 0, 3600000, 1000, CFG_ZONES, 0),
+    CONFIG_FIELD(ZoneConfig, debounce, "debounce", "Debounce", 0, 60, 1, CFG_ZONES, 0),
+};
+
+// hour/minute/second come in as one "slotNTime" argument, see handleSettings()
+const ConfigField slotFields[] = {
+    CONFIG_FIELD(ScheduleSlot, enabled, "enabled", "Enabled", 0, 1, 1, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, hour, "hour", nullptr, 0, 23, 1, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, minute, "minute", nullptr, 0, 59, 1, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, second, "second", nullptr, 0, 59, 1, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, days, "days", "Days", 0, SCHEDULE_ALL_DAYS, 1, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, duration, "duration", "Duration", 0, 600000, 1000, CFG_SCHEDULE, 0),
+    CONFIG_FIELD(ScheduleSlot, zones, "zones", "Zones", 0, (1 << ZONE_COUNT_MAX) - 1, 1, CFG_SCHEDULE, FIELD_INDEX_LIST),
+};
+
+// Usually filled by POST /calibrate; soil3Raw1=2650&soil3Pct1=0&soil3Points=2 also works
+const ConfigField soilCalibrationFields[] = {
+    CONFIG_FIELD(SoilCalibration, points, "points", "Points", 0, SOIL_CAL_POINTS, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, raw[0], "raw1", "Raw1", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, percent[0], "pct1", "Pct1", 0, SOIL_PERCENT_MAX, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, raw[1], "raw2", "Raw2", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, percent[1], "pct2", "Pct2", 0, SOIL_PERCENT_MAX, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, raw[2], "raw3", "Raw3", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, percent[2], "pct3", "Pct3", 0, SOIL_PERCENT_MAX, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, raw[3], "raw4", "Raw4", 0, 4095, 1, CFG_CALIBRATION, 0),
+    CONFIG_FIELD(SoilCalibration, percent[3], "pct4", "Pct4", 0, SOIL_PERCENT_MAX, 1, CFG_CALIBRATION, 0),
+};
+
+const ConfigField soilFilterFields[] = {
+    CONFIG_FIELD(SoilFilterConfig, mode, "mode", "Mode", SOIL_FILTER_MEAN, SOIL_FILTER_MEDIAN, 1, CFG_FILTER, 0),
+    CONFIG_FIELD(SoilFilterConfig, window, "window", "Window", 1, SOIL_FILTER_WINDOW, 1, CFG_FILTER, 0),
+    CONFIG_FIELD(SoilFilterConfig, emaShift, "emaShift", "Ema", 0, SOIL_EMA_SHIFT_MAX, 1, CFG_FILTER, 0),
+    CONFIG_FIELD(SoilFilterConfig, oversample, "oversample", "Oversample", 1, SOIL_OVERSAMPLE_MAX, 1, CFG_FILTER, 0),
+};
+
+// Arrays of structs inside Config: "zones": [{...}], /settings zone1Enabled, ...
+struct ConfigList
+{
+    const char *key;
+    const char *argPrefix;
+    const ConfigField *fields;
+    uint8_t fieldCount;
+    uint16_t offset;
+    uint16_t stride;
+    uint8_t count;
+};
+
+const ConfigList configLists[] = {
+    {"zones", "zone", zoneFields, sizeof(zoneFields) / sizeof(zoneFields[0]),
+     offsetof(Config, zones), sizeof(ZoneConfig), ZONE_COUNT_MAX},
+    {"schedule", "slot", slotFields, sizeof(slotFields) / sizeof(slotFields[0]),
+     offsetof(Config, schedule), sizeof(ScheduleSlot), SCHEDULE_SLOT_MAX},
+    {"soilCalibration", "soil", soilCalibrationFields, sizeof(soilCalibrationFields) / sizeof(soilCalibrationFields[0]),
+     offsetof(Config, soilCalibration), sizeof(SoilCalibration), SOIL_CHANNEL_COUNT},
+    {"soilFilter", "filter", soilFilterFields, sizeof(soilFilterFields) / sizeof(soilFilterFields[0]),
+     offsetof(Config, soilFilter), sizeof(SoilFilterConfig), SOIL_CHANNEL_COUNT},
+};
+
+// Chunked HTTP body written through a small stack buffer; send the headers first
+struct ChunkedResponse : public Print
+{
+    char buffer[256];
+    size_t length = 0;
+
+    using Print::write;
+    size_t write(uint8_t c) override
+    {
+        if (length == sizeof(buffer))
+            flush();
+        buffer[length++] = c;
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t size) override
+    {
+        for (size_t i = 0; i < size; i++)
+            write(data[i]);
+        return size;
+    }
+    void flush();
+};
+
+// Passes bytes through to a file and keeps a running CRC-32 of them
+struct ChecksumPrint : public Print
+{
+    Print &out;
+    uint32_t crc = 0;
+    bool failed = false;
+
+    explicit ChecksumPrint(Print &out) : out(out) {}
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size) override;
+};
+
+// config.json reader: a 64-byte window over the file, no JSON document in RAM
+struct JsonReader
+{
+    File &file;
+    uint8_t buffer[64];
+    size_t pos;
+    size_t length;
+};
+
 // ========== LOG BUFFER ==========
 struct LogMessage
 {
+    unsigned long seq; // 1, 2, 3, ... never reused, not even after /logs/clear
     unsigned long timestamp;
     char message[80];
 };
 
+// Worst case for one formatted entry: every message byte escaped as \u00XX
+#define LOG_ENTRY_JSON_SIZE (64 + 6 * sizeof(LogMessage::message))
+
 LogMessage serialBuffer[SERIAL_BUFFER_SIZE];
 int serialBufferIndex = 0;
 int totalMessages = 0;
+unsigned long logSequence = 0; // seq of the newest message, never reset
+uint32_t logEpoch = 0;         // bumped by handleLogsClear()
 
 // ========== PUMP STATE MACHINE ==========
 enum PumpState
@@ -124,20 +548,72 @@ enum ControlSource
 };
 
 // Debounce: require avg < threshold for N consecutive checks before starting (prevents rapid cycling)
+#ifndef MOISTURE_DEBOUNCE_COUNT
 #define MOISTURE_DEBOUNCE_COUNT 5
+#endif
 
+// state is derived from the zones: RUNNING while a valve is fed, COOLDOWN
+// while the pump is free but a zone is still cooling down
 struct PumpControl
 {
     PumpState state = PUMP_IDLE;
     unsigned long startTime = 0;
-    unsigned long cooldownStart = 0;
-    bool irrigationDone[2] = {false, false};
     bool manualOverride = false;
     ControlSource controlSource = CONTROL_NONE;
-    uint8_t moistureStableCount = 0; // debounce for moisture-based start
-    int pumpRunsToday = 0;           // jumlah penyiraman hari ini, reset tiap ganti hari
+    int activeZone = -1;             // zona yang valve-nya terbuka, -1 = pompa mati
+    int pumpRunsToday = 0;           // jumlah penyiraman hari ini (semua zona), reset tiap ganti hari
 } pumpControl;
 
+enum ZoneState
+{
+    ZONE_IDLE,
+    ZONE_WATERING,
+    ZONE_COOLDOWN
+};
+
+// Runtime state per zone; queued zones wait for the pump, driest first
+struct ZoneControl
+{
+    ZoneState state = ZONE_IDLE;
+    bool queued = false;
+    ControlSource queuedBy = CONTROL_NONE;
+    unsigned long queuedRunMs = 0;   // durasi dari slot jadwal, 0 = durasi zona
+    uint8_t moistureStableCount = 0; // debounce for moisture-based start
+    unsigned long cooldownStart = 0;
+    int soil = -1;                   // rata-rata sensor zona pada pemeriksaan terakhir
+    int runsToday = 0;
+    unsigned long runMs = 0;         // panjang siklus yang sedang/terakhir berjalan
+
+    // Soil response learning: % of moisture gained per pump-second
+    float gain = 0;                  // 0 = belum dipelajari, pakai durasi tetap
+    int runStartSoil = -1;
+    unsigned long pumpedMs = 0;      // pompa benar-benar menyala pada siklus terakhir
+    bool learning = false;           // menunggu ADAPTIVE_SETTLE_MS setelah siklus untuk mengukur kenaikan
+    bool settled = false;            // ADAPTIVE_SETTLE_MS sudah lewat, menunggu snapshot sensor berikutnya
+    unsigned long stoppedAt = 0;
+    uint32_t settleGeneration = 0;   // snapshot sensor saat masa settle selesai
+} zoneControl[ZONE_COUNT_MAX];
+
+// ========== SCHEDULE QUEUE ==========
+// Next fire time of every enabled slot, soonest first: each tick only looks at events[0]
+struct ScheduleEvent
+{
+    uint32_t fireAt; // RTC unixtime
+    uint8_t slot;
+};
+
+struct ScheduleQueue
+{
+    ScheduleEvent events[SCHEDULE_SLOT_MAX];
+    uint8_t count = 0;
+    bool valid = false; // false = dibangun ulang dari config dan RTC pada pemeriksaan berikutnya
+    // Per slot, the time up to which its events were consumed (fired, missed
+    // or skipped by a rebuild), kept in SCHEDULE_STATE_FILE: the first rebuild
+    // after boot resumes from it
+    uint32_t lastFire[SCHEDULE_SLOT_MAX] = {0};
+    bool resumed = false;
+} scheduleQueue;
+
 // ========= STATUS SYSTEM ==========
 struct SystemStatus
 {
@@ -145,6 +621,223 @@ struct SystemStatus
     bool bh1750OK = false;
 } status;
 
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED; // serialBuffer is written from both cores
+
+// ========== STATUS CACHE ==========
+// Everything /status depends on. The body is only re-rendered when this changes.
+struct StatusKey
+{
+    uint32_t sensorGeneration;
+    int pumpState;
+    int controlSource;
+    bool manualOverride;
+    int threshold;
+    int wateringMode;
+    uint32_t nextSchedule;
+    int activeZone;
+    uint8_t zoneState[ZONE_COUNT_MAX];
+    bool zoneQueued[ZONE_COUNT_MAX];
+    int zoneRuns[ZONE_COUNT_MAX];
+    int zoneThreshold[ZONE_COUNT_MAX]; // 0 = zona nonaktif
+    uint16_t zoneSensors[ZONE_COUNT_MAX]; // bitmask channel soil; menentukan "soil" zona
+    float zoneGain[ZONE_COUNT_MAX];    // berubah di controlPump() dan /settings, bukan hanya saat snapshot baru
+    uint32_t i2cLastHour;
+    uint32_t i2cErrors;
+    int32_t rtcDrift;
+    uint32_t rtcDriftSteps;
+};
+
+uint32_t dataLogVersion = 0; // bumped whenever the data log file changes
+
+// ========== DATA LOG STORAGE ==========
+// One sample as stored on flash: 24 bytes instead of a ~100-byte CSV line
+struct __attribute__((packed)) DataRecord
+{
+    uint32_t epoch;       // RTC unixtime
+    int16_t temperature;  // centi-degC
+    int16_t humidity;     // centi-%
+    uint32_t lux;         // centi-lux
+    uint8_t soil[SOIL_CHANNEL_COUNT]; // %
+    uint8_t runsToday;
+    uint8_t crc;          // CRC-8 over the bytes above; catches torn appends
+};
+static_assert(sizeof(DataRecord) == 24, "DataRecord must stay 24 bytes");
+
+// Written once at the start of every segment file
+struct __attribute__((packed)) SegmentHeader
+{
+    uint32_t magic = DATA_SEGMENT_MAGIC;
+    uint16_t version = DATA_FORMAT_VERSION;
+    uint16_t recordSize = sizeof(DataRecord);
+    uint32_t firstEpoch = 0;
+    uint32_t crc = 0; // CRC-32 over the fields above
+};
+
+// A segment file on flash. Numbers can have gaps when a file went missing.
+struct DataSegment
+{
+    uint32_t index;
+    uint32_t firstEpoch; // from the header, 0 = unreadable
+    uint32_t size;
+};
+
+// Derived from the segment files at boot, then kept in step by
+// appendDataRecord() and dropOldestSegment()
+struct DataLogMeta
+{
+    uint32_t records = 0;
+    uint32_t size = 0;         // bytes across all segments
+    std::vector<DataSegment> segments; // every segment file, oldest first
+    uint32_t firstSegment = 0; // 0 = no segment yet
+    uint32_t lastSegment = 0;
+    uint32_t lastSegmentRecords = 0;
+    uint32_t firstEpoch = 0;
+    uint32_t lastEpoch = 0;
+} dataLogMeta;
+
+// Walks the records of the segments in order, a buffer at a time, so a
+// response can pick up where its previous slice stopped
+struct DataReader
+{
+    uint32_t segment = 0; // segment being read, > lastSegment at the end
+    uint32_t offset = 0;  // next record of `segment`: where it is opened, then counts up
+    File file;
+    DataRecord records[16];
+    size_t count = 0;
+    size_t next = 0;
+};
+
+// State of one /data/download between slices
+struct DataDownload
+{
+    DataReader reader;
+    uint32_t end = 0;                // dataPosition() of the first record not sent (?to=)
+    uint32_t skip = 0;               // bytes still to drop before the first one sent (Range)
+    uint32_t remaining = UINT32_MAX; // bytes still to send (Range / Content-Length)
+    bool headerSent = false;
+    bool finished = false;
+};
+
+// CSV bytes of every DOWNLOAD_INDEX_STRIDE records, so /data/download knows
+// its length and which records a byte offset falls in without formatting the
+// whole log. Built a block per loop() after boot, then kept in step by
+// appendDataRecord() and dropOldestSegment().
+struct DownloadIndex
+{
+    uint32_t firstSegment = 0;    // segment of blocks[0]
+    std::vector<uint16_t> blocks; // DOWNLOAD_INDEX_BLOCKS per segment
+    uint32_t segment = 0;         // next record to measure while building
+    uint32_t record = 0;
+    bool ready = false;
+} downloadIndex;
+
+// ========== DATA QUERY ==========
+// Fields of a DataRecord that /data/query can aggregate, in bitmask order
+const char *const queryFieldNames[QUERY_FIELD_COUNT] = {
+    "temperature", "humidity", "lux", "soil",
+    "soil1", "soil2", "soil3", "soil4", "soil5", "soil6", "soil7", "soil8", "soil9", "soil10",
+    "runsToday"};
+#define QUERY_DEFAULT_FIELDS 0x000F // temperature, humidity, lux, soil (rata-rata)
+
+// min/avg/max accumulator for one time bucket
+struct QueryBucket
+{
+    uint32_t start = 0;
+    uint32_t records = 0;
+    uint32_t count[QUERY_FIELD_COUNT];
+    float min[QUERY_FIELD_COUNT];
+    float max[QUERY_FIELD_COUNT];
+    double sum[QUERY_FIELD_COUNT];
+};
+
+// State of one /data/query between slices
+struct DataQuery
+{
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint32_t step = 0;
+    uint16_t fields = 0;
+    DataReader reader;
+    QueryBucket bucket;
+    bool started = false;  // preamble sent
+    bool firstBucket = true;
+    bool done = false;     // no more records in range
+    bool finished = false; // closing "]}" sent
+};
+#define QUERY_BUCKET_JSON_MAX 768   // satu bucket dengan semua field; harus <= HTTP_SLICE_SIZE
+#define QUERY_RECORDS_PER_SLICE 256 // record dibaca per potongan, agar bucket lebar tidak menahan loop()
+
+// ========== STORAGE MANAGER ==========
+struct LogFileInfo
+{
+    uint32_t date; // YYYYMMDD
+    uint32_t size;
+};
+
+// Daily log files: listed once at boot by scanLogFiles(), then kept in step
+// by addLogBytes() and deleteOldestLogFile(), so the storage policy never
+// walks the directory
+struct StorageUsage
+{
+    uint32_t logBytes = 0;
+    std::vector<LogFileInfo> logFiles; // oldest first
+    uint32_t deletedFiles = 0;         // since boot
+    uint32_t fsUsed = 0;    // LittleFS.usedBytes() at the last walk, see fsUsedBytes()
+    uint32_t fsTracked = 0; // trackedBlockBytes() at that walk
+} storageUsage;
+
+// ========== LOG STAGING ==========
+// logToFile() only appends to RAM. Two stages alternate: when the active one
+// fills up (or the date changes) it becomes pending and the loop task writes
+// it out with one open/append/close, while new lines go to the other stage.
+struct LogStage
+{
+    char text[LOG_STAGE_SIZE];
+    size_t length = 0;
+    uint32_t date = 0;           // YYYYMMDD of every line in text
+    unsigned long firstAt = 0;   // millis() of the oldest staged line
+};
+LogStage logStages[2];
+uint8_t activeLogStage = 0;
+bool logStagePending = false;    // logStages[activeLogStage ^ 1] is waiting to be written
+uint32_t droppedLogLines = 0;    // both stages full; reported on the next write
+portMUX_TYPE logStageMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ========== SERVER-SENT EVENTS ==========
+// State of one /events stream between slices. Per-client cursors: each
+// stream only gets what changed since its last push.
+struct EventClient
+{
+    std::string pending;     // event being sent, pending[pendingSent..] still to go
+    size_t pendingSent = 0;
+    unsigned long lastWrite = 0;
+    uint32_t statusGeneration = 0;
+    unsigned long logSequence = 0;
+    uint32_t logEpoch = 0;
+    uint32_t dataLogVersion = 0;
+};
+// Streams are owned by their HttpServer connection; a slot is free once it closed
+std::weak_ptr<EventClient> eventClients[SSE_MAX_CLIENTS];
+
+struct StatusCache
+{
+    bool valid = false;
+    StatusKey key;
+    uint32_t bootId = 0;     // keeps ETags from a previous boot from matching
+    uint32_t generation = 0; // bumped on every re-render
+    size_t length = 0;
+    char etag[24];
+    char body[STATUS_CACHE_SIZE];
+} statusCache;
+
+// ETag of /index.html and /index.html.gz: CRC-32 of the file, computed on the
+// first request. The file only changes with an uploadfs, which reboots.
+struct PageEtag
+{
+    size_t size = 0; // of the file it was computed for, 0 = not yet
+    char etag[16];
+} pageEtags[2]; // [0] = plain, [1] = gzip
+
 String getDataLogFilename()
 {
     return String("/data_log_") + ".csv";
@@ -152,43 +845,156 @@ String getDataLogFilename()
 
 // ========== FUNCTION PROTOTYPES ==========
 void serialPrintln(const char *message); // untuk menampilkan pesan di Serial Monitor dan menyimpan log ke buffer
-void logToFile(const char *message);     // untuk menyimpan log ke file dengan timestamp dari RTC
+void logToFile(const char *message, bool urgent = false); // untuk menyimpan log dengan timestamp dari RTC ke buffer staging; urgent langsung ditulis ke file (hanya dari loop task)
+void writePendingLogStage();             // untuk menulis stage log yang penuh ke file log harian
+void flushLogFile();                     // untuk menulis semua baris log yang masih di RAM ke flash (hanya dari loop task)
+void serviceLogFlush();                  // untuk menulis buffer log jika penuh atau sudah LOG_FLUSH_INTERVAL
 void initRTC();                          // untuk inisialisasi RTC dan penyesuaian waktu jika diperlukan
+void initI2cBus();                       // untuk memulai Wire dan membuat mutex bus I2C
+void i2cBegin();                         // untuk mengambil bus I2C sebelum transaksi (DS3231/BH1750)
+void i2cEnd(uint32_t transactions, bool ok); // untuk melepas bus I2C dan menghitung transaksi serta error-nya
+uint32_t clockEpoch();                   // untuk waktu unix saat ini dari cache RTC, tanpa transaksi I2C
+DateTime clockNow();                     // untuk waktu saat ini dari cache RTC sebagai DateTime
+void setClockBase(uint32_t epoch, unsigned long at, int32_t drift); // untuk menetapkan cache: DS3231 menunjukkan epoch pada millis() at, dengan hasil sync
+bool syncClock();                        // untuk membaca DS3231 sekali, mendeteksi drift dan memperbarui cache; false jika error I2C
+void setClock(const DateTime &time);     // untuk menulis waktu baru ke DS3231 dan cache
+void serviceI2cBus();                    // untuk sync RTC per RTC_SYNC_INTERVAL dan menghitung transaksi per jam (dari sensorTask)
 void initWatchdog();                     // untuk inisialisasi watchdog timer
 void resetWatchdog();                    // untuk mereset watchdog timer agar mencegah reset sistem
 bool setupLittleFS();                    // untuk inisialisasi LittleFS dan memastikan filesystem siap digunakan
 void createDefaultConfig();              // untuk membuat file konfigurasi default jika belum ada
 bool loadConfig();                       // untuk memuat konfigurasi dari file dan mengisi struktur Config
 bool saveConfig();                       // untuk menyimpan konfigurasi saat ini ke file dalam format JSON
+bool writeConfigFile(const Config &source); // untuk menulis config ke file sementara lalu rename (atomik) ke CONFIG_FILE
+bool commitTempFile(File &file, const char *tempPath, const char *path, bool ok); // untuk menutup file sementara lalu rename (atomik) ke path, atau membuangnya jika penulisan gagal
+int checkConfigCrc(File &file);          // untuk memeriksa trailer CRC config.json: 1 = cocok, 0 = tidak ada trailer, -1 = rusak
+void migrateConfig(Config &loaded);      // untuk menyesuaikan config dari skema lama (loaded.version) ke CONFIG_VERSION
 void validateMeasurementInterval();      // untuk memastikan interval pengukuran tidak kurang dari batas minimum
 
-void readDHT22(); // untuk membaca data suhu dan kelembapan dari sensor DHT22, serta menyimpan hasilnya ke struktur SensorData
-int readSoilPercent(int pin); // untuk membaca data kelembaban tanah dari sensor menggunakan ADC, kemudian mengkonversi nilai tersebut menjadi persentase berdasarkan kalibrasi ADC_DRY dan ADC_WET
-void readSoilMoisture();      // untuk membaca kelembaban tanah dari semua sensor yang terhubung dan menyimpan hasilnya ke struktur SensorData
+void readDHT22(); // untuk menyalin pembacaan DHT22 valid terakhir (serta umur dan jumlah gagalnya) ke struktur SensorData
+void serviceDHT22(); // untuk menjalankan transfer DHT22 (RMT) yang sedang berjalan dan mencatat hasilnya ke log
+const char *dhtErrorName(Dht22::Error error); // untuk nama penyebab gagal baca DHT22
+int readSoilPercent(int channel, int raw); // untuk mengkonversi rata-rata ADC kelembaban tanah menjadi persentase lewat LUT channel tersebut
+void sortSoilCalibration(SoilCalibration &cal); // untuk mengurutkan titik kalibrasi dari kering (ADC tinggi) ke basah
+void buildSoilLut();          // untuk menghitung ulang LUT ADC -> % semua channel dari kurva kalibrasi
+void handleCalibrate();       // untuk menangani "/calibrate": GET = ADC terkini per probe, POST = rekam titik kering/basah dari ADC terkini
+bool readSoilMoisture();      // untuk menyalin output filter semua channel ke SensorData; false jika window filter belum terisi (setelah boot)
+bool serviceSoilSampler();    // untuk mengambil satu sampel per channel tiap SOIL_SAMPLE_PERIOD_MS ke filternya; true jika sampel diambil
+uint16_t filterSoilSample(SoilFilter &filter, const SoilFilterConfig &cfg, uint16_t sample); // untuk memasukkan satu sampel ke ring lalu window + EMA
+uint16_t readSoilFiltered(int channel); // untuk membaca output filter terkini satu channel (ADC)
+uint8_t checkSoilChannel(int channel); // untuk memeriksa rail, stuck dan laju perubahan satu channel; mengembalikan flag SOIL_FAULT_*
+int medianOf(int *values, int count);  // untuk mengurutkan values (maks. SOIL_CHANNEL_COUNT) dan mengembalikan mediannya
+void checkSoilOutliers();     // untuk menandai probe yang jauh dari median/MAD probe lain di zona yang sama
+void checkSoilHealth();       // untuk menjalankan semua pemeriksaan kesehatan soil dan mencatat perubahan status ke log
+const char *soilFaultName(uint8_t fault); // untuk nama flag terpenting: rail, stuck, outlier atau rate
+void publishSensorData();               // untuk menyalin data kerja sensorTask ke snapshot bersama (seqlock)
+uint32_t readSensorSnapshot(SensorData &out); // untuk membaca snapshot SensorData yang utuh, mengembalikan nomor generasinya
+uint32_t sensorSnapshotGeneration();    // untuk mengetahui generasi snapshot terakhir tanpa menyalin datanya
+void sensorTask(void *param);           // task FreeRTOS di core 0 untuk akuisisi DHT22, soil dan BH1750
+void startSensorTask();                 // untuk membuat sensorTask yang di-pin ke SENSOR_TASK_CORE
 void initLuxMeter();          // untuk inisialisasi sensor cahaya BH1750
 void readLuxMeter();          // untuk membaca data cahaya dari sensor BH1750 dan menampilkan hasilnya di Serial Monitor serta menyimpan log
 
 void setupWiFi();          // untuk menghubungkan ESP32 ke jaringan WiFi menggunakan SSID dan password yang telah ditentukan
 void setupWebServer();     // untuk menginisialisasi web server, mendefinisikan rute HTTP, dan memulai server untuk menerima permintaan dari klien
 void handleRoot();         // untuk menangani permintaan HTTP ke rute root ("/"), biasanya digunakan untuk menampilkan halaman utama dengan informasi status sistem
+void handleNotFound();     // untuk menyajikan file /assets/ yang ber-fingerprint (cache immutable), selain itu 404
+bool clientAcceptsGzip();  // untuk memeriksa apakah header Accept-Encoding klien memuat gzip
+File openStaticFile(const String &path, bool &gzip); // untuk membuka versi .gz dari file statis jika klien menerimanya, jika tidak versi biasa
+void fillStatusKey(StatusKey &key); // untuk mengumpulkan semua state yang mempengaruhi isi /status
+void refreshStatusCache(); // untuk merender ulang body JSON /status ke buffer statis jika state berubah
 void handleStatus();       // untuk menangani permintaan HTTP ke rute "/status", biasanya digunakan untuk mengirimkan data sensor dalam format JSON sebagai respons
 void handleConfig();       // untuk menangani permintaan HTTP ke rute "/config", biasanya digunakan untuk menerima data konfigurasi baru dari klien, memperbarui struktur Config, dan menyimpan perubahan ke file
 void handleSettings();     // untuk menangani permintaan HTTP ke rute "/settings", biasanya digunakan untuk menerima data konfigurasi baru dari klien, memperbarui struktur Config, dan menyimpan perubahan ke file
 void handleRestart();      // untuk menangani permintaan HTTP ke rute "/restart", biasanya digunakan untuk mereset sistem secara manual melalui antarmuka web
 void handlePumpControl();  // untuk menangani permintaan HTTP POST ke rute "/pump", mengontrol pompa ON/OFF secara manual
+bool nextLogEntry(unsigned long after, LogMessage &out); // untuk menyalin entri log pertama yang lebih baru dari seq `after`
+size_t formatLogEntry(char *out, size_t size, const LogMessage &entry); // untuk menulis satu entri log sebagai objek JSON tanpa JsonDocument
 void handleLogs();         // untuk menangani permintaan HTTP ke rute "/logs", biasanya digunakan untuk mengirimkan log pesan yang disimpan dalam buffer sebagai respons dalam format JSON
 void handleLogsClear();    // untuk mengosongkan buffer log (POST /logs/clear)
 void handleSetDateTime();  // untuk menangani permintaan HTTP ke rute "/setdatetime", biasanya digunakan untuk menerima data tanggal dan waktu baru dari klien, memperbarui RTC dengan nilai tersebut, dan mengirimkan respons status kepada klien
 void handleTime();         // untuk menangani permintaan HTTP ke rute "/time", biasanya digunakan untuk mengirimkan waktu saat ini dari RTC dalam format JSON sebagai respons
 void handleDateTime();     // untuk menangani permintaan HTTP ke rute "/datetime", biasanya digunakan untuk menerima data tanggal dan waktu baru dari klien, memperbarui RTC dengan nilai tersebut, dan mengirimkan respons status kepada klien
-void handleDataDownload(); // untuk menangani permintaan HTTP ke rute "/data/download", biasanya digunakan untuk mengirimkan file data log dalam format CSV sebagai respons untuk diunduh oleh klien
+void handleDataDownload(); // untuk menangani permintaan HTTP ke rute "/data/download", mengirimkan data log sebagai CSV yang dibentuk langsung dari segment biner
+bool nextDataRecord(DataReader &reader, DataRecord &record); // untuk mengambil record berikutnya dari segment (CRC belum diperiksa); false di akhir log
+size_t fillDataDownload(DataDownload &download, char *out, size_t size); // untuk mengisi potongan CSV berikutnya dari /data/download
+size_t clipDataDownload(DataDownload &download, char *piece, size_t length); // untuk menyalin potongan CSV setelah dipotong sesuai Range (skip/remaining)
+uint32_t dataPosition(uint32_t segment, uint32_t record); // untuk mengubah (segment, record) menjadi satu nomor urut yang bisa dibandingkan
+uint32_t measureDataRecords(File &file, uint32_t &count); // untuk menghitung byte CSV dari `count` record berikutnya di file segment
+void resetDownloadIndex();   // untuk membangun ulang indeks byte CSV dari awal (setelah boot atau hapus data)
+void serviceDownloadIndex(); // untuk mengukur satu blok indeks byte CSV per loop() sampai lengkap
+uint16_t *downloadIndexBlock(uint32_t segment, uint32_t record); // untuk blok indeks yang memuat record tsb, nullptr jika di luar indeks
+uint32_t downloadOffset(uint32_t segment, uint32_t record); // untuk posisi byte CSV (tanpa header) dari record tsb
+void seekDownloadIndex(uint32_t offset, uint32_t &segment, uint32_t &record, uint32_t &blockOffset); // untuk mencari awal blok yang memuat byte CSV ke-offset
+int parseByteRange(const String &value, uint32_t length, uint32_t &first, uint32_t &last); // untuk membaca header Range: 206, 416, atau 200 = abaikan
+bool queryFieldValue(const DataRecord &record, int field, float &value); // untuk mengambil nilai satu field dari record; false jika tidak valid
+void resetQueryBucket(QueryBucket &bucket, uint32_t start); // untuk mengosongkan akumulator bucket
+size_t formatQueryBucket(char *out, size_t size, const QueryBucket &bucket, uint16_t fields, bool first); // untuk menulis satu bucket sebagai objek JSON
+bool segmentFirstEpoch(uint32_t index, uint32_t &epoch); // untuk membaca firstEpoch dari header segment
+void locateDataRecord(uint32_t from, uint32_t &segment, uint32_t &record); // untuk mencari record pertama dengan epoch >= from (binary search, tanpa scan)
+void handleDataQuery();    // untuk menangani GET /data/query?from=&to=&step=&fields=, mengirim bucket min/avg/max secara streaming
+size_t fillDataQuery(DataQuery &query, char *out, size_t size); // untuk mengisi potongan JSON berikutnya dari /data/query
 void handleDataDelete();   // untuk menangani permintaan HTTP ke rute "/data/delete", biasanya digunakan untuk menghapus file data log yang ada dan mengirimkan respons status kepada klien
+void buildDataInfo(JsonDocument &doc); // untuk mengisi informasi file data log (dipakai /data/info dan /events)
 void handleDataInfo();     // untuk menangani permintaan HTTP ke rute "/data/info", biasanya digunakan untuk mengirimkan informasi tentang file data log yang ada, seperti ukuran dan tanggal terakhir diubah, dalam format JSON sebagai respons
-void initDataLog();        // untuk menginisialisasi file data log, memastikan file tersebut ada dan memiliki header yang benar jika baru dibuat
-void saveDataRecord();     // untuk menyimpan rekaman data sensor saat ini ke file data log dalam format CSV dengan timestamp dari RTC
+uint8_t crc8(const uint8_t *bytes, size_t length);   // CRC-8 (poly 0x07) untuk tiap DataRecord
+uint32_t crc32(const uint8_t *bytes, size_t length, uint32_t previous = 0); // CRC-32 untuk SegmentHeader dan config.json; previous = hasil potongan sebelumnya
+void segmentPath(char *out, size_t size, uint32_t index); // untuk membentuk path file segment ke-index
+bool readSegmentHeader(File &file, SegmentHeader &header); // untuk membaca dan memvalidasi header segment
+bool readDataRecord(File &file, DataRecord &record);       // untuk membaca satu record dan memeriksa CRC-nya
+void encodeDataRecord(const SensorData &snapshot, uint32_t epoch, int runsToday, DataRecord &record); // untuk mengemas SensorData menjadi DataRecord
+size_t formatDataRecordCsv(char *out, size_t size, const DataRecord &record); // untuk menulis satu record sebagai baris CSV
+bool appendDataRecord(const DataRecord &record); // untuk menambahkan record ke segment aktif (membuat segment baru jika penuh)
+void scanDataSegments();   // untuk menghitung metadata data log dari direktori segment
+void migrateLegacyCsv();   // untuk mengkonversi data_log.csv lama menjadi segment biner
+uint32_t dateKey(const DateTime &t); // untuk mengubah tanggal menjadi angka YYYYMMDD
+void scanLogFiles();       // untuk mendaftar file log harian beserta ukurannya (sekali saat boot)
+void addLogBytes(uint32_t date, size_t bytes); // untuk mencatat byte yang ditambahkan ke file log tanggal itu
+void deleteOldestLogFile(); // untuk menghapus file log harian tertua
+bool dropOldestSegment();  // untuk menghapus segment data tertua (segment aktif tidak pernah dihapus)
+void enforceStoragePolicy(const DateTime &now); // untuk menegakkan batas retensi hari dan anggaran byte, menghapus yang tertua dulu
+uint32_t trackedBlockBytes(); // untuk byte blok yang dipakai segment dan log harian, dihitung dari daftar di RAM
+uint32_t fsUsedBytes();    // untuk perkiraan byte terpakai LittleFS tanpa menelusuri filesystem
+void initDataLog();        // untuk menginisialisasi direktori segment data log dan memuat metadatanya
+void saveDataRecord();     // untuk menyimpan rekaman data sensor saat ini sebagai record biner dengan timestamp dari RTC
+
+void handleEvents();      // untuk membuka stream SSE /events; isinya dikirim fillEvents() per potongan
+size_t fillEvents(EventClient &ec, char *out, size_t size); // untuk mengisi potongan stream SSE berikutnya: perubahan status, log dan data log
+void queueEvent(EventClient &ec, const char *event, const char *payload, size_t length); // untuk menyiapkan satu event SSE di ec.pending
+bool nextEvent(EventClient &ec); // untuk menyiapkan event berikutnya yang perlu dikirim ke klien; false jika tidak ada
 
 void resetDailyIrrigation(DateTime &currentTime);
+int getZoneSoilMoisture(const SensorData &snapshot, uint16_t sensors); // untuk rata-rata channel tanah yang termasuk satu zona, -1 jika tidak ada data
+int zoneThreshold(int zone);          // untuk threshold zona (atau threshold global jika 0)
+unsigned long zoneDuration(int zone); // untuk durasi siram zona dalam ms (atau pumpDuration jika 0)
+unsigned long zoneCooldown(int zone); // untuk cooldown zona dalam ms (atau COOLDOWN_TIME jika 0)
+uint8_t zoneDebounce(int zone);       // untuk jumlah pemeriksaan debounce zona (atau MOISTURE_DEBOUNCE_COUNT jika 0)
+void initZoneValves();                // untuk menyiapkan pin valve semua zona aktif sebagai output dalam keadaan tertutup
+unsigned long adaptiveRunMs(int zone); // untuk menghitung lama siklus MODE_ADAPTIVE dari gain yang dipelajari
+void learnZoneGain(int zone);         // untuk memperbarui gain zona dari kenaikan kelembaban siklus terakhir
+void loadLearnedGains();              // untuk memuat gain hasil belajar dari LEARN_FILE
+void saveLearnedGains();              // untuk menyimpan gain hasil belajar ke LEARN_FILE
+void startZone(int zone, ControlSource source); // untuk membuka valve zona lalu menyalakan pompa
+void stopZone(bool cooldown);         // untuk mematikan pompa lalu menutup valve zona yang sedang disiram
+void queueZone(int zone, ControlSource source, unsigned long runMs); // untuk memasukkan zona ke antrean pompa (runMs 0 = durasi zona)
+uint32_t nextSlotTime(const ScheduleSlot &slot, uint32_t after); // untuk menghitung waktu slot jadwal berikutnya setelah `after`, 0 jika tidak pernah
+void pushScheduleEvent(uint8_t slot, uint32_t fireAt); // untuk memasukkan event ke antrean jadwal, terurut waktu
+void rebuildScheduleQueue(uint32_t now); // untuk membangun ulang antrean jadwal dari config dan waktu RTC
+void loadScheduleState();                // untuk memuat waktu event terakhir per slot dari SCHEDULE_STATE_FILE
+void saveScheduleState();                // untuk menyimpan waktu event terakhir per slot ke SCHEDULE_STATE_FILE
+void fireScheduleSlot(int slot, uint32_t late); // untuk mengantrekan zona-zona milik slot jadwal
+void serviceSchedule(uint32_t now, bool allow); // untuk menjalankan event jadwal yang jatuh tempo (dengan toleransi SCHEDULE_GRACE_S)
+void formatScheduleList(char *out, size_t size); // untuk menulis jam semua slot aktif, mis. "07:00:00 & 16:00:00"
 void controlPump(DateTime &currentTime);
+uint16_t parseIndexList(const String &list, int count); // untuk mengubah daftar nomor "1-5,7" (1..count) menjadi bitmask
+void formatIndexList(char *out, size_t size, uint16_t mask, int count); // untuk menulis bitmask sebagai "1-5,7"
+bool isValvePinChoice(int pin);       // untuk memeriksa apakah pin boleh dipakai sebagai valve zona
+void sanitizeZones();                 // untuk mengganti pin valve yang tidak valid dan menonaktifkan pin valve ganda
+long getConfigField(const void *base, const ConfigField &field); // untuk membaca nilai field dari struct sesuai tabel
+void setConfigField(void *base, const ConfigField &field, long value); // untuk menulis nilai field ke struct sesuai tabel
+size_t writeConfigJson(Print &out, const Config &source); // untuk menulis isi objek config.json (tanpa kurung kurawal) langsung ke file/respons
+bool readConfigJson(File &file, Config &target); // untuk membaca config.json secara streaming ke struktur Config
+uint16_t applyConfigArgs(); // untuk menerapkan argumen /settings yang ada di tabel field; hasilnya grup CFG_* yang berubah
 
 // ========== LOGGING FUNCTIONS ==========
 void serialPrintln(const char *message)
@@ -199,6 +1005,8 @@ void serialPrintln(const char *message)
     Serial.print("] ");
     Serial.println(message);
 
+    portENTER_CRITICAL(&logMux);
+    serialBuffer[serialBufferIndex].seq = ++logSequence;
     serialBuffer[serialBufferIndex].timestamp = ms;
     strncpy(serialBuffer[serialBufferIndex].message, message,
             sizeof(serialBuffer[0].message) - 1);
@@ -207,35 +1015,315 @@ void serialPrintln(const char *message)
     serialBufferIndex = (serialBufferIndex + 1) % SERIAL_BUFFER_SIZE;
     if (totalMessages < SERIAL_BUFFER_SIZE)
         totalMessages++;
+    portEXIT_CRITICAL(&logMux);
+}
+
+// Copies the oldest buffered entry newer than `after`. Entries that were
+// overwritten or cleared are skipped; a cursor from before a reboot
+// (after > logSequence) simply gets everything that is buffered.
+bool nextLogEntry(unsigned long after, LogMessage &out)
+{
+    portENTER_CRITICAL(&logMux);
+    unsigned long pending = logSequence - after;
+    if (pending > (unsigned long)totalMessages)
+        pending = totalMessages;
+    if (pending > 0)
+        out = serialBuffer[(serialBufferIndex + SERIAL_BUFFER_SIZE - pending) % SERIAL_BUFFER_SIZE];
+    portEXIT_CRITICAL(&logMux);
+    return pending > 0;
+}
+
+size_t formatLogEntry(char *out, size_t size, const LogMessage &entry)
+{
+    int len = snprintf(out, size, "{\"seq\":%lu,\"timestamp\":%lu,\"message\":\"",
+                       entry.seq, entry.timestamp);
+    if (len < 0 || (size_t)len >= size)
+        return 0;
+
+    size_t n = len;
+    for (const char *p = entry.message; *p && n + 8 < size; p++)
+    {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\')
+        {
+            out[n++] = '\\';
+            out[n++] = c;
+        }
+        else if (c < 0x20)
+            n += snprintf(out + n, size - n, "\\u%04x", c);
+        else
+            out[n++] = c;
+    }
+    out[n++] = '"';
+    out[n++] = '}';
+    out[n] = '\0';
+    return n;
 }
 
-void logToFile(const char *message)
+void logToFile(const char *message, bool urgent)
 {
     if (!status.rtcInitialized)
         return;
 
-    DateTime now = rtc.now();
-    char logBuffer[32];
-    snprintf(logBuffer, sizeof(logBuffer), "/log_%04d%02d%02d.txt",
-             now.year(), now.month(), now.day());
+    DateTime now = clockNow();
+    char line[160];
+    int n = snprintf(line, sizeof(line), "[%02d:%02d:%02d] %s\r\n",
+                     now.hour(), now.minute(), now.second(), message);
+    if (n < 0)
+        return;
+    if (n >= (int)sizeof(line))
+    {
+        n = sizeof(line) - 1;
+        line[n - 2] = '\r';
+        line[n - 1] = '\n';
+    }
+    uint32_t date = dateKey(now);
 
-    File file = LittleFS.open(logBuffer, "a");
-    if (!file)
+    portENTER_CRITICAL(&logStageMux);
+    LogStage *stage = &logStages[activeLogStage];
+    bool accepted = true;
+    if (stage->length > 0 && (stage->date != date || stage->length + n > LOG_STAGE_SIZE))
+    {
+        if (logStagePending)
+            accepted = false;
+        else
+        {
+            logStagePending = true;
+            activeLogStage ^= 1;
+            stage = &logStages[activeLogStage];
+        }
+    }
+    if (accepted)
+    {
+        if (stage->length == 0)
+        {
+            stage->date = date;
+            stage->firstAt = millis();
+        }
+        memcpy(stage->text + stage->length, line, n);
+        stage->length += n;
+    }
+    else
+        droppedLogLines++;
+    portEXIT_CRITICAL(&logStageMux);
+
+    if (urgent)
+        flushLogFile();
+}
+
+void writePendingLogStage()
+{
+    portENTER_CRITICAL(&logStageMux);
+    LogStage *stage = logStagePending ? &logStages[activeLogStage ^ 1] : nullptr;
+    uint32_t dropped = droppedLogLines;
+    droppedLogLines = 0;
+    portEXIT_CRITICAL(&logStageMux);
+    if (!stage)
         return;
 
-    char timestamp[20];
-    snprintf(timestamp, sizeof(timestamp), "[%02d:%02d:%02d] ",
-             now.hour(), now.minute(), now.second());
-    file.print(timestamp);
-    file.println(message);
-    file.close();
+    // Writers leave the pending stage alone, so it is read here without the lock
+    char path[32];
+    snprintf(path, sizeof(path), "/" LOG_FILE_PREFIX "%08lu.txt", (unsigned long)stage->date);
+    File file = LittleFS.open(path, "a");
+    if (file)
+    {
+        addLogBytes(stage->date, file.write((const uint8_t *)stage->text, stage->length));
+        file.close();
+    }
+    else
+        serialPrintln("Failed to write log file");
+
+    if (dropped > 0)
+    {
+        char logBuffer[48];
+        snprintf(logBuffer, sizeof(logBuffer), "Log staging full, %lu lines dropped", (unsigned long)dropped);
+        serialPrintln(logBuffer);
+    }
+
+    stage->length = 0;
+    portENTER_CRITICAL(&logStageMux);
+    logStagePending = false;
+    portEXIT_CRITICAL(&logStageMux);
+}
+
+void flushLogFile()
+{
+    writePendingLogStage();
+
+    portENTER_CRITICAL(&logStageMux);
+    if (logStages[activeLogStage].length > 0)
+    {
+        logStagePending = true;
+        activeLogStage ^= 1;
+    }
+    portEXIT_CRITICAL(&logStageMux);
+
+    writePendingLogStage();
+}
+
+void serviceLogFlush()
+{
+    portENTER_CRITICAL(&logStageMux);
+    const LogStage &stage = logStages[activeLogStage];
+    bool due = logStagePending ||
+               (stage.length > 0 && millis() - stage.firstAt >= LOG_FLUSH_INTERVAL);
+    portEXIT_CRITICAL(&logStageMux);
+
+    if (due)
+        flushLogFile();
+}
+
+// ========== I2C BUS ==========
+void initI2cBus()
+{
+    Wire.begin();
+    if (!i2cBus.lock)
+        i2cBus.lock = xSemaphoreCreateMutex();
+}
+
+void i2cBegin()
+{
+    if (i2cBus.lock)
+        xSemaphoreTake(i2cBus.lock, portMAX_DELAY);
+}
+
+void i2cEnd(uint32_t transactions, bool ok)
+{
+    i2cBus.transactions += transactions;
+    if (!ok)
+        i2cBus.errors++;
+    if (i2cBus.lock)
+        xSemaphoreGive(i2cBus.lock);
+}
+
+uint32_t clockEpoch()
+{
+    portENTER_CRITICAL(&clockMux);
+    uint32_t epoch = i2cBus.syncEpoch + (millis() - i2cBus.syncMillis) / 1000;
+    portEXIT_CRITICAL(&clockMux);
+    return epoch;
+}
+
+DateTime clockNow()
+{
+    return DateTime(clockEpoch());
+}
+
+// syncClock() runs on core 0 and setClock() on core 1: both call this with
+// the I2C lock held, so their read-compute-write never interleaves, and the
+// anchor and the sync results change together under clockMux
+void setClockBase(uint32_t epoch, unsigned long at, int32_t drift)
+{
+    portENTER_CRITICAL(&clockMux);
+    i2cBus.syncEpoch = epoch;
+    i2cBus.syncMillis = at;
+    i2cBus.lastSync = at;
+    i2cBus.lastDrift = drift;
+    if (drift > RTC_DRIFT_LIMIT_S || drift < -RTC_DRIFT_LIMIT_S)
+        i2cBus.driftSteps++;
+    i2cBus.synced = true;
+    portEXIT_CRITICAL(&clockMux);
+}
+
+// The DS3231 only reports whole seconds, so right after a sync the cache can
+// trail it by up to a second: a drift of +1 re-anchors the cache on a tick
+// that just happened, -1 means millis() runs fast and the cache waits for the
+// DS3231. Only beyond RTC_DRIFT_LIMIT_S (RTC set by hand, crystal trouble,
+// garbage on the bus that still decoded) is the time stepped.
+bool syncClock()
+{
+    i2cBegin();
+    DateTime now = rtc.now();
+    unsigned long at = millis();
+    bool ok = now.isValid() && now.year() >= 2000 && now.year() <= 2099;
+
+    char logBuffer[64];
+    if (!ok)
+    {
+        portENTER_CRITICAL(&clockMux);
+        i2cBus.lastSync = at;
+        portEXIT_CRITICAL(&clockMux);
+        i2cEnd(I2C_TX_RTC_READ, false);
+        if (!i2cBus.syncFailed)
+        {
+            serialPrintln("RTC read failed (I2C error), keeping the cached time");
+            logToFile("RTC read failed (I2C error), keeping the cached time");
+        }
+        i2cBus.syncFailed = true;
+        return false;
+    }
+    if (i2cBus.syncFailed)
+    {
+        snprintf(logBuffer, sizeof(logBuffer), "RTC read OK again (%lu I2C errors so far)", (unsigned long)i2cBus.errors);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
+        i2cBus.syncFailed = false;
+    }
+
+    uint32_t epoch = now.unixtime();
+    if (!i2cBus.synced)
+    {
+        setClockBase(epoch, at, 0);
+        i2cEnd(I2C_TX_RTC_READ, true);
+        return true;
+    }
+
+    uint32_t cached = clockEpoch();
+    int32_t drift = (int32_t)(epoch - cached);
+    if (drift < 0 && drift >= -RTC_DRIFT_LIMIT_S)
+        setClockBase(cached, at, drift); // never backwards
+    else if (drift == 0)
+    {
+        // Same second: move the anchor up by whole seconds so the millis()
+        // difference stays small, keeping the sub-second phase
+        unsigned long whole = (at - i2cBus.syncMillis) / 1000;
+        setClockBase(i2cBus.syncEpoch + whole, i2cBus.syncMillis + whole * 1000, 0);
+    }
+    else
+        setClockBase(epoch, at, drift);
+    i2cEnd(I2C_TX_RTC_READ, true);
+
+    if (drift > RTC_DRIFT_LIMIT_S || drift < -RTC_DRIFT_LIMIT_S)
+    {
+        snprintf(logBuffer, sizeof(logBuffer), "RTC drift %+lds against the cached time, clock stepped", (long)drift);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
+    }
+    return true;
+}
+
+void setClock(const DateTime &time)
+{
+    i2cBegin();
+    rtc.adjust(time);
+    setClockBase(time.unixtime(), millis(), 0);
+    i2cEnd(I2C_TX_RTC_ADJUST, true);
+}
+
+void serviceI2cBus()
+{
+    unsigned long now = millis();
+    if (now - i2cBus.hourStart >= 3600000UL)
+    {
+        i2cBus.lastHour = i2cBus.transactions - i2cBus.hourStartCount;
+        i2cBus.hourStartCount = i2cBus.transactions;
+        i2cBus.hourStart = now;
+    }
+
+    if (!status.rtcInitialized)
+        return;
+    unsigned long interval = i2cBus.syncFailed ? RTC_ERROR_RETRY : RTC_SYNC_INTERVAL;
+    if (now - i2cBus.lastSync >= interval)
+        syncClock();
 }
 
 // ========== INITIALIZATION FUNCTIONS ==========
 void initRTC()
 {
-    Wire.begin();
-    if (!rtc.begin())
+    i2cBegin();
+    bool found = rtc.begin();
+    i2cEnd(I2C_TX_PROBE, found);
+    if (!found)
     {
         serialPrintln("RTC not found");
         status.rtcInitialized = false;
@@ -243,11 +1331,16 @@ void initRTC()
     else
     {
         status.rtcInitialized = true;
-        if (rtc.lostPower())
+        i2cBegin();
+        bool lostPower = rtc.lostPower();
+        i2cEnd(I2C_TX_RTC_LOST_POWER, true);
+        if (lostPower)
         {
             serialPrintln("RTC lost power, setting time!");
-            rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
+            setClock(DateTime(F(__DATE__), F(__TIME__)));
         }
+        else
+            syncClock();
         serialPrintln("RTC initialized successfully");
     }
 }
@@ -278,41 +1371,26 @@ bool setupLittleFS()
 // ========== CONFIGURATION FUNCTIONS ==========
 void createDefaultConfig()
 {
-    JsonDocument doc;
-    // Default moisture threshold (%) for automatic watering
-    doc["threshold"] = 30;
-    // Default watering mode: 2 = both (moisture first, then schedule)
-    doc["wateringMode"] = 2;
-    doc["dry"] = 2662;
-    doc["wet"] = 1269;
-    doc["pumpDuration"] = 60000;
-    doc["measurementInterval"] = 60000;
-    doc["dataLogInterval"] = 3600000;
-    doc["irrigationHour1"] = 7;
-    doc["irrigationMinute1"] = 0;
-    doc["irrigationSecond1"] = 0;
-    doc["irrigationHour2"] = 16;
-    doc["irrigationMinute2"] = 0;
-    doc["irrigationSecond2"] = 0;
-
-    File file = LittleFS.open(CONFIG_FILE, "w");
-    if (!file)
-    {
-        serialPrintln("Failed to create default config file");
-        return;
-    }
-
-    if (serializeJson(doc, file) == 0)
+    // Defaults are the member initializers of Config: threshold 30%, mode 2
+    // (moisture first, then schedule), every day at 07:00:00 and 16:00:00
+    Config defaults;
+    if (!writeConfigFile(defaults))
     {
         serialPrintln("Failed to write default config");
+        return;
     }
-
-    file.close();
     serialPrintln("Default config.json created successfully");
 }
 
 bool loadConfig()
 {
+    // Left over from a save cut short by a reset: config.json is still the previous one
+    if (LittleFS.exists(CONFIG_TEMP_FILE))
+    {
+        LittleFS.remove(CONFIG_TEMP_FILE);
+        serialPrintln("Discarded unfinished config save");
+    }
+
     if (!LittleFS.exists(CONFIG_FILE))
     {
         return false;
@@ -322,835 +1400,3352 @@ bool loadConfig()
     if (!file)
         return false;
 
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, file);
+    // Parse into a copy: a damaged file must not leave half of it applied.
+    // Files without "version" are schema 1.
+    int crc = checkConfigCrc(file);
+    Config loaded = config;
+    loaded.version = 1;
+    bool ok = crc >= 0 && file.seek(0) && readConfigJson(file, loaded);
     file.close();
 
-    if (error)
+    // From version 2 on every file is written with a CRC trailer
+    if (!ok || (crc == 0 && loaded.version >= 2))
+    {
+        LittleFS.remove(CONFIG_BAD_FILE);
+        LittleFS.rename(CONFIG_FILE, CONFIG_BAD_FILE);
+        serialPrintln("config.json is damaged, moved to " CONFIG_BAD_FILE);
+        logToFile("config.json is damaged, moved to " CONFIG_BAD_FILE, true);
         return false;
+    }
 
-    config.threshold = doc["threshold"] | config.threshold;
-    config.wateringMode = doc["wateringMode"] | config.wateringMode;
-    config.dry = doc["dry"] | config.dry;
-    config.wet = doc["wet"] | config.wet;
-    config.pumpDuration = doc["pumpDuration"] | config.pumpDuration;
-    config.measurementInterval = doc["measurementInterval"] | config.measurementInterval;
-    config.dataLogInterval = doc["dataLogInterval"] | config.dataLogInterval;
-    config.irrigationHour1 = doc["irrigationHour1"] | config.irrigationHour1;
-    config.irrigationMinute1 = doc["irrigationMinute1"] | config.irrigationMinute1;
-    config.irrigationSecond1 = doc["irrigationSecond1"] | config.irrigationSecond1;
-    config.irrigationHour2 = doc["irrigationHour2"] | config.irrigationHour2;
-    config.irrigationMinute2 = doc["irrigationMinute2"] | config.irrigationMinute2;
-    config.irrigationSecond2 = doc["irrigationSecond2"] | config.irrigationSecond2;
+    int fileVersion = loaded.version;
+    migrateConfig(loaded);
+    config = loaded;
+    sanitizeZones();
+    scheduleQueue.valid = false;
 
-    // Log loaded irrigation schedule
-    char logBuffer[80];
-    snprintf(logBuffer, sizeof(logBuffer),
-             "Irrigation Schedule: %02d:%02d:%02d and %02d:%02d:%02d",
-             config.irrigationHour1, config.irrigationMinute1, config.irrigationSecond1,
-             config.irrigationHour2, config.irrigationMinute2, config.irrigationSecond2);
-    serialPrintln(logBuffer);
+    char logBuffer[128];
+    if (fileVersion != CONFIG_VERSION)
+    {
+        snprintf(logBuffer, sizeof(logBuffer), "Config migrated from version %d to %d", fileVersion, CONFIG_VERSION);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer, true);
+        saveConfig();
+    }
+
+    // Log loaded irrigation schedule
+    char schedule[96];
+    formatScheduleList(schedule, sizeof(schedule));
+    snprintf(logBuffer, sizeof(logBuffer), "Irrigation Schedule: %s", schedule);
+    serialPrintln(logBuffer);
 
     return true;
 }
 
+// Hooks run oldest first and fall through, so a file several versions
+// behind passes through each step. A new field needs no case: it keeps
+// the Config default when its key is missing.
+void migrateConfig(Config &loaded)
+{
+    switch (loaded.version)
+    {
+    case 1:
+        // irrigationHour1..irrigationSecond2 were already read into slots 1
+        // and 2 by their legacy rows in configFields
+    default:
+        break;
+    }
+    // A file from newer firmware keeps the fields this version knows
+    loaded.version = CONFIG_VERSION;
+}
+
 bool saveConfig()
 {
-    File file = LittleFS.open(CONFIG_FILE, "w");
+    return writeConfigFile(config);
+}
+
+// Write to CONFIG_TEMP_FILE, then rename over CONFIG_FILE
+bool writeConfigFile(const Config &source)
+{
+    File file = LittleFS.open(CONFIG_TEMP_FILE, "w");
     if (!file)
         return false;
 
-    JsonDocument doc;
-    doc["threshold"] = config.threshold;
-    doc["wateringMode"] = config.wateringMode;
-    doc["dry"] = config.dry;
-    doc["wet"] = config.wet;
-    doc["pumpDuration"] = config.pumpDuration;
-    doc["measurementInterval"] = config.measurementInterval;
-    doc["dataLogInterval"] = config.dataLogInterval;
-    doc["irrigationHour1"] = config.irrigationHour1;
-    doc["irrigationMinute1"] = config.irrigationMinute1;
-    doc["irrigationSecond1"] = config.irrigationSecond1;
-    doc["irrigationHour2"] = config.irrigationHour2;
-    doc["irrigationMinute2"] = config.irrigationMinute2;
-    doc["irrigationSecond2"] = config.irrigationSecond2;
-
-    size_t bytesWritten = serializeJson(doc, file);
-    file.close();
+    ChecksumPrint out(file);
+    out.print('{');
+    writeConfigJson(out, source);
 
-    return bytesWritten > 0;
+    char trailer[CONFIG_CRC_TRAILER_SIZE + 1];
+    snprintf(trailer, sizeof(trailer), ",\"crc\":\"%08lx\"}", (unsigned long)out.crc);
+    bool ok = !out.failed && file.print(trailer) == CONFIG_CRC_TRAILER_SIZE;
+    return commitTempFile(file, CONFIG_TEMP_FILE, CONFIG_FILE, ok);
 }
 
-void validateMeasurementInterval()
+// LittleFS renames atomically, so after a reset at any point `path` is either
+// the old or the new file, never a truncated one
+bool commitTempFile(File &file, const char *tempPath, const char *path, bool ok)
 {
-    if (config.measurementInterval < MINIMUM_INTERVAL)
+    file.flush();
+    file.close();
+
+    if (!ok || !LittleFS.rename(tempPath, path))
     {
-        config.measurementInterval = MINIMUM_INTERVAL;
-        saveConfig();
+        LittleFS.remove(tempPath);
+        return false;
     }
+    return true;
 }
 
-// ========== SENSOR READING FUNCTIONS ==========
-void readDHT22()
+// The CRC covers every byte before the trailer writeConfigFile() ends the file with
+int checkConfigCrc(File &file)
 {
-    float t = dht.readTemperature();
-    float h = dht.readHumidity();
-
-    if (!isnan(t) && !isnan(h))
+    size_t size = file.size();
+    char trailer[CONFIG_CRC_TRAILER_SIZE + 1];
+    if (size < CONFIG_CRC_TRAILER_SIZE || !file.seek(size - CONFIG_CRC_TRAILER_SIZE) ||
+        file.read((uint8_t *)trailer, CONFIG_CRC_TRAILER_SIZE) != CONFIG_CRC_TRAILER_SIZE)
+        return 0;
+    trailer[CONFIG_CRC_TRAILER_SIZE] = '\0';
+    if (strncmp(trailer, ",\"crc\":\"", 8) != 0 || strcmp(trailer + 16, "\"}") != 0)
+        return 0;
+    uint32_t expected = strtoul(trailer + 8, NULL, 16);
+
+    uint8_t buffer[64];
+    uint32_t crc = 0;
+    size_t remaining = size - CONFIG_CRC_TRAILER_SIZE;
+    file.seek(0);
+    while (remaining > 0)
     {
-        data.temperature = t;
-        data.humidity = h;
-
-        char logBuffer[64];
-        snprintf(logBuffer, sizeof(logBuffer),
-                 "Temp: %.2f°C | Humidity: %.2f%%",
-                 data.temperature, data.humidity);
-        // serialPrintln("DHT22 sensor read successfully");
-        logToFile(logBuffer);
+        size_t got = file.read(buffer, min(remaining, sizeof(buffer)));
+        if (got == 0)
+            return -1;
+        crc = crc32(buffer, got, crc);
+        remaining -= got;
     }
-    else
+    return crc == expected ? 1 : -1;
+}
+
+long getConfigField(const void *base, const ConfigField &field)
+{
+    const uint8_t *p = (const uint8_t *)base + field.offset;
+    switch (field.type)
     {
-        serialPrintln("Failed to read DHT22 sensor");
+    case FIELD_BOOL:
+        return *(const bool *)p;
+    case FIELD_U8:
+        return *p;
+    case FIELD_U16:
+        return *(const uint16_t *)p;
+    case FIELD_INT:
+        return *(const int *)p;
+    default:
+        return (long)*(const unsigned long *)p;
     }
 }
 
-// int readSoilPercent(int pin)
-// {
-//     int raw = analogRead(pin);
-//     raw = constrain(raw, config.dry, config.wet); // sesuaikan hasil kalibrasi
-//     return map(raw, config.wet, config.dry, 0, 100);
-// }
-
-int readADC(int pin)
+void setConfigField(void *base, const ConfigField &field, long value)
 {
-    long sum = 0;
-    for(int i=0; i<10; i++)
+    uint8_t *p = (uint8_t *)base + field.offset;
+    switch (field.type)
     {
-        sum += analogRead(pin);
-        delay(10);
+    case FIELD_BOOL:
+        *(bool *)p = value != 0;
+        break;
+    case FIELD_U8:
+        *p = (uint8_t)value;
+        break;
+    case FIELD_U16:
+        *(uint16_t *)p = (uint16_t)value;
+        break;
+    case FIELD_INT:
+        *(int *)p = (int)value;
+        break;
+    default:
+        *(unsigned long *)p = (unsigned long)value;
+        break;
     }
-    return sum / 10;
 }
 
-int readSoilPercent(int pin)
+// "key":value pairs of one struct, comma separated; legacy fields are skipped
+size_t writeConfigFields(Print &out, const ConfigField *fields, size_t count, const void *base)
 {
-    int raw = readADC(pin);
-    raw = constrain(raw, config.wet, config.dry); // sesuaikan hasil kalibrasi
-    return map(raw, config.dry, config.wet, 0, 50);
+    size_t n = 0;
+    bool first = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        const ConfigField &field = fields[i];
+        if (field.flags & FIELD_LEGACY)
+            continue;
+        if (!first)
+            n += out.print(',');
+        first = false;
+        n += out.print('"');
+        n += out.print(field.key);
+        n += out.print("\":");
+        long value = getConfigField(base, field);
+        n += field.type == FIELD_BOOL ? out.print(value ? "true" : "false") : out.print(value);
+    }
+    return n;
 }
 
-void readSoilMoisture()
+size_t writeConfigJson(Print &out, const Config &source)
 {
-    data.soilMoisture1 = readSoilPercent(SOIL1_MOISTURE_PIN);
-    data.soilMoisture2 = readSoilPercent(SOIL2_MOISTURE_PIN);
-    data.soilMoisture3 = readSoilPercent(SOIL3_MOISTURE_PIN);
-    data.soilMoisture4 = readSoilPercent(SOIL4_MOISTURE_PIN);
-    data.soilMoisture5 = readSoilPercent(SOIL5_MOISTURE_PIN);
-    data.soilMoisture6 = readSoilPercent(SOIL6_MOISTURE_PIN);
-    data.soilMoisture7 = readSoilPercent(SOIL7_MOISTURE_PIN);
-    data.soilMoisture8 = readSoilPercent(SOIL8_MOISTURE_PIN);
-    data.soilMoisture9 = readSoilPercent(SOIL9_MOISTURE_PIN);
-    data.soilMoisture10 = readSoilPercent(SOIL10_MOISTURE_PIN);
+    size_t n = writeConfigFields(out, configFields, sizeof(configFields) / sizeof(configFields[0]), &source);
+    for (const ConfigList &list : configLists)
+    {
+        n += out.print(",\"");
+        n += out.print(list.key);
+        n += out.print("\":[");
+        for (int i = 0; i < list.count; i++)
+        {
+            n += out.print(i ? ",{" : "{");
+            n += writeConfigFields(out, list.fields, list.fieldCount, (const uint8_t *)&source + list.offset + i * list.stride);
+            n += out.print('}');
+        }
+        n += out.print(']');
+    }
+    return n;
 }
 
-void initLuxMeter()
+size_t ChecksumPrint::write(const uint8_t *data, size_t size)
 {
-    Wire.begin();
-
-    status.bh1750OK = lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE);
+    crc = crc32(data, size, crc);
+    size_t written = out.write(data, size);
+    if (written != size)
+        failed = true;
+    return written;
+}
 
-    if (status.bh1750OK)
-        serialPrintln("BH1750 initialized");
-    else
-        serialPrintln("Error initializing BH1750");
+void ChunkedResponse::flush()
+{
+    if (length > 0)
+        server.sendContent(buffer, length);
+    length = 0;
 }
 
-void readLuxMeter()
+int jsonPeek(JsonReader &r)
 {
-    if (!status.bh1750OK)
+    if (r.pos == r.length)
     {
-        serialPrintln("BH1750 not available");
-        return;
+        r.length = r.file.read(r.buffer, sizeof(r.buffer));
+        r.pos = 0;
+        if (r.length == 0)
+            return -1;
     }
-
-    data.lux = lightMeter.readLightLevel();
-    char logBuffer[64];
-    snprintf(logBuffer, sizeof(logBuffer), "Light: %.2f lux", data.lux);
-    logToFile(logBuffer);
+    return r.buffer[r.pos];
 }
 
-// ========== IRRIGATION CONTROL ==========
-void resetDailyIrrigation(DateTime &currentTime)
+int jsonSkipSpace(JsonReader &r)
 {
-    static int lastDay = -1;
-
-    if (currentTime.day() != lastDay)
-    {
-        lastDay = currentTime.day();
-        pumpControl.irrigationDone[0] = false;
-        pumpControl.irrigationDone[1] = false;
-        pumpControl.pumpRunsToday = 0;
+    int c;
+    while ((c = jsonPeek(r)) == ' ' || c == '\n' || c == '\r' || c == '\t')
+        r.pos++;
+    return c;
+}
 
-        char logBuffer[80];
-        snprintf(logBuffer, sizeof(logBuffer),
-                 "Schedule reset (%02d:%02d:%02d & %02d:%02d:%02d)",
-                 config.irrigationHour1, config.irrigationMinute1, config.irrigationSecond1,
-                 config.irrigationHour2, config.irrigationMinute2, config.irrigationSecond2);
-        serialPrintln(logBuffer);
-        logToFile(logBuffer);
-    }
+bool jsonExpect(JsonReader &r, char expected)
+{
+    if (jsonSkipSpace(r) != expected)
+        return false;
+    r.pos++;
+    return true;
 }
 
-// Returns average soil moisture (0-100) or -1 if no valid sensor data
-int getAverageSoilMoisture()
+// Keys longer than `size` are cut; out may be nullptr to skip a string
+bool jsonReadString(JsonReader &r, char *out, size_t size)
 {
-    int vals[10] = {
-        data.soilMoisture1, data.soilMoisture2, data.soilMoisture3, data.soilMoisture4,
-        data.soilMoisture5, data.soilMoisture6, data.soilMoisture7, data.soilMoisture8,
-        data.soilMoisture9, data.soilMoisture10
-    };
-    int sum = 0, count = 0;
-    for (int i = 0; i < 10; i++)
+    if (!jsonExpect(r, '"'))
+        return false;
+    size_t n = 0;
+    int c;
+    while ((c = jsonPeek(r)) != '"')
     {
-        if (vals[i] >= 0 && vals[i] <= 100)
+        if (c < 0)
+            return false;
+        r.pos++;
+        if (c == '\\')
         {
-            sum += vals[i];
-            count++;
+            if (jsonPeek(r) < 0)
+                return false;
+            c = r.buffer[r.pos++]; // config keys are plain ASCII: keep the escaped character
         }
+        if (out && n + 1 < size)
+            out[n++] = (char)c;
     }
-    if (count == 0)
-        return -1;
-    return sum / count;
+    r.pos++;
+    if (out)
+        out[n] = '\0';
+    return true;
 }
 
-void startPump(int scheduleIndex, int hour, int minute, int second)
+// Integers, true/false/null; a fraction or exponent is dropped
+bool jsonReadNumber(JsonReader &r, long &value)
 {
-    pumpControl.state = PUMP_RUNNING;
-    pumpControl.startTime = millis();
-    pumpControl.pumpRunsToday++;
-
-    digitalWrite(SOLENOID_PIN, SOLENOID_OPEN);
-    delay(500);
-
-    digitalWrite(PUMP_PIN, PUMP_ON);
-
-    if (scheduleIndex >= 0 && scheduleIndex <= 1)
-        pumpControl.irrigationDone[scheduleIndex] = true;
-
-    char logBuffer[80];
-    snprintf(logBuffer, sizeof(logBuffer),
-             "Pump START (%02d:%02d:%02d)",
-             hour, minute, second);
+    int c = jsonSkipSpace(r);
+    if (isalpha(c))
+    {
+        value = c == 't';
+        while (isalpha(jsonPeek(r)))
+            r.pos++;
+        return true;
+    }
 
-    serialPrintln(logBuffer);
-    logToFile(logBuffer);
+    bool negative = c == '-';
+    if (negative)
+        r.pos++;
+    if (!isdigit(jsonPeek(r)))
+        return false;
+    long v = 0;
+    while (isdigit(c = jsonPeek(r)))
+    {
+        if (v < 100000000L)
+            v = v * 10 + (c - '0');
+        r.pos++;
+    }
+    while ((c = jsonPeek(r)) == '.' || c == 'e' || c == 'E' || c == '+' || c == '-' || isdigit(c))
+        r.pos++;
+    value = negative ? -v : v;
+    return true;
 }
 
-void controlPump(DateTime &currentTime)
+bool jsonSkipValue(JsonReader &r, int depth)
 {
-    int avgSoil = getAverageSoilMoisture();
-
-    // ==========================
-    // STATE MACHINE: RUNNING -> duration expires -> COOLDOWN -> IDLE
-    // Pump turns OFF after configured duration; cooldown prevents overlapping cycles.
-    // ==========================
+    int c = jsonSkipSpace(r);
+    if (c == '"')
+        return jsonReadString(r, nullptr, 0);
+    if (c != '{' && c != '[')
+    {
+        long ignored;
+        return jsonReadNumber(r, ignored);
+    }
 
-    switch (pumpControl.state)
+    char close = c == '{' ? '}' : ']';
+    if (depth > 8)
+        return false;
+    r.pos++;
+    if (jsonSkipSpace(r) == close)
     {
-    case PUMP_IDLE:
-        break;
+        r.pos++;
+        return true;
+    }
+    do
+    {
+        if (close == '}' && (!jsonReadString(r, nullptr, 0) || !jsonExpect(r, ':')))
+            return false;
+        if (!jsonSkipValue(r, depth + 1))
+            return false;
+    } while (jsonExpect(r, ','));
+    return jsonExpect(r, close);
+}
 
-    case PUMP_RUNNING:
-        if (millis() - pumpControl.startTime >= config.pumpDuration)
+// One JSON object into `base`; unknown keys are skipped, known ones clamped to the table range
+bool jsonReadFields(JsonReader &r, const ConfigField *fields, size_t count, void *base, bool topLevel)
+{
+    if (!jsonExpect(r, '{'))
+        return false;
+    if (jsonSkipSpace(r) == '}')
+    {
+        r.pos++;
+        return true;
+    }
+    do
+    {
+        char key[24];
+        if (!jsonReadString(r, key, sizeof(key)) || !jsonExpect(r, ':'))
+            return false;
+
+        const ConfigList *list = nullptr;
+        for (size_t i = 0; topLevel && i < sizeof(configLists) / sizeof(configLists[0]); i++)
+            if (strcmp(configLists[i].key, key) == 0)
+                list = &configLists[i];
+        const ConfigField *field = nullptr;
+        for (size_t i = 0; i < count && !list; i++)
+            if (strcmp(fields[i].key, key) == 0)
+                field = &fields[i];
+
+        int c = jsonSkipSpace(r);
+        bool ok;
+        if (list && c == '[')
         {
-            digitalWrite(PUMP_PIN, PUMP_OFF);
-            delay(500);
-            digitalWrite(SOLENOID_PIN, SOLENOID_CLOSED);
-            pumpControl.state = PUMP_COOLDOWN;
-            pumpControl.cooldownStart = millis();
-            serialPrintln("Pump STOP");
-            logToFile("Pump stopped");
+            r.pos++;
+            int i = 0;
+            ok = true;
+            if (jsonSkipSpace(r) == ']')
+                r.pos++;
+            else
+            {
+                do
+                {
+                    ok = i < list->count ? jsonReadFields(r, list->fields, list->fieldCount,
+                                                          (uint8_t *)base + list->offset + i * list->stride, false)
+                                         : jsonSkipValue(r, 2);
+                    i++;
+                } while (ok && jsonExpect(r, ','));
+                ok = ok && jsonExpect(r, ']');
+            }
         }
-        break;
-
-    case PUMP_COOLDOWN:
-        if (millis() - pumpControl.cooldownStart >= COOLDOWN_TIME)
+        else if (field && c != '"' && c != '{' && c != '[')
         {
-            pumpControl.state = PUMP_IDLE;
-            serialPrintln("Pump READY");
+            long value;
+            ok = jsonReadNumber(r, value);
+            if (ok)
+                setConfigField(base, *field, constrain(value, field->min, field->max));
         }
-        break;
+        else
+            ok = jsonSkipValue(r, 1);
 
-    case PUMP_ERROR:
-        digitalWrite(PUMP_PIN, PUMP_OFF);
-        break;
-    }
+        if (!ok)
+            return false;
+    } while (jsonExpect(r, ','));
+    return jsonExpect(r, '}');
+}
 
-    // ==========================
-    // PRIORITY 1: Manual override — skip all automation
-    // ==========================
-    if (pumpControl.manualOverride)
-        return;
+bool readConfigJson(File &file, Config &target)
+{
+    JsonReader reader = {file, {}, 0, 0};
+    return jsonReadFields(reader, configFields, sizeof(configFields) / sizeof(configFields[0]), &target, true);
+}
 
-    if (pumpControl.state != PUMP_IDLE)
-        return;
+// Bits needed for a bitmask field, e.g. 10 for the soil sensors
+int indexListCount(long max)
+{
+    int count = 0;
+    while (count < 16 && (max >> count))
+        count++;
+    return count;
+}
 
-    // ==========================
-    // PRIORITY 2: Moisture-based (Average Soil Moisture < threshold from Settings)
-    // Uses config.threshold (%) and config.pumpDuration (ms). Cooldown between activations.
-    // ==========================
-    bool allowMoisture =
-        (config.wateringMode == MODE_MOISTURE || config.wateringMode == MODE_BOTH);
-    bool allowSchedule =
-        (config.wateringMode == MODE_SCHEDULE || config.wateringMode == MODE_BOTH);
+uint16_t applyConfigArg(const ConfigField &field, const char *name, void *base)
+{
+    if (!field.arg || !server.hasArg(name))
+        return 0;
 
-    if (allowMoisture && avgSoil >= 0 && avgSoil < config.threshold)
+    long value;
+    if (field.flags & FIELD_INDEX_LIST)
+        value = parseIndexList(server.arg(name), indexListCount(field.max));
+    else
     {
-        pumpControl.moistureStableCount++;
-        if (pumpControl.moistureStableCount >= MOISTURE_DEBOUNCE_COUNT)
-        {
-            pumpControl.moistureStableCount = 0;
-            startPump(-1, 0, 0, 0);
-            pumpControl.controlSource = SOIL_AUTOMATION;
-            char buf[80];
-            snprintf(buf, sizeof(buf), "Pump START (Moisture Auto, avg %d%% < threshold %d%%)", avgSoil, config.threshold);
-            serialPrintln(buf);
-            logToFile(buf);
-        }
-        return;
+        long raw = server.arg(name).toInt();
+        // Compare before scaling so huge inputs cannot overflow
+        long lowest = (field.min + field.argScale - 1) / field.argScale;
+        long highest = field.max / field.argScale;
+        if ((raw < lowest || raw > highest) && !(field.flags & FIELD_CLAMP))
+            return 0;
+        value = constrain(raw, lowest, highest) * field.argScale;
     }
-    pumpControl.moistureStableCount = 0;
-
-    // ==========================
-    // PRIORITY 3: Scheduled irrigation (only if manual off and moisture not triggering)
-    // ==========================
-    if (!allowSchedule)
-        return;
+    if (value < field.min || value > field.max)
+        return 0;
 
-    int currentHour = currentTime.hour();
-    int currentMinute = currentTime.minute();
-    int currentSecond = currentTime.second();
+    long old = getConfigField(base, field);
+    setConfigField(base, field, value);
+    return old != value ? field.group : 0;
+}
 
-    if (currentHour == config.irrigationHour1 &&
-        currentMinute == config.irrigationMinute1 &&
-        currentSecond >= config.irrigationSecond1 &&
-        !pumpControl.irrigationDone[0])
-    {
-        startPump(0, config.irrigationHour1, config.irrigationMinute1, config.irrigationSecond1);
-        pumpControl.controlSource = SCHEDULE_AUTOMATION;
-        serialPrintln("Pump START (Schedule)");
-        logToFile("Pump started by schedule");
-        return;
-    }
+uint16_t applyConfigArgs()
+{
+    uint16_t changed = 0;
+    for (const ConfigField &field : configFields)
+        changed |= applyConfigArg(field, field.arg, &config);
 
-    if (currentHour == config.irrigationHour2 &&
-        currentMinute == config.irrigationMinute2 &&
-        currentSecond >= config.irrigationSecond2 &&
-        !pumpControl.irrigationDone[1])
+    for (const ConfigList &list : configLists)
     {
-        startPump(1, config.irrigationHour2, config.irrigationMinute2, config.irrigationSecond2);
-        pumpControl.controlSource = SCHEDULE_AUTOMATION;
-        serialPrintln("Pump START (Schedule)");
-        logToFile("Pump started by schedule");
-        return;
+        for (int i = 0; i < list.count; i++)
+        {
+            void *base = (uint8_t *)&config + list.offset + i * list.stride;
+            for (int f = 0; f < list.fieldCount; f++)
+            {
+                const ConfigField &field = list.fields[f];
+                if (!field.arg)
+                    continue;
+                char name[24];
+                snprintf(name, sizeof(name), "%s%d%s", list.argPrefix, i + 1, field.arg);
+                changed |= applyConfigArg(field, name, base);
+            }
+        }
     }
+    return changed;
 }
 
-// ========== WEB SERVER HANDLERS ==========
-void handleRoot()
+bool isValvePinChoice(int pin)
 {
-    File file = LittleFS.open("/index.html", "r");
-    if (!file)
+    for (size_t i = 0; i < sizeof(zoneValvePinChoices); i++)
     {
-        server.send(404, "text/plain", "File not found");
-        return;
+        if (zoneValvePinChoices[i] == pin)
+            return true;
     }
-    server.sendHeader("Cache-Control", "private, max-age=120");
-    server.streamFile(file, "text/html");
-    file.close();
+    return false;
 }
 
-void handleStatus()
+void sanitizeZones()
 {
-    JsonDocument doc;
-    doc["temperature"] = data.temperature;
-    doc["humidity"] = data.humidity;
-    doc["lux"] = data.lux;
-    doc["soilMoisture1"] = data.soilMoisture1;
-    doc["soilMoisture2"] = data.soilMoisture2;
-    doc["soilMoisture3"] = data.soilMoisture3;
-    doc["soilMoisture4"] = data.soilMoisture4;
-    doc["soilMoisture5"] = data.soilMoisture5;
-    doc["soilMoisture6"] = data.soilMoisture6;
-    doc["soilMoisture7"] = data.soilMoisture7;
-    doc["soilMoisture8"] = data.soilMoisture8;
-    doc["soilMoisture9"] = data.soilMoisture9;
-    doc["soilMoisture10"] = data.soilMoisture10;
-    doc["pumpState"] = pumpControl.state;
-    doc["controlSource"] = (int)pumpControl.controlSource;
-    doc["manualOverride"] = pumpControl.manualOverride;
-    doc["threshold"] = config.threshold;
-    doc["wateringMode"] = config.wateringMode;
-    doc["irrigationHour1"] = config.irrigationHour1;
-    doc["irrigationMinute1"] = config.irrigationMinute1;
-    doc["irrigationSecond1"] = config.irrigationSecond1;
-    doc["irrigationHour2"] = config.irrigationHour2;
-    doc["irrigationMinute2"] = config.irrigationMinute2;
-    doc["irrigationSecond2"] = config.irrigationSecond2;
-
-    if (status.rtcInitialized)
+    bool anyEnabled = false;
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
     {
-        DateTime now = rtc.now();
-        char timeStr[20];
-        snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
-                 now.year(), now.month(), now.day(),
-                 now.hour(), now.minute(), now.second());
-        doc["timestamp"] = timeStr;
+        ZoneConfig &zc = config.zones[z];
+        if (!isValvePinChoice(zc.valvePin))
+            zc.valvePin = zoneValvePinChoices[z];
+
+        if (!zc.enabled)
+            continue;
+        // Two zones on one valve would water each other
+        for (int other = 0; other < z; other++)
+        {
+            if (config.zones[other].enabled && config.zones[other].valvePin == zc.valvePin)
+                zc.enabled = false;
+        }
+        if (zc.enabled)
+            anyEnabled = true;
     }
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    if (!anyEnabled)
+    {
+        config.zones[0].enabled = true;
+        config.zones[0].sensors = ZONE_ALL_SENSORS;
+    }
 }
 
-void handleConfig()
+// Sensors and zones are numbered from 1 in the API and the UI
+uint16_t parseIndexList(const String &list, int count)
 {
-    JsonDocument doc;
-    doc["threshold"] = config.threshold;
-    doc["wateringMode"] = config.wateringMode;
-    doc["dry"] = config.dry;
-    doc["wet"] = config.wet;
-    doc["pumpDuration"] = config.pumpDuration;
-    doc["measurementInterval"] = config.measurementInterval;
-    doc["dataLogInterval"] = config.dataLogInterval;
-    doc["irrigationHour1"] = config.irrigationHour1;
-    doc["irrigationMinute1"] = config.irrigationMinute1;
-    doc["irrigationSecond1"] = config.irrigationSecond1;
-    doc["irrigationHour2"] = config.irrigationHour2;
-    doc["irrigationMinute2"] = config.irrigationMinute2;
-    doc["irrigationSecond2"] = config.irrigationSecond2;
-
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    uint16_t mask = 0;
+    const char *p = list.c_str();
+    while (*p)
+    {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p)
+        {
+            p++; // separator or junk
+            continue;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1)
+                last = first;
+            p = end;
+        }
+        for (long ch = max(1L, first); ch <= min((long)count, last); ch++)
+            mask |= 1 << (ch - 1);
+    }
+    return mask;
 }
 
-void handleSettings()
+void formatIndexList(char *out, size_t size, uint16_t mask, int count)
 {
-    // Simpan nilai lama untuk bandingkan — hanya log yang benar-benar berubah
-    int oldThreshold = config.threshold;
-    int oldDry = config.dry;
-    int oldWet = config.wet;
-    unsigned long oldPumpDuration = config.pumpDuration;
-    unsigned long oldMeasurementInterval = config.measurementInterval;
-    unsigned long oldDataLogInterval = config.dataLogInterval;
-    int oldWateringMode = config.wateringMode;
-    int oldH1 = config.irrigationHour1, oldM1 = config.irrigationMinute1, oldS1 = config.irrigationSecond1;
-    int oldH2 = config.irrigationHour2, oldM2 = config.irrigationMinute2, oldS2 = config.irrigationSecond2;
-
-    bool logSchedule = false;
-    bool logModeWatering = false;
-    bool logThreshold = false;
-    bool logPumpDuration = false;
-    bool logMeasurementInterval = false;
-    bool logDataLogInterval = false;
-    bool logCalibration = false;
-
-    if (server.hasArg("threshold"))
+    size_t len = 0;
+    out[0] = '\0';
+    for (int ch = 0; ch < count; ch++)
     {
-        int v = server.arg("threshold").toInt();
-        if (v != oldThreshold) logThreshold = true;
-        config.threshold = v;
+        if (!(mask & (1 << ch)))
+            continue;
+        int last = ch;
+        while (last + 1 < count && (mask & (1 << (last + 1))))
+            last++;
+        int n = last > ch ? snprintf(out + len, size - len, "%s%d-%d", len ? "," : "", ch + 1, last + 1)
+                          : snprintf(out + len, size - len, "%s%d", len ? "," : "", ch + 1);
+        if (n < 0 || (size_t)n >= size - len)
+            break;
+        len += n;
+        ch = last;
     }
-    if (server.hasArg("dry"))
-    {
-        int v = server.arg("dry").toInt();
-        if (v != oldDry) logCalibration = true;
-        config.dry = v;
-    }
-    if (server.hasArg("wet"))
-    {
-        int v = server.arg("wet").toInt();
-        if (v != oldWet) logCalibration = true;
-        config.wet = v;
-    }
-    if (server.hasArg("pumpDuration"))
+    if (len == 0)
+        snprintf(out, size, "-");
+}
+
+void validateMeasurementInterval()
+{
+    if (config.measurementInterval < (int)MINIMUM_INTERVAL)
     {
-        unsigned long v = (unsigned long)server.arg("pumpDuration").toInt();
-        if (v != oldPumpDuration) logPumpDuration = true;
-        config.pumpDuration = v;
+        config.measurementInterval = MINIMUM_INTERVAL;
+        saveConfig();
     }
-    if (server.hasArg("measurementInterval"))
+}
+
+// ========== SENSOR READING FUNCTIONS ==========
+// The transfer itself runs in Dht22 (RMT + esp_timer); a measurement only
+// takes the last good reading, so a failed one leaves the previous value
+// with a growing age instead of stalling sensorTask
+void readDHT22()
+{
+    if (dht.hasValue())
     {
-        unsigned long seconds = server.arg("measurementInterval").toInt();
-        unsigned long v = max(MINIMUM_INTERVAL, seconds * 1000UL);
-        if (v != oldMeasurementInterval) logMeasurementInterval = true;
-        config.measurementInterval = v;
+        data.temperature = dht.temperature();
+        data.humidity = dht.humidity();
+        data.dhtAge = dht.age() / 1000;
     }
-    if (server.hasArg("dataLogInterval"))
+    data.dhtFailures = dht.failures();
+    data.dhtErrors = dht.errors();
+}
+
+const char *dhtErrorName(Dht22::Error error)
+{
+    switch (error)
     {
-        unsigned long seconds = server.arg("dataLogInterval").toInt();
-        unsigned long v = seconds * 1000UL;
-        if (v != oldDataLogInterval) logDataLogInterval = true;
-        config.dataLogInterval = v;
+    case Dht22::DHT22_NO_RESPONSE: return "no response";
+    case Dht22::DHT22_SHORT_FRAME: return "short frame";
+    case Dht22::DHT22_CHECKSUM: return "checksum";
+    case Dht22::DHT22_RANGE: return "out of range";
+    default: return "ok";
     }
-    if (server.hasArg("wateringMode"))
+}
+
+// Logs each finished transfer: the values, the first failure of a streak
+// (retries back off silently) and the recovery
+void serviceDHT22()
+{
+    static uint32_t lastFailures = 0;
+    bool wasBusy = dht.busy();
+    dht.service();
+    if (!wasBusy || dht.busy())
+        return;
+
+    char logBuffer[80];
+    if (dht.lastError() == Dht22::DHT22_OK)
     {
-        int mode = server.arg("wateringMode").toInt();
-        if (mode >= MODE_SCHEDULE && mode <= MODE_BOTH)
+        if (lastFailures > 0)
         {
-            if (mode != oldWateringMode) logModeWatering = true;
-            config.wateringMode = mode;
+            snprintf(logBuffer, sizeof(logBuffer), "DHT22 read OK again after %lu failures", (unsigned long)lastFailures);
+            serialPrintln(logBuffer);
+            logToFile(logBuffer);
         }
+        snprintf(logBuffer, sizeof(logBuffer), "Temp: %.2f°C | Humidity: %.2f%%", dht.temperature(), dht.humidity());
+        logToFile(logBuffer);
     }
-    if (server.hasArg("irrigationHour1"))
-    {
-        int hour = server.arg("irrigationHour1").toInt();
-        if (hour >= 0 && hour <= 23) config.irrigationHour1 = hour;
-    }
-    if (server.hasArg("irrigationMinute1"))
-    {
-        int minute = server.arg("irrigationMinute1").toInt();
-        if (minute >= 0 && minute <= 59) config.irrigationMinute1 = minute;
-    }
-    if (server.hasArg("irrigationSecond1"))
+    else if (dht.failures() == 1)
     {
-        int second = server.arg("irrigationSecond1").toInt();
-        if (second >= 0 && second <= 59) config.irrigationSecond1 = second;
+        snprintf(logBuffer, sizeof(logBuffer), "Failed to read DHT22 sensor (%s), retrying with backoff",
+                 dhtErrorName(dht.lastError()));
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
     }
-    if (server.hasArg("irrigationHour2"))
-    {
-        int hour = server.arg("irrigationHour2").toInt();
-        if (hour >= 0 && hour <= 23) config.irrigationHour2 = hour;
+    lastFailures = dht.failures();
+}
+
+// int readSoilPercent(int pin)
+// {
+//     int raw = analogRead(pin);
+//     raw = constrain(raw, config.dry, config.wet); // sesuaikan hasil kalibrasi
+//     return map(raw, config.wet, config.dry, 0, 100);
+// }
+
+int readSoilPercent(int channel, int raw)
+{
+    return soilLut[channel][constrain(raw, 0, 4095) >> SOIL_LUT_SHIFT];
+}
+
+void sortSoilCalibration(SoilCalibration &cal)
+{
+    cal.points = min(cal.points, (uint8_t)SOIL_CAL_POINTS);
+    for (int i = 1; i < cal.points; i++)
+    {
+        for (int j = i; j > 0 && cal.raw[j] > cal.raw[j - 1]; j--)
+        {
+            uint16_t raw = cal.raw[j];
+            cal.raw[j] = cal.raw[j - 1];
+            cal.raw[j - 1] = raw;
+            uint8_t percent = cal.percent[j];
+            cal.percent[j] = cal.percent[j - 1];
+            cal.percent[j - 1] = percent;
+        }
     }
-    if (server.hasArg("irrigationMinute2"))
+}
+
+// Interpolates each bin centre on the channel's curve, truncating like map();
+// outside the curve the end points hold, like constrain()
+void buildSoilLut()
+{
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
     {
-        int minute = server.arg("irrigationMinute2").toInt();
-        if (minute >= 0 && minute <= 59) config.irrigationMinute2 = minute;
+        sortSoilCalibration(config.soilCalibration[ch]);
+        SoilCalibration cal = config.soilCalibration[ch];
+        if (cal.points < 2)
+        {
+            cal.points = 2;
+            cal.raw[0] = config.dry;
+            cal.percent[0] = 0;
+            cal.raw[1] = config.wet;
+            cal.percent[1] = SOIL_PERCENT_MAX;
+        }
+
+        int segment = 0;
+        for (int bin = SOIL_LUT_SIZE - 1; bin >= 0; bin--)
+        {
+            long raw = ((long)bin << SOIL_LUT_SHIFT) + (1 << SOIL_LUT_SHIFT) / 2;
+            while (segment < cal.points - 2 && raw <= cal.raw[segment + 1])
+                segment++;
+            long hi = cal.raw[segment], lo = cal.raw[segment + 1];
+            long percent;
+            if (raw >= hi)
+                percent = cal.percent[segment];
+            else if (raw <= lo || hi == lo)
+                percent = cal.percent[segment + 1];
+            else
+                percent = cal.percent[segment] + (cal.percent[segment + 1] - cal.percent[segment]) * (hi - raw) / (hi - lo);
+            soilLut[ch][bin] = constrain(percent, 0, SOIL_PERCENT_MAX);
+        }
     }
-    if (server.hasArg("irrigationSecond2"))
+}
+
+// The filters are always current, so a measurement only copies their output
+bool readSoilMoisture()
+{
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
     {
-        int second = server.arg("irrigationSecond2").toInt();
-        if (second >= 0 && second <= 59) config.irrigationSecond2 = second;
+        if (soilSampler.filters[ch].count < min((int)config.soilFilter[ch].window, SOIL_FILTER_WINDOW))
+            return false; // first cycle after boot
     }
 
-    if (config.irrigationHour1 != oldH1 || config.irrigationMinute1 != oldM1 || config.irrigationSecond1 != oldS1 ||
-        config.irrigationHour2 != oldH2 || config.irrigationMinute2 != oldM2 || config.irrigationSecond2 != oldS2)
-        logSchedule = true;
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+    {
+        data.soilRaw[ch] = readSoilFiltered(ch);
+        data.soilMoisture[ch] = readSoilPercent(ch, data.soilRaw[ch]);
+    }
+    checkSoilHealth();
+    return true;
+}
 
-    if (saveConfig())
+bool serviceSoilSampler()
+{
+    unsigned long now = millis();
+    if (now - soilSampler.lastRound < SOIL_SAMPLE_PERIOD_MS)
+        return false;
+    soilSampler.lastRound = now;
+
+    // `oversample` analogReads per pin (~10-20 us each), never a delay()
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
     {
-        server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Settings saved\"}");
+        const SoilFilterConfig &cfg = config.soilFilter[ch];
+        int oversample = constrain((int)cfg.oversample, 1, SOIL_OVERSAMPLE_MAX);
+        uint32_t sum = 0;
+        for (int i = 0; i < oversample; i++)
+            sum += analogRead(soilPins[ch]);
+        filterSoilSample(soilSampler.filters[ch], cfg, sum / oversample);
+    }
+    return true;
+}
 
-        char logBuf[128];
-        if (logSchedule)
+uint16_t filterSoilSample(SoilFilter &filter, const SoilFilterConfig &cfg, uint16_t sample)
+{
+    filter.ring[filter.head] = sample;
+    filter.head = (filter.head + 1) % SOIL_FILTER_WINDOW;
+    if (filter.count < SOIL_FILTER_WINDOW)
+        filter.count++;
+
+    // Window stage over the newest `window` samples; the config may change
+    // at any time, the ring always holds the last SOIL_FILTER_WINDOW
+    int n = constrain((int)cfg.window, 1, (int)filter.count);
+    int values[SOIL_FILTER_WINDOW];
+    long sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        values[i] = filter.ring[(filter.head + SOIL_FILTER_WINDOW - 1 - i) % SOIL_FILTER_WINDOW];
+        sum += values[i];
+    }
+    int windowed = cfg.mode == SOIL_FILTER_MEDIAN ? medianOf(values, n) : sum / n;
+
+    // EMA stage, seeded with the first output
+    int shift = min((int)cfg.emaShift, SOIL_EMA_SHIFT_MAX);
+    if (shift == 0 || filter.count == 1)
+        filter.ema = (int32_t)windowed << 8;
+    else
+        filter.ema += (((int32_t)windowed << 8) - filter.ema) >> shift;
+    filter.value = (filter.ema + 128) >> 8;
+    return filter.value;
+}
+
+uint16_t readSoilFiltered(int channel)
+{
+    return soilSampler.filters[channel].value;
+}
+
+// ========== SOIL HEALTH ==========
+// readSoilPercent() clamps everything to 0..50, so a disconnected probe looks
+// like a plausible reading. These checks flag such channels so control skips them.
+uint8_t checkSoilChannel(int channel)
+{
+    SoilHealth &health = soilHealth[channel];
+    uint16_t raw = data.soilRaw[channel];
+    uint8_t fault = 0;
+
+    if (raw == health.lastRaw)
+        health.sameCount = min(health.sameCount + 1, 255);
+    else
+        health.sameCount = 0;
+    health.lastRaw = raw;
+
+    if (raw <= SOIL_RAIL_LOW || raw >= SOIL_RAIL_HIGH)
+    {
+        health.lastPercent = -1; // the first reading after reconnecting is accepted as is
+        health.held = false;
+        return SOIL_FAULT_RAIL;
+    }
+    if (health.sameCount >= SOIL_STUCK_CYCLES)
+        fault |= SOIL_FAULT_STUCK;
+
+    // A single jump is held back for one cycle; if the next reading confirms
+    // the new level (e.g. while watering) it is accepted
+    int percent = data.soilMoisture[channel];
+    if (health.lastPercent >= 0 && !health.held && abs(percent - health.lastPercent) > SOIL_RATE_MAX_STEP)
+    {
+        health.held = true;
+        data.soilMoisture[channel] = health.lastPercent;
+        return fault | SOIL_FAULT_RATE;
+    }
+    health.held = false;
+    health.lastPercent = percent;
+    return fault;
+}
+
+int medianOf(int *values, int count)
+{
+    for (int i = 1; i < count; i++)
+    {
+        for (int j = i; j > 0 && values[j] < values[j - 1]; j--)
         {
-            snprintf(logBuf, sizeof(logBuf),
-                     "Update schedule ('%02d:%02d:%02d & %02d:%02d:%02d')",
-                     config.irrigationHour1, config.irrigationMinute1, config.irrigationSecond1,
-                     config.irrigationHour2, config.irrigationMinute2, config.irrigationSecond2);
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            int value = values[j];
+            values[j] = values[j - 1];
+            values[j - 1] = value;
         }
-        if (logModeWatering)
+    }
+    if (count % 2)
+        return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Probes of one zone sit in the same bed and are watered together, so a
+// channel far from the zone's median is more likely broken than right
+void checkSoilOutliers()
+{
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        if (!config.zones[z].enabled)
+            continue;
+
+        uint16_t sensors = config.zones[z].sensors;
+        int values[SOIL_CHANNEL_COUNT];
+        int count = 0;
+        for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
         {
-            const char *modeStr = config.wateringMode == MODE_SCHEDULE ? "Schedule" :
-                                 config.wateringMode == MODE_MOISTURE ? "Moisture" : "Both";
-            snprintf(logBuf, sizeof(logBuf), "Update mode watering ('%s')", modeStr);
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            if ((sensors & (1 << ch)) && !(data.soilFault[ch] & ~SOIL_FAULT_OUTLIER))
+                values[count++] = data.soilMoisture[ch];
         }
-        if (logThreshold)
+        if (count < SOIL_OUTLIER_MIN_CHANNELS)
+            continue;
+
+        int median = medianOf(values, count);
+        for (int i = 0; i < count; i++)
+            values[i] = abs(values[i] - median);
+        int limit = max(SOIL_OUTLIER_MAD_SCALE * medianOf(values, count), SOIL_OUTLIER_MIN_SPREAD);
+
+        for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
         {
-            snprintf(logBuf, sizeof(logBuf), "Update threshold ('%d%%')", config.threshold);
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            if ((sensors & (1 << ch)) && !data.soilFault[ch] && abs(data.soilMoisture[ch] - median) > limit)
+                data.soilFault[ch] |= SOIL_FAULT_OUTLIER;
         }
-        if (logPumpDuration)
+    }
+}
+
+void checkSoilHealth()
+{
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+        data.soilFault[ch] = checkSoilChannel(ch);
+    checkSoilOutliers();
+
+    // Rate holds last a single cycle and are not worth a log line
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+    {
+        uint8_t fault = data.soilFault[ch] & ~SOIL_FAULT_RATE;
+        if (fault == soilHealth[ch].fault)
+            continue;
+        soilHealth[ch].fault = fault;
+
+        char logBuffer[64];
+        if (fault)
+            snprintf(logBuffer, sizeof(logBuffer), "Soil %d fault: %s (raw %u), excluded from control",
+                     ch + 1, soilFaultName(fault), data.soilRaw[ch]);
+        else
+            snprintf(logBuffer, sizeof(logBuffer), "Soil %d healthy again", ch + 1);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
+    }
+}
+
+const char *soilFaultName(uint8_t fault)
+{
+    if (fault & SOIL_FAULT_RAIL)
+        return "rail";
+    if (fault & SOIL_FAULT_STUCK)
+        return "stuck";
+    if (fault & SOIL_FAULT_OUTLIER)
+        return "outlier";
+    if (fault & SOIL_FAULT_RATE)
+        return "rate";
+    return "ok";
+}
+
+// ========== SENSOR TASK ==========
+void publishSensorData()
+{
+    uint32_t seq = sensorSnapshot.seq.load(std::memory_order_relaxed);
+    sensorSnapshot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    sensorSnapshot.value = data;
+    sensorSnapshot.seq.store(seq + 2, std::memory_order_release);
+}
+
+uint32_t readSensorSnapshot(SensorData &out)
+{
+    uint32_t before, after;
+    do
+    {
+        before = sensorSnapshot.seq.load(std::memory_order_acquire);
+        out = sensorSnapshot.value;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sensorSnapshot.seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return before / 2;
+}
+
+uint32_t sensorSnapshotGeneration()
+{
+    return sensorSnapshot.seq.load(std::memory_order_acquire) / 2;
+}
+
+void sensorTask(void *)
+{
+    esp_task_wdt_add(NULL);
+
+    // First cycle starts immediately instead of one measurementInterval after boot
+    data.lastMeasurement = millis() - config.measurementInterval;
+    bool soilPending = false;
+
+    for (;;)
+    {
+        unsigned long now = millis();
+        if (now - data.lastMeasurement >= (unsigned long)config.measurementInterval)
         {
-            snprintf(logBuf, sizeof(logBuf), "Update pump duration ('%lus')",
-                     (unsigned long)(config.pumpDuration / 1000));
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            data.lastMeasurement = now;
+
+            dht.request(); // ignored within DHT22_MIN_INTERVAL or while backing off: the cached value is used
+            readLuxMeter();
+            soilPending = true;
         }
-        if (logMeasurementInterval)
+        serviceI2cBus();
+        serviceDHT22();
+
+        // The soil filters run all the time; a measurement takes their
+        // current output, so only the first one after boot has to wait.
+        // A DHT22 transfer in flight finishes within DHT22_RESPONSE_TIMEOUT.
+        serviceSoilSampler();
+        if (soilPending && !dht.busy() && readSoilMoisture())
         {
-            snprintf(logBuf, sizeof(logBuf), "Update measurement interval ('%lus')",
-                     (unsigned long)(config.measurementInterval / 1000));
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            soilPending = false;
+            readDHT22();
+            publishSensorData();
         }
-        if (logDataLogInterval)
+
+        esp_task_wdt_reset();
+        vTaskDelay(pdMS_TO_TICKS(SOIL_SAMPLE_PERIOD_MS));
+    }
+}
+
+void startSensorTask()
+{
+    if (xTaskCreatePinnedToCore(sensorTask, "sensorTask", SENSOR_TASK_STACK, NULL,
+                                SENSOR_TASK_PRIORITY, NULL, SENSOR_TASK_CORE) != pdPASS)
+    {
+        serialPrintln("Failed to start sensor task");
+        return;
+    }
+    serialPrintln("Sensor task started on core 0");
+}
+
+void initLuxMeter()
+{
+    i2cBegin();
+    status.bh1750OK = lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE);
+    i2cEnd(I2C_TX_PROBE, status.bh1750OK);
+
+    if (status.bh1750OK)
+        serialPrintln("BH1750 initialized");
+    else
+        serialPrintln("Error initializing BH1750");
+}
+
+void readLuxMeter()
+{
+    if (!status.bh1750OK)
+    {
+        serialPrintln("BH1750 not available");
+        return;
+    }
+
+    i2cBegin();
+    float lux = lightMeter.readLightLevel();
+    i2cEnd(I2C_TX_LUX_READ, lux >= 0);
+    if (lux < 0)
+    {
+        serialPrintln("BH1750 read failed (I2C error), keeping the last value");
+        return;
+    }
+    data.lux = lux;
+    char logBuffer[64];
+    snprintf(logBuffer, sizeof(logBuffer), "Light: %.2f lux", data.lux);
+    logToFile(logBuffer);
+}
+
+// ========== IRRIGATION CONTROL ==========
+void resetDailyIrrigation(DateTime &currentTime)
+{
+    static int lastDay = -1;
+
+    if (currentTime.day() != lastDay)
+    {
+        lastDay = currentTime.day();
+        pumpControl.pumpRunsToday = 0;
+        for (int z = 0; z < ZONE_COUNT_MAX; z++)
+            zoneControl[z].runsToday = 0;
+
+        char schedule[96];
+        char logBuffer[128];
+        formatScheduleList(schedule, sizeof(schedule));
+        snprintf(logBuffer, sizeof(logBuffer), "Schedule reset (%s)", schedule);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
+    }
+}
+
+// Returns the average (0-100) of the healthy soil channels in `sensors`, or -1 if none has valid data
+int getZoneSoilMoisture(const SensorData &snapshot, uint16_t sensors)
+{
+    int sum = 0, count = 0;
+    for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+    {
+        if (!(sensors & (1 << i)) || snapshot.soilFault[i])
+            continue;
+        if (snapshot.soilMoisture[i] >= 0 && snapshot.soilMoisture[i] <= 100)
         {
-            snprintf(logBuf, sizeof(logBuf), "Update data log interval ('%lus')",
-                     (unsigned long)(config.dataLogInterval / 1000));
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+            sum += snapshot.soilMoisture[i];
+            count++;
         }
-        if (logCalibration)
-        {
-            snprintf(logBuf, sizeof(logBuf), "Update calibration ('dry %d, wet %d')",
-                     config.dry, config.wet);
-            serialPrintln(logBuf);
-            logToFile(logBuf);
+    }
+    if (count == 0)
+        return -1;
+    return sum / count;
+}
+
+// Returns average soil moisture (0-100) or -1 if no valid sensor data
+int getAverageSoilMoisture(const SensorData &snapshot)
+{
+    return getZoneSoilMoisture(snapshot, ZONE_ALL_SENSORS);
+}
+
+int getAverageSoilMoisture()
+{
+    SensorData snapshot;
+    if (readSensorSnapshot(snapshot) == 0)
+        return -1; // sensorTask has not published anything yet
+    return getAverageSoilMoisture(snapshot);
+}
+
+int zoneThreshold(int zone)
+{
+    return config.zones[zone].threshold > 0 ? config.zones[zone].threshold : config.threshold;
+}
+
+unsigned long zoneDuration(int zone)
+{
+    return config.zones[zone].duration > 0 ? config.zones[zone].duration : (unsigned long)config.pumpDuration;
+}
+
+unsigned long zoneCooldown(int zone)
+{
+    return config.zones[zone].cooldown > 0 ? config.zones[zone].cooldown : COOLDOWN_TIME;
+}
+
+uint8_t zoneDebounce(int zone)
+{
+    return config.zones[zone].debounce > 0 ? config.zones[zone].debounce : MOISTURE_DEBOUNCE_COUNT;
+}
+
+void initZoneValves()
+{
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        if (!config.zones[z].enabled)
+            continue;
+        pinMode(config.zones[z].valvePin, OUTPUT);
+        digitalWrite(config.zones[z].valvePin, SOLENOID_CLOSED);
+    }
+}
+
+// Pump time to lift the zone from its last reading to the middle of its band
+unsigned long adaptiveRunMs(int zone)
+{
+    const ZoneControl &zc = zoneControl[zone];
+    unsigned long fixed = zoneDuration(zone);
+    if (zc.gain <= 0 || zc.soil < 0)
+        return fixed; // first run: fixed duration, learn from it
+
+    float target = zoneThreshold(zone) + config.moistureBand / 2.0f;
+    float ms = (target - zc.soil) / zc.gain * 1000.0f;
+    return constrain((unsigned long)max(ms, 0.0f), ADAPTIVE_MIN_RUN_MS, fixed * ADAPTIVE_MAX_RUN_FACTOR);
+}
+
+// Called once the first sensor snapshot after ADAPTIVE_SETTLE_MS is in
+void learnZoneGain(int zone)
+{
+    ZoneControl &zc = zoneControl[zone];
+    zc.learning = false;
+
+    int rise = zc.soil - zc.runStartSoil;
+    if (zc.soil < 0 || rise <= 0)
+        return; // no measurable response (dry spell or sensor trouble): keep the old gain
+
+    float sample = rise / (zc.pumpedMs / 1000.0f);
+    zc.gain = zc.gain > 0 ? zc.gain + ADAPTIVE_GAIN_ALPHA * (sample - zc.gain) : sample;
+
+    char logBuffer[80];
+    snprintf(logBuffer, sizeof(logBuffer), "Zone %d gain %.3f%%/s (+%d%% in %lus)",
+             zone + 1, zc.gain, rise, zc.pumpedMs / 1000);
+    serialPrintln(logBuffer);
+    logToFile(logBuffer);
+    saveLearnedGains();
+}
+
+void loadLearnedGains()
+{
+    File file = LittleFS.open(LEARN_FILE, "r");
+    if (!file)
+        return;
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+        return;
+
+    int z = 0;
+    for (JsonVariant gain : doc["gain"].as<JsonArray>())
+    {
+        if (z >= ZONE_COUNT_MAX)
+            break;
+        zoneControl[z++].gain = max(0.0f, gain.as<float>());
+    }
+}
+
+// A few bytes once per learned cycle; kept out of config.json so settings are never rewritten by the controller
+void saveLearnedGains()
+{
+    JsonDocument doc;
+    JsonArray gains = doc["gain"].to<JsonArray>();
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+        gains.add(zoneControl[z].gain);
+
+    File file = LittleFS.open(LEARN_TEMP_FILE, "w");
+    if (!file || !commitTempFile(file, LEARN_TEMP_FILE, LEARN_FILE, serializeJson(doc, file) == measureJson(doc)))
+        serialPrintln("Failed to save learned gain");
+}
+
+void startZone(int zone, ControlSource source)
+{
+    ZoneControl &zc = zoneControl[zone];
+    zc.state = ZONE_WATERING;
+    zc.queued = false;
+    zc.moistureStableCount = 0;
+    zc.runsToday++;
+    if (source == SOIL_AUTOMATION && config.wateringMode == MODE_ADAPTIVE)
+        zc.runMs = adaptiveRunMs(zone);
+    else if (source == SCHEDULE_AUTOMATION && zc.queuedRunMs > 0)
+        zc.runMs = zc.queuedRunMs;
+    else
+        zc.runMs = zoneDuration(zone);
+    zc.queuedRunMs = 0;
+    zc.runStartSoil = zc.soil;
+    zc.learning = false;
+
+    pumpControl.activeZone = zone;
+    pumpControl.state = PUMP_RUNNING;
+    pumpControl.controlSource = source;
+    pumpControl.startTime = millis();
+    pumpControl.pumpRunsToday++;
+
+    digitalWrite(config.zones[zone].valvePin, SOLENOID_OPEN);
+    delay(500);
+
+    digitalWrite(PUMP_PIN, PUMP_ON);
+
+    char logBuffer[80];
+    if (source == MANUAL_OVERRIDE)
+        snprintf(logBuffer, sizeof(logBuffer), "Pump ON (manual, zone %d)", zone + 1);
+    else if (source == SOIL_AUTOMATION && config.wateringMode == MODE_ADAPTIVE)
+        snprintf(logBuffer, sizeof(logBuffer), "Pump START zone %d (Adaptive, avg %d%%, %lus)",
+                 zone + 1, zc.soil, zc.runMs / 1000);
+    else if (source == SOIL_AUTOMATION)
+        snprintf(logBuffer, sizeof(logBuffer), "Pump START zone %d (Moisture Auto, avg %d%% < threshold %d%%)",
+                 zone + 1, zc.soil, zoneThreshold(zone));
+    else
+        snprintf(logBuffer, sizeof(logBuffer), "Pump START zone %d (Schedule)", zone + 1);
+    serialPrintln(logBuffer);
+    logToFile(logBuffer, true);
+}
+
+// Pump off first, then the valve, so the line never holds pressure against a closed valve
+void stopZone(bool cooldown)
+{
+    int zone = pumpControl.activeZone;
+    if (zone < 0)
+        return;
+
+    digitalWrite(PUMP_PIN, PUMP_OFF);
+    unsigned long elapsed = millis() - pumpControl.startTime;
+    delay(500);
+    digitalWrite(config.zones[zone].valvePin, SOLENOID_CLOSED);
+
+    ZoneControl &zc = zoneControl[zone];
+    zc.state = cooldown ? ZONE_COOLDOWN : ZONE_IDLE;
+    zc.cooldownStart = millis();
+
+    // The pump came on 500 ms after the valve; measure the rise once the water has spread.
+    // Only runs the adaptive controller sized itself feed the gain.
+    zc.pumpedMs = elapsed > 500 ? elapsed - 500 : 0;
+    zc.learning = config.wateringMode == MODE_ADAPTIVE && pumpControl.controlSource == SOIL_AUTOMATION &&
+                  zc.runStartSoil >= 0 && zc.pumpedMs >= ADAPTIVE_MIN_RUN_MS;
+    zc.settled = false;
+    zc.stoppedAt = millis();
+    pumpControl.activeZone = -1;
+    pumpControl.state = PUMP_IDLE;
+}
+
+void queueZone(int zone, ControlSource source, unsigned long runMs)
+{
+    ZoneControl &zc = zoneControl[zone];
+    if (zc.queued || zc.state == ZONE_WATERING)
+        return;
+    zc.queued = true;
+    zc.queuedBy = source;
+    zc.queuedRunMs = runMs;
+}
+
+// First time after `after` that the slot fires, 0 if it never does. The RTC
+// keeps local time, so unixtime % 86400 is the local time of day.
+uint32_t nextSlotTime(const ScheduleSlot &slot, uint32_t after)
+{
+    if (!slot.enabled || !(slot.days & SCHEDULE_ALL_DAYS))
+        return 0;
+
+    uint32_t dayStart = after - after % 86400UL;
+    uint32_t offset = slot.hour * 3600UL + slot.minute * 60UL + slot.second;
+    for (int day = 0; day <= 7; day++)
+    {
+        uint32_t t = dayStart + day * 86400UL + offset;
+        if (t > after && (slot.days & (1 << DateTime(t).dayOfTheWeek())))
+            return t;
+    }
+    return 0;
+}
+
+void pushScheduleEvent(uint8_t slot, uint32_t fireAt)
+{
+    if (fireAt == 0 || scheduleQueue.count >= SCHEDULE_SLOT_MAX)
+        return;
+
+    // At most SCHEDULE_SLOT_MAX entries: insertion keeps the soonest at events[0]
+    int i = scheduleQueue.count++;
+    while (i > 0 && scheduleQueue.events[i - 1].fireAt > fireAt)
+    {
+        scheduleQueue.events[i] = scheduleQueue.events[i - 1];
+        i--;
+    }
+    scheduleQueue.events[i].fireAt = fireAt;
+    scheduleQueue.events[i].slot = slot;
+}
+
+// Right after boot each slot resumes from where it was consumed before the
+// power went, so a slot that fell due meanwhile is fired late or logged as
+// missed by serviceSchedule(), and one that already fired does not fire
+// again. The very first boot, and later rebuilds (new slots, clock set),
+// start from now: nothing before it is owed.
+void rebuildScheduleQueue(uint32_t now)
+{
+    bool changed = false;
+    scheduleQueue.count = 0;
+    for (int slot = 0; slot < SCHEDULE_SLOT_MAX; slot++)
+    {
+        uint32_t &lastFire = scheduleQueue.lastFire[slot];
+        uint32_t after = now - 1; // a slot due this second still fires
+        if (!scheduleQueue.resumed && lastFire != 0 && lastFire < after)
+            after = lastFire;
+        if (lastFire != after)
+        {
+            lastFire = after;
+            changed = true;
+        }
+        pushScheduleEvent(slot, nextSlotTime(config.schedule[slot], after));
+    }
+    scheduleQueue.resumed = true;
+    scheduleQueue.valid = true;
+    if (changed)
+        saveScheduleState();
+}
+
+void loadScheduleState()
+{
+    File file = LittleFS.open(SCHEDULE_STATE_FILE, "r");
+    if (!file)
+        return;
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+        return;
+
+    int slot = 0;
+    for (JsonVariant lastFire : doc["lastFire"].as<JsonArray>())
+    {
+        if (slot >= SCHEDULE_SLOT_MAX)
+            break;
+        scheduleQueue.lastFire[slot++] = lastFire.as<uint32_t>();
+    }
+}
+
+// A few bytes per consumed slot, a couple of times a day
+void saveScheduleState()
+{
+    JsonDocument doc;
+    JsonArray lastFire = doc["lastFire"].to<JsonArray>();
+    for (int slot = 0; slot < SCHEDULE_SLOT_MAX; slot++)
+        lastFire.add(scheduleQueue.lastFire[slot]);
+
+    File file = LittleFS.open(SCHEDULE_STATE_TEMP_FILE, "w");
+    if (!file ||
+        !commitTempFile(file, SCHEDULE_STATE_TEMP_FILE, SCHEDULE_STATE_FILE, serializeJson(doc, file) == measureJson(doc)))
+        serialPrintln("Failed to save schedule state");
+}
+
+// Every zone in the slot (or every enabled zone) is queued; each waits for the pump and its own cooldown
+void fireScheduleSlot(int slot, uint32_t late)
+{
+    const ScheduleSlot &s = config.schedule[slot];
+
+    int queued = 0;
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        if (!config.zones[z].enabled || (s.zones && !(s.zones & (1 << z))))
+            continue;
+        queueZone(z, SCHEDULE_AUTOMATION, s.duration);
+        queued++;
+    }
+
+    char logBuffer[80];
+    if (late > 0)
+        snprintf(logBuffer, sizeof(logBuffer), "Pump started by schedule %d (%d zone, %lus late)",
+                 slot + 1, queued, (unsigned long)late);
+    else
+        snprintf(logBuffer, sizeof(logBuffer), "Pump started by schedule %d (%d zone)", slot + 1, queued);
+    serialPrintln(logBuffer);
+    logToFile(logBuffer, true);
+}
+
+// Fires every event that is due. A slot more than SCHEDULE_GRACE_S late is
+// skipped instead of watering at an unexpected hour; either way it is
+// re-queued at its next occurrence after now.
+void serviceSchedule(uint32_t now, bool allow)
+{
+    // RTC moved backwards (or never ran): events could be days away
+    if (!scheduleQueue.valid ||
+        (scheduleQueue.count > 0 && scheduleQueue.events[0].fireAt > now + 8 * 86400UL))
+        rebuildScheduleQueue(now);
+
+    bool consumed = false;
+    while (scheduleQueue.count > 0 && scheduleQueue.events[0].fireAt <= now)
+    {
+        ScheduleEvent event = scheduleQueue.events[0];
+        scheduleQueue.count--;
+        memmove(&scheduleQueue.events[0], &scheduleQueue.events[1], scheduleQueue.count * sizeof(ScheduleEvent));
+        scheduleQueue.lastFire[event.slot] = event.fireAt;
+        consumed = true;
+
+        uint32_t late = now - event.fireAt;
+        if (allow && late <= SCHEDULE_GRACE_S)
+            fireScheduleSlot(event.slot, late);
+        else if (allow)
+        {
+            char logBuffer[64];
+            snprintf(logBuffer, sizeof(logBuffer), "Schedule %d missed (%lus late)", event.slot + 1, (unsigned long)late);
+            serialPrintln(logBuffer);
+            logToFile(logBuffer);
+        }
+        pushScheduleEvent(event.slot, nextSlotTime(config.schedule[event.slot], now));
+    }
+    if (consumed)
+        saveScheduleState();
+}
+
+void formatScheduleList(char *out, size_t size)
+{
+    size_t len = 0;
+    out[0] = '\0';
+    for (int slot = 0; slot < SCHEDULE_SLOT_MAX; slot++)
+    {
+        const ScheduleSlot &s = config.schedule[slot];
+        if (!s.enabled)
+            continue;
+        int n = snprintf(out + len, size - len, "%s%02d:%02d:%02d", len ? " & " : "", s.hour, s.minute, s.second);
+        if (n < 0 || (size_t)n >= size - len)
+            break;
+        len += n;
+    }
+    if (len == 0)
+        snprintf(out, size, "-");
+}
+
+void controlPump(DateTime &currentTime)
+{
+    SensorData snapshot;
+    uint32_t generation = readSensorSnapshot(snapshot);
+    bool haveSensors = generation != 0;
+
+    if (pumpControl.state == PUMP_ERROR)
+    {
+        digitalWrite(PUMP_PIN, PUMP_OFF);
+        return;
+    }
+
+    // ==========================
+    // ZONE STATE MACHINE: WATERING -> run length expires -> COOLDOWN -> IDLE
+    // The pump feeds one zone at a time; each zone has its own duration and cooldown.
+    // MODE_ADAPTIVE also stops as soon as the zone reaches the top of its band.
+    // ==========================
+    int activeZone = pumpControl.activeZone;
+    bool bandReached = activeZone >= 0 && config.wateringMode == MODE_ADAPTIVE && haveSensors &&
+                       getZoneSoilMoisture(snapshot, config.zones[activeZone].sensors) >= zoneThreshold(activeZone) + config.moistureBand;
+    if (activeZone >= 0 &&
+        (millis() - pumpControl.startTime >= zoneControl[activeZone].runMs || bandReached))
+    {
+        int zone = pumpControl.activeZone;
+        stopZone(true);
+
+        char logBuffer[32];
+        snprintf(logBuffer, sizeof(logBuffer), "Pump STOP zone %d", zone + 1);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer, true);
+    }
+
+    bool cooling = false;
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        ZoneControl &zc = zoneControl[z];
+        zc.soil = haveSensors ? getZoneSoilMoisture(snapshot, config.zones[z].sensors) : -1;
+
+        if (zc.state == ZONE_COOLDOWN && millis() - zc.cooldownStart >= zoneCooldown(z))
+        {
+            zc.state = ZONE_IDLE;
+            char logBuffer[32];
+            snprintf(logBuffer, sizeof(logBuffer), "Zone %d READY", z + 1);
+            serialPrintln(logBuffer);
+        }
+        if (config.zones[z].enabled && zc.state == ZONE_COOLDOWN)
+            cooling = true;
+
+        if (zc.learning && !zc.settled && millis() - zc.stoppedAt >= ADAPTIVE_SETTLE_MS)
+        {
+            zc.settled = true;
+            zc.settleGeneration = generation;
+        }
+        else if (zc.learning && zc.settled && haveSensors && generation != zc.settleGeneration)
+            learnZoneGain(z);
+    }
+    if (pumpControl.activeZone < 0)
+        pumpControl.state = cooling ? PUMP_COOLDOWN : PUMP_IDLE;
+
+    bool allowMoisture =
+        (config.wateringMode == MODE_MOISTURE || config.wateringMode == MODE_BOTH ||
+         config.wateringMode == MODE_ADAPTIVE);
+    bool allowSchedule =
+        (config.wateringMode == MODE_SCHEDULE || config.wateringMode == MODE_BOTH);
+
+    // ==========================
+    // Scheduled irrigation: event queue, soonest slot first. Due events are
+    // consumed even when they may not fire, so none of them fires late after
+    // a manual override or a mode change.
+    // ==========================
+    serviceSchedule(currentTime.unixtime(), allowSchedule && !pumpControl.manualOverride);
+
+    // ==========================
+    // PRIORITY 1: Manual override — skip all automation
+    // ==========================
+    if (pumpControl.manualOverride)
+        return;
+
+    // ==========================
+    // PRIORITY 2: Moisture-based, per zone (zone average < zone threshold)
+    // Debounced per zone; a zone in cooldown or already queued is not counted.
+    // ==========================
+
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        ZoneControl &zc = zoneControl[z];
+        if (!config.zones[z].enabled || zc.state != ZONE_IDLE || zc.queued)
+            continue;
+
+        if (allowMoisture && zc.soil >= 0 && zc.soil < zoneThreshold(z))
+        {
+            if (++zc.moistureStableCount >= zoneDebounce(z))
+                queueZone(z, SOIL_AUTOMATION, 0);
+        }
+        else
+            zc.moistureStableCount = 0;
+    }
+
+    // ==========================
+    // Sequencer: when the pump is free, the driest queued zone that is not cooling down goes next
+    // ==========================
+    if (pumpControl.activeZone >= 0)
+        return;
+
+    int next = -1;
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        ZoneControl &zc = zoneControl[z];
+        if (!config.zones[z].enabled || !zc.queued || zc.state != ZONE_IDLE)
+            continue;
+        if (zc.queuedBy == SOIL_AUTOMATION && zc.soil >= zoneThreshold(z))
+        {
+            zc.queued = false; // watered enough by its neighbours' runoff or rain while waiting
+            continue;
+        }
+        int soil = zc.soil >= 0 ? zc.soil : 101; // no data: after zones with readings
+        if (next < 0 || soil < (zoneControl[next].soil >= 0 ? zoneControl[next].soil : 101))
+            next = z;
+    }
+    if (next >= 0)
+        startZone(next, zoneControl[next].queuedBy);
+}
+
+// ========== WEB SERVER HANDLERS ==========
+bool clientAcceptsGzip()
+{
+    return server.hasHeader("Accept-Encoding") && server.header("Accept-Encoding").indexOf("gzip") >= 0;
+}
+
+File openStaticFile(const String &path, bool &gzip)
+{
+    gzip = clientAcceptsGzip() && LittleFS.exists(path + ".gz");
+    return LittleFS.open(gzip ? path + ".gz" : path, "r");
+}
+
+// The page itself cannot be renamed per build, so it is revalidated on every
+// load; the CSS/JS it links are fingerprinted and cached for good
+void handleRoot()
+{
+    bool gzip;
+    File file = openStaticFile("/index.html", gzip);
+    if (!file)
+    {
+        server.send(404, "text/plain", "File not found");
+        return;
+    }
+
+    PageEtag &page = pageEtags[gzip];
+    if (page.size != file.size())
+    {
+        uint8_t buffer[256];
+        uint32_t crc = 0;
+        size_t got;
+        while ((got = file.read(buffer, sizeof(buffer))) > 0)
+            crc = crc32(buffer, got, crc);
+        file.seek(0);
+        snprintf(page.etag, sizeof(page.etag), "\"%08lx%s\"", (unsigned long)crc, gzip ? "-gz" : "");
+        page.size = file.size();
+    }
+
+    server.sendHeader("ETag", page.etag);
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendHeader("Vary", "Accept-Encoding");
+    if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == page.etag)
+    {
+        file.close();
+        server.send(304);
+        return;
+    }
+    // streamFile() adds Content-Encoding: gzip for *.gz files and closes the file when sent
+    server.streamFile(file, "text/html");
+}
+
+void handleNotFound()
+{
+    String path = server.uri();
+    if (server.method() != HTTP_GET || !path.startsWith(ASSET_PREFIX) || path.indexOf("..") >= 0)
+    {
+        server.send(404, "text/plain", "Not found");
+        return;
+    }
+
+    const char *type = path.endsWith(".css") ? "text/css" :
+                       path.endsWith(".js") ? "application/javascript" : "application/octet-stream";
+
+    // The name changes with the content, so the name is the validator
+    String etag = "\"" + path.substring(path.lastIndexOf('/') + 1) + "\"";
+    server.sendHeader("Cache-Control", ASSET_CACHE_CONTROL);
+    server.sendHeader("Vary", "Accept-Encoding");
+    if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == etag)
+    {
+        server.sendHeader("ETag", etag);
+        server.send(304);
+        return;
+    }
+
+    bool gzip;
+    File file = openStaticFile(path, gzip);
+    if (!file)
+    {
+        server.send(404, "text/plain", "Not found");
+        return;
+    }
+    server.sendHeader("ETag", etag);
+    server.streamFile(file, type);
+}
+
+void fillStatusKey(StatusKey &key)
+{
+    memset(&key, 0, sizeof(key)); // padding ikut dibandingkan oleh memcmp
+    key.sensorGeneration = sensorSnapshotGeneration();
+    key.pumpState = pumpControl.state;
+    key.controlSource = pumpControl.controlSource;
+    key.manualOverride = pumpControl.manualOverride;
+    key.threshold = config.threshold;
+    key.wateringMode = config.wateringMode;
+    key.nextSchedule = scheduleQueue.count ? scheduleQueue.events[0].fireAt : 0;
+    key.activeZone = pumpControl.activeZone;
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        key.zoneState[z] = zoneControl[z].state;
+        key.zoneQueued[z] = zoneControl[z].queued;
+        key.zoneRuns[z] = zoneControl[z].runsToday;
+        key.zoneThreshold[z] = config.zones[z].enabled ? zoneThreshold(z) : 0;
+        key.zoneSensors[z] = config.zones[z].sensors;
+        key.zoneGain[z] = zoneControl[z].gain;
+    }
+    key.i2cLastHour = i2cBus.lastHour;
+    key.i2cErrors = i2cBus.errors;
+    portENTER_CRITICAL(&clockMux);
+    key.rtcDrift = i2cBus.lastDrift;
+    key.rtcDriftSteps = i2cBus.driftSteps;
+    portEXIT_CRITICAL(&clockMux);
+}
+
+void refreshStatusCache()
+{
+    StatusKey key;
+    fillStatusKey(key);
+    if (statusCache.valid && memcmp(&key, &statusCache.key, sizeof(key)) == 0)
+        return;
+
+    SensorData snapshot;
+    readSensorSnapshot(snapshot);
+
+    JsonDocument doc;
+    doc["temperature"] = snapshot.temperature;
+    doc["humidity"] = snapshot.humidity;
+    doc["lux"] = snapshot.lux;
+    for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+    {
+        char jsonKey[16];
+        snprintf(jsonKey, sizeof(jsonKey), "soilMoisture%d", i + 1);
+        doc[jsonKey] = snapshot.soilMoisture[i];
+    }
+    JsonArray soilFaults = doc["soilFaults"].to<JsonArray>(); // SOIL_FAULT_* per channel, 0 = sehat
+    for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+        soilFaults.add(snapshot.soilFault[i]);
+    JsonObject dhtStatus = doc["dht"].to<JsonObject>();
+    dhtStatus["age"] = snapshot.dhtAge; // detik saat pengukuran, -1 = belum pernah terbaca
+    dhtStatus["failures"] = snapshot.dhtFailures;
+    dhtStatus["errors"] = snapshot.dhtErrors;
+    doc["pumpState"] = pumpControl.state;
+    doc["controlSource"] = (int)pumpControl.controlSource;
+    doc["manualOverride"] = pumpControl.manualOverride;
+    doc["threshold"] = config.threshold;
+    doc["wateringMode"] = config.wateringMode;
+    if (key.nextSchedule)
+    {
+        DateTime next(key.nextSchedule);
+        char nextStr[32];
+        snprintf(nextStr, sizeof(nextStr), "%04d-%02d-%02d %02d:%02d:%02d",
+                 next.year(), next.month(), next.day(),
+                 next.hour(), next.minute(), next.second());
+        doc["nextSchedule"] = nextStr;
+        doc["nextScheduleSlot"] = scheduleQueue.events[0].slot + 1;
+    }
+    doc["activeZone"] = pumpControl.activeZone + 1; // 0 = pompa mati
+    JsonArray zones = doc["zones"].to<JsonArray>();
+    for (int z = 0; z < ZONE_COUNT_MAX; z++)
+    {
+        if (!config.zones[z].enabled)
+            continue;
+        JsonObject zone = zones.add<JsonObject>();
+        zone["zone"] = z + 1;
+        zone["soil"] = getZoneSoilMoisture(snapshot, config.zones[z].sensors);
+        zone["threshold"] = zoneThreshold(z);
+        zone["state"] = (int)zoneControl[z].state;
+        zone["queued"] = zoneControl[z].queued;
+        zone["runsToday"] = zoneControl[z].runsToday;
+        zone["gain"] = zoneControl[z].gain; // %/detik pompa, 0 = belum dipelajari
+    }
+    JsonObject i2c = doc["i2c"].to<JsonObject>();
+    i2c["perHour"] = key.i2cLastHour; // transaksi pada jam uptime terakhir yang sudah lengkap
+    i2c["errors"] = key.i2cErrors;
+    i2c["rtcDrift"] = key.rtcDrift;   // detik, DS3231 dikurangi cache pada sync terakhir
+    i2c["rtcSteps"] = key.rtcDriftSteps;
+
+    // Time the body was rendered, i.e. of the last sensor or pump change
+    if (status.rtcInitialized)
+    {
+        DateTime now = clockNow();
+        char timeStr[32];
+        snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+                 now.year(), now.month(), now.day(),
+                 now.hour(), now.minute(), now.second());
+        doc["timestamp"] = timeStr;
+    }
+
+    if (measureJson(doc) >= sizeof(statusCache.body))
+    {
+        serialPrintln("Status cache too small");
+        invalidateStatusCache();
+        return;
+    }
+
+    if (statusCache.bootId == 0)
+        statusCache.bootId = esp_random() | 1;
+
+    statusCache.length = serializeJson(doc, statusCache.body, sizeof(statusCache.body));
+    statusCache.generation++;
+    snprintf(statusCache.etag, sizeof(statusCache.etag), "\"%08lx-%lu\"",
+             (unsigned long)statusCache.bootId, (unsigned long)statusCache.generation);
+    statusCache.key = key;
+    statusCache.valid = true;
+}
+
+void invalidateStatusCache()
+{
+    statusCache.valid = false;
+}
+
+void handleStatus()
+{
+    refreshStatusCache();
+    if (!statusCache.valid)
+    {
+        server.send(500, "application/json", "{\"error\":\"Status unavailable\"}");
+        return;
+    }
+
+    // no-cache: browsers may keep the body but must revalidate with If-None-Match
+    server.sendHeader("ETag", statusCache.etag);
+    server.sendHeader("Cache-Control", "no-cache");
+    if (server.hasHeader("If-None-Match") &&
+        server.header("If-None-Match") == statusCache.etag)
+    {
+        server.send(304);
+        return;
+    }
+    server.send_P(200, "application/json", statusCache.body, statusCache.length);
+}
+
+void handleConfig()
+{
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+
+    ChunkedResponse out;
+    out.print('{');
+    writeConfigJson(out, config);
+    out.print(",\"valvePinChoices\":[");
+    for (size_t i = 0; i < sizeof(zoneValvePinChoices); i++)
+    {
+        if (i)
+            out.print(',');
+        out.print((int)zoneValvePinChoices[i]);
+    }
+    out.print("]}");
+    out.flush();
+    server.sendContent("");
+}
+
+void handleSettings()
+{
+    // Simpan nilai lama untuk bandingkan — hanya log yang benar-benar berubah
+    ScheduleSlot oldSchedule[SCHEDULE_SLOT_MAX];
+    memcpy(oldSchedule, config.schedule, sizeof(oldSchedule));
+    ZoneConfig oldZones[ZONE_COUNT_MAX];
+    memcpy(oldZones, config.zones, sizeof(oldZones));
+    SoilFilterConfig oldFilters[SOIL_CHANNEL_COUNT];
+    memcpy(oldFilters, config.soilFilter, sizeof(oldFilters));
+
+    // Every argument named in the field tables: threshold, pumpDuration (ms),
+    // measurementInterval and dataLogInterval (seconds), zone1Sensors ("1-5,7"),
+    // zone1Duration (seconds), slot1Days (bitmask, bit 0 = Sunday), slot1Zones ("1,3"), ...
+    uint16_t changed = applyConfigArgs();
+    if (changed & CFG_CALIBRATION)
+        buildSoilLut();
+
+    // slotNTime is "HH:MM" or "HH:MM:SS"
+    for (int slot = 0; slot < SCHEDULE_SLOT_MAX; slot++)
+    {
+        ScheduleSlot &sc = config.schedule[slot];
+        char arg[20];
+        snprintf(arg, sizeof(arg), "slot%dTime", slot + 1);
+        if (!server.hasArg(arg))
+            continue;
+        int hour, minute, second = 0;
+        int n = sscanf(server.arg(arg).c_str(), "%d:%d:%d", &hour, &minute, &second);
+        if (n >= 2 && hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59 && second >= 0 && second <= 59)
+        {
+            sc.hour = hour;
+            sc.minute = minute;
+            sc.second = second;
+        }
+    }
+
+    bool logSchedule = false;
+    bool logModeWatering = changed & CFG_MODE;
+    bool logThreshold = changed & CFG_THRESHOLD;
+    bool logPumpDuration = changed & CFG_PUMP_DURATION;
+    bool logMeasurementInterval = changed & CFG_MEASUREMENT;
+    bool logDataLogInterval = changed & CFG_DATA_LOG;
+    bool logCalibration = changed & CFG_CALIBRATION;
+    bool logStorage = changed & CFG_STORAGE;
+    bool logFilter = changed & CFG_FILTER;
+    bool logZones = false;
+
+    sanitizeZones();
+    if (memcmp(oldZones, config.zones, sizeof(oldZones)) != 0)
+    {
+        logZones = true;
+
+        // Valves may have moved: stop watering, close the old valves, set up the new ones
+        stopZone(false);
+        for (int z = 0; z < ZONE_COUNT_MAX; z++)
+        {
+            if (oldZones[z].enabled)
+                digitalWrite(oldZones[z].valvePin, SOLENOID_CLOSED);
+            if (!config.zones[z].enabled)
+                zoneControl[z].queued = false;
+            // Different valve or sensors: what was learned no longer applies
+            if (oldZones[z].valvePin != config.zones[z].valvePin || oldZones[z].sensors != config.zones[z].sensors)
+            {
+                zoneControl[z].gain = 0;
+                zoneControl[z].learning = false;
+            }
+        }
+        initZoneValves();
+        saveLearnedGains();
+    }
+
+    if (memcmp(oldSchedule, config.schedule, sizeof(oldSchedule)) != 0)
+    {
+        logSchedule = true;
+        scheduleQueue.valid = false; // next controlPump() rebuilds from the new slots
+    }
+
+    if (saveConfig())
+    {
+        server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Settings saved\"}");
+
+        char logBuf[128];
+        if (logSchedule)
+        {
+            char schedule[96];
+            formatScheduleList(schedule, sizeof(schedule));
+            snprintf(logBuf, sizeof(logBuf), "Update schedule ('%s')", schedule);
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logModeWatering)
+        {
+            const char *modeStr = config.wateringMode == MODE_SCHEDULE ? "Schedule" :
+                                 config.wateringMode == MODE_MOISTURE ? "Moisture" :
+                                 config.wateringMode == MODE_ADAPTIVE ? "Adaptive" : "Both";
+            snprintf(logBuf, sizeof(logBuf), "Update mode watering ('%s')", modeStr);
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logThreshold)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update threshold ('%d%%', band %d%%)", config.threshold, config.moistureBand);
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logPumpDuration)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update pump duration ('%lus')",
+                     (unsigned long)(config.pumpDuration / 1000));
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logMeasurementInterval)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update measurement interval ('%lus')",
+                     (unsigned long)(config.measurementInterval / 1000));
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logDataLogInterval)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update data log interval ('%lus')",
+                     (unsigned long)(config.dataLogInterval / 1000));
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logCalibration)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update calibration ('dry %d, wet %d')",
+                     config.dry, config.wet);
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+        }
+        if (logStorage)
+        {
+            snprintf(logBuf, sizeof(logBuf), "Update storage ('%d KB, %d days')",
+                     config.storageBudgetKB, config.retentionDays);
+            serialPrintln(logBuf);
+            logToFile(logBuf);
+            if (i2cBus.synced)
+                enforceStoragePolicy(clockNow());
+        }
+        if (logZones)
+        {
+            for (int z = 0; z < ZONE_COUNT_MAX; z++)
+            {
+                const ZoneConfig &zc = config.zones[z];
+                if (memcmp(&oldZones[z], &zc, sizeof(zc)) == 0)
+                    continue;
+                char sensors[32];
+                formatIndexList(sensors, sizeof(sensors), zc.sensors, SOIL_CHANNEL_COUNT);
+                snprintf(logBuf, sizeof(logBuf), "Update zone %d ('%s, pin %d, sensors %s, %d%%, %lus')",
+                         z + 1, zc.enabled ? "on" : "off", zc.valvePin, sensors,
+                         zoneThreshold(z), zoneDuration(z) / 1000);
+                serialPrintln(logBuf);
+                logToFile(logBuf);
+            }
+        }
+        if (logFilter)
+        {
+            for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+            {
+                const SoilFilterConfig &fc = config.soilFilter[ch];
+                if (memcmp(&oldFilters[ch], &fc, sizeof(fc)) == 0)
+                    continue;
+                snprintf(logBuf, sizeof(logBuf), "Update soil %d filter ('%s %d, ema 1/%d, x%d')",
+                         ch + 1, fc.mode == SOIL_FILTER_MEDIAN ? "median" : "mean", fc.window,
+                         1 << fc.emaShift, fc.oversample);
+                serialPrintln(logBuf);
+                logToFile(logBuf);
+            }
+        }
+        if (!logSchedule && !logModeWatering && !logThreshold && !logPumpDuration &&
+            !logMeasurementInterval && !logDataLogInterval && !logCalibration && !logStorage && !logZones &&
+            !logFilter)
+        {
+            serialPrintln("Settings saved (no changes)");
+        }
+    }
+    else
+    {
+        server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to save\"}");
+        serialPrintln("Settings save failed");
+    }
+}
+
+void handlePumpControl()
+{
+    if (!server.hasArg("state"))
+    {
+        server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Missing state\"}");
+        return;
+    }
+    String state = server.arg("state");
+    state.toLowerCase();
+
+    if (state == "on")
+    {
+        // Optional zone (1-based); default is the first enabled zone
+        int zone = -1;
+        if (server.hasArg("zone"))
+            zone = server.arg("zone").toInt() - 1;
+        else
+        {
+            for (int z = ZONE_COUNT_MAX - 1; z >= 0; z--)
+                if (config.zones[z].enabled) zone = z;
+        }
+        if (zone < 0 || zone >= ZONE_COUNT_MAX || !config.zones[zone].enabled)
+        {
+            server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Invalid zone\"}");
+            return;
+        }
+
+        pumpControl.manualOverride = true;
+        stopZone(false); // one zone at a time: switching zones closes the current valve first
+        startZone(zone, MANUAL_OVERRIDE);
+
+        char response[64];
+        snprintf(response, sizeof(response), "{\"status\":\"success\",\"pump\":\"on\",\"zone\":%d}", zone + 1);
+        server.send(200, "application/json", response);
+    }
+    else if (state == "off")
+    {
+        pumpControl.manualOverride = true;
+        pumpControl.controlSource = MANUAL_OVERRIDE;
+        stopZone(false);
+        digitalWrite(PUMP_PIN, PUMP_OFF);
+        pumpControl.state = PUMP_IDLE;
+        serialPrintln("Pump OFF (manual)");
+        logToFile("Pump OFF (manual)", true);
+        server.send(200, "application/json", "{\"status\":\"success\",\"pump\":\"off\"}");
+    }
+    else if (state == "auto")
+    {
+        // A manual run still in progress finishes its zone duration
+        pumpControl.manualOverride = false;
+        if (pumpControl.activeZone < 0)
+            pumpControl.controlSource = CONTROL_NONE;
+
+        serialPrintln("Pump AUTO mode");
+        logToFile("Pump AUTO mode", true);
+
+        server.send(200, "application/json", "{\"status\":\"success\",\"mode\":\"auto\"}");
+    }
+    else
+    {
+        server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Invalid state\"}");
+    }
+}
+
+// Writes {"channel":N,"raw":R,"percent":P,"points":[[raw,pct],...]} for one probe
+void writeCalibrationJson(Print &out, int ch, const SensorData &snapshot)
+{
+    const SoilCalibration &cal = config.soilCalibration[ch];
+    out.printf("{\"channel\":%d,\"raw\":%u,\"percent\":%d,\"points\":[",
+               ch + 1, snapshot.soilRaw[ch], snapshot.soilMoisture[ch]);
+    for (int i = 0; i < cal.points; i++)
+        out.printf("%s[%u,%u]", i ? "," : "", cal.raw[i], cal.percent[i]);
+    out.print("]}");
+}
+
+// GET  /calibrate                         -> every probe (or channel=...): ADC now, % now, curve
+// POST /calibrate channel=3 point=dry      -> current ADC of SOIL3 becomes its 0% point
+//      point=wet (SOIL_PERCENT_MAX) or percent=25 for a middle point;
+//      channel takes a list ("1-10"), reset=1 drops the curve (back to global dry/wet)
+void handleCalibrate()
+{
+    SensorData snapshot;
+    readSensorSnapshot(snapshot);
+
+    uint16_t channels = ZONE_ALL_SENSORS;
+    if (server.hasArg("channel"))
+        channels = parseIndexList(server.arg("channel"), SOIL_CHANNEL_COUNT);
+
+    if (server.method() == HTTP_POST)
+    {
+        bool reset = server.arg("reset").toInt() != 0;
+        int percent = -1;
+        if (server.arg("point") == "dry")
+            percent = 0;
+        else if (server.arg("point") == "wet")
+            percent = SOIL_PERCENT_MAX;
+        else if (server.hasArg("percent"))
+            percent = server.arg("percent").toInt();
+
+        if (channels == 0 || (!reset && (percent < 0 || percent > SOIL_PERCENT_MAX)))
+        {
+            server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Need channel and point=dry|wet, percent or reset\"}");
+            return;
+        }
+
+        for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+        {
+            if (!(channels & (1 << ch)))
+                continue;
+            SoilCalibration &cal = config.soilCalibration[ch];
+            if (reset)
+            {
+                cal = SoilCalibration();
+                continue;
+            }
+            if (snapshot.soilRaw[ch] == 0)
+            {
+                server.send(503, "application/json", "{\"status\":\"error\",\"error\":\"No soil reading yet\"}");
+                return;
+            }
+
+            // Same percent again replaces that point: re-capturing "dry" moves the dry end
+            int i = 0;
+            while (i < cal.points && cal.percent[i] != percent)
+                i++;
+            if (i == SOIL_CAL_POINTS)
+            {
+                server.send(409, "application/json", "{\"status\":\"error\",\"error\":\"Curve full, reset the channel first\"}");
+                return;
+            }
+            cal.raw[i] = snapshot.soilRaw[ch];
+            cal.percent[i] = percent;
+            if (i == cal.points)
+                cal.points++;
+            sortSoilCalibration(cal);
+        }
+
+        buildSoilLut();
+        saveConfig();
+
+        char sensors[32];
+        char logBuffer[80];
+        formatIndexList(sensors, sizeof(sensors), channels, SOIL_CHANNEL_COUNT);
+        if (reset)
+            snprintf(logBuffer, sizeof(logBuffer), "Calibration reset (soil %s)", sensors);
+        else
+            snprintf(logBuffer, sizeof(logBuffer), "Calibration point %d%% captured (soil %s)", percent, sensors);
+        serialPrintln(logBuffer);
+        logToFile(logBuffer);
+    }
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    ChunkedResponse out;
+    out.printf("{\"percentMax\":%d,\"channels\":[", SOIL_PERCENT_MAX);
+    bool first = true;
+    for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+    {
+        if (!(channels & (1 << ch)))
+            continue;
+        if (!first)
+            out.print(',');
+        first = false;
+        writeCalibrationJson(out, ch, snapshot);
+    }
+    out.print("]}");
+    out.flush();
+    server.sendContent("");
+}
+
+void handleRestart()
+{
+    server.send(200, "text/plain", "Restarting...");
+    logToFile("Restart requested", true);
+    delay(1000);
+    ESP.restart();
+}
+
+// GET /logs?since=<seq> -> {"epoch":E,"next":N,"logs":[entries with seq > since]}
+// `epoch` changes on /logs/clear, so a client can tell "cleared" from "nothing new".
+void handleLogs()
+{
+    unsigned long since = 0;
+    if (server.hasArg("since"))
+        since = strtoul(server.arg("since").c_str(), NULL, 10);
+
+    portENTER_CRITICAL(&logMux);
+    uint32_t epoch = logEpoch;
+    unsigned long next = logSequence;
+    portEXIT_CRITICAL(&logMux);
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+
+    char buffer[1024];
+    size_t len = snprintf(buffer, sizeof(buffer), "{\"epoch\":%lu,\"next\":%lu,\"logs\":[",
+                          (unsigned long)epoch, next);
+
+    LogMessage entry;
+    unsigned long cursor = since;
+    bool first = true;
+    // Stop at `next` so lines logged while sending wait for the next request
+    while (nextLogEntry(cursor, entry) && entry.seq <= next)
+    {
+        cursor = entry.seq;
+        if (len + LOG_ENTRY_JSON_SIZE + 1 > sizeof(buffer))
+        {
+            server.sendContent(buffer, len);
+            len = 0;
+        }
+        if (!first)
+            buffer[len++] = ',';
+        len += formatLogEntry(buffer + len, sizeof(buffer) - len, entry);
+        first = false;
+    }
+
+    if (len + 3 > sizeof(buffer))
+    {
+        server.sendContent(buffer, len);
+        len = 0;
+    }
+    buffer[len++] = ']';
+    buffer[len++] = '}';
+    server.sendContent(buffer, len);
+    server.sendContent("");
+}
+
+void handleLogsClear()
+{
+    portENTER_CRITICAL(&logMux);
+    serialBufferIndex = 0;
+    totalMessages = 0;
+    logEpoch++;
+    portEXIT_CRITICAL(&logMux);
+    serialPrintln("Log buffer cleared");
+    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Log cleared\"}");
+}
+
+// ========== WIFI SETUP ==========
+void setupWiFi()
+{
+    WiFi.mode(WIFI_AP);
+    WiFi.softAP("Smart Nursery", "12345678");
+    IPAddress ip = WiFi.softAPIP();
+
+    char logBuffer[32];
+    snprintf(logBuffer, sizeof(logBuffer), "AP IP: %d.%d.%d.%d",
+             ip[0], ip[1], ip[2], ip[3]);
+    serialPrintln(logBuffer);
+}
+
+// ========== DATA MANAGEMENT FUNCTIONS ==========
+// Sensor history is stored as fixed 24-byte binary records in numbered segment
+// files under DATA_DIR. CSV is only produced on the fly for /data/download.
+uint8_t crc8(const uint8_t *bytes, size_t length)
+{
+    uint8_t crc = 0;
+    while (length--)
+    {
+        crc ^= *bytes++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+uint32_t crc32(const uint8_t *bytes, size_t length, uint32_t previous)
+{
+    uint32_t crc = ~previous;
+    while (length--)
+    {
+        crc ^= *bytes++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+void segmentPath(char *out, size_t size, uint32_t index)
+{
+    snprintf(out, size, DATA_DIR "/%05lu.seg", (unsigned long)index);
+}
+
+bool readSegmentHeader(File &file, SegmentHeader &header)
+{
+    if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header))
+        return false;
+    return header.magic == DATA_SEGMENT_MAGIC &&
+           header.version == DATA_FORMAT_VERSION &&
+           header.recordSize == sizeof(DataRecord) &&
+           header.crc == crc32((const uint8_t *)&header, offsetof(SegmentHeader, crc));
+}
+
+bool readDataRecord(File &file, DataRecord &record)
+{
+    return file.read((uint8_t *)&record, sizeof(record)) == sizeof(record) &&
+           record.crc == crc8((const uint8_t *)&record, offsetof(DataRecord, crc));
+}
+
+void encodeDataRecord(const SensorData &snapshot, uint32_t epoch, int runsToday, DataRecord &record)
+{
+    record.epoch = epoch;
+    record.temperature = (int16_t)constrain(lroundf(snapshot.temperature * 100.0f), INT16_MIN, INT16_MAX);
+    record.humidity = (int16_t)constrain(lroundf(snapshot.humidity * 100.0f), INT16_MIN, INT16_MAX);
+    record.lux = (uint32_t)lroundf(max(snapshot.lux, 0.0f) * 100.0f);
+    for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+        record.soil[i] = (uint8_t)constrain(snapshot.soilMoisture[i], 0, 255);
+    record.runsToday = (uint8_t)constrain(runsToday, 0, 255);
+    record.crc = crc8((const uint8_t *)&record, offsetof(DataRecord, crc));
+}
+
+size_t formatDataRecordCsv(char *out, size_t size, const DataRecord &record)
+{
+    DateTime t(record.epoch);
+    int len = snprintf(out, size, "%04d-%02d-%02d %02d:%02d:%02d,%.2f,%.2f,%.2f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\r\n",
+                       t.year(), t.month(), t.day(),
+                       t.hour(), t.minute(), t.second(),
+                       record.temperature / 100.0f,
+                       record.humidity / 100.0f,
+                       record.lux / 100.0f,
+                       record.soil[0], record.soil[1], record.soil[2], record.soil[3], record.soil[4],
+                       record.soil[5], record.soil[6], record.soil[7], record.soil[8], record.soil[9],
+                       record.runsToday);
+    return (len > 0 && (size_t)len < size) ? len : 0;
+}
+
+bool appendDataRecord(const DataRecord &record)
+{
+    char path[32];
+
+    // Start a new segment when there is none yet or the current one is full
+    if (dataLogMeta.lastSegment == 0 || dataLogMeta.lastSegmentRecords >= DATA_SEGMENT_RECORDS)
+    {
+        uint32_t index = dataLogMeta.lastSegment + 1;
+        segmentPath(path, sizeof(path), index);
+        File file = LittleFS.open(path, "w");
+        if (!file)
+            return false;
+
+        SegmentHeader header;
+        header.firstEpoch = record.epoch;
+        header.crc = crc32((const uint8_t *)&header, offsetof(SegmentHeader, crc));
+        bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+        file.close();
+        if (!ok)
+            return false;
+
+        if (dataLogMeta.firstSegment == 0)
+            dataLogMeta.firstSegment = index;
+        dataLogMeta.lastSegment = index;
+        dataLogMeta.lastSegmentRecords = 0;
+        dataLogMeta.size += sizeof(header);
+        dataLogMeta.segments.push_back({index, header.firstEpoch, (uint32_t)sizeof(header)});
+    }
+
+    segmentPath(path, sizeof(path), dataLogMeta.lastSegment);
+    File file = LittleFS.open(path, "a");
+    if (!file)
+        return false;
+    bool ok = file.write((const uint8_t *)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    if (!ok)
+        return false;
+
+    dataLogMeta.records++;
+    dataLogMeta.lastSegmentRecords++;
+    dataLogMeta.size += sizeof(record);
+    dataLogMeta.segments.back().size += sizeof(record);
+    if (dataLogMeta.records == 1)
+        dataLogMeta.firstEpoch = record.epoch;
+    dataLogMeta.lastEpoch = record.epoch;
+
+    // While the index is still being built it picks this record up itself
+    uint16_t *block = downloadIndex.ready ? downloadIndexBlock(dataLogMeta.lastSegment, dataLogMeta.lastSegmentRecords - 1) : nullptr;
+    if (block)
+    {
+        char line[128];
+        *block += formatDataRecordCsv(line, sizeof(line), record);
+    }
+    return true;
+}
+
+// Rebuilds dataLogMeta from the segment directory: one header read per
+// segment plus two record reads, independent of how many records are stored.
+void scanDataSegments()
+{
+    dataLogMeta = DataLogMeta();
+
+    File dir = LittleFS.open(DATA_DIR);
+    if (!dir || !dir.isDirectory())
+        return;
+
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+    {
+        unsigned long index;
+        const char *name = strrchr(entry.name(), '/');
+        name = name ? name + 1 : entry.name();
+        if (sscanf(name, "%lu.seg", &index) != 1 || index == 0)
+            continue;
+
+        SegmentHeader header;
+        uint32_t firstEpoch = readSegmentHeader(entry, header) ? header.firstEpoch : 0;
+        dataLogMeta.segments.push_back({(uint32_t)index, firstEpoch, (uint32_t)entry.size()});
+        dataLogMeta.size += entry.size();
+        if (entry.size() > sizeof(SegmentHeader))
+            dataLogMeta.records += (entry.size() - sizeof(SegmentHeader)) / sizeof(DataRecord);
+        entry.close();
+    }
+    dir.close();
+
+    if (dataLogMeta.segments.empty())
+        return;
+    std::sort(dataLogMeta.segments.begin(), dataLogMeta.segments.end(),
+              [](const DataSegment &a, const DataSegment &b) { return a.index < b.index; });
+    dataLogMeta.firstSegment = dataLogMeta.segments.front().index;
+    dataLogMeta.lastSegment = dataLogMeta.segments.back().index;
+
+    char path[32];
+    DataRecord record;
+
+    segmentPath(path, sizeof(path), dataLogMeta.firstSegment);
+    File file = LittleFS.open(path, "r");
+    SegmentHeader header;
+    if (file && readSegmentHeader(file, header) && readDataRecord(file, record))
+        dataLogMeta.firstEpoch = record.epoch;
+    if (file)
+        file.close();
+
+    segmentPath(path, sizeof(path), dataLogMeta.lastSegment);
+    file = LittleFS.open(path, "r");
+    if (!file)
+        return;
+    size_t payload = file.size() > sizeof(SegmentHeader) ? file.size() - sizeof(SegmentHeader) : 0;
+    dataLogMeta.lastSegmentRecords = payload / sizeof(DataRecord);
+    if (payload % sizeof(DataRecord) != 0)
+        dataLogMeta.lastSegmentRecords = DATA_SEGMENT_RECORDS; // torn tail: never append after it
+    if (payload >= sizeof(DataRecord))
+    {
+        file.seek(sizeof(SegmentHeader) + (payload / sizeof(DataRecord) - 1) * sizeof(DataRecord));
+        if (readDataRecord(file, record))
+            dataLogMeta.lastEpoch = record.epoch;
+    }
+    file.close();
+}
+
+// One-time conversion of the old /data_log.csv into binary segments
+void migrateLegacyCsv()
+{
+    File csv = LittleFS.open(DATA_LOG_FILE, "r");
+    if (!csv)
+        return;
+
+    serialPrintln("Converting data_log.csv to binary segments...");
+    char line[256];
+    uint32_t converted = 0;
+    bool header = true;
+    while (csv.available())
+    {
+        size_t len = csv.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = '\0';
+        if (header)
+        {
+            header = false;
+            continue;
+        }
+
+        int y, mo, d, h, mi, sec, runs;
+        SensorData row;
+        int n = sscanf(line, "%d-%d-%d %d:%d:%d,%f,%f,%f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+                       &y, &mo, &d, &h, &mi, &sec,
+                       &row.temperature, &row.humidity, &row.lux,
+                       &row.soilMoisture[0], &row.soilMoisture[1], &row.soilMoisture[2],
+                       &row.soilMoisture[3], &row.soilMoisture[4], &row.soilMoisture[5],
+                       &row.soilMoisture[6], &row.soilMoisture[7], &row.soilMoisture[8],
+                       &row.soilMoisture[9], &runs);
+        if (n != 20)
+            continue;
+
+        DataRecord record;
+        encodeDataRecord(row, DateTime(y, mo, d, h, mi, sec).unixtime(), runs, record);
+        if (!appendDataRecord(record))
+        {
+            csv.close();
+            serialPrintln("CSV conversion failed, keeping data_log.csv");
+            return;
+        }
+        if (++converted % 256 == 0)
+            resetWatchdog();
+    }
+    csv.close();
+
+    LittleFS.remove(DATA_LOG_FILE);
+    char logBuffer[64];
+    snprintf(logBuffer, sizeof(logBuffer), "Converted %lu CSV records", (unsigned long)converted);
+    serialPrintln(logBuffer);
+}
+
+// ========== STORAGE MANAGER ==========
+uint32_t dateKey(const DateTime &t)
+{
+    return t.year() * 10000UL + t.month() * 100UL + t.day();
+}
+
+void scanLogFiles()
+{
+    storageUsage.logBytes = 0;
+    storageUsage.logFiles.clear();
+
+    File dir = LittleFS.open("/");
+    if (!dir || !dir.isDirectory())
+        return;
+
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+    {
+        unsigned long date;
+        const char *name = strrchr(entry.name(), '/');
+        name = name ? name + 1 : entry.name();
+        if (!entry.isDirectory() && sscanf(name, LOG_FILE_PREFIX "%8lu.txt", &date) == 1)
+        {
+            storageUsage.logBytes += entry.size();
+            storageUsage.logFiles.push_back({(uint32_t)date, (uint32_t)entry.size()});
+        }
+        entry.close();
+    }
+    dir.close();
+
+    std::sort(storageUsage.logFiles.begin(), storageUsage.logFiles.end(),
+              [](const LogFileInfo &a, const LogFileInfo &b) { return a.date < b.date; });
+}
+
+// Almost always today's file, the last one
+void addLogBytes(uint32_t date, size_t bytes)
+{
+    std::vector<LogFileInfo> &files = storageUsage.logFiles;
+    size_t i = files.size();
+    while (i > 0 && files[i - 1].date > date)
+        i--;
+    if (i > 0 && files[i - 1].date == date)
+        files[i - 1].size += bytes;
+    else
+        files.insert(files.begin() + i, {date, (uint32_t)bytes});
+    storageUsage.logBytes += bytes;
+}
+
+void deleteOldestLogFile()
+{
+    if (storageUsage.logFiles.empty())
+        return;
+    LogFileInfo oldest = storageUsage.logFiles.front();
+    char path[32];
+    snprintf(path, sizeof(path), "/" LOG_FILE_PREFIX "%08lu.txt", (unsigned long)oldest.date);
+    LittleFS.remove(path);
+    storageUsage.logFiles.erase(storageUsage.logFiles.begin());
+    storageUsage.logBytes -= min(oldest.size, storageUsage.logBytes);
+    storageUsage.deletedFiles++;
+}
+
+bool dropOldestSegment()
+{
+    if (dataLogMeta.segments.size() < 2)
+        return false;
+
+    // Already gone counts as removed, or a lost file would stop the cleanup for good
+    DataSegment oldest = dataLogMeta.segments.front();
+    char path[32];
+    segmentPath(path, sizeof(path), oldest.index);
+    if (!LittleFS.remove(path) && LittleFS.exists(path))
+        return false;
+
+    dataLogMeta.segments.erase(dataLogMeta.segments.begin());
+    dataLogMeta.size -= min(oldest.size, dataLogMeta.size);
+    if (oldest.size > sizeof(SegmentHeader))
+        dataLogMeta.records -= min((uint32_t)((oldest.size - sizeof(SegmentHeader)) / sizeof(DataRecord)), dataLogMeta.records);
+    dataLogMeta.firstSegment = dataLogMeta.segments.front().index;
+    storageUsage.deletedFiles++;
+    // Blocks of the removed segment and of any gap after it
+    while (downloadIndex.firstSegment != 0 && downloadIndex.firstSegment < dataLogMeta.firstSegment)
+    {
+        size_t drop = min(downloadIndex.blocks.size(), (size_t)DOWNLOAD_INDEX_BLOCKS);
+        downloadIndex.blocks.erase(downloadIndex.blocks.begin(), downloadIndex.blocks.begin() + drop);
+        downloadIndex.firstSegment++;
+    }
+
+    segmentPath(path, sizeof(path), dataLogMeta.firstSegment);
+    File file = LittleFS.open(path, "r");
+    SegmentHeader header;
+    DataRecord record;
+    if (file && readSegmentHeader(file, header) && readDataRecord(file, record))
+        dataLogMeta.firstEpoch = record.epoch;
+    if (file)
+        file.close();
+    return true;
+}
+
+// Retention first, then the byte budget, always removing the oldest file of
+// either kind. Today's log and the segment being appended to are never removed.
+void enforceStoragePolicy(const DateTime &now)
+{
+    uint32_t today = dateKey(now);
+    uint32_t cutoffEpoch = now.unixtime() - (uint32_t)config.retentionDays * 86400UL;
+    uint32_t cutoffDate = dateKey(DateTime(cutoffEpoch));
+    uint32_t deletedBefore = storageUsage.deletedFiles;
+
+    const std::vector<LogFileInfo> &logs = storageUsage.logFiles;
+    while (!logs.empty() && logs.front().date < cutoffDate && logs.front().date != today)
+        deleteOldestLogFile();
+
+    // A segment is entirely expired once the next one starts before the cutoff
+    const std::vector<DataSegment> &segments = dataLogMeta.segments;
+    while (segments.size() > 1 && segments[1].firstEpoch != 0 && segments[1].firstEpoch < cutoffEpoch)
+    {
+        if (!dropOldestSegment())
+            break;
+    }
+
+    uint32_t budget = (uint32_t)config.storageBudgetKB * 1024UL;
+    while (dataLogMeta.size + storageUsage.logBytes > budget)
+    {
+        bool canDropLog = !logs.empty() && logs.front().date != today;
+        bool canDropSegment = segments.size() > 1;
+        if (canDropLog && (!canDropSegment || logs.front().date <= dateKey(DateTime(dataLogMeta.firstEpoch))))
+            deleteOldestLogFile();
+        else if (!canDropSegment || !dropOldestSegment())
+            break;
+    }
+
+    if (storageUsage.deletedFiles != deletedBefore)
+    {
+        char logBuffer[80];
+        snprintf(logBuffer, sizeof(logBuffer), "Storage cleanup: %lu files removed, %lu KB used",
+                 (unsigned long)(storageUsage.deletedFiles - deletedBefore),
+                 (unsigned long)((dataLogMeta.size + storageUsage.logBytes) / 1024));
+        serialPrintln(logBuffer);
+        dataLogVersion++;
+    }
+
+    // usedBytes() walks the whole filesystem (lfs_fs_size()); only after boot
+    // and after files were removed, the rest follows from the totals in RAM
+    if (storageUsage.deletedFiles != deletedBefore || storageUsage.fsUsed == 0)
+    {
+        storageUsage.fsUsed = LittleFS.usedBytes();
+        storageUsage.fsTracked = trackedBlockBytes();
+    }
+}
+
+uint32_t trackedBlockBytes()
+{
+    uint32_t total = 0;
+    for (const DataSegment &segment : dataLogMeta.segments)
+        total += (segment.size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE * FS_BLOCK_SIZE;
+    for (const LogFileInfo &file : storageUsage.logFiles)
+        total += (file.size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE * FS_BLOCK_SIZE;
+    return total;
+}
+
+// Config and state files are rewritten in place and barely change in size;
+// segments and daily logs grow, and are followed here without touching flash
+uint32_t fsUsedBytes()
+{
+    int64_t used = (int64_t)storageUsage.fsUsed + trackedBlockBytes() - storageUsage.fsTracked;
+    return (uint32_t)max(used, (int64_t)0);
+}
+
+void initDataLog()
+{
+    if (!LittleFS.exists(DATA_DIR))
+        LittleFS.mkdir(DATA_DIR);
+
+    scanDataSegments();
+
+    if (LittleFS.exists(DATA_LOG_FILE))
+        migrateLegacyCsv();
+    if (LittleFS.exists("/data_log.meta"))
+        LittleFS.remove("/data_log.meta"); // sidecar of the CSV format, no longer used
+
+    scanLogFiles();
+    if (i2cBus.synced)
+        enforceStoragePolicy(clockNow());
+    resetDownloadIndex();
+
+    char logBuffer[80];
+    snprintf(logBuffer, sizeof(logBuffer), "Data log: %lu records in %lu segments",
+             (unsigned long)dataLogMeta.records,
+             (unsigned long)(dataLogMeta.lastSegment ? dataLogMeta.lastSegment - dataLogMeta.firstSegment + 1 : 0));
+    serialPrintln(logBuffer);
+}
+
+void saveDataRecord()
+{
+    if (!i2cBus.synced)
+    {
+        serialPrintln("Cannot save data - RTC time not read yet");
+        return;
+    }
+
+    SensorData snapshot;
+    readSensorSnapshot(snapshot);
+
+    DateTime now = clockNow();
+    int avgSoil = getAverageSoilMoisture(snapshot);
+
+    DataRecord record;
+    encodeDataRecord(snapshot, now.unixtime(), pumpControl.pumpRunsToday, record);
+    if (!appendDataRecord(record))
+    {
+        serialPrintln("Failed to write data record");
+        return;
+    }
+    enforceStoragePolicy(now);
+
+    dataLogVersion++;
+    char logMsg[120];
+    snprintf(logMsg, sizeof(logMsg), "Data saved: Temperature=%.2f°C Humidity=%.2f%% Lux=%.2f AvgSoil=%d%%",
+             snapshot.temperature, snapshot.humidity, snapshot.lux, avgSoil);
+    serialPrintln(logMsg);
+}
+
+bool nextDataRecord(DataReader &reader, DataRecord &record)
+{
+    while (reader.next == reader.count)
+    {
+        if (!reader.file)
+        {
+            if (dataLogMeta.records == 0 || reader.segment > dataLogMeta.lastSegment)
+                return false;
+            char path[32];
+            segmentPath(path, sizeof(path), reader.segment);
+            reader.file = LittleFS.open(path, "r");
+            SegmentHeader header;
+            if (!reader.file || !readSegmentHeader(reader.file, header) ||
+                !reader.file.seek(sizeof(SegmentHeader) + reader.offset * sizeof(DataRecord)))
+            {
+                reader.file = File(); // rotated away or unreadable: skip it
+                reader.segment++;
+                reader.offset = 0;
+                continue;
+            }
         }
-        if (!logSchedule && !logModeWatering && !logThreshold && !logPumpDuration &&
-            !logMeasurementInterval && !logDataLogInterval && !logCalibration)
+
+        reader.count = reader.file.read((uint8_t *)reader.records, sizeof(reader.records)) / sizeof(DataRecord);
+        reader.next = 0;
+        if (reader.count == 0)
         {
-            serialPrintln("Settings saved (no changes)");
+            reader.file.close();
+            reader.file = File();
+            reader.segment++;
+            reader.offset = 0;
         }
     }
-    else
-    {
-        server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to save\"}");
-        serialPrintln("Settings save failed");
-    }
+    record = reader.records[reader.next++];
+    reader.offset++;
+    return true;
 }
 
-void handlePumpControl()
+uint32_t dataPosition(uint32_t segment, uint32_t record)
 {
-    if (!server.hasArg("state"))
+    return segment * DATA_SEGMENT_RECORDS + record;
+}
+
+// Copies `piece` to `out` without what the Range leaves out: the first
+// `skip` bytes and everything past `remaining`. Returns the bytes copied.
+size_t clipDataDownload(DataDownload &download, char *out, const char *piece, size_t length)
+{
+    size_t drop = min(length, (size_t)download.skip);
+    download.skip -= drop;
+    length = min(length - drop, (size_t)download.remaining);
+    download.remaining -= length;
+    memcpy(out, piece + drop, length);
+    return length;
+}
+
+// Whole CSV lines only, so a slice never ends inside a row (except where a
+// Range starts or ends). With a Content-Length the last slices are only as
+// large as what is left, so a row is formatted aside and then copied.
+size_t fillDataDownload(DataDownload &download, char *out, size_t size)
+{
+    static const char header[] = DATA_CSV_HEADER "\r\n";
+    size_t len = 0;
+    if (!download.headerSent)
     {
-        server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Missing state\"}");
-        return;
+        len = clipDataDownload(download, out, header, sizeof(header) - 1);
+        download.headerSent = true;
     }
-    String state = server.arg("state");
-    state.toLowerCase();
 
-    if (state == "on")
+    DataRecord record;
+    char line[128];
+    while (download.remaining > 0 && len + min((size_t)sizeof(line), (size_t)download.remaining) <= size)
     {
-        pumpControl.manualOverride = true;
-        pumpControl.controlSource = MANUAL_OVERRIDE;
-        pumpControl.state = PUMP_RUNNING;
-        pumpControl.startTime = millis();
-        pumpControl.pumpRunsToday++;
-        digitalWrite(SOLENOID_PIN, SOLENOID_OPEN);
-        delay(500);
-        digitalWrite(PUMP_PIN, PUMP_ON);
-        serialPrintln("Pump ON (manual)");
-        logToFile("Pump ON (manual)");
-        server.send(200, "application/json", "{\"status\":\"success\",\"pump\":\"on\"}");
+        if (!nextDataRecord(download.reader, record) ||
+            dataPosition(download.reader.segment, download.reader.offset - 1) >= download.end)
+        {
+            download.remaining = 0;
+            break;
+        }
+        if (record.crc != crc8((const uint8_t *)&record, offsetof(DataRecord, crc)))
+            continue; // torn or corrupted record
+        len += clipDataDownload(download, out + len, line, formatDataRecordCsv(line, sizeof(line), record));
     }
-    else if (state == "off")
+
+    if (download.remaining == 0 && !download.finished)
     {
-        pumpControl.manualOverride = true;
-        pumpControl.controlSource = MANUAL_OVERRIDE;
-        pumpControl.state = PUMP_IDLE;
-        digitalWrite(PUMP_PIN, PUMP_OFF);
-        digitalWrite(SOLENOID_PIN, SOLENOID_CLOSED);
-        serialPrintln("Pump OFF (manual)");
-        logToFile("Pump OFF (manual)");
-        server.send(200, "application/json", "{\"status\":\"success\",\"pump\":\"off\"}");
+        download.finished = true;
+        serialPrintln("Data downloaded by user");
     }
-    else if (state == "auto")
+    return len;
+}
+
+// ========== DOWNLOAD INDEX ==========
+// CSV bytes of the next `count` records of an open segment; `count` becomes
+// the number of records that were actually there
+uint32_t measureDataRecords(File &file, uint32_t &count)
+{
+    DataRecord records[16];
+    char line[128];
+    uint32_t bytes = 0, measured = 0;
+    while (measured < count)
     {
-        pumpControl.manualOverride = false;
-        pumpControl.controlSource = CONTROL_NONE;
-        pumpControl.state = PUMP_IDLE;
+        size_t wanted = min((size_t)(count - measured), sizeof(records) / sizeof(DataRecord));
+        size_t got = file.read((uint8_t *)records, wanted * sizeof(DataRecord)) / sizeof(DataRecord);
+        for (size_t i = 0; i < got; i++)
+        {
+            if (records[i].crc == crc8((const uint8_t *)&records[i], offsetof(DataRecord, crc)))
+                bytes += formatDataRecordCsv(line, sizeof(line), records[i]);
+        }
+        measured += got;
+        if (got < wanted)
+            break;
+    }
+    count = measured;
+    return bytes;
+}
 
-        serialPrintln("Pump AUTO mode");
-        logToFile("Pump AUTO mode");
+void resetDownloadIndex()
+{
+    downloadIndex = DownloadIndex();
+    downloadIndex.firstSegment = dataLogMeta.firstSegment;
+    downloadIndex.segment = dataLogMeta.firstSegment;
+}
 
-        server.send(200, "application/json", "{\"status\":\"success\",\"mode\":\"auto\"}");
+uint16_t *downloadIndexBlock(uint32_t segment, uint32_t record)
+{
+    if (downloadIndex.blocks.empty())
+        downloadIndex.firstSegment = segment; // nothing measured yet: start where the log starts now
+    if (segment < downloadIndex.firstSegment || record >= DATA_SEGMENT_RECORDS)
+        return nullptr;
+    size_t segmentBlocks = (segment - downloadIndex.firstSegment) * DOWNLOAD_INDEX_BLOCKS;
+    if (segmentBlocks >= downloadIndex.blocks.size())
+        downloadIndex.blocks.resize(segmentBlocks + DOWNLOAD_INDEX_BLOCKS, 0);
+    return &downloadIndex.blocks[segmentBlocks + record / DOWNLOAD_INDEX_STRIDE];
+}
+
+// Measures at most one block per call: after boot the index is built over
+// many loop() passes, each costing about as much as one download slice
+void serviceDownloadIndex()
+{
+    if (downloadIndex.ready)
+        return;
+    if (downloadIndex.segment < dataLogMeta.firstSegment)
+    {
+        downloadIndex.segment = dataLogMeta.firstSegment; // rotated away while being measured
+        downloadIndex.record = 0;
+    }
+    if (dataLogMeta.records == 0 || downloadIndex.segment > dataLogMeta.lastSegment)
+    {
+        downloadIndex.ready = true;
+        return;
     }
+
+    char path[32];
+    segmentPath(path, sizeof(path), downloadIndex.segment);
+    File file = LittleFS.open(path, "r");
+    SegmentHeader header;
+    uint16_t *block = downloadIndexBlock(downloadIndex.segment, downloadIndex.record);
+    uint32_t wanted = DOWNLOAD_INDEX_STRIDE - downloadIndex.record % DOWNLOAD_INDEX_STRIDE;
+    uint32_t count = wanted;
+    if (block && file && readSegmentHeader(file, header) &&
+        file.seek(sizeof(SegmentHeader) + downloadIndex.record * sizeof(DataRecord)))
+        *block += measureDataRecords(file, count);
     else
+        count = 0; // unreadable: nextDataRecord() skips it too
+    if (file)
+        file.close();
+
+    downloadIndex.record += count;
+    if (count < wanted) // end of the segment
     {
-        server.send(400, "application/json", "{\"status\":\"error\",\"error\":\"Invalid state\"}");
+        if (downloadIndex.segment >= dataLogMeta.lastSegment)
+        {
+            downloadIndex.ready = true; // from here on appendDataRecord() keeps it up to date
+            return;
+        }
+        downloadIndex.segment++;
+        downloadIndex.record = 0;
     }
 }
 
-void handleRestart()
+// Whole blocks come from the index; only the records in front of `record`
+// in its own block (fewer than DOWNLOAD_INDEX_STRIDE) are formatted
+uint32_t downloadOffset(uint32_t segment, uint32_t record)
 {
-    server.send(200, "text/plain", "Restarting...");
-    delay(1000);
-    ESP.restart();
+    if (segment < downloadIndex.firstSegment)
+        return 0;
+    size_t block = (segment - downloadIndex.firstSegment) * DOWNLOAD_INDEX_BLOCKS + record / DOWNLOAD_INDEX_STRIDE;
+    uint32_t offset = 0;
+    for (size_t i = 0; i < block && i < downloadIndex.blocks.size(); i++)
+        offset += downloadIndex.blocks[i];
+
+    uint32_t count = record % DOWNLOAD_INDEX_STRIDE;
+    if (count == 0)
+        return offset;
+    char path[32];
+    segmentPath(path, sizeof(path), segment);
+    File file = LittleFS.open(path, "r");
+    SegmentHeader header;
+    if (file && readSegmentHeader(file, header) &&
+        file.seek(sizeof(SegmentHeader) + (record - count) * sizeof(DataRecord)))
+        offset += measureDataRecords(file, count);
+    if (file)
+        file.close();
+    return offset;
 }
 
-void handleLogs()
+void seekDownloadIndex(uint32_t offset, uint32_t &segment, uint32_t &record, uint32_t &blockOffset)
 {
-    JsonDocument doc;
-    JsonArray logs = doc["logs"].to<JsonArray>();
-
-    int start = (totalMessages < SERIAL_BUFFER_SIZE) ? 0 : serialBufferIndex;
-    int count = min(totalMessages, SERIAL_BUFFER_SIZE);
+    size_t i = 0;
+    blockOffset = 0;
+    while (i + 1 < downloadIndex.blocks.size() && blockOffset + downloadIndex.blocks[i] <= offset)
+        blockOffset += downloadIndex.blocks[i++];
+    segment = downloadIndex.firstSegment + i / DOWNLOAD_INDEX_BLOCKS;
+    record = (i % DOWNLOAD_INDEX_BLOCKS) * DOWNLOAD_INDEX_STRIDE;
+}
 
-    for (int i = 0; i < count; i++)
+// bytes=first-last, bytes=first- or bytes=-suffix. Anything else, including
+// several ranges, is ignored (200, the whole body), as HTTP allows.
+int parseByteRange(const String &value, uint32_t length, uint32_t &first, uint32_t &last)
+{
+    if (!value.startsWith("bytes=") || value.indexOf(',') >= 0)
+        return 200;
+    const char *spec = value.c_str() + 6;
+    const char *dash = strchr(spec, '-');
+    char *end;
+    if (!dash)
+        return 200;
+
+    if (dash == spec)
     {
-        int idx = (start + i) % SERIAL_BUFFER_SIZE;
-        JsonObject logEntry = logs.add<JsonObject>();
-        logEntry["timestamp"] = serialBuffer[idx].timestamp;
-        logEntry["message"] = serialBuffer[idx].message;
+        unsigned long suffix = strtoul(dash + 1, &end, 10);
+        if (end == dash + 1 || *end)
+            return 200;
+        if (suffix == 0)
+            return 416;
+        first = suffix < length ? length - suffix : 0;
+        last = length - 1;
+        return 206;
     }
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    unsigned long from = strtoul(spec, &end, 10);
+    if (end != dash)
+        return 200;
+    unsigned long to = length - 1;
+    if (dash[1])
+    {
+        to = strtoul(dash + 1, &end, 10);
+        if (*end || to < from)
+            return 200;
+    }
+    if (from >= length)
+        return 416;
+    first = from;
+    last = min(to, (unsigned long)length - 1);
+    return 206;
 }
 
-void handleLogsClear()
+// GET /data/download[?from=<epoch>&to=<epoch>]
+// The CSV is produced a slice at a time from server.handleClient(), so a slow
+// client takes longer itself but holds up nothing else. from/to are found
+// with locateDataRecord() and bound the download by record position. Once the
+// download index is built, the size is known before the first byte: the reply
+// has a Content-Length and an ETag, and Range (with If-Range) resumes an
+// interrupted download at any byte.
+void handleDataDownload()
 {
-    serialBufferIndex = 0;
-    totalMessages = 0;
-    serialPrintln("Log buffer cleared");
-    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Log cleared\"}");
-}
+    if (dataLogMeta.records == 0)
+    {
+        server.send(404, "text/plain", "No data available");
+        return;
+    }
+    uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : 0;
+    uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : UINT32_MAX;
+    if (to < from)
+    {
+        server.send(400, "text/plain", "Invalid range");
+        return;
+    }
 
-// ========== WIFI SETUP ==========
-void setupWiFi()
-{
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP("Smart Nursery", "12345678");
-    IPAddress ip = WiFi.softAPIP();
+    std::shared_ptr<DataDownload> download(new DataDownload);
+    DataReader &reader = download->reader;
+    reader.segment = dataLogMeta.firstSegment;
+    if (from > 0)
+        locateDataRecord(from, reader.segment, reader.offset);
+    uint32_t endSegment = dataLogMeta.lastSegment + 1, endRecord = 0;
+    if (to < UINT32_MAX)
+        locateDataRecord(to + 1, endSegment, endRecord);
+    uint32_t startPosition = dataPosition(reader.segment, reader.offset);
+    download->end = max(dataPosition(endSegment, endRecord), startPosition);
+
+    auto fill = [download](uint8_t *buffer, size_t size)
+    { return fillDataDownload(*download, (char *)buffer, size); };
+    server.sendHeader("Content-Disposition", "attachment; filename=sensor_data.csv");
+    if (!downloadIndex.ready)
+    {
+        server.sendBody(200, "text/csv", CONTENT_LENGTH_UNKNOWN, fill); // size unknown until the index is built
+        return;
+    }
 
-    char logBuffer[32];
-    snprintf(logBuffer, sizeof(logBuffer), "AP IP: %d.%d.%d.%d",
-             ip[0], ip[1], ip[2], ip[3]);
-    serialPrintln(logBuffer);
+    const uint32_t headerLength = strlen(DATA_CSV_HEADER "\r\n");
+    uint32_t start = downloadOffset(reader.segment, reader.offset);
+    uint32_t length = headerLength;
+    if (download->end > startPosition)
+        length += downloadOffset(endSegment, endRecord) - start;
+
+    // Changes whenever records are added inside the range or rotated out of the log
+    struct
+    {
+        uint32_t firstEpoch, start, end, length;
+    } version = {dataLogMeta.firstEpoch, startPosition, download->end, length};
+    char etag[12];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)crc32((const uint8_t *)&version, sizeof(version)));
+    server.sendHeader("Accept-Ranges", "bytes");
+    server.sendHeader("ETag", etag);
+
+    uint32_t first = 0, last = length - 1;
+    int code = 200;
+    if (server.hasHeader("Range") && (!server.hasHeader("If-Range") || server.header("If-Range") == etag))
+        code = parseByteRange(server.header("Range"), length, first, last);
+    char range[48];
+    if (code == 416)
+    {
+        snprintf(range, sizeof(range), "bytes */%lu", (unsigned long)length);
+        server.sendHeader("Content-Range", range);
+        server.send(416, "text/plain", "Range not satisfiable");
+        return;
+    }
+    if (code == 206)
+    {
+        snprintf(range, sizeof(range), "bytes %lu-%lu/%lu", (unsigned long)first, (unsigned long)last, (unsigned long)length);
+        server.sendHeader("Content-Range", range);
+    }
+
+    // Start reading at the block holding the first byte and drop what comes before it
+    if (first >= headerLength)
+    {
+        uint32_t blockOffset;
+        seekDownloadIndex(start + first - headerLength, reader.segment, reader.offset, blockOffset);
+        download->skip = start + first - headerLength - blockOffset;
+        download->headerSent = true;
+    }
+    else
+        download->skip = first;
+    download->remaining = last - first + 1;
+    server.sendBody(code, "text/csv", download->remaining, fill);
 }
 
-// ========== DATA MANAGEMENT FUNCTIONS ==========
-void initDataLog()
+// ========== DATA QUERY ==========
+bool queryFieldValue(const DataRecord &record, int field, float &value)
 {
-    if (!LittleFS.exists(DATA_LOG_FILE))
+    switch (field)
     {
-        File file = LittleFS.open(DATA_LOG_FILE, "w");
-        if (!file)
+    case 0:
+        value = record.temperature / 100.0f;
+        return true;
+    case 1:
+        value = record.humidity / 100.0f;
+        return true;
+    case 2:
+        value = record.lux / 100.0f;
+        return true;
+    case 3:
+    {
+        int sum = 0, count = 0;
+        for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
         {
-            serialPrintln("Failed to create data log file");
-            return;
+            if (record.soil[i] <= 100)
+            {
+                sum += record.soil[i];
+                count++;
+            }
         }
-        file.println("DateTime,Temperature(C),Humidity(%),Lux,SoilMoisture1(%),SoilMoisture2(%),SoilMoisture3(%),SoilMoisture4(%),SoilMoisture5(%),SoilMoisture6(%),SoilMoisture7(%),SoilMoisture8(%),SoilMoisture9(%),SoilMoisture10(%),WateringCountToday");
-        file.close();
-        serialPrintln("Data log file created with header");
+        value = count > 0 ? (float)sum / count : 0;
+        return count > 0;
     }
-    else
-    {
-        serialPrintln("Data log file already exists");
+    case QUERY_FIELD_COUNT - 1:
+        value = record.runsToday;
+        return true;
+    default:
+        value = record.soil[field - 4];
+        return record.soil[field - 4] <= 100;
     }
 }
 
-void saveDataRecord()
+void resetQueryBucket(QueryBucket &bucket, uint32_t start)
 {
-    if (!status.rtcInitialized)
+    bucket.start = start;
+    bucket.records = 0;
+    for (int i = 0; i < QUERY_FIELD_COUNT; i++)
     {
-        serialPrintln("Cannot save data - RTC not initialized");
-        return;
+        bucket.count[i] = 0;
+        bucket.sum[i] = 0;
     }
+}
 
-    File file = LittleFS.open(DATA_LOG_FILE, "a");
-    if (!file)
+size_t formatQueryBucket(char *out, size_t size, const QueryBucket &bucket, uint16_t fields, bool first)
+{
+    int len = snprintf(out, size, "%s{\"t\":%lu,\"n\":%lu", first ? "" : ",",
+                       (unsigned long)bucket.start, (unsigned long)bucket.records);
+    for (int i = 0; i < QUERY_FIELD_COUNT && len > 0 && (size_t)len < size; i++)
     {
-        serialPrintln("Failed to open data log file");
-        return;
+        if (!(fields & (1 << i)))
+            continue;
+        if (bucket.count[i] == 0)
+            len += snprintf(out + len, size - len, ",\"%s\":null", queryFieldNames[i]);
+        else
+            len += snprintf(out + len, size - len, ",\"%s\":[%.2f,%.2f,%.2f]", queryFieldNames[i],
+                            bucket.min[i], bucket.sum[i] / bucket.count[i], bucket.max[i]);
     }
+    if (len > 0 && (size_t)len + 1 < size)
+    {
+        out[len++] = '}';
+        out[len] = '\0';
+        return len;
+    }
+    return 0;
+}
 
-    DateTime now = rtc.now();
-    int avgSoil = getAverageSoilMoisture();
-    char buffer[220];
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d,%.2f,%.2f,%.2f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
-             now.year(), now.month(), now.day(),
-             now.hour(), now.minute(), now.second(),
-             data.temperature,
-             data.humidity,
-             data.lux,
-             data.soilMoisture1,
-             data.soilMoisture2,
-             data.soilMoisture3,
-             data.soilMoisture4,
-             data.soilMoisture5,
-             data.soilMoisture6,
-             data.soilMoisture7,
-             data.soilMoisture8,
-             data.soilMoisture9,
-             data.soilMoisture10,
-             pumpControl.pumpRunsToday);
-
-    file.println(buffer);
+bool segmentFirstEpoch(uint32_t index, uint32_t &epoch)
+{
+    char path[32];
+    segmentPath(path, sizeof(path), index);
+    File file = LittleFS.open(path, "r");
+    if (!file)
+        return false;
+    SegmentHeader header;
+    bool ok = readSegmentHeader(file, header);
     file.close();
-    char logMsg[120];
-    snprintf(logMsg, sizeof(logMsg), "Data saved: Temperature=%.2f°C Humidity=%.2f%% Lux=%.2f AvgSoil=%d%%",
-             data.temperature, data.humidity, data.lux, avgSoil);
-    serialPrintln(logMsg);
+    epoch = header.firstEpoch;
+    return ok;
 }
 
-void handleDataDownload()
+// The time index is the segment layout itself: segments are numbered in append
+// order with their first epoch in the header, and records are fixed size. So
+// `from` is found with a binary search over headers and then one over records
+// in a single segment. Unreadable headers/records are treated as "later than
+// from", which can only move the start earlier, never skip data.
+void locateDataRecord(uint32_t from, uint32_t &segment, uint32_t &record)
 {
-    if (!LittleFS.exists(DATA_LOG_FILE))
+    segment = dataLogMeta.firstSegment;
+    record = 0;
+
+    uint32_t lo = dataLogMeta.firstSegment, hi = dataLogMeta.lastSegment;
+    while (lo <= hi)
     {
-        server.send(404, "text/plain", "No data available");
-        return;
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t epoch;
+        if (segmentFirstEpoch(mid, epoch) && epoch <= from)
+        {
+            segment = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            if (mid == dataLogMeta.firstSegment)
+                break;
+            hi = mid - 1;
+        }
     }
 
-    File file = LittleFS.open(DATA_LOG_FILE, "r");
+    char path[32];
+    segmentPath(path, sizeof(path), segment);
+    File file = LittleFS.open(path, "r");
     if (!file)
-    {
-        server.send(500, "text/plain", "Failed to open data file");
         return;
+    size_t count = file.size() > sizeof(SegmentHeader) ? (file.size() - sizeof(SegmentHeader)) / sizeof(DataRecord) : 0;
+    size_t first = 0, last = count;
+    while (first < last)
+    {
+        size_t mid = first + (last - first) / 2;
+        DataRecord candidate;
+        if (file.seek(sizeof(SegmentHeader) + mid * sizeof(DataRecord)) &&
+            readDataRecord(file, candidate) && candidate.epoch < from)
+            first = mid + 1;
+        else
+            last = mid;
     }
-
-    server.sendHeader("Content-Type", "text/csv");
-    server.sendHeader("Content-Disposition", "attachment; filename=sensor_data.csv");
-    server.streamFile(file, "text/csv");
     file.close();
-
-    serialPrintln("Data downloaded by user");
+    record = first;
 }
 
-void handleDataDelete()
+// GET /data/query?from=<epoch>&to=<epoch>&step=<s>&fields=temperature,soil,...
+// -> {"from":F,"to":T,"step":S,"fields":[...],"buckets":[{"t":start,"n":records,"<field>":[min,avg,max]},...]}
+// Empty buckets are omitted. Memory use is fixed whatever the range.
+void handleDataQuery()
 {
-    if (LittleFS.exists(DATA_LOG_FILE))
+    uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : dataLogMeta.firstEpoch;
+    uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : dataLogMeta.lastEpoch;
+    if (to < from)
     {
-        LittleFS.remove(DATA_LOG_FILE);
-        initDataLog(); // Recreate with header
-        server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Data deleted\"}");
-        serialPrintln("Data deleted and file reset");
+        server.send(400, "application/json", "{\"error\":\"Invalid range\"}");
+        return;
     }
-    else
+
+    uint32_t span = to - from;
+    uint32_t step = server.hasArg("step") ? strtoul(server.arg("step").c_str(), NULL, 10)
+                                          : span / QUERY_DEFAULT_BUCKETS + 1;
+    if (step == 0 || span / step >= QUERY_MAX_BUCKETS)
+        step = span / QUERY_MAX_BUCKETS + 1;
+
+    uint16_t fields = QUERY_DEFAULT_FIELDS;
+    if (server.hasArg("fields"))
     {
-        server.send(404, "application/json", "{\"status\":\"error\",\"message\":\"No data file found\"}");
+        fields = 0;
+        String list = server.arg("fields");
+        int start = 0;
+        while (start <= (int)list.length())
+        {
+            int end = list.indexOf(',', start);
+            if (end < 0)
+                end = list.length();
+            String name = list.substring(start, end);
+            name.trim();
+            int i = 0;
+            while (i < QUERY_FIELD_COUNT && name != queryFieldNames[i])
+                i++;
+            if (i == QUERY_FIELD_COUNT)
+            {
+                server.send(400, "application/json", "{\"error\":\"Unknown field\"}");
+                return;
+            }
+            fields |= 1 << i;
+            start = end + 1;
+        }
     }
+
+    std::shared_ptr<DataQuery> query(new DataQuery);
+    query->from = from;
+    query->to = to;
+    query->step = step;
+    query->fields = fields;
+    resetQueryBucket(query->bucket, from);
+    query->done = dataLogMeta.records == 0;
+    if (!query->done)
+        locateDataRecord(from, query->reader.segment, query->reader.offset);
+
+    server.sendBody(200, "application/json", CONTENT_LENGTH_UNKNOWN, [query](uint8_t *buffer, size_t size)
+                    { return fillDataQuery(*query, (char *)buffer, size); });
 }
 
-void handleDataInfo()
+// Adds records to the current bucket and writes out the buckets they close,
+// as long as another full bucket still fits into `out`
+size_t fillDataQuery(DataQuery &query, char *out, size_t size)
 {
-    JsonDocument doc;
-
-    if (!LittleFS.exists(DATA_LOG_FILE))
+    size_t len = 0;
+    int scanned = 0;
+    if (!query.started)
     {
-        doc["exists"] = false;
-        doc["records"] = 0;
-        doc["size"] = 0;
+        len = snprintf(out, size, "{\"from\":%lu,\"to\":%lu,\"step\":%lu,\"fields\":[",
+                       (unsigned long)query.from, (unsigned long)query.to, (unsigned long)query.step);
+        bool firstField = true;
+        for (int i = 0; i < QUERY_FIELD_COUNT; i++)
+        {
+            if (query.fields & (1 << i))
+            {
+                len += snprintf(out + len, size - len, "%s\"%s\"", firstField ? "" : ",", queryFieldNames[i]);
+                firstField = false;
+            }
+        }
+        len += snprintf(out + len, size - len, "],\"buckets\":[");
+        query.started = true;
     }
-    else
+
+    QueryBucket &bucket = query.bucket;
+    DataRecord record;
+    while (!query.finished && len + QUERY_BUCKET_JSON_MAX <= size)
     {
-        File file = LittleFS.open(DATA_LOG_FILE, "r");
-        if (!file)
+        if (query.done)
+        {
+            if (bucket.records > 0)
+            {
+                len += formatQueryBucket(out + len, size - len, bucket, query.fields, query.firstBucket);
+                bucket.records = 0;
+            }
+            len += snprintf(out + len, size - len, "]}");
+            query.finished = true;
+            break;
+        }
+
+        if (scanned++ == QUERY_RECORDS_PER_SLICE)
+            return len > 0 ? len : HTTP_BODY_LATER; // a wide bucket: go on next round
+        if (!nextDataRecord(query.reader, record))
         {
-            doc["exists"] = false;
-            doc["records"] = 0;
-            doc["size"] = 0;
+            query.done = true;
+            continue;
         }
-        else
+        if (record.crc != crc8((const uint8_t *)&record, offsetof(DataRecord, crc)) || record.epoch < query.from)
+            continue;
+        if (record.epoch > query.to)
         {
-            doc["exists"] = true;
-            doc["size"] = file.size();
+            query.done = true;
+            continue;
+        }
 
-            int lineCount = 0;
-            while (file.available())
+        uint32_t start = query.from + (record.epoch - query.from) / query.step * query.step;
+        if (start != bucket.start)
+        {
+            if (bucket.records > 0)
             {
-                String line = file.readStringUntil('\n');
-                lineCount++;
+                len += formatQueryBucket(out + len, size - len, bucket, query.fields, query.firstBucket);
+                query.firstBucket = false;
             }
-            doc["records"] = lineCount > 0 ? lineCount - 1 : 0; // -1 for header
-            file.close();
+            resetQueryBucket(bucket, start);
+        }
+
+        bucket.records++;
+        for (int i = 0; i < QUERY_FIELD_COUNT; i++)
+        {
+            float value;
+            if (!(query.fields & (1 << i)) || !queryFieldValue(record, i, value))
+                continue;
+            if (bucket.count[i] == 0 || value < bucket.min[i])
+                bucket.min[i] = value;
+            if (bucket.count[i] == 0 || value > bucket.max[i])
+                bucket.max[i] = value;
+            bucket.sum[i] += value;
+            bucket.count[i]++;
         }
     }
+    return len;
+}
+
+void handleDataDelete()
+{
+    for (const DataSegment &segment : dataLogMeta.segments)
+    {
+        char path[32];
+        segmentPath(path, sizeof(path), segment.index);
+        LittleFS.remove(path);
+    }
+    dataLogMeta = DataLogMeta();
+    resetDownloadIndex();
+    dataLogVersion++;
+    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Data deleted\"}");
+    serialPrintln("Data deleted and file reset");
+}
+
+void buildDataInfo(JsonDocument &doc)
+{
+    doc["exists"] = dataLogMeta.lastSegment != 0;
+    doc["records"] = dataLogMeta.records;
+    doc["size"] = dataLogMeta.size;
+    if (dataLogMeta.records > 0)
+    {
+        char timeStr[32];
+        DateTime first(dataLogMeta.firstEpoch);
+        snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+                 first.year(), first.month(), first.day(), first.hour(), first.minute(), first.second());
+        doc["firstRecord"] = timeStr;
+        DateTime last(dataLogMeta.lastEpoch);
+        snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+                 last.year(), last.month(), last.day(), last.hour(), last.minute(), last.second());
+        doc["lastRecord"] = timeStr;
+    }
+
+    JsonObject storage = doc["storage"].to<JsonObject>();
+    storage["dataBytes"] = dataLogMeta.size;
+    storage["logBytes"] = storageUsage.logBytes;
+    storage["logFiles"] = storageUsage.logFiles.size();
+    storage["budget"] = (uint32_t)config.storageBudgetKB * 1024UL;
+    storage["retentionDays"] = config.retentionDays;
+    storage["fsUsed"] = fsUsedBytes(); // not LittleFS.usedBytes(): /data/info and every datainfo event stay O(1)
+    storage["fsTotal"] = LittleFS.totalBytes();
 
     // Calculate next log time
-    if (data.lastDataLog > 0)
+    if (lastDataLog > 0)
     {
-        unsigned long timeSinceLog = millis() - data.lastDataLog;
-        if (timeSinceLog < config.dataLogInterval)
+        unsigned long timeSinceLog = millis() - lastDataLog;
+        if (timeSinceLog < (unsigned long)config.dataLogInterval)
         {
             doc["nextLogSeconds"] = (config.dataLogInterval - timeSinceLog) / 1000;
         }
@@ -1163,6 +4758,12 @@ void handleDataInfo()
     {
         doc["nextLogSeconds"] = config.dataLogInterval / 1000; // 1800 seconds = 30 minutes
     }
+}
+
+void handleDataInfo()
+{
+    JsonDocument doc;
+    buildDataInfo(doc);
 
     String response;
     serializeJson(doc, response);
@@ -1199,7 +4800,8 @@ void handleSetDateTime()
         return;
     }
 
-    rtc.adjust(DateTime(y, mo, d, h, mi, s));
+    setClock(DateTime(y, mo, d, h, mi, s));
+    scheduleQueue.valid = false; // slots skipped by the jump are not missed ones
 
     char logBuffer[64];
     snprintf(logBuffer, sizeof(logBuffer),
@@ -1209,14 +4811,127 @@ void handleSetDateTime()
     server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"RTC updated\"}");
 }
 
+// ========== SERVER-SENT EVENTS ==========
+void handleEvents()
+{
+    std::weak_ptr<EventClient> *slot = nullptr;
+    for (int i = 0; i < SSE_MAX_CLIENTS && !slot; i++)
+        if (eventClients[i].expired())
+            slot = &eventClients[i];
+    if (!slot)
+    {
+        server.send(503, "text/plain", "Too many event streams");
+        return;
+    }
+
+    // Full initial push: status, the whole log ring, data log info
+    std::shared_ptr<EventClient> ec(new EventClient);
+    ec->pending = "retry: 3000\n\n";
+    ec->lastWrite = millis();
+    portENTER_CRITICAL(&logMux);
+    ec->logSequence = logSequence - totalMessages;
+    ec->logEpoch = logEpoch;
+    portEXIT_CRITICAL(&logMux);
+    ec->dataLogVersion = dataLogVersion - 1;
+    *slot = ec;
+
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendBody(200, "text/event-stream", CONTENT_LENGTH_UNKNOWN, [ec](uint8_t *buffer, size_t size)
+                    { return fillEvents(*ec, (char *)buffer, size); });
+}
+
+// Copies the rest of the current event and as many next ones as fit, so a
+// new stream's log backlog goes out one slice per handleClient()
+size_t fillEvents(EventClient &ec, char *out, size_t size)
+{
+    refreshStatusCache();
+
+    size_t len = 0;
+    while (len < size)
+    {
+        if (ec.pendingSent == ec.pending.size())
+        {
+            ec.pending.clear();
+            ec.pendingSent = 0;
+            if (!nextEvent(ec))
+                break;
+        }
+        size_t n = min(size - len, ec.pending.size() - ec.pendingSent);
+        memcpy(out + len, ec.pending.data() + ec.pendingSent, n);
+        ec.pendingSent += n;
+        len += n;
+    }
+
+    unsigned long now = millis();
+    if (len == 0 && now - ec.lastWrite >= SSE_KEEPALIVE_INTERVAL)
+        len = snprintf(out, size, ": ping\n\n");
+    if (len == 0)
+        return HTTP_BODY_LATER;
+    ec.lastWrite = now;
+    return len;
+}
+
+void queueEvent(EventClient &ec, const char *event, const char *payload, size_t length)
+{
+    ec.pending.append("event: ").append(event).append("\ndata: ").append(payload, length).append("\n\n");
+}
+
+bool nextEvent(EventClient &ec)
+{
+    // ---------- Status ----------
+    if (statusCache.valid && ec.statusGeneration != statusCache.generation)
+    {
+        queueEvent(ec, "status", statusCache.body, statusCache.length);
+        ec.statusGeneration = statusCache.generation;
+        return true;
+    }
+
+    // ---------- Log lines, one per event ----------
+    portENTER_CRITICAL(&logMux);
+    uint32_t epoch = logEpoch;
+    portEXIT_CRITICAL(&logMux);
+    if (ec.logEpoch != epoch)
+    {
+        queueEvent(ec, "logclear", "{}", 2);
+        ec.logEpoch = epoch;
+        return true;
+    }
+
+    LogMessage entry;
+    if (nextLogEntry(ec.logSequence, entry))
+    {
+        char payload[LOG_ENTRY_JSON_SIZE];
+        size_t length = formatLogEntry(payload, sizeof(payload), entry);
+        queueEvent(ec, "log", payload, length);
+        ec.logSequence = entry.seq;
+        return true;
+    }
+
+    // ---------- Data log counters ----------
+    if (ec.dataLogVersion != dataLogVersion)
+    {
+        JsonDocument doc;
+        buildDataInfo(doc);
+        char payload[384];
+        size_t length = serializeJson(doc, payload, sizeof(payload));
+        queueEvent(ec, "datainfo", payload, length);
+        ec.dataLogVersion = dataLogVersion;
+        return true;
+    }
+    return false;
+}
+
 void setupWebServer()
 {
+    static const char *collectedHeaders[] = {"If-None-Match", "Accept-Encoding", "Range", "If-Range"};
+    server.collectHeaders(collectedHeaders, 4);
     server.enableCORS(true);
 
     server.on("/", HTTP_GET, handleRoot);
     server.on("/status", HTTP_GET, handleStatus);
     server.on("/config", HTTP_GET, handleConfig);
     server.on("/settings", HTTP_POST, handleSettings);
+    server.on("/calibrate", HTTP_ANY, handleCalibrate);
     server.on("/restart", HTTP_POST, handleRestart);
     server.on("/pump", HTTP_POST, handlePumpControl);
     server.on("/logs", HTTP_GET, handleLogs);
@@ -1236,6 +4951,9 @@ void setupWebServer()
     server.on("/data/download", HTTP_GET, handleDataDownload);
     server.on("/data/delete", HTTP_POST, handleDataDelete);
     server.on("/data/info", HTTP_GET, handleDataInfo);
+    server.on("/data/query", HTTP_GET, handleDataQuery);
+    server.on("/events", HTTP_GET, handleEvents);
+    server.onNotFound(handleNotFound);
 
     server.begin();
     serialPrintln("Web server started");
@@ -1245,7 +4963,7 @@ void handleDateTime()
 {
     if (status.rtcInitialized)
     {
-        DateTime now = rtc.now();
+        DateTime now = clockNow();
         String json = "{";
         json += "\"date\":\"" + String(now.timestamp(DateTime::TIMESTAMP_DATE)) + "\",";
         json += "\"time\":\"" + String(now.timestamp(DateTime::TIMESTAMP_TIME)) + "\"";
@@ -1263,7 +4981,7 @@ void handleTime()
 {
     if (status.rtcInitialized)
     {
-        DateTime now = rtc.now();
+        DateTime now = clockNow();
         String json = "{";
         json += "\"time\":\"" + String(now.timestamp(DateTime::TIMESTAMP_TIME)) + "\"";
         json += "}";
@@ -1285,34 +5003,17 @@ void setup()
     serialPrintln("Starting Smart Nursery System...");
 
     analogReadResolution(12);                              // Atur resolusi ADC menjadi 12 bit (0-4095)
-    analogSetPinAttenuation(SOIL1_MOISTURE_PIN, ADC_11db); // Atur attenuasi untuk rentang pengukuran yang lebih luas (0-3.3V)
-    analogSetPinAttenuation(SOIL2_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL3_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL4_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL5_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL6_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL7_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL8_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL9_MOISTURE_PIN, ADC_11db);
-    analogSetPinAttenuation(SOIL10_MOISTURE_PIN, ADC_11db);
-
-    pinMode(SOIL1_MOISTURE_PIN, INPUT);
-    pinMode(SOIL2_MOISTURE_PIN, INPUT);
-    pinMode(SOIL3_MOISTURE_PIN, INPUT);
-    pinMode(SOIL4_MOISTURE_PIN, INPUT);
-    pinMode(SOIL5_MOISTURE_PIN, INPUT);
-    pinMode(SOIL6_MOISTURE_PIN, INPUT);
-    pinMode(SOIL7_MOISTURE_PIN, INPUT);
-    pinMode(SOIL8_MOISTURE_PIN, INPUT);
-    pinMode(SOIL9_MOISTURE_PIN, INPUT);
-    pinMode(SOIL10_MOISTURE_PIN, INPUT);
-
-    // Initialize sensors
-    dht.begin();
-    readDHT22();
-    readSoilMoisture();
+    for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+    {
+        analogSetPinAttenuation(soilPins[i], ADC_11db); // Atur attenuasi untuk rentang pengukuran yang lebih luas (0-3.3V)
+        pinMode(soilPins[i], INPUT);
+    }
+
+    // Initialize sensors (first reading is taken by sensorTask)
+    if (!dht.begin())
+        serialPrintln("DHT22 RMT setup failed");
+    initI2cBus();
     initLuxMeter();
-    readLuxMeter();
 
     initRTC();
     initWatchdog();
@@ -1325,7 +5026,7 @@ void setup()
         ESP.restart();
     }
 
-    // Load configuration
+    // Load configuration (a damaged file is moved aside, not overwritten)
     if (!loadConfig())
     {
         serialPrintln("Using default configuration");
@@ -1333,6 +5034,12 @@ void setup()
         loadConfig();
     }
     validateMeasurementInterval();
+    buildSoilLut();
+    loadLearnedGains();
+    loadScheduleState();
+
+    // Sensor acquisition runs on core 0 from here on
+    startSensorTask();
 
     // ← TAMBAH 2 BARIS INI:
     initDataLog();
@@ -1340,9 +5047,8 @@ void setup()
 
     // Initialize pump control
     pinMode(PUMP_PIN, OUTPUT);
-    pinMode(SOLENOID_PIN, OUTPUT);
     digitalWrite(PUMP_PIN, PUMP_OFF);
-    digitalWrite(SOLENOID_PIN, SOLENOID_CLOSED);
+    initZoneValves();
 
     // Setup network and web server
     setupWiFi();
@@ -1355,20 +5061,20 @@ void setup()
 void loop()
 {
     server.handleClient();
+    serviceLogFlush();
+    serviceDownloadIndex();
     resetWatchdog();
 
+    // Log once per new sensor snapshot published by sensorTask
+    static uint32_t lastSnapshotGeneration = 0;
+    uint32_t generation = sensorSnapshotGeneration();
     unsigned long now = millis();
-    if (now - data.lastMeasurement >= config.measurementInterval)
+    if (generation != lastSnapshotGeneration)
     {
-        data.lastMeasurement = now;
-
-        readDHT22();
-        readSoilMoisture();
-        readLuxMeter();
-
-        if (now - data.lastDataLog >= config.dataLogInterval)
+        lastSnapshotGeneration = generation;
+        if (i2cBus.synced && now - lastDataLog >= (unsigned long)config.dataLogInterval)
         {
-            data.lastDataLog = now;
+            lastDataLog = now;
             saveDataRecord();
         }
 
@@ -1387,12 +5093,14 @@ void loop()
         // }
     }
 
-    // Pump control runs every second — not gated by measurementInterval
+    // Pump control runs every second — not gated by measurementInterval.
+    // It waits for the first good RTC read: a clock near 1970 would reset the
+    // daily counters and build the schedule queue from the wrong day.
     static unsigned long lastPumpCheck = 0;
-    if (status.rtcInitialized && millis() - lastPumpCheck >= 1000)
+    if (i2cBus.synced && millis() - lastPumpCheck >= 1000)
     {
         lastPumpCheck = millis();
-        DateTime currentTime = rtc.now();
+        DateTime currentTime = clockNow();
         resetDailyIrrigation(currentTime);
         controlPump(currentTime);
     }
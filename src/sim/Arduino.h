@@ -0,0 +1,403 @@
+// Minimal Arduino-ESP32 core for the native build, backed by hal.h.
+// Only what src/main.cpp and ArduinoJson use is provided.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hal.h"
+
+typedef uint8_t byte;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define ADC_11db 3
+
+#define PROGMEM
+#define IRAM_ATTR
+#define F(string_literal) (string_literal)
+
+using std::isnan;
+using std::max;
+using std::min;
+
+template <class T, class L, class H>
+inline T constrain(T value, L low, H high)
+{
+    return value < low ? low : (value > high ? high : value);
+}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// ---- time / GPIO / ADC ----
+inline unsigned long millis() { return (unsigned long)hal::nowMs(); }
+inline unsigned long micros() { return (unsigned long)(hal::nowMs() * 1000); }
+inline void delay(unsigned long ms) { hal::sleep((uint32_t)ms); }
+inline void delayMicroseconds(unsigned int) {}
+inline void yield() {}
+inline void pinMode(uint8_t pin, uint8_t mode) { hal::pinMode(pin, mode); }
+inline void digitalWrite(uint8_t pin, uint8_t level) { hal::digitalWrite(pin, level); }
+inline int digitalRead(uint8_t pin) { return hal::digitalRead(pin); }
+inline uint16_t analogRead(uint8_t pin) { return hal::analogRead(pin); }
+inline void analogReadResolution(uint8_t) {}
+inline void analogSetPinAttenuation(uint8_t, int) {}
+inline uint32_t esp_random() { return (uint32_t)rand(); }
+
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size)
+    {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return length;
+}
+
+// ---- String ----
+class String
+{
+public:
+    String() {}
+    String(const char *s) : value(s ? s : "") {}
+    String(const std::string &s) : value(s) {}
+    String(char c) : value(1, c) {}
+    String(int v) : value(std::to_string(v)) {}
+    String(unsigned int v) : value(std::to_string(v)) {}
+    String(long v) : value(std::to_string(v)) {}
+    String(unsigned long v) : value(std::to_string(v)) {}
+    String(float v, unsigned int decimals = 2) : value(format(v, decimals)) {}
+    String(double v, unsigned int decimals = 2) : value(format(v, decimals)) {}
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    bool reserve(unsigned int size)
+    {
+        value.reserve(size);
+        return true;
+    }
+
+    bool concat(const char *s)
+    {
+        if (s)
+            value += s;
+        return true;
+    }
+    bool concat(const char *s, unsigned int n)
+    {
+        value.append(s, n);
+        return true;
+    }
+    bool concat(const String &s)
+    {
+        value += s.value;
+        return true;
+    }
+    bool concat(char c)
+    {
+        value += c;
+        return true;
+    }
+    template <class T>
+    String &operator+=(const T &rhs)
+    {
+        concat(String(rhs));
+        return *this;
+    }
+    String &operator+=(const char *rhs)
+    {
+        concat(rhs);
+        return *this;
+    }
+
+    bool equals(const String &s) const { return value == s.value; }
+    bool operator==(const String &s) const { return value == s.value; }
+    bool operator==(const char *s) const { return value == (s ? s : ""); }
+    bool operator!=(const String &s) const { return value != s.value; }
+    bool operator!=(const char *s) const { return !(*this == s); }
+    bool operator<(const String &s) const { return value < s.value; }
+    char operator[](unsigned int i) const { return i < value.size() ? value[i] : 0; }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+
+    bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return value.size() >= suffix.value.size() &&
+               value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return find(value.find(c, from)); }
+    int indexOf(const String &s, unsigned int from = 0) const { return find(value.find(s.value, from)); }
+    int lastIndexOf(char c) const { return find(value.rfind(c)); }
+    String substring(unsigned int from) const { return from < value.size() ? value.substr(from) : std::string(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+            std::swap(from, to);
+        return from < value.size() ? value.substr(from, to - from) : std::string();
+    }
+
+    void trim()
+    {
+        size_t first = value.find_first_not_of(" \t\r\n");
+        size_t last = value.find_last_not_of(" \t\r\n");
+        value = first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+    }
+    void toLowerCase()
+    {
+        for (char &c : value)
+            c = (char)tolower((unsigned char)c);
+    }
+    void toUpperCase()
+    {
+        for (char &c : value)
+            c = (char)toupper((unsigned char)c);
+    }
+    void replace(const String &from, const String &to)
+    {
+        if (from.value.empty())
+            return;
+        for (size_t at = value.find(from.value); at != std::string::npos; at = value.find(from.value, at + to.value.size()))
+            value.replace(at, from.value.size(), to.value);
+    }
+
+    long toInt() const { return strtol(value.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(value.c_str(), nullptr); }
+
+private:
+    std::string value;
+
+    static int find(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+    static std::string format(double v, unsigned int decimals)
+    {
+        char buffer[40];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, v);
+        return buffer;
+    }
+};
+
+// Same role as in the Arduino core: the result type of String concatenation
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+inline StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+inline StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+// ---- Print / Stream ----
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size-- && write(*buffer++))
+            n++;
+        return n;
+    }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int decimals = 2) { return printf("%.*f", decimals, v); }
+
+    size_t println() { return write("\r\n"); }
+    template <class T>
+    size_t println(const T &v)
+    {
+        size_t n = print(v);
+        return n + println();
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0)
+            return 0;
+        if ((size_t)length < sizeof(buffer))
+            return write((const uint8_t *)buffer, length);
+
+        std::string big(length + 1, '\0');
+        va_start(args, format);
+        vsnprintf(&big[0], big.size(), format, args);
+        va_end(args);
+        return write((const uint8_t *)big.data(), length);
+    }
+};
+
+class Printable
+{
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long) {}
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = 0;
+        int c;
+        while (n < length && (c = read()) >= 0)
+            buffer[n++] = (char)c;
+        return n;
+    }
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    size_t readBytesUntil(char terminator, char *buffer, size_t length)
+    {
+        size_t n = 0;
+        int c;
+        while (n < length && (c = read()) >= 0 && c != terminator)
+            buffer[n++] = (char)c;
+        return n;
+    }
+    String readStringUntil(char terminator)
+    {
+        std::string out;
+        int c;
+        while ((c = read()) >= 0 && c != terminator)
+            out += (char)c;
+        return out;
+    }
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    using Print::write;
+    size_t write(uint8_t c) override
+    {
+        hal::consoleWrite(&c, 1);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        hal::consoleWrite(buffer, size);
+        return size;
+    }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+extern HardwareSerial Serial;
+
+class IPAddress
+{
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+    uint8_t operator[](int i) const { return bytes[i & 3]; }
+    String toString() const
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return buffer;
+    }
+
+private:
+    uint8_t bytes[4];
+};
+
+class EspClass
+{
+public:
+    [[noreturn]] void restart() { hal::restart(); }
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 200000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+};
+extern EspClass ESP;
+
+// ---- FreeRTOS ----
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffUL
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *, uint32_t, void *param,
+                                          UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    if (handle)
+        *handle = nullptr;
+    hal::startTask(task, param);
+    return pdPASS;
+}
+inline void vTaskDelay(TickType_t ticks) { hal::sleep(ticks); }
+inline TickType_t xTaskGetTickCount() { return (TickType_t)hal::nowMs(); }
+inline BaseType_t xPortGetCoreID() { return 1; }
+
+// Tasks are coroutines on the main thread (see hal.h), so critical sections
+// never contend on the host.
+typedef struct
+{
+    int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+
+// Same for mutexes: a task only yields in vTaskDelay()/delay(), never while
+// holding one, so taking it always succeeds at once.
+typedef void *SemaphoreHandle_t;
+#define pdTRUE 1
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    static int mutex;
+    return &mutex;
+}
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
@@ -0,0 +1,43 @@
+// BH1750 for the native build: illuminance from the simulated nursery.
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class BH1750
+{
+public:
+    enum Mode
+    {
+        UNCONFIGURED = 0,
+        CONTINUOUS_HIGH_RES_MODE = 0x10,
+        CONTINUOUS_HIGH_RES_MODE_2 = 0x11,
+        CONTINUOUS_LOW_RES_MODE = 0x13,
+        ONE_TIME_HIGH_RES_MODE = 0x20,
+        ONE_TIME_HIGH_RES_MODE_2 = 0x21,
+        ONE_TIME_LOW_RES_MODE = 0x23
+    };
+
+    explicit BH1750(uint8_t address = 0x23) : address(address) {}
+    bool begin(Mode mode = CONTINUOUS_HIGH_RES_MODE, uint8_t = 0x23, TwoWire * = nullptr)
+    {
+        this->mode = mode;
+        Wire.transactions += 1;
+        return true;
+    }
+    bool configure(Mode mode)
+    {
+        this->mode = mode;
+        return true;
+    }
+    bool measurementReady(bool = false) { return true; }
+    float readLightLevel()
+    {
+        Wire.transactions += 1;
+        return hal::lux();
+    }
+
+private:
+    uint8_t address;
+    Mode mode = UNCONFIGURED;
+};
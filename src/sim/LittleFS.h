@@ -0,0 +1,71 @@
+// LittleFS for the native build, stored as plain files under a host
+// directory (hal::setFsRoot(), "sim_fs" by default). Files are opened in
+// binary mode; directories list their entries like the ESP32 VFS does.
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+struct FileImpl;
+
+class File : public Stream
+{
+public:
+    File() {}
+    explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+    explicit operator bool() const;
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t *buffer, size_t size);
+    void flush() override;
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    time_t getLastWrite();
+    const char *path() const;
+    const char *name() const;
+    bool isDirectory() const;
+    File openNextFile(const char *mode = "r");
+    void rewindDirectory();
+
+private:
+    std::shared_ptr<FileImpl> impl;
+};
+
+class LittleFSFS
+{
+public:
+    bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char *partitionLabel = "spiffs");
+    void end() {}
+    bool format();
+    size_t totalBytes();
+    size_t usedBytes();
+
+    File open(const char *path, const char *mode = "r", bool create = false);
+    File open(const String &path, const char *mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char *path);
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+    bool rmdir(const char *path);
+    bool rmdir(const String &path) { return rmdir(path.c_str()); }
+};
+extern LittleFSFS LittleFS;
@@ -0,0 +1,94 @@
+// RTClib subset for the native build. DateTime does real calendar math; the
+// DS3231 reads its time from the simulated clock (hal::rtcEpoch()).
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class TimeSpan
+{
+public:
+    TimeSpan(int32_t seconds = 0) : total(seconds) {}
+    TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+        : total((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+    int16_t days() const { return total / 86400L; }
+    int8_t hours() const { return total / 3600 % 24; }
+    int8_t minutes() const { return total / 60 % 60; }
+    int8_t seconds() const { return total % 60; }
+    int32_t totalseconds() const { return total; }
+    TimeSpan operator+(const TimeSpan &right) const { return TimeSpan(total + right.total); }
+    TimeSpan operator-(const TimeSpan &right) const { return TimeSpan(total - right.total); }
+
+private:
+    int32_t total;
+};
+
+class DateTime
+{
+public:
+    enum timestampOpt
+    {
+        TIMESTAMP_FULL,
+        TIMESTAMP_TIME,
+        TIMESTAMP_DATE
+    };
+
+    DateTime(uint32_t t = 946684800UL); // 2000-01-01 00:00:00
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    DateTime(const char *date, const char *time); // __DATE__, __TIME__
+
+    bool isValid() const;
+    uint16_t year() const { return y; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const;
+    uint32_t unixtime() const;
+    uint32_t secondstime() const { return unixtime() - 946684800UL; }
+    String timestamp(timestampOpt opt = TIMESTAMP_FULL) const;
+
+    DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+    DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+    TimeSpan operator-(const DateTime &right) const { return TimeSpan((int32_t)(unixtime() - right.unixtime())); }
+    bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+    bool operator>(const DateTime &right) const { return right < *this; }
+    bool operator<=(const DateTime &right) const { return !(*this > right); }
+    bool operator>=(const DateTime &right) const { return !(*this < right); }
+    bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+    bool operator!=(const DateTime &right) const { return !(*this == right); }
+
+private:
+    uint16_t y;
+    uint8_t m, d, hh, mm, ss;
+};
+
+class RTC_DS3231
+{
+public:
+    // Transactions as RTClib issues them: begin() probes the address,
+    // lostPower() reads the status register, now() sets the register pointer
+    // and reads 7 bytes, adjust() writes 7 bytes and clears OSF (read + write)
+    bool begin(TwoWire * = nullptr)
+    {
+        Wire.transactions += 1;
+        return true;
+    }
+    bool lostPower()
+    {
+        Wire.transactions += 2;
+        return false;
+    }
+    void adjust(const DateTime &dt)
+    {
+        Wire.transactions += 4;
+        hal::rtcAdjust(dt.unixtime());
+    }
+    DateTime now()
+    {
+        Wire.transactions += 2;
+        return DateTime(hal::rtcEpoch());
+    }
+    float getTemperature() { return hal::temperature(); }
+};
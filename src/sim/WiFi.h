@@ -0,0 +1,68 @@
+// WiFi for the native build: the soft AP always comes up, and WiFiServer /
+// WiFiClient are real sockets (see the network part of hal.h). Clients reach
+// a server through hal::connect(), or over TCP after hal::listenOnHost().
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+
+#include "hal.h"
+
+#define WIFI_AP 2
+
+class WiFiClient : public Stream
+{
+public:
+    WiFiClient() {}
+    explicit WiFiClient(int fd);
+
+    explicit operator bool() { return connected(); }
+    bool connected();
+    void stop();
+    int fd() const { return socket ? socket->fd : -1; }
+    void setNoDelay(bool) {}
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override; // blocking, like the ESP32 client
+    int available() override;
+    int read() override;
+    int peek() override;
+    IPAddress remoteIP() { return IPAddress(127, 0, 0, 1); }
+    uint16_t remotePort() { return 0; }
+
+private:
+    // Shared by copies like the ESP32 client's socket handle; the last copy closes it
+    struct Socket
+    {
+        int fd;
+        explicit Socket(int fd) : fd(fd) {}
+        ~Socket();
+    };
+    std::shared_ptr<Socket> socket;
+};
+
+class WiFiServer
+{
+public:
+    explicit WiFiServer(uint16_t port = 80) : port(port) {}
+    void begin() { hal::serverBegin(port); }
+    void setNoDelay(bool) {}
+    WiFiClient available() { return accept(); }
+    WiFiClient accept()
+    {
+        int fd = hal::serverAccept(port);
+        return fd >= 0 ? WiFiClient(fd) : WiFiClient();
+    }
+
+private:
+    uint16_t port;
+};
+
+class WiFiClass
+{
+public:
+    bool mode(int) { return true; }
+    bool softAP(const char *, const char * = nullptr) { return true; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+};
+extern WiFiClass WiFi;
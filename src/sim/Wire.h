@@ -0,0 +1,18 @@
+// I2C for the native build: RTC and BH1750 are simulated above the bus.
+// `transactions` counts what the real chips would put on the wire (one per
+// START..STOP), so the firmware's bus traffic can be compared in the sim.
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire
+{
+public:
+    bool begin() { return true; }
+    bool begin(int, int, uint32_t = 0) { return true; }
+    void setClock(uint32_t) {}
+    void setTimeOut(uint16_t) {}
+
+    uint64_t transactions = 0;
+};
+extern TwoWire Wire;
@@ -0,0 +1,586 @@
+// Implementations behind the native Arduino headers in this directory.
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <driver/gpio.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+TwoWire Wire;
+LittleFSFS LittleFS;
+
+// ========== DateTime ==========
+namespace
+{
+    // Days since 1970-01-01 <-> civil date (proleptic Gregorian)
+    int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2;
+        int64_t era = (y >= 0 ? y : y - 399) / 400;
+        unsigned yoe = (unsigned)(y - era * 400);
+        unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (int64_t)doe - 719468;
+    }
+
+    void civilFromDays(int64_t z, int &y, unsigned &m, unsigned &d)
+    {
+        z += 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        unsigned doe = (unsigned)(z - era * 146097);
+        unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = (int)(yoe + era * 400 + (m <= 2));
+    }
+}
+
+DateTime::DateTime(uint32_t t)
+{
+    int year;
+    unsigned month, day;
+    civilFromDays(t / 86400UL, year, month, day);
+    y = year;
+    m = month;
+    d = day;
+    hh = t / 3600 % 24;
+    mm = t / 60 % 60;
+    ss = t % 60;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
+    : y(year < 100 ? year + 2000 : year), m(month), d(day), hh(hour), mm(min), ss(sec) {}
+
+DateTime::DateTime(const char *date, const char *time)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char name[4] = {0};
+    int day = 1, year = 2000, hour = 0, minute = 0, second = 0;
+    sscanf(date, "%3s %d %d", name, &day, &year);
+    sscanf(time, "%d:%d:%d", &hour, &minute, &second);
+    const char *at = strstr(months, name);
+    y = year;
+    m = at ? (at - months) / 3 + 1 : 1;
+    d = day;
+    hh = hour;
+    mm = minute;
+    ss = second;
+}
+
+bool DateTime::isValid() const
+{
+    if (y < 2000 || y > 2099 || m < 1 || m > 12 || d < 1 || hh > 23 || mm > 59 || ss > 59)
+        return false;
+    return DateTime(unixtime()).day() == d;
+}
+
+uint8_t DateTime::dayOfTheWeek() const
+{
+    return (uint8_t)((daysFromCivil(y, m, d) + 4) % 7); // 1970-01-01 was a Thursday
+}
+
+uint32_t DateTime::unixtime() const
+{
+    return (uint32_t)(daysFromCivil(y, m, d) * 86400 + hh * 3600L + mm * 60L + ss);
+}
+
+String DateTime::timestamp(timestampOpt opt) const
+{
+    char buffer[32];
+    if (opt == TIMESTAMP_TIME)
+        snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hh, mm, ss);
+    else if (opt == TIMESTAMP_DATE)
+        snprintf(buffer, sizeof(buffer), "%u-%02d-%02d", y, m, d);
+    else
+        snprintf(buffer, sizeof(buffer), "%u-%02d-%02dT%02d:%02d:%02d", y, m, d, hh, mm, ss);
+    return buffer;
+}
+
+// ========== DHT22 (GPIO, esp_timer, RMT) ==========
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+};
+
+struct RmtRing
+{
+    std::vector<rmt_item32_t> frame; // reply waiting in the ring buffer
+    bool taken = false;              // handed out, not returned yet
+};
+
+namespace
+{
+    struct RmtChannel
+    {
+        gpio_num_t pin = -1;
+        RmtRing ring;
+    } rmtChannels[RMT_CHANNEL_MAX];
+
+    bool startSignal[64];       // pin pulled low since the last rmt_rx_start()
+    uint64_t lastReplyMs = 0;
+    bool replied = false;
+
+    // Low/high pulse pairs in 1 us ticks: preamble, 40 bits, final low with
+    // the idle high as the zero-length end marker
+    void encodeDhtFrame(std::vector<rmt_item32_t> &items)
+    {
+        int humidity = (int)lroundf(std::min(std::max(hal::humidity(), 0.0f), 100.0f) * 10);
+        int temperature = (int)lroundf(hal::temperature() * 10);
+        uint8_t bytes[5] = {(uint8_t)(humidity >> 8), (uint8_t)humidity,
+                            (uint8_t)((std::abs(temperature) >> 8) | (temperature < 0 ? 0x80 : 0)),
+                            (uint8_t)std::abs(temperature), 0};
+        bytes[4] = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+
+        auto pulse = [&items](uint32_t low, uint32_t high)
+        {
+            rmt_item32_t item;
+            item.level0 = 0;
+            item.duration0 = low;
+            item.level1 = 1;
+            item.duration1 = high;
+            items.push_back(item);
+        };
+        items.clear();
+        pulse(80, 80);
+        for (int i = 0; i < 40; i++)
+            pulse(50, bytes[i / 8] & (0x80 >> (i % 8)) ? 70 : 27);
+        pulse(50, 0);
+    }
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    hal::digitalWrite(pin, level ? HIGH : LOW);
+    if (!level)
+        startSignal[pin & 63] = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    *out = new esp_timer{*args};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t)
+{
+    timer->args.callback(timer->args.arg);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_config(const rmt_config_t *config)
+{
+    rmtChannels[config->channel].pin = config->gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t, size_t, int)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *ring)
+{
+    *ring = &rmtChannels[channel].ring;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool)
+{
+    RmtChannel &rmt = rmtChannels[channel];
+    bool signalled = rmt.pin >= 0 && startSignal[rmt.pin & 63];
+    if (rmt.pin >= 0)
+        startSignal[rmt.pin & 63] = false;
+    if (!signalled || (replied && hal::nowMs() - lastReplyMs < 2000))
+        return ESP_OK; // the sensor stays silent
+    encodeDhtFrame(rmt.ring.frame);
+    lastReplyMs = hal::nowMs();
+    replied = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t)
+{
+    return ESP_OK;
+}
+
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *item_size, TickType_t)
+{
+    if (ring->frame.empty() || ring->taken)
+        return nullptr;
+    ring->taken = true;
+    *item_size = ring->frame.size() * sizeof(rmt_item32_t);
+    return ring->frame.data();
+}
+
+void vRingbufferReturnItem(RingbufHandle_t ring, void *)
+{
+    ring->frame.clear();
+    ring->taken = false;
+}
+
+// ========== LittleFS ==========
+struct FileImpl
+{
+    std::string path;     // LittleFS path, e.g. "/tsdb/00001.seg"
+    std::string name;     // last path component
+    FILE *handle = nullptr;
+    bool directory = false;
+    std::vector<std::string> entries; // directory listing, taken at open
+    size_t nextEntry = 0;
+
+    ~FileImpl()
+    {
+        if (handle)
+            fclose(handle);
+    }
+};
+
+namespace
+{
+    std::string baseName(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    std::string joinPath(const std::string &dir, const std::string &name)
+    {
+        return dir == "/" ? "/" + name : dir + "/" + name;
+    }
+
+    void sumSizes(const std::string &hostDir, size_t &total)
+    {
+        DIR *dir = opendir(hostDir.c_str());
+        if (!dir)
+            return;
+        while (dirent *entry = readdir(dir))
+        {
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+                continue;
+            std::string path = hostDir + "/" + entry->d_name;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0)
+                continue;
+            if (S_ISDIR(st.st_mode))
+                sumSizes(path, total);
+            else
+                total += (st.st_size + 4095) / 4096 * 4096; // LittleFS allocates whole 4 KB blocks
+        }
+        closedir(dir);
+    }
+}
+
+File::operator bool() const
+{
+    return impl && (impl->handle || impl->directory);
+}
+
+size_t File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+    if (!impl || !impl->handle)
+        return 0;
+    size_t written = fwrite(buffer, 1, hal::bytesBeforePowerCut(impl->path, size), impl->handle);
+    hal::checkPowerCut(impl->handle);
+    return written;
+}
+
+int File::available()
+{
+    if (!impl || !impl->handle)
+        return 0;
+    return (int)(size() - position());
+}
+
+int File::read()
+{
+    if (!impl || !impl->handle)
+        return -1;
+    return fgetc(impl->handle);
+}
+
+int File::peek()
+{
+    if (!impl || !impl->handle)
+        return -1;
+    int c = fgetc(impl->handle);
+    if (c != EOF)
+        ungetc(c, impl->handle);
+    return c;
+}
+
+size_t File::read(uint8_t *buffer, size_t size)
+{
+    if (!impl || !impl->handle)
+        return 0;
+    return fread(buffer, 1, size, impl->handle);
+}
+
+void File::flush()
+{
+    if (impl && impl->handle)
+        fflush(impl->handle);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    if (!impl || !impl->handle)
+        return false;
+    int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+    if ((mode == SeekSet && pos > size()) || fseek(impl->handle, pos, whence) != 0)
+        return false;
+    return true;
+}
+
+size_t File::position() const
+{
+    if (!impl || !impl->handle)
+        return 0;
+    long at = ftell(impl->handle);
+    return at < 0 ? 0 : (size_t)at;
+}
+
+size_t File::size() const
+{
+    if (!impl || !impl->handle)
+        return 0;
+    fflush(impl->handle);
+    struct stat st;
+    return fstat(fileno(impl->handle), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::close()
+{
+    impl.reset();
+}
+
+time_t File::getLastWrite()
+{
+    struct stat st;
+    if (!impl || stat(hal::fsPath(impl->path.c_str()).c_str(), &st) != 0)
+        return 0;
+    return st.st_mtime;
+}
+
+const char *File::path() const
+{
+    return impl ? impl->path.c_str() : nullptr;
+}
+
+const char *File::name() const
+{
+    return impl ? impl->name.c_str() : nullptr;
+}
+
+bool File::isDirectory() const
+{
+    return impl && impl->directory;
+}
+
+File File::openNextFile(const char *mode)
+{
+    if (!impl || !impl->directory || impl->nextEntry >= impl->entries.size())
+        return File();
+    return LittleFS.open(joinPath(impl->path, impl->entries[impl->nextEntry++]).c_str(), mode);
+}
+
+void File::rewindDirectory()
+{
+    if (impl)
+        impl->nextEntry = 0;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char *, uint8_t, const char *)
+{
+    (void)formatOnFail;
+    std::string root = hal::fsPath("/");
+    ::mkdir(root.c_str(), 0755);
+    struct stat st;
+    return stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool LittleFSFS::format()
+{
+    File root = open("/");
+    for (File entry = root.openNextFile(); entry; entry = root.openNextFile())
+    {
+        std::string path = entry.path();
+        if (entry.isDirectory())
+        {
+            for (File child = entry.openNextFile(); child; child = entry.openNextFile())
+            {
+                std::string childPath = child.path();
+                child.close();
+                remove(childPath.c_str());
+            }
+            entry.close();
+            rmdir(path.c_str());
+        }
+        else
+        {
+            entry.close();
+            remove(path.c_str());
+        }
+    }
+    return true;
+}
+
+size_t LittleFSFS::totalBytes()
+{
+    return 0x160000; // default 4 MB partition table: 1.375 MB LittleFS
+}
+
+size_t LittleFSFS::usedBytes()
+{
+    size_t total = 0;
+    sumSizes(hal::fsPath("/"), total);
+    return total;
+}
+
+File LittleFSFS::open(const char *path, const char *mode, bool create)
+{
+    (void)create;
+    std::string hostPath = hal::fsPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path[0] == '/' ? path : std::string("/") + path;
+    impl->name = baseName(impl->path);
+
+    struct stat st;
+    if (stat(hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        if (mode[0] != 'r')
+            return File();
+        impl->directory = true;
+        DIR *dir = opendir(hostPath.c_str());
+        if (!dir)
+            return File();
+        while (dirent *entry = readdir(dir))
+            if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+                impl->entries.push_back(entry->d_name);
+        closedir(dir);
+        std::sort(impl->entries.begin(), impl->entries.end());
+        hal::fsStats().opens++;
+        hal::fsStats().listings++;
+        return File(impl);
+    }
+
+    std::string hostMode = std::string(mode).find('+') != std::string::npos ? std::string(1, mode[0]) + "+b"
+                                                                              : std::string(1, mode[0]) + "b";
+    impl->handle = fopen(hostPath.c_str(), hostMode.c_str());
+    if (!impl->handle)
+        return File();
+    hal::fsStats().opens++;
+    return File(impl);
+}
+
+bool LittleFSFS::exists(const char *path)
+{
+    struct stat st;
+    return stat(hal::fsPath(path).c_str(), &st) == 0;
+}
+
+bool LittleFSFS::remove(const char *path)
+{
+    return unlink(hal::fsPath(path).c_str()) == 0;
+}
+
+bool LittleFSFS::rename(const char *from, const char *to)
+{
+    return ::rename(hal::fsPath(from).c_str(), hal::fsPath(to).c_str()) == 0;
+}
+
+bool LittleFSFS::mkdir(const char *path)
+{
+    return ::mkdir(hal::fsPath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool LittleFSFS::rmdir(const char *path)
+{
+    return ::rmdir(hal::fsPath(path).c_str()) == 0;
+}
+
+// ========== WiFiClient ==========
+WiFiClient::WiFiClient(int fd) : socket(std::make_shared<Socket>(fd)) {}
+
+WiFiClient::Socket::~Socket()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool WiFiClient::connected()
+{
+    if (fd() < 0)
+        return false;
+    char c;
+    ssize_t got = ::recv(fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return got > 0 || (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+void WiFiClient::stop()
+{
+    if (socket && socket->fd >= 0)
+    {
+        ::close(socket->fd);
+        socket->fd = -1;
+    }
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)
+{
+    size_t sent = 0;
+    while (fd() >= 0 && sent < size)
+    {
+        ssize_t n = ::send(fd(), buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+    return sent;
+}
+
+int WiFiClient::available()
+{
+    int count = 0;
+    return fd() >= 0 && ::ioctl(fd(), FIONREAD, &count) == 0 ? count : 0;
+}
+
+int WiFiClient::read()
+{
+    unsigned char c;
+    return fd() >= 0 && ::recv(fd(), &c, 1, MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+int WiFiClient::peek()
+{
+    unsigned char c;
+    return fd() >= 0 && ::recv(fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
@@ -0,0 +1,396 @@
+// `program bench`: replays weeks to years of conditions through the pump
+// policy only (controlPump(), resetDailyIrrigation(), getAverageSoilMoisture())
+// on a virtual clock, once per WateringMode, and compares the outcome.
+//
+// Unlike the full simulation there is no sensorTask and no loop(): each
+// simulated second runs the same pump check loop() does, and every --sample
+// seconds the firmware's own sampler takes one round per filter window slot
+// (window x oversample analogReads per channel) before the measurement.
+// A year of minute-resolution data takes about 12 s per mode at -O2.
+//
+//   program bench --days 365 --set threshold=30 --set pumpDuration=60000
+//   program bench --replay sensor_data.csv --modes 1,2
+//
+// Options:
+//   --days N        simulated days (default 28; with --replay: the whole file)
+//   --start TIME    "YYYY-MM-DD HH:MM:SS" (default 2025-01-01 00:00:00; with --replay: first row)
+//   --replay FILE   CSV from /data/download: temperature, humidity and lux per row
+//                   replace the synthetic weather (soil still follows the bed model)
+//   --modes LIST    WateringMode values to compare (default 0,1,2,3)
+//   --sample S      seconds between soil measurements (default 60)
+//   --flow L        pump flow in litres per minute, for water used (default 2)
+//   --set KEY=VAL   POST /settings before the run, repeatable
+//   --moisture F    initial soil water content 0..1 (default 0.45)
+//   --seed N        sensor noise / bed variation seed (default 1)
+//   --valves LIST   valve pin feeding each of the 10 beds (default all 18, i.e. zone 1)
+//   --fs DIR        LittleFS root; each mode uses DIR/mode<N> (default sim_fs/bench)
+//
+// COOLDOWN_TIME and MOISTURE_DEBOUNCE_COUNT are compile-time constants; sweep
+// them with e.g. PLATFORMIO_BUILD_FLAGS="-D COOLDOWN_TIME=600000UL".
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+#include "nursery.h"
+
+// From main.cpp
+extern RTC_DS3231 rtc;
+void initRTC();
+bool setupLittleFS();
+bool loadConfig();
+void createDefaultConfig();
+void buildSoilLut();
+void setupWebServer();
+bool readSoilMoisture();
+bool serviceSoilSampler();
+void publishSensorData();
+int getAverageSoilMoisture();
+void resetDailyIrrigation(DateTime &currentTime);
+void controlPump(DateTime &currentTime);
+void serviceLogFlush();
+
+namespace
+{
+    const char *const modeNames[] = {"SCHEDULE", "MOISTURE", "BOTH", "ADAPTIVE"};
+    const uint32_t DEMAND_GRACE = 10; // s; longer than the debounce, so only cooldown keeps demand unmet
+    const uint32_t SOIL_SAMPLE_PERIOD_MS = 50; // as in main.cpp
+
+    struct WeatherRow
+    {
+        uint32_t epoch;
+        float temperature;
+        float humidity;
+        float lux;
+    };
+
+    struct Result
+    {
+        uint32_t starts = 0;
+        double pumpMinutes = 0;
+        double liters = 0;
+        double hoursBelow = 0;
+        double bedHoursBelow = 0; // per bed, averaged over the 10 beds
+        double hoursOutOfBand = 0; // average outside threshold .. threshold + moistureBand
+        uint32_t collisions = 0;
+        int minSoil = 100;
+        int maxSoil = 0;
+        double wallSeconds = 0;
+    };
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr,
+                "usage: program bench [--days N] [--start \"YYYY-MM-DD HH:MM:SS\"] [--replay FILE] [--modes 0,1,2,3]\n"
+                "                     [--sample S] [--flow L] [--set KEY=VAL]... [--moisture F] [--seed N] [--valves LIST] [--fs DIR]\n");
+        exit(2);
+    }
+
+    bool loadReplay(const char *path, std::vector<WeatherRow> &rows)
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+            return false;
+
+        char line[512];
+        while (fgets(line, sizeof(line), file))
+        {
+            int y, mo, d, h, mi, s;
+            WeatherRow row;
+            if (sscanf(line, "%d-%d-%d %d:%d:%d,%f,%f,%f", &y, &mo, &d, &h, &mi, &s,
+                       &row.temperature, &row.humidity, &row.lux) != 9)
+                continue; // header or damaged line
+            row.epoch = DateTime(y, mo, d, h, mi, s).unixtime();
+            if (rows.empty() || row.epoch > rows.back().epoch)
+                rows.push_back(row);
+        }
+        fclose(file);
+        return !rows.empty();
+    }
+
+    // /config value, or the --set value when the JSON library is not the real one
+    int configInt(JsonDocument &config, const http::Params &settings, const char *key, int fallback)
+    {
+        for (const auto &setting : settings)
+            if (setting.first == key)
+                fallback = setting.second.toInt();
+        return config[key] | fallback;
+    }
+
+    // Largest filter window of the 10 channels: sensorTask samples all the
+    // time, but a measurement only sees the last `window` rounds (the EMA
+    // behind it forgets the minute before within a few rounds), so feeding
+    // that many rounds just before a measurement is equivalent
+    int filterWindow(JsonDocument &config, const http::Params &settings)
+    {
+        int most = 1;
+        for (int ch = 0; ch < 10; ch++)
+        {
+            String key = "filter" + String(ch + 1) + "Window";
+            int window = 5; // SoilFilterConfig default
+            for (const auto &setting : settings)
+                if (setting.first == key)
+                    window = setting.second.toInt();
+            window = config["soilFilter"][ch]["window"] | window;
+            most = max(most, constrain(window, 1, 10)); // SOIL_FILTER_WINDOW
+        }
+        return most;
+    }
+
+    Result runMode(int mode, uint32_t start, uint64_t seconds, uint32_t sampleSeconds, float flow,
+                   const http::Params &settings, const std::vector<WeatherRow> &weather)
+    {
+        auto wallStart = std::chrono::steady_clock::now();
+
+        hal::rtcAdjust(start);
+        if (LittleFS.begin())
+            LittleFS.format();
+        initRTC();
+        setupLittleFS();
+        if (!loadConfig())
+        {
+            createDefaultConfig();
+            loadConfig();
+        }
+        buildSoilLut();
+        setupWebServer();
+
+        http::Params args = settings;
+        args.push_back({"wateringMode", String(mode)});
+        http::request("POST", "/settings", args);
+
+        std::string body;
+        http::request("GET", "/config", http::Params(), http::Params(), &body);
+        JsonDocument config;
+        deserializeJson(config, body);
+        int threshold = configInt(config, settings, "threshold", 30);
+        int band = configInt(config, settings, "moistureBand", 10);
+        int settleRounds = filterWindow(config, settings);
+        bool moistureMode = mode != 0;
+
+        Result result;
+        size_t nextWeather = 0;
+        uint32_t demandSince = 0;
+        bool collisionCounted = false;
+
+        for (uint64_t second = 0; second < seconds; second++)
+        {
+            uint64_t tickEnd = hal::nowMs() + 1000;
+
+            while (nextWeather < weather.size() && weather[nextWeather].epoch <= hal::rtcEpoch())
+            {
+                const WeatherRow &row = weather[nextWeather++];
+                nursery::setWeather(row.temperature, row.humidity, row.lux);
+            }
+
+            if (second % sampleSeconds == 0)
+            {
+                for (int round = 0; round < settleRounds; round++)
+                {
+                    hal::advance(SOIL_SAMPLE_PERIOD_MS);
+                    serviceSoilSampler();
+                }
+                if (readSoilMoisture())
+                    publishSensorData();
+            }
+
+            // Same as the once-per-second block at the end of loop()
+            DateTime now = rtc.now();
+            resetDailyIrrigation(now);
+            controlPump(now);
+            serviceLogFlush();
+
+            int soil = getAverageSoilMoisture();
+            bool pumping = nursery::watering();
+            if (soil >= 0)
+            {
+                result.minSoil = min(result.minSoil, soil);
+                result.maxSoil = max(result.maxSoil, soil);
+            }
+
+            bool demand = moistureMode && soil >= 0 && soil < threshold && !pumping;
+            if (soil >= 0 && soil < threshold)
+                result.hoursBelow += 1 / 3600.0;
+            if (soil >= 0 && (soil < threshold || soil > threshold + band))
+                result.hoursOutOfBand += 1 / 3600.0;
+            for (int i = 0; i < 10; i++)
+            {
+                // Same scale as readSoilPercent(): 0..50 over the dry..wet range
+                if (nursery::moisture(i) * 50 < threshold)
+                    result.bedHoursBelow += 1 / 36000.0;
+            }
+            if (!demand)
+            {
+                demandSince = 0;
+                collisionCounted = false;
+            }
+            else if (demandSince == 0)
+                demandSince = hal::rtcEpoch();
+            else if (!collisionCounted && hal::rtcEpoch() - demandSince > DEMAND_GRACE)
+            {
+                result.collisions++; // below threshold, automation allowed, pump held off
+                collisionCounted = true;
+            }
+
+            if (hal::nowMs() < tickEnd)
+                hal::advance((uint32_t)(tickEnd - hal::nowMs()));
+        }
+
+        const nursery::Stats &stats = nursery::stats();
+        result.starts = stats.pumpCycles;
+        result.pumpMinutes = stats.pumpOnMs / 60000.0;
+        result.liters = result.pumpMinutes * flow;
+        result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        return result;
+    }
+}
+
+int runBench(int argc, char **argv)
+{
+    double days = -1;
+    uint32_t start = 0;
+    uint32_t sampleSeconds = 60;
+    float flow = 2;
+    const char *replay = nullptr;
+    std::string fsRoot = "sim_fs/bench";
+    std::vector<int> modes = {0, 1, 2, 3};
+    http::Params settings;
+    nursery::Config bed;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--days"))
+            days = atof(value);
+        else if (!strcmp(opt, "--sample"))
+            sampleSeconds = max(1, atoi(value));
+        else if (!strcmp(opt, "--flow"))
+            flow = atof(value);
+        else if (!strcmp(opt, "--replay"))
+            replay = value;
+        else if (!strcmp(opt, "--moisture"))
+            bed.initialMoisture = atof(value);
+        else if (!strcmp(opt, "--seed"))
+            bed.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(opt, "--valves"))
+        {
+            if (!nursery::parseValvePins(value, bed))
+                usage();
+        }
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else if (!strcmp(opt, "--start"))
+        {
+            int y, mo, d, h = 0, mi = 0, s = 0;
+            if (sscanf(value, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &s) < 3)
+                usage();
+            start = DateTime(y, mo, d, h, mi, s).unixtime();
+        }
+        else if (!strcmp(opt, "--modes"))
+        {
+            modes.clear();
+            for (const char *p = value; *p; p++)
+                if (*p >= '0' && *p <= '3')
+                    modes.push_back(*p - '0');
+            if (modes.empty())
+                usage();
+        }
+        else if (!strcmp(opt, "--set"))
+        {
+            const char *eq = strchr(value, '=');
+            if (!eq)
+                usage();
+            settings.push_back({String(std::string(value, eq - value)), String(eq + 1)});
+        }
+        else
+            usage();
+    }
+
+    std::vector<WeatherRow> weather;
+    if (replay)
+    {
+        if (!loadReplay(replay, weather))
+        {
+            fprintf(stderr, "bench: no usable rows in %s\n", replay);
+            return 1;
+        }
+        if (start == 0)
+            start = weather.front().epoch;
+        if (days < 0)
+            days = (weather.back().epoch - weather.front().epoch) / 86400.0;
+    }
+    if (start == 0)
+        start = DateTime(2025, 1, 1, 0, 0, 0).unixtime();
+    if (days < 0)
+        days = 28;
+    uint64_t seconds = (uint64_t)(days * 86400);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir(fsRoot.c_str(), 0755);
+
+    // One child per mode: each starts from a fresh firmware state and they run in parallel
+    std::vector<std::pair<pid_t, int>> children;
+    for (int mode : modes)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            return 1;
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            hal::setFsRoot(fsRoot + "/mode" + std::to_string(mode));
+            nursery::configure(bed);
+            Result result = runMode(mode, start, seconds, sampleSeconds, flow, settings, weather);
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            std::_Exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+        }
+        close(fds[1]);
+        children.push_back({pid, fds[0]});
+    }
+
+    printf("%.1f days from %s, soil sampled every %lus%s%s\n\n", days, DateTime(start).timestamp().c_str(),
+           (unsigned long)sampleSeconds, replay ? ", weather from " : "", replay ? replay : "");
+    printf("%-9s %7s %9s %9s %11s %9s %10s %10s %9s %7s\n",
+           "mode", "starts", "pump min", "water L", "below thr h", "bed h", "out band h", "collisions", "soil %", "wall s");
+    int status = 0;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        Result result;
+        bool ok = read(children[i].second, &result, sizeof(result)) == (ssize_t)sizeof(result);
+        close(children[i].second);
+        int exitStatus;
+        waitpid(children[i].first, &exitStatus, 0);
+        if (!ok)
+        {
+            printf("%-9s failed\n", modeNames[modes[i]]);
+            status = 1;
+            continue;
+        }
+        char range[16];
+        snprintf(range, sizeof(range), "%d-%d", result.minSoil, result.maxSoil);
+        printf("%-9s %7lu %9.1f %9.1f %11.1f %9.1f %10.1f %10lu %9s %7.2f\n", modeNames[modes[i]],
+               (unsigned long)result.starts, result.pumpMinutes, result.liters, result.hoursBelow,
+               result.bedHoursBelow, result.hoursOutOfBand, (unsigned long)result.collisions, range, result.wallSeconds);
+    }
+    printf("\nbelow thr h: average of all probes; bed h: hours per bed below threshold, mean of 10 beds\n");
+    printf("out band h: average of all probes outside threshold .. threshold + moistureBand\n");
+    printf("collisions: below threshold with moisture automation on, pump held off > %lus (cooldown)\n",
+           (unsigned long)DEMAND_GRACE);
+    return status;
+}
@@ -0,0 +1,260 @@
+// `program config`: checks /config and /settings against the field table.
+//   - /config is what ArduinoJson would print: parsed and serialized again it
+//     gives the same bytes, and the keys of the old JsonDocument handler come
+//     in the same order
+//   - --rounds random POST /settings, each with values in range, out of range
+//     (ignored) and, for the intervals, below the minimum (clamped), must
+//     change /config exactly as the table says
+//   - after a reboot, config.json loads back to the same /config
+//   - heap allocations per GET /config, next to /status and /data/info
+// Exits 1 on the first mismatch.
+//
+//   program config
+//   program config --rounds 5000 --seed 7
+//
+// Options:
+//   --rounds N      random /settings posts (default 500)
+//   --seed N        value seed (default 1)
+//   --fs DIR        LittleFS root (default sim_fs/config)
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+
+namespace
+{
+    struct Options
+    {
+        int rounds = 500;
+        unsigned seed = 1;
+    } options;
+
+    // A /settings argument as the field table defines it, written down again
+    // here so the test does not read the table it checks
+    struct Setting
+    {
+        const char *arg;  // suffix after zoneN / slotN for list entries
+        const char *list; // nullptr = top level
+        int count;        // entries in the list
+        const char *key;
+        long min;
+        long max;
+        long scale;
+        bool clamp;
+    };
+
+    const Setting settings[] = {
+        {"threshold", nullptr, 0, "threshold", 0, 50, 1, false},
+        {"wateringMode", nullptr, 0, "wateringMode", 0, 3, 1, false},
+        {"dry", nullptr, 0, "dry", 0, 4095, 1, false},
+        {"wet", nullptr, 0, "wet", 0, 4095, 1, false},
+        {"pumpDuration", nullptr, 0, "pumpDuration", 1000, 600000, 1, false},
+        {"measurementInterval", nullptr, 0, "measurementInterval", 1000, 3600000, 1000, true},
+        {"dataLogInterval", nullptr, 0, "dataLogInterval", 1000, 86400000, 1000, true},
+        {"storageBudgetKB", nullptr, 0, "storageBudgetKB", 64, 4096, 1, false},
+        {"retentionDays", nullptr, 0, "retentionDays", 1, 3650, 1, false},
+        {"moistureBand", nullptr, 0, "moistureBand", 1, 50, 1, false},
+        {"Threshold", "zone", 4, "threshold", 0, 50, 1, false},
+        {"Duration", "zone", 4, "duration", 0, 600000, 1000, false},
+        {"Cooldown", "zone", 4, "cooldown", 0, 3600000, 1000, false},
+        {"Debounce", "zone", 4, "debounce", 0, 60, 1, false},
+        {"Duration", "slot", 8, "duration", 0, 600000, 1000, false},
+        {"Days", "slot", 8, "days", 0, 127, 1, false},
+    };
+
+    // Top-level keys in the order the JsonDocument handler added them
+    const char *const legacyOrder[] = {"threshold", "wateringMode", "dry", "wet", "pumpDuration",
+                                       "measurementInterval", "dataLogInterval", "storageBudgetKB",
+                                       "retentionDays", "moistureBand", "zones", "schedule", "valvePinChoices"};
+
+    std::mt19937 rng;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program config [--rounds N] [--seed N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "config: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    long pick(long lo, long hi)
+    {
+        return std::uniform_int_distribution<long>(lo, hi)(rng);
+    }
+
+    std::string getConfig()
+    {
+        std::string body;
+        int code = http::request("GET", "/config", http::Params(), http::Params(), &body);
+        check(code == 200, "GET /config status");
+        return body;
+    }
+
+    void checkFormat(const std::string &body)
+    {
+        JsonDocument doc;
+        check(!deserializeJson(doc, body.c_str(), body.size()), "/config is not JSON", body);
+        String out;
+        serializeJson(doc, out);
+        std::string again = out.c_str();
+        check(again == body, "/config differs from ArduinoJson output", body + "\n" + again);
+
+        size_t at = 0;
+        for (const char *key : legacyOrder)
+        {
+            std::string quoted = std::string("\"") + key + "\":";
+            size_t found = body.find(quoted, at);
+            check(found != std::string::npos, "key missing or out of order", key);
+            at = found;
+        }
+    }
+
+    // One POST /settings with a few random arguments; `model` follows what the table promises
+    void randomSettings(JsonDocument &model)
+    {
+        http::Params args;
+        int count = pick(1, 4);
+        for (int i = 0; i < count; i++)
+        {
+            const Setting &s = settings[pick(0, sizeof(settings) / sizeof(settings[0]) - 1)];
+            int index = s.list ? pick(0, s.count - 1) : 0;
+            String name = s.list ? String(s.list) + String(index + 1) + s.arg : String(s.arg);
+            bool repeated = false;
+            for (const auto &arg : args)
+                repeated |= arg.first == name;
+            if (repeated)
+                continue;
+
+            long lo = (s.min + s.scale - 1) / s.scale, hi = s.max / s.scale;
+            long span = (hi - lo) / 4 + 2;
+            long raw = pick(lo - span, hi + span);
+            args.push_back({name, String(raw)});
+
+            JsonVariant target = s.list ? model[strcmp(s.list, "zone") ? "schedule" : "zones"][index][s.key]
+                                        : model[s.key];
+            if (raw >= lo && raw <= hi)
+                target.set(raw * s.scale);
+            else if (s.clamp)
+                target.set((raw < lo ? lo : hi) * s.scale);
+        }
+
+        std::string reply;
+        int code = http::request("POST", "/settings", args, http::Params(), &reply);
+        check(code == 200, "POST /settings", reply);
+    }
+
+    // config.json as the next boot reads it; the child process is the reboot
+    void checkReboot(const std::string &fsRoot, const std::string &expected)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            hal::setFsRoot(fsRoot);
+            setup();
+            std::string body;
+            http::request("GET", "/config", http::Params(), http::Params(), &body);
+            if (body != expected)
+                fprintf(stderr, "after reboot:\n%s\n", body.c_str());
+            fflush(stderr);
+            std::_Exit(body == expected ? 0 : 1);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "config.json did not load back to the same /config");
+    }
+
+    void printHeap(const char *uri)
+    {
+        const int calls = 20;
+        uint64_t allocations = 0, bytes = 0;
+        for (int i = 0; i < calls; i++)
+        {
+            std::string body;
+            http::request("GET", uri, http::Params(), http::Params(), &body);
+            allocations += http::lastServerHeap().allocations;
+            bytes += http::lastServerHeap().bytes;
+        }
+        printf("  %-10s %6.1f allocations %8.0f bytes per call\n", uri, allocations / (double)calls,
+               bytes / (double)calls);
+    }
+}
+
+int runConfig(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/config";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--rounds"))
+            options.rounds = atoi(value);
+        else if (!strcmp(opt, "--seed"))
+            options.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.rounds <= 0)
+        usage();
+    rng.seed(options.seed);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    setup();
+
+    std::string body = getConfig();
+    checkFormat(body);
+    JsonDocument model;
+    deserializeJson(model, body.c_str(), body.size());
+
+    for (int round = 0; round < options.rounds; round++)
+    {
+        randomSettings(model);
+        body = getConfig();
+        String expected;
+        serializeJson(model, expected);
+        check(body == expected.c_str(), "/config after /settings", std::string(expected.c_str()) + "\n" + body);
+        if (round % 50 == 0)
+            checkFormat(body);
+    }
+    checkReboot(fsRoot, body);
+
+    printf("config: %d checks passed (%d /settings rounds)\n", checks, options.rounds);
+    printf("firmware heap per request:\n");
+    printHeap("/config");
+    printHeap("/status");
+    printHeap("/data/info");
+    fflush(stdout);
+    return 0;
+}
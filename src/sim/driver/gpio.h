@@ -0,0 +1,34 @@
+// ESP-IDF GPIO calls for the native build, on top of hal::digitalWrite().
+// gpio_set_level() also tells the simulated DHT22 (driver/rmt.h) about a
+// start signal.
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef ESP_OK
+typedef int esp_err_t;
+#define ESP_OK 0
+#endif
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+    GPIO_MODE_OUTPUT_OD = 6,
+    GPIO_MODE_INPUT_OUTPUT_OD = 7,
+    GPIO_MODE_INPUT_OUTPUT = 3
+} gpio_mode_t;
+
+typedef enum
+{
+    GPIO_PULLUP_ONLY,
+    GPIO_PULLDOWN_ONLY,
+    GPIO_PULLUP_PULLDOWN,
+    GPIO_FLOATING
+} gpio_pull_mode_t;
+
+inline esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+inline esp_err_t gpio_set_pull_mode(gpio_num_t, gpio_pull_mode_t) { return ESP_OK; }
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level);
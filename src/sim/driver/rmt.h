@@ -0,0 +1,71 @@
+// Legacy RMT receive driver (ESP-IDF 4.x) for the native build, with a DHT22
+// on the other end of the wire: rmt_rx_start() on a pin that was just pulled
+// low answers with a frame encoded from hal::temperature()/hal::humidity(),
+// the way the sensor's pulses would come out of the RMT (1 us ticks). As on
+// the real sensor, a start signal less than 2 s after the previous reply gets
+// no answer.
+#pragma once
+
+#include <Arduino.h>
+
+#include "gpio.h"
+
+typedef int rmt_channel_t;
+#define RMT_CHANNEL_0 0
+#define RMT_CHANNEL_1 1
+#define RMT_CHANNEL_2 2
+#define RMT_CHANNEL_3 3
+#define RMT_CHANNEL_MAX 8
+
+typedef enum
+{
+    RMT_MODE_TX,
+    RMT_MODE_RX
+} rmt_mode_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t duration0 : 15;
+            uint32_t level0 : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1 : 1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+typedef struct
+{
+    uint16_t idle_threshold;
+    uint8_t filter_ticks_thresh;
+    bool filter_en;
+} rmt_rx_config_t;
+
+typedef struct
+{
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    uint32_t flags;
+    rmt_rx_config_t rx_config;
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_RX(gpio, channel_id) \
+    {RMT_MODE_RX, (channel_id), (gpio), 80, 1, 0, {12000, 100, true}}
+
+// freertos/ringbuf.h, which the real rmt.h pulls in
+typedef struct RmtRing *RingbufHandle_t;
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *item_size, TickType_t ticks_to_wait);
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item);
+
+esp_err_t rmt_config(const rmt_config_t *config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *ring);
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool rx_idx_rst);
+esp_err_t rmt_rx_stop(rmt_channel_t channel);
@@ -0,0 +1,26 @@
+// esp_timer for the native build. A one-shot timer fires at once: the only
+// user is the DHT22 start signal (~1 ms), far below the simulated tick.
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ESP_OK
+typedef int esp_err_t;
+#define ESP_OK 0
+#endif
+
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef struct esp_timer *esp_timer_handle_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    int dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
@@ -0,0 +1,258 @@
+// `program events`: checks /events as served by HttpServer.
+//   - a new stream gets status, then every line of the log ring in order,
+//     then data info, and the backlog takes several handleClient() rounds
+//     of at most one slice (HTTP_SLICE_SIZE bytes of body) each
+//   - a line logged later arrives on the open stream
+//   - SSE_MAX_CLIENTS streams are served at once, the next one gets 503,
+//     /status still answers meanwhile, and a closed stream frees its slot
+//     right away
+// Exits 1 on the first mismatch.
+//
+//   program events
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "HttpServer.h"
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+void serialPrintln(const char *message);
+extern HttpServer server;
+
+namespace
+{
+    const int streamMax = 4; // SSE_MAX_CLIENTS
+    const int ringSize = 100; // SERIAL_BUFFER_SIZE
+
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program events\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "events: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    struct Event
+    {
+        std::string name;
+        std::string data;
+    };
+
+    // One /events connection, read without blocking
+    struct EventStream
+    {
+        int fd = -1;
+        std::string raw;  // bytes received, headers and chunk framing included
+        int code = 0;
+        size_t parsed = 0; // raw[parsed..] is not taken apart yet
+        std::string body;  // de-chunked
+        size_t bodyRead = 0;
+        size_t lastRound = 0; // body bytes that came in the last receive()
+
+        void open()
+        {
+            fd = hal::connect(80);
+            const char request[] = "GET /events HTTP/1.1\r\nHost: sim\r\nAccept: text/event-stream\r\n\r\n";
+            check(fd >= 0 && ::send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) == (ssize_t)sizeof(request) - 1,
+                  "connect");
+        }
+
+        void close()
+        {
+            ::close(fd);
+            fd = -1;
+        }
+
+        void receive()
+        {
+            char buffer[4096];
+            ssize_t got;
+            while ((got = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+                raw.append(buffer, got);
+
+            size_t before = body.size();
+            if (parsed == 0)
+            {
+                size_t end = raw.find("\r\n\r\n");
+                if (end == std::string::npos)
+                    return;
+                sscanf(raw.c_str(), "HTTP/1.%*d %d", &code);
+                parsed = end + 4;
+            }
+            for (;;)
+            {
+                size_t lineEnd = raw.find("\r\n", parsed);
+                if (lineEnd == std::string::npos)
+                    break;
+                size_t length = strtoul(raw.c_str() + parsed, nullptr, 16);
+                if (raw.size() < lineEnd + 2 + length + 2)
+                    break;
+                body.append(raw, lineEnd + 2, length);
+                parsed = lineEnd + 2 + length + 2;
+            }
+            lastRound = body.size() - before;
+        }
+
+        // Complete events received so far and not returned before
+        std::vector<Event> events()
+        {
+            std::vector<Event> out;
+            size_t end;
+            while ((end = body.find("\n\n", bodyRead)) != std::string::npos)
+            {
+                Event event;
+                size_t line = bodyRead;
+                while (line < end)
+                {
+                    size_t lineEnd = body.find('\n', line);
+                    if (lineEnd > end)
+                        lineEnd = end;
+                    std::string text = body.substr(line, lineEnd - line);
+                    if (text.compare(0, 7, "event: ") == 0)
+                        event.name = text.substr(7);
+                    else if (text.compare(0, 6, "data: ") == 0)
+                        event.data = text.substr(6);
+                    else if (text.compare(0, 7, "retry: ") == 0)
+                        event.name = "retry";
+                    line = lineEnd + 1;
+                }
+                out.push_back(event);
+                bodyRead = end + 2;
+            }
+            return out;
+        }
+    };
+
+    void rounds(std::vector<EventStream *> streams, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            server.handleClient();
+            for (EventStream *stream : streams)
+                stream->receive();
+        }
+    }
+
+    long seqOf(const Event &event)
+    {
+        JsonDocument doc;
+        deserializeJson(doc, event.data.c_str(), event.data.size());
+        return doc["seq"] | -1L;
+    }
+}
+
+int runEvents(int argc, char **)
+{
+    if (argc > 1)
+        usage();
+    hal::setConsoleQuiet(true);
+    setup();
+
+    // Fill the log ring past its size
+    for (int i = 1; i <= ringSize + 20; i++)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "events backlog line %d of %d", i, ringSize + 20);
+        serialPrintln(line);
+    }
+
+    // ---------- Backlog: one slice per round ----------
+    EventStream first;
+    first.open();
+    size_t largest = 0;
+    int roundsWithData = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        rounds({&first}, 1);
+        largest = std::max(largest, first.lastRound);
+        roundsWithData += first.lastRound > 0;
+    }
+    check(first.code == 200, "GET /events status", first.raw.substr(0, 200));
+    check(first.raw.find("Content-Type: text/event-stream") != std::string::npos, "event-stream content type");
+    check(largest <= HTTP_SLICE_SIZE, "more than one slice in a round", std::to_string(largest) + " bytes");
+
+    std::vector<Event> events = first.events();
+    check(events.size() == (size_t)ringSize + 3, "backlog event count", std::to_string(events.size()));
+    check(events[0].name == "retry" && events[1].name == "status", "stream starts with retry and status");
+    long seq = 0;
+    for (int i = 0; i < ringSize; i++)
+    {
+        const Event &event = events[2 + i];
+        long next = seqOf(event);
+        check(event.name == "log" && (i == 0 || next == seq + 1), "log lines in order", event.data);
+        seq = next;
+    }
+    check(events[2 + ringSize - 1].data.find("events backlog line 120 of 120") != std::string::npos,
+          "backlog ends with the newest line", events[2 + ringSize - 1].data);
+    check(events.back().name == "datainfo", "datainfo after the log lines");
+    printf("backlog: %zu events, %zu body bytes in %d rounds, largest round %zu bytes (slice %d)\n", events.size(),
+           first.body.size(), roundsWithData, largest, HTTP_SLICE_SIZE);
+
+    // ---------- Live line ----------
+    serialPrintln("events live line");
+    rounds({&first}, 3);
+    events = first.events();
+    bool live = false;
+    for (const Event &event : events)
+        live |= event.name == "log" && event.data.find("events live line") != std::string::npos &&
+                seqOf(event) == seq + 1;
+    check(live, "live line not pushed");
+    printf("live: a new log line arrives on the open stream\n");
+
+    // ---------- EventStream limit and freed slots ----------
+    std::vector<EventStream> more(streamMax);
+    std::vector<EventStream *> open = {&first};
+    for (int i = 0; i < streamMax - 1; i++)
+    {
+        more[i].open();
+        open.push_back(&more[i]);
+    }
+    rounds(open, 20);
+    for (EventStream *stream : open)
+        check(stream->code == 200, "stream within the limit refused");
+
+    EventStream extra;
+    extra.open();
+    open.push_back(&extra);
+    rounds(open, 20);
+    check(extra.code == 503, "stream over the limit not refused", std::to_string(extra.code));
+    extra.close();
+    open.pop_back();
+
+    std::string status;
+    check(http::request("GET", "/status", http::Params(), http::Params(), &status) == 200,
+          "/status with every stream open");
+
+    first.close();
+    open.erase(open.begin());
+    EventStream again;
+    again.open();
+    open.push_back(&again);
+    rounds(open, 20);
+    check(again.code == 200, "closed stream did not free its slot", std::to_string(again.code));
+    printf("limit: %d streams served, the next one 503, /status answered, closed slot reused\n", streamMax);
+
+    printf("events: %d checks passed\n", checks);
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,315 @@
+// `program filters`: feeds a noisy ADC signal through the firmware's soil
+// filters (serviceSoilSampler() and filterSoilSample() in main.cpp) with
+// several settings and reports the noise each one removes against how late
+// it follows a step.
+//
+// Soil channel 1 sees --from for a while, then a step to --to, plus noise.
+// The noise is synthetic (Gaussian with occasional spikes, like the ESP32
+// ADC) or comes from a recorded trace: its samples minus their median are
+// replayed in order on top of the known levels, so the step can still be timed.
+//
+//   program filters
+//   program filters --trace adc.txt --set filter1Mode=1 --set filter1Window=7
+//
+// Options:
+//   --trace FILE    recorded raw ADC samples of one probe, one number per line
+//   --noise SD      synthetic Gaussian noise in ADC counts (default 25)
+//   --spikes P      chance per analogRead of a +-1000 count spike, in % (default 1)
+//   --from RAW      level before the step (default 2400)
+//   --to RAW        level after the step (default 1700)
+//   --seed N        noise seed (default 1)
+//   --set KEY=VAL   adds a "custom" row: POST /settings filter1... arguments, repeatable
+//   --fs DIR        LittleFS root (default sim_fs/filters)
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+#include "nursery.h"
+
+// From main.cpp
+bool setupLittleFS();
+bool loadConfig();
+void createDefaultConfig();
+void setupWebServer();
+bool serviceSoilSampler();
+uint16_t readSoilFiltered(int channel);
+
+namespace
+{
+    const uint32_t WARMUP_MS = 30000; // long enough for the slowest EMA to forget the previous row
+    const uint32_t STEADY_MS = 60000;
+    const uint32_t STEP_MS = 20000;
+
+    struct Preset
+    {
+        const char *name;
+        int mode, window, emaShift, oversample;
+    };
+
+    const Preset presets[] = {
+        {"single sample", 0, 1, 0, 1},
+        {"mean 10 (old boxcar)", 0, 10, 0, 1},
+        {"median 5", 1, 5, 0, 1},
+        {"ema 1/8", 0, 1, 3, 1},
+        {"x16 oversample", 0, 1, 0, 16},
+        {"median 5, ema 1/4, x4", 1, 5, 2, 4}, // SoilFilterConfig defaults
+    };
+
+    struct Source
+    {
+        uint8_t pin = nursery::Config().soilPins[0];
+        int level = 0;
+        double noiseSd = 25;
+        double spikePercent = 1;
+        std::vector<int> trace; // recorded noise, median removed
+        size_t next = 0;
+        uint32_t rng = 1;
+
+        // analogReads of channel 1 while `measuring`
+        bool measuring = false;
+        uint64_t reads = 0;
+        double sumSquares = 0;
+    } source;
+
+    struct Result
+    {
+        double readsPerSecond = 0;
+        double rawRms = 0;
+        double rms = 0;
+        int maxError = 0;
+        long stepMs = -1; // -1 = never within 10% of the new level
+    };
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr,
+                "usage: program filters [--trace FILE] [--noise SD] [--spikes P] [--from RAW] [--to RAW]\n"
+                "                       [--seed N] [--set KEY=VAL]... [--fs DIR]\n");
+        exit(2);
+    }
+
+    double uniform()
+    {
+        source.rng ^= source.rng << 13;
+        source.rng ^= source.rng >> 17;
+        source.rng ^= source.rng << 5;
+        return (source.rng + 0.5) / 4294967296.0;
+    }
+
+    int noise()
+    {
+        if (!source.trace.empty())
+        {
+            int value = source.trace[source.next];
+            source.next = (source.next + 1) % source.trace.size();
+            return value;
+        }
+        double gaussian = std::sqrt(-2 * std::log(uniform())) * std::cos(2 * M_PI * uniform());
+        int value = (int)std::lround(gaussian * source.noiseSd);
+        if (uniform() * 100 < source.spikePercent)
+            value += uniform() < 0.5 ? -1000 : 1000;
+        return value;
+    }
+
+    uint16_t analogSource(uint8_t pin)
+    {
+        if (pin != source.pin)
+            return 2000; // other channels: a quiet mid-range probe
+        int raw = std::min(4095, std::max(0, source.level + noise()));
+        if (source.measuring)
+        {
+            source.reads++;
+            source.sumSquares += (double)(raw - source.level) * (raw - source.level);
+        }
+        return (uint16_t)raw;
+    }
+
+    bool loadTrace(const char *path)
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+            return false;
+        char line[64];
+        while (fgets(line, sizeof(line), file))
+        {
+            char *end;
+            long value = strtol(line, &end, 10);
+            if (end != line && value >= 0 && value <= 4095)
+                source.trace.push_back((int)value);
+        }
+        fclose(file);
+        if (source.trace.size() < 2)
+            return false;
+
+        std::vector<int> sorted = source.trace;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        int median = sorted[sorted.size() / 2];
+        for (int &value : source.trace)
+            value -= median;
+        return true;
+    }
+
+    // Runs the sampler until `ms` have passed, calling `sample` with each new filter output
+    template <class F>
+    void run(uint32_t ms, F sample)
+    {
+        uint64_t end = hal::nowMs() + ms;
+        while (hal::nowMs() < end)
+        {
+            if (serviceSoilSampler())
+                sample(readSoilFiltered(0));
+            hal::advance(10);
+        }
+    }
+
+    Result measure(int from, int to)
+    {
+        Result result;
+
+        source.level = from;
+        run(WARMUP_MS, [](uint16_t) {});
+
+        source.measuring = true;
+        source.reads = 0;
+        source.sumSquares = 0;
+        double sumSquares = 0;
+        long outputs = 0;
+        run(STEADY_MS, [&](uint16_t value)
+            {
+                int error = value - from;
+                sumSquares += (double)error * error;
+                outputs++;
+                result.maxError = std::max(result.maxError, abs(error));
+            });
+        source.measuring = false;
+        result.readsPerSecond = source.reads * 1000.0 / STEADY_MS;
+        result.rawRms = source.reads ? std::sqrt(source.sumSquares / source.reads) : 0;
+        result.rms = outputs ? std::sqrt(sumSquares / outputs) : 0;
+
+        source.level = to;
+        uint64_t stepAt = hal::nowMs();
+        int tolerance = std::max(1, abs(to - from) / 10);
+        run(STEP_MS, [&](uint16_t value)
+            {
+                if (result.stepMs < 0 && abs(value - to) <= tolerance)
+                    result.stepMs = (long)(hal::nowMs() - stepAt);
+            });
+        return result;
+    }
+
+    void apply(const http::Params &args)
+    {
+        std::string body;
+        if (http::request("POST", "/settings", args, http::Params(), &body) != 200)
+            fprintf(stderr, "filters: /settings rejected the arguments: %s\n", body.c_str());
+    }
+
+    void printRow(const char *name, const Result &result)
+    {
+        char step[24];
+        if (result.stepMs < 0)
+            snprintf(step, sizeof(step), "> %lu", (unsigned long)STEP_MS);
+        else
+            snprintf(step, sizeof(step), "%ld", result.stepMs);
+        printf("%-24s %8.0f %10.1f %10.1f %10.1fx %8d %12s\n", name, result.readsPerSecond, result.rawRms,
+               result.rms, result.rms > 0 ? result.rawRms / result.rms : 0.0, result.maxError, step);
+    }
+}
+
+int runFilters(int argc, char **argv)
+{
+    int from = 2400, to = 1700;
+    const char *trace = nullptr;
+    std::string fsRoot = "sim_fs/filters";
+    http::Params custom;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--trace"))
+            trace = value;
+        else if (!strcmp(opt, "--noise"))
+            source.noiseSd = atof(value);
+        else if (!strcmp(opt, "--spikes"))
+            source.spikePercent = atof(value);
+        else if (!strcmp(opt, "--from"))
+            from = atoi(value);
+        else if (!strcmp(opt, "--to"))
+            to = atoi(value);
+        else if (!strcmp(opt, "--seed"))
+            source.rng = std::max(1UL, strtoul(value, nullptr, 10));
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else if (!strcmp(opt, "--set"))
+        {
+            const char *eq = strchr(value, '=');
+            if (!eq)
+                usage();
+            custom.push_back({String(std::string(value, eq - value)), String(eq + 1)});
+        }
+        else
+            usage();
+    }
+    if (trace && !loadTrace(trace))
+    {
+        fprintf(stderr, "filters: no usable samples in %s\n", trace);
+        return 1;
+    }
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    setupLittleFS();
+    if (!loadConfig())
+    {
+        createDefaultConfig();
+        loadConfig();
+    }
+    setupWebServer();
+    hal::setAnalogSource(analogSource);
+
+    if (trace)
+        printf("step %d -> %d, noise from %s (%zu samples)\n\n", from, to, trace, source.trace.size());
+    else
+        printf("step %d -> %d, Gaussian noise sd %.0f, %.1f%% spikes of +-1000\n\n", from, to,
+               source.noiseSd, source.spikePercent);
+    printf("%-24s %8s %10s %10s %11s %8s %12s\n",
+           "filter", "reads/s", "raw rms", "out rms", "reduction", "max err", "90% step ms");
+
+    for (const Preset &preset : presets)
+    {
+        apply({{"filter1Mode", String(preset.mode)},
+               {"filter1Window", String(preset.window)},
+               {"filter1Ema", String(preset.emaShift)},
+               {"filter1Oversample", String(preset.oversample)}});
+        printRow(preset.name, measure(from, to));
+    }
+    if (!custom.empty())
+    {
+        apply(custom);
+        printRow("custom (--set)", measure(from, to));
+    }
+
+    printf("\nraw rms / out rms: error of single analogReads / of the filter output against the true level\n");
+    printf("max err: worst output error in %lus of steady signal (spikes that got through)\n",
+           (unsigned long)(STEADY_MS / 1000));
+    printf("90%% step ms: time until the output is within 10%% of the step from the new level\n");
+    hal::setAnalogSource(nullptr);
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include "hal.h"
+#include "nursery.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace hal
+{
+    thread_local HeapStats threadHeap = {0, 0}; // plain data: no TLS constructor on the malloc path
+
+    namespace
+    {
+        const size_t TASK_STACK_SIZE = 256 * 1024; // host code (printf, libstdc++) needs more than the ESP32 task
+
+        struct Task
+        {
+            ucontext_t context;
+            std::vector<char> stack;
+            void (*entry)(void *);
+            void *param;
+            uint64_t wakeAt = 0;
+            bool finished = false;
+        };
+
+        struct Listener
+        {
+            int fd = -1; // host socket, -1 if not listening on the host
+            uint16_t hostPort = 0;
+            std::deque<int> pending; // server ends from connect()
+        };
+
+        const int TCP_SEND_BUFFER = 5744; // lwIP TCP_SND_BUF on the ESP32, instead of the host's megabytes
+
+        bool hostNetwork = false;
+        std::map<uint16_t, Listener> listeners;
+
+        uint64_t clockMs = 0;
+        ucontext_t mainContext;
+        std::vector<Task *> tasks;
+        Task *currentTask = nullptr;
+
+        uint8_t pinLevels[64];
+        uint16_t (*analogSource)(uint8_t pin) = nullptr;
+        int64_t rtcOffset = 1735711200; // 2025-01-01 06:00:00 at millis() == 0
+        std::string fsRoot = "sim_fs";
+        std::string powerCutPath;
+        long powerCutLeft = -1; // bytes to powerCutPath until the cut, -1 = none
+        FsStats fsCounters = {0, 0};
+        bool quiet = false;
+
+        void runTask()
+        {
+            currentTask->entry(currentTask->param);
+            currentTask->finished = true; // uc_link returns to resume()
+        }
+
+        void resume(Task *task)
+        {
+            currentTask = task;
+            swapcontext(&mainContext, &task->context);
+            currentTask = nullptr;
+
+            if (task->finished)
+            {
+                tasks.erase(std::find(tasks.begin(), tasks.end(), task));
+                delete task;
+            }
+        }
+
+        struct PinInit
+        {
+            // Relays are active low: start released, like the pull-ups on the board
+            PinInit() { memset(pinLevels, 1, sizeof(pinLevels)); }
+        } pinInit;
+    }
+
+    uint64_t nowMs()
+    {
+        return clockMs;
+    }
+
+    // Steps the clock from one task wake-up to the next on the way to the
+    // target, so a task sees the same millis() it would on the device.
+    void advance(uint32_t ms)
+    {
+        uint64_t target = clockMs + ms;
+        for (;;)
+        {
+            std::vector<Task *> due;
+            for (Task *task : tasks)
+                if (task->wakeAt <= clockMs)
+                    due.push_back(task);
+            for (Task *task : due)
+                resume(task);
+
+            if (clockMs >= target)
+                break;
+
+            uint64_t next = target;
+            for (Task *task : tasks)
+                next = std::min(next, task->wakeAt);
+
+            nursery::step((uint32_t)(next - clockMs), (uint32_t)(rtcOffset + (int64_t)(next / 1000)));
+            clockMs = next;
+        }
+    }
+
+    void sleep(uint32_t ms)
+    {
+        if (!currentTask)
+        {
+            advance(ms);
+            return;
+        }
+
+        Task *self = currentTask;
+        self->wakeAt = clockMs + std::max<uint32_t>(ms, 1);
+        swapcontext(&self->context, &mainContext);
+    }
+
+    void startTask(void (*entry)(void *), void *param)
+    {
+        Task *task = new Task();
+        task->entry = entry;
+        task->param = param;
+        task->stack.resize(TASK_STACK_SIZE);
+
+        getcontext(&task->context);
+        task->context.uc_stack.ss_sp = task->stack.data();
+        task->context.uc_stack.ss_size = task->stack.size();
+        task->context.uc_link = &mainContext;
+        makecontext(&task->context, runTask, 0);
+
+        tasks.push_back(task);
+        resume(task); // run up to its first delay, like a higher-priority task would
+    }
+
+    void pinMode(uint8_t pin, uint8_t mode)
+    {
+        (void)pin;
+        (void)mode;
+    }
+
+    void digitalWrite(uint8_t pin, uint8_t level)
+    {
+        pinLevels[pin & 63] = level ? 1 : 0;
+    }
+
+    int digitalRead(uint8_t pin)
+    {
+        return pinLevels[pin & 63];
+    }
+
+    uint16_t analogRead(uint8_t pin)
+    {
+        return analogSource ? analogSource(pin) : nursery::soilRaw(pin);
+    }
+
+    void setAnalogSource(uint16_t (*source)(uint8_t pin))
+    {
+        analogSource = source;
+    }
+
+    uint32_t rtcEpoch()
+    {
+        return (uint32_t)(rtcOffset + (int64_t)(clockMs / 1000));
+    }
+
+    void rtcAdjust(uint32_t epoch)
+    {
+        rtcOffset = (int64_t)epoch - (int64_t)(clockMs / 1000);
+    }
+
+    float temperature()
+    {
+        return nursery::temperature();
+    }
+
+    float humidity()
+    {
+        return nursery::humidity();
+    }
+
+    float lux()
+    {
+        return nursery::lux();
+    }
+
+    void setFsRoot(const std::string &dir)
+    {
+        fsRoot = dir;
+    }
+
+    void cutPowerAfter(const std::string &path, long bytes)
+    {
+        powerCutPath = path;
+        powerCutLeft = bytes;
+    }
+
+    size_t bytesBeforePowerCut(const std::string &path, size_t size)
+    {
+        if (powerCutLeft < 0 || path != powerCutPath)
+            return size;
+        size_t landed = std::min(size, (size_t)powerCutLeft);
+        powerCutLeft -= landed;
+        return landed;
+    }
+
+    void checkPowerCut(FILE *handle)
+    {
+        if (powerCutLeft != 0)
+            return;
+        fflush(handle);
+        fflush(stdout);
+        std::_Exit(4);
+    }
+
+    FsStats &fsStats()
+    {
+        return fsCounters;
+    }
+
+    std::string fsPath(const char *path)
+    {
+        if (!path || !*path || (path[0] == '/' && !path[1]))
+            return fsRoot;
+        return fsRoot + (path[0] == '/' ? "" : "/") + path;
+    }
+
+    void listenOnHost(bool enable)
+    {
+        hostNetwork = enable;
+    }
+
+    void serverBegin(uint16_t port)
+    {
+        Listener &listener = listeners[port];
+        if (!hostNetwork || listener.fd >= 0)
+            return;
+
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (fd < 0 || ::bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(fd, 16) != 0 ||
+            ::getsockname(fd, (sockaddr *)&address, &length) != 0)
+        {
+            perror("hal: listen");
+            if (fd >= 0)
+                ::close(fd);
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        listener.fd = fd;
+        listener.hostPort = ntohs(address.sin_port);
+    }
+
+    int serverAccept(uint16_t port)
+    {
+        auto it = listeners.find(port);
+        if (it == listeners.end())
+            return -1;
+        Listener &listener = it->second;
+        if (!listener.pending.empty())
+        {
+            int fd = listener.pending.front();
+            listener.pending.pop_front();
+            return fd;
+        }
+        if (listener.fd < 0)
+            return -1;
+        int fd = ::accept(listener.fd, nullptr, nullptr);
+        if (fd >= 0)
+        {
+            int size = TCP_SEND_BUFFER;
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        }
+        return fd;
+    }
+
+    uint16_t hostPort(uint16_t port)
+    {
+        auto it = listeners.find(port);
+        return it == listeners.end() ? 0 : it->second.hostPort;
+    }
+
+    int connect(uint16_t port)
+    {
+        auto it = listeners.find(port);
+        int ends[2];
+        if (it == listeners.end() || ::socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0)
+            return -1;
+        it->second.pending.push_back(ends[0]);
+        return ends[1];
+    }
+
+    HeapStats heapStats()
+    {
+        return threadHeap;
+    }
+
+    void setConsoleQuiet(bool value)
+    {
+        quiet = value;
+    }
+
+    void consoleWrite(const uint8_t *data, size_t length)
+    {
+        if (!quiet)
+            fwrite(data, 1, length, stdout);
+    }
+
+    void restart()
+    {
+        fflush(stdout);
+        fprintf(stderr, "ESP.restart() at %llu ms\n", (unsigned long long)nowMs());
+        std::_Exit(3);
+    }
+}
+
+// glibc lets the program replace malloc; the originals stay reachable as __libc_*
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+
+    void *malloc(size_t size)
+    {
+        hal::threadHeap.allocations++;
+        hal::threadHeap.bytes += size;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        hal::threadHeap.allocations++;
+        hal::threadHeap.bytes += count * size;
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        hal::threadHeap.allocations++;
+        hal::threadHeap.bytes += size;
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
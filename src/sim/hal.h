@@ -0,0 +1,87 @@
+// Host-side hardware abstraction for the native build.
+//
+// The Arduino-style headers in this directory (Arduino.h, LittleFS.h, RTClib.h,
+// driver/rmt.h, ...) are thin wrappers over the functions below, so src/main.cpp
+// compiles unchanged on Linux. Time is simulated: it only moves when the main
+// loop calls hal::advance() (or delay()), which lets setup()/loop() run many
+// times faster than real time and keeps every run deterministic.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace hal
+{
+    // ---- clock ----
+    uint64_t nowMs();
+    void advance(uint32_t ms); // outside tasks only: move time forward, resuming tasks that wake on the way
+    void sleep(uint32_t ms);   // outside tasks: same as advance(); inside a task: yield until ms have passed
+
+    // ---- tasks ----
+    // FreeRTOS tasks are coroutines on the main thread. advance() resumes each
+    // one at the simulated time its sleep() ends, so nothing runs concurrently
+    // and portMUX sections need no lock.
+    void startTask(void (*task)(void *), void *param);
+
+    // ---- GPIO / ADC ----
+    void pinMode(uint8_t pin, uint8_t mode);
+    void digitalWrite(uint8_t pin, uint8_t level);
+    int digitalRead(uint8_t pin);
+    uint16_t analogRead(uint8_t pin);
+    void setAnalogSource(uint16_t (*source)(uint8_t pin)); // replaces the nursery's probes, nullptr = nursery again
+
+    // ---- RTC (DS3231) ----
+    uint32_t rtcEpoch();
+    void rtcAdjust(uint32_t epoch);
+
+    // ---- environment sensors (DHT22, BH1750) ----
+    float temperature();
+    float humidity();
+    float lux();
+
+    // ---- filesystem (LittleFS) ----
+    void setFsRoot(const std::string &dir);
+    std::string fsPath(const char *path); // LittleFS path -> host path under the root
+    // Power cut in the middle of a write: once `bytes` more bytes have been
+    // written to `path` (a LittleFS path), they are flushed and the process
+    // exits with code 4, as if the board lost power right there. bytes < 0 = off
+    void cutPowerAfter(const std::string &path, long bytes);
+    size_t bytesBeforePowerCut(const std::string &path, size_t size); // File::write: how many of `size` land
+    void checkPowerCut(FILE *handle);                                   // File::write: flush and exit if the cut is due
+    struct FsStats
+    {
+        uint64_t opens;    // LittleFS.open() calls that found a file or directory
+        uint64_t listings; // of them directories, i.e. walks over their entries
+    };
+    FsStats &fsStats(); // counted by LittleFS.open()
+
+    // ---- network (WiFiServer / WiFiClient) ----
+    // Connections are real sockets. A server port is only opened on the host
+    // (127.0.0.1, a free port) after listenOnHost(true); otherwise its clients
+    // come from connect(), which hands one end of a socket pair to the server.
+    void listenOnHost(bool enable);
+    void serverBegin(uint16_t port);
+    int serverAccept(uint16_t port);  // next waiting connection, -1 if none
+    uint16_t hostPort(uint16_t port); // host TCP port of a listening server, 0 if not listening
+    int connect(uint16_t port);       // in-process connection, returns the client's end; -1 if no server
+
+    // ---- heap ----
+    // malloc/calloc/realloc are counted per thread (operator new, String and
+    // ArduinoJson all end up there), so the heap traffic of a handler can be
+    // measured without a client thread's own allocations
+    struct HeapStats
+    {
+        uint64_t allocations;
+        uint64_t bytes; // requested, summed
+    };
+    HeapStats heapStats();
+
+    // ---- console (Serial) ----
+    void setConsoleQuiet(bool quiet);
+    void consoleWrite(const uint8_t *data, size_t length);
+
+    // ---- restart ----
+    [[noreturn]] void restart();
+}
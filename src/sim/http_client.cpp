@@ -0,0 +1,146 @@
+#include "http_client.h"
+
+#include <HttpServer.h>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "hal.h"
+
+// From main.cpp
+extern HttpServer server;
+
+namespace http
+{
+    namespace
+    {
+        const int IDLE_ROUNDS = 100000; // handleClient() calls without a byte before giving up
+        hal::HeapStats serverHeap = {0, 0};
+    }
+
+    hal::HeapStats lastServerHeap()
+    {
+        return serverHeap;
+    }
+
+    bool dechunk(const std::string &in, std::string &out)
+    {
+        out.clear();
+        size_t pos = 0;
+        while (pos < in.size())
+        {
+            char *end;
+            unsigned long size = strtoul(in.c_str() + pos, &end, 16);
+            size_t data = in.find("\r\n", pos);
+            if (end == in.c_str() + pos || data == std::string::npos)
+                return false;
+            data += 2;
+            if (size == 0)
+                return true;
+            if (data + size + 2 > in.size())
+                return false;
+            out.append(in, data, size);
+            pos = data + size + 2;
+        }
+        return false;
+    }
+
+    std::string encode(const String &value)
+    {
+        std::string out;
+        for (const char *p = value.c_str(); *p; p++)
+        {
+            unsigned char c = *p;
+            if (isalnum(c) || strchr("-_.~", c))
+                out += (char)c;
+            else if (c == ' ')
+                out += '+';
+            else
+            {
+                char escape[4];
+                snprintf(escape, sizeof(escape), "%%%02X", c);
+                out += escape;
+            }
+        }
+        return out;
+    }
+
+    int request(const char *method, const String &uri, const Params &args, const Params &headers,
+                std::string *body, std::string *responseHeaders)
+    {
+        std::string form;
+        for (const auto &arg : args)
+            form += (form.empty() ? "" : "&") + encode(arg.first) + "=" + encode(arg.second);
+        bool inQuery = !strcmp(method, "GET") || !strcmp(method, "DELETE");
+
+        std::string text = std::string(method) + " " + uri.c_str();
+        if (inQuery && !form.empty())
+            text += (strchr(uri.c_str(), '?') ? "&" : "?") + form;
+        text += " HTTP/1.1\r\nHost: sim\r\nConnection: close\r\n";
+        for (const auto &header : headers)
+            text += std::string(header.first.c_str()) + ": " + header.second.c_str() + "\r\n";
+        if (!inQuery)
+            text += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                    std::to_string(form.size()) + "\r\n\r\n" + form;
+        else
+            text += "\r\n";
+
+        int fd = hal::connect(80);
+        if (fd < 0)
+            return 0;
+        if (::send(fd, text.data(), text.size(), MSG_NOSIGNAL) != (ssize_t)text.size())
+        {
+            ::close(fd);
+            return 0;
+        }
+
+        // Connection: close, so the reply ends where the stream does
+        std::string reply;
+        char buffer[4096];
+        serverHeap = {0, 0};
+        for (int idle = 0; idle < IDLE_ROUNDS; idle++)
+        {
+            hal::HeapStats before = hal::heapStats();
+            server.handleClient();
+            hal::HeapStats after = hal::heapStats();
+            serverHeap.allocations += after.allocations - before.allocations;
+            serverHeap.bytes += after.bytes - before.bytes;
+            ssize_t got = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (got == 0)
+                break;
+            if (got > 0)
+            {
+                reply.append(buffer, got);
+                idle = 0;
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                break;
+        }
+        ::close(fd);
+
+        size_t split = reply.find("\r\n\r\n");
+        int code = 0;
+        if (split == std::string::npos || sscanf(reply.c_str(), "HTTP/1.%*d %d", &code) != 1)
+            return 0;
+        std::string head = reply.substr(0, split + 2);
+        std::string content = reply.substr(split + 4);
+        if (strcasestr(head.c_str(), "\r\nTransfer-Encoding: chunked\r\n"))
+        {
+            std::string plain;
+            if (!dechunk(content, plain))
+                return 0;
+            content.swap(plain);
+        }
+        if (body)
+            *body = content;
+        if (responseHeaders)
+            *responseHeaders = head;
+        return code;
+    }
+}
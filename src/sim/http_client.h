@@ -0,0 +1,30 @@
+// HTTP client for the native build. Talks to the firmware's HttpServer over
+// an in-process socket pair (hal::connect()), running server.handleClient()
+// until the reply is complete, so bench/filters/main drive /settings and
+// /config through the same request parsing and response code as a browser.
+#pragma once
+
+#include <Arduino.h>
+
+#include "hal.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace http
+{
+    typedef std::vector<std::pair<String, String>> Params;
+
+    // GET/DELETE args go into the query string, others into a form body.
+    // Returns the status code (0 = no reply); `body` gets the decoded body.
+    int request(const char *method, const String &uri, const Params &args = Params(),
+                const Params &headers = Params(), std::string *body = nullptr, std::string *responseHeaders = nullptr);
+
+    // Heap use of the firmware while it served the last request(): only what
+    // ran inside server.handleClient(), not the client's own buffers
+    hal::HeapStats lastServerHeap();
+
+    std::string encode(const String &value); // application/x-www-form-urlencoded
+    bool dechunk(const std::string &in, std::string &out); // undoes Transfer-Encoding: chunked; false if cut short
+}
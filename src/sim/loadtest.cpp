@@ -0,0 +1,352 @@
+// `program loadtest`: serves the firmware over real TCP on 127.0.0.1 and
+// measures how long /status takes while slow clients pull /data/download,
+// the case where the old single-client WebServer made every other request
+// wait for the whole transfer.
+//
+// The data log is filled with --records records first. Then loop() runs on
+// the main thread in real time while client threads connect over TCP:
+//   - one client asks for /status on a keep-alive connection every --interval ms
+//   - --downloads clients each fetch /data/download, reading --rate KB/s
+// /status latency (p50/p99/max) is measured without and then with the
+// downloads in flight, along with the longest single loop() call.
+//
+//   program loadtest
+//   program loadtest --downloads 3 --rate 20
+//
+// Options:
+//   --records N     data log records to create first, one a minute (default 10000)
+//   --downloads N   concurrent slow downloads (default 2)
+//   --rate KB       read rate of each download in KB/s (default 100)
+//   --requests N    /status requests per phase (default 500)
+//   --interval MS   pause between /status requests (default 5)
+//   --fs DIR        LittleFS root (default sim_fs/loadtest)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+void loop();
+void saveDataRecord();
+void setClock(const DateTime &time);
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int CLIENT_RCVBUF = 8192; // a phone's receive window, roughly
+
+    struct Options
+    {
+        int records = 10000;
+        int downloads = 2;
+        double rateKB = 100;
+        int requests = 500;
+        int intervalMs = 5;
+    } options;
+
+    uint16_t port = 0;
+    std::atomic<int> activeDownloads{0};
+
+    struct Download
+    {
+        size_t bytes = 0;
+        size_t rows = 0; // CSV lines after the header
+        double seconds = 0;
+        bool complete = false; // 200 and the whole body (chunked, or Content-Length once indexed)
+    };
+
+    struct Latencies
+    {
+        std::vector<double> ms;
+        int failures = 0;
+        int reconnects = 0;
+    };
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr,
+                "usage: program loadtest [--records N] [--downloads N] [--rate KB] [--requests N]\n"
+                "                        [--interval MS] [--fs DIR]\n");
+        exit(2);
+    }
+
+    int connectServer(int receiveBuffer = 0)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (receiveBuffer > 0)
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (::connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool sendAll(int fd, const std::string &text)
+    {
+        return ::send(fd, text.data(), text.size(), MSG_NOSIGNAL) == (ssize_t)text.size();
+    }
+
+    // One response on a keep-alive connection: headers, then Content-Length bytes
+    bool readResponse(int fd, std::string &pending, int &code)
+    {
+        char buffer[2048];
+        size_t split;
+        while ((split = pending.find("\r\n\r\n")) == std::string::npos)
+        {
+            ssize_t got = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (got <= 0)
+                return false;
+            pending.append(buffer, got);
+        }
+        const char *length = strcasestr(pending.c_str(), "\r\nContent-Length:");
+        size_t size = length && length < pending.c_str() + split ? strtoul(length + 17, nullptr, 10) : 0;
+        if (sscanf(pending.c_str(), "HTTP/1.%*d %d", &code) != 1)
+            return false;
+        while (pending.size() < split + 4 + size)
+        {
+            ssize_t got = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (got <= 0)
+                return false;
+            pending.append(buffer, got);
+        }
+        pending.erase(0, split + 4 + size);
+        return true;
+    }
+
+    // Sends /status requests one after another; while `whileDownloading`,
+    // stops early when no download is left so every sample overlaps one
+    void pollStatus(Latencies &result, bool whileDownloading)
+    {
+        int fd = -1;
+        std::string pending;
+        for (int i = 0; i < options.requests; i++)
+        {
+            if (whileDownloading && activeDownloads == 0)
+                break;
+            if (fd < 0)
+            {
+                fd = connectServer();
+                pending.clear();
+                if (i > 0)
+                    result.reconnects++;
+            }
+
+            auto start = Clock::now();
+            int code = 0;
+            bool ok = fd >= 0 && sendAll(fd, "GET /status HTTP/1.1\r\nHost: loadtest\r\n\r\n") &&
+                      readResponse(fd, pending, code) && code == 200;
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (ok)
+                result.ms.push_back(ms);
+            else
+            {
+                result.failures++;
+                if (fd >= 0)
+                    ::close(fd);
+                fd = -1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.intervalMs));
+        }
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    // Reads /data/download at options.rateKB, like a phone on a weak link
+    void download(Download &result)
+    {
+        auto start = Clock::now();
+        int fd = connectServer(CLIENT_RCVBUF);
+        std::string body;
+        if (fd >= 0 && sendAll(fd, "GET /data/download HTTP/1.1\r\nHost: loadtest\r\nConnection: close\r\n\r\n"))
+        {
+            char buffer[1024];
+            double bytesPerMs = options.rateKB * 1024 / 1000;
+            ssize_t got;
+            while ((got = ::recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            {
+                body.append(buffer, got);
+                auto due = start + std::chrono::duration<double, std::milli>(body.size() / bytesPerMs);
+                std::this_thread::sleep_until(due);
+            }
+        }
+        if (fd >= 0)
+            ::close(fd);
+        activeDownloads--;
+
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.bytes = body.size();
+        size_t split = body.find("\r\n\r\n");
+        std::string csv;
+        result.complete = body.compare(0, 12, "HTTP/1.1 200") == 0 && split != std::string::npos;
+        if (result.complete)
+        {
+            std::string head = body.substr(0, split + 2);
+            const char *length = strcasestr(head.c_str(), "\r\nContent-Length:");
+            if (length)
+            {
+                csv = body.substr(split + 4);
+                result.complete = csv.size() == strtoul(length + 17, nullptr, 10);
+            }
+            else
+                result.complete = http::dechunk(body.substr(split + 4), csv);
+        }
+        size_t lines = std::count(csv.begin(), csv.end(), '\n');
+        result.rows = lines > 0 ? lines - 1 : 0;
+    }
+
+    // Runs loop() on this thread with the simulated clock following the wall clock
+    void serveUntil(const std::atomic<bool> &done, double &longestLoopMs)
+    {
+        auto last = Clock::now();
+        while (!done)
+        {
+            auto start = Clock::now();
+            loop();
+            auto now = Clock::now();
+            longestLoopMs = std::max(longestLoopMs, std::chrono::duration<double, std::milli>(now - start).count());
+            uint32_t elapsed = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+            if (elapsed > 0)
+            {
+                hal::advance(elapsed);
+                last += std::chrono::milliseconds(elapsed);
+            }
+        }
+    }
+
+    void report(const char *phase, Latencies &latencies, double longestLoopMs)
+    {
+        std::vector<double> &ms = latencies.ms;
+        std::sort(ms.begin(), ms.end());
+        auto at = [&](double q) { return ms.empty() ? 0.0 : ms[std::min(ms.size() - 1, (size_t)(q * ms.size()))]; };
+        printf("%-22s %8zu %8.2f %8.2f %8.2f %8d %10d %12.1f\n", phase, ms.size(), at(0.5), at(0.99),
+               ms.empty() ? 0.0 : ms.back(), latencies.failures, latencies.reconnects, longestLoopMs);
+    }
+}
+
+int runLoadtest(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/loadtest";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--records"))
+            options.records = atoi(value);
+        else if (!strcmp(opt, "--downloads"))
+            options.downloads = atoi(value);
+        else if (!strcmp(opt, "--rate"))
+            options.rateKB = atof(value);
+        else if (!strcmp(opt, "--requests"))
+            options.requests = atoi(value);
+        else if (!strcmp(opt, "--interval"))
+            options.intervalMs = atoi(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.rateKB <= 0 || options.requests <= 0)
+        usage();
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    hal::listenOnHost(true);
+
+    uint32_t start = DateTime(2025, 1, 1, 0, 0, 0).unixtime();
+    hal::rtcAdjust(start);
+    setup();
+    port = hal::hostPort(80);
+    if (!port)
+    {
+        fprintf(stderr, "loadtest: the web server is not listening\n");
+        return 1;
+    }
+
+    // Only the clock moves, so the sensor task is not run for every minute
+    for (int i = 0; i < options.records; i++)
+    {
+        setClock(DateTime(start + 60u * i));
+        saveDataRecord();
+    }
+
+    printf("127.0.0.1:%u, %d data records, %d download(s) at %.0f KB/s, /status every %d ms\n\n",
+           port, options.records, options.downloads, options.rateKB, options.intervalMs);
+    printf("%-22s %8s %8s %8s %8s %8s %10s %12s\n",
+           "phase", "requests", "p50 ms", "p99 ms", "max ms", "failed", "reconnects", "max loop ms");
+
+    // ---------- /status alone ----------
+    Latencies idle;
+    double idleLoopMs = 0;
+    std::atomic<bool> done{false};
+    std::thread poller([&]()
+                       {
+                           pollStatus(idle, false);
+                           done = true;
+                       });
+    serveUntil(done, idleLoopMs);
+    poller.join();
+    report("/status", idle, idleLoopMs);
+
+    // ---------- /status during downloads ----------
+    Latencies busy;
+    double busyLoopMs = 0;
+    std::vector<Download> downloads(options.downloads);
+    std::vector<std::thread> clients;
+    activeDownloads = options.downloads;
+    done = false;
+    for (Download &d : downloads)
+        clients.emplace_back(download, std::ref(d));
+    std::thread busyPoller([&]()
+                           {
+                               std::this_thread::sleep_for(std::chrono::milliseconds(100)); // downloads under way
+                               pollStatus(busy, true);
+                               for (std::thread &client : clients)
+                                   client.join();
+                               done = true;
+                           });
+    serveUntil(done, busyLoopMs);
+    busyPoller.join();
+    report("/status + downloads", busy, busyLoopMs);
+
+    printf("\n");
+    for (size_t i = 0; i < downloads.size(); i++)
+        printf("download %zu: %zu bytes, %zu CSV rows in %.1f s (%.0f KB/s)%s\n", i + 1, downloads[i].bytes,
+               downloads[i].rows, downloads[i].seconds, downloads[i].bytes / 1024.0 / std::max(downloads[i].seconds, 1e-3),
+               downloads[i].complete ? "" : ", INCOMPLETE");
+    printf("\nlatency: request sent -> last byte of the response, on one keep-alive connection\n");
+    printf("max loop ms: longest single loop() call, i.e. the longest controlPump() could have waited\n");
+    fflush(stdout);
+    return 0;
+}
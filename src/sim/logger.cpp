@@ -0,0 +1,206 @@
+// `program logger`: loop() latency with the daily log staged in RAM, against
+// writing every line straight to flash as logToFile() used to. Each loop()
+// pass logs --lines lines first; the same run is made twice:
+//   - per line: every logToFile() is urgent, one open/append/close per line
+//   - staged: lines go to the RAM stages, serviceLogFlush() writes batches
+// Checks that every line reaches the daily file in order in both runs, that
+// an urgent line is on flash when logToFile() returns, and that a staged
+// line is written within LOG_FLUSH_INTERVAL without further logging.
+// Prints host time per loop pass (mean, p99, worst) and file opens per
+// line; on the ESP32 each open/close is a LittleFS metadata commit.
+// Exits 1 on the first mismatch.
+//
+//   program logger
+//   program logger --passes 20000 --lines 5
+//
+// Options:
+//   --passes N      loop() passes per run (default 5000)
+//   --lines N       log lines per pass (default 2)
+//   --fs DIR        LittleFS root (default sim_fs/logger)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+
+// From main.cpp
+void setup();
+void loop();
+void logToFile(const char *message, bool urgent);
+void flushLogFile();
+
+namespace
+{
+    struct Options
+    {
+        long passes = 5000;
+        int lines = 2;
+    } options;
+
+    const uint32_t flushIntervalMs = 60000; // LOG_FLUSH_INTERVAL
+
+    int checks = 0;
+    long nextLine = 0; // number of the next line logged, across both runs
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program logger [--passes N] [--lines N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "logger: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    std::string dailyFile(const std::string &fsRoot)
+    {
+        DateTime now(hal::rtcEpoch());
+        char name[32];
+        snprintf(name, sizeof(name), "/log_%04d%02d%02d.txt", now.year(), now.month(), now.day());
+        return fsRoot + name;
+    }
+
+    // Numbers of the "logger line N" lines in the daily file, in file order
+    std::vector<long> linesOnFlash(const std::string &fsRoot)
+    {
+        std::vector<long> numbers;
+        std::ifstream in(dailyFile(fsRoot));
+        std::string line;
+        while (std::getline(in, line))
+        {
+            size_t at = line.find("logger line ");
+            if (at != std::string::npos)
+                numbers.push_back(atol(line.c_str() + at + 12));
+        }
+        return numbers;
+    }
+
+    void logLine(bool urgent)
+    {
+        char message[64];
+        snprintf(message, sizeof(message), "logger line %ld: soil sensor reading stored", nextLine++);
+        logToFile(message, urgent);
+    }
+
+    struct Result
+    {
+        double mean = 0, p99 = 0, worst = 0; // us per loop pass
+        double opensPerLine = 0;
+    };
+
+    Result run(const std::string &fsRoot, bool urgent)
+    {
+        long first = nextLine;
+        std::vector<double> passes;
+        passes.reserve(options.passes);
+        hal::FsStats before = hal::fsStats();
+        for (long pass = 0; pass < options.passes; pass++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < options.lines; i++)
+                logLine(urgent);
+            loop();
+            passes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6);
+            hal::advance(10);
+        }
+        hal::FsStats after = hal::fsStats();
+        flushLogFile();
+
+        std::vector<long> onFlash = linesOnFlash(fsRoot);
+        std::vector<long> expected;
+        for (long n = 0; n < nextLine; n++)
+            expected.push_back(n);
+        check(onFlash == expected, urgent ? "per line: lines missing or out of order" : "staged: lines missing or out of order",
+              std::to_string(onFlash.size()) + " of " + std::to_string(nextLine) + " lines in the file");
+
+        Result result;
+        std::sort(passes.begin(), passes.end());
+        for (double us : passes)
+            result.mean += us / passes.size();
+        result.p99 = passes[passes.size() * 99 / 100];
+        result.worst = passes.back();
+        result.opensPerLine = (after.opens - before.opens) / (double)(nextLine - first);
+        return result;
+    }
+
+    void printRow(const char *label, const Result &result)
+    {
+        printf("  %-10s %8.2f %8.2f %8.1f %14.3f\n", label, result.mean, result.p99, result.worst,
+               result.opensPerLine);
+    }
+}
+
+int runLogger(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/logger";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--passes"))
+            options.passes = atol(value);
+        else if (!strcmp(opt, "--lines"))
+            options.lines = atoi(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.passes < 100 || options.lines < 1)
+        usage();
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    hal::rtcAdjust(DateTime(2025, 1, 1, 6, 0, 0).unixtime());
+    setup();
+
+    // Urgent: on flash as soon as logToFile() returns
+    logLine(true);
+    check(linesOnFlash(fsRoot).size() == 1, "urgent line not written at once");
+
+    // Staged: nothing on flash until LOG_FLUSH_INTERVAL has passed
+    logLine(false);
+    loop();
+    check(linesOnFlash(fsRoot).size() == 1, "staged line written at once");
+    for (uint32_t ms = 0; ms <= flushIntervalMs; ms += 100)
+    {
+        loop();
+        hal::advance(100);
+    }
+    check(linesOnFlash(fsRoot).size() == 2, "staged line not written within LOG_FLUSH_INTERVAL");
+    printf("urgent line on flash when logToFile() returns; staged line written within %lu s\n",
+           (unsigned long)(flushIntervalMs / 1000));
+
+    Result perLine = run(fsRoot, true);
+    Result staged = run(fsRoot, false);
+    printf("%ld loop() passes, %d log lines each: every line on flash, in order\n", options.passes, options.lines);
+    printf("host us per loop pass:\n");
+    printf("  %-10s %8s %8s %8s %14s\n", "", "mean", "p99", "worst", "opens per line");
+    printRow("per line", perLine);
+    printRow("staged", staged);
+    printf("logger: %d checks passed\n", checks);
+    fflush(stdout);
+    return 0;
+}
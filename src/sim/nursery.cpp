@@ -0,0 +1,188 @@
+#include "nursery.h"
+#include "hal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace nursery
+{
+    namespace
+    {
+        Config cfg;
+        Stats statistics;
+        float beds[10];
+        float bedRate[10]; // per-bed drain multiplier: beds never dry in lockstep
+        bool pumping = false;
+        uint64_t pumpStartMs = 0;
+        uint32_t currentEpoch = 0;
+        uint32_t rng = 1;
+        bool recorded = false;
+        float recordedTemperature, recordedHumidity, recordedLux;
+
+        // xorshift32: deterministic for a given seed, cheap enough for every sample
+        uint32_t nextRandom()
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            return rng;
+        }
+
+        float hourOfDay()
+        {
+            return (currentEpoch % 86400UL) / 3600.0f;
+        }
+
+        // 0 at night, 1 at solar noon (12:00), sunrise 06:00, sunset 18:00
+        float sun()
+        {
+            if (recorded)
+                return std::min(1.0f, recordedLux / 45000);
+            float h = hourOfDay();
+            if (h < 6 || h > 18)
+                return 0;
+            return std::sin((h - 6) / 12 * (float)M_PI);
+        }
+    }
+
+    void configure(const Config &config)
+    {
+        cfg = config;
+        rng = cfg.seed ? cfg.seed : 1;
+        for (int i = 0; i < 10; i++)
+        {
+            bedRate[i] = 0.8f + (nextRandom() % 400) / 1000.0f;
+            beds[i] = cfg.initialMoisture;
+        }
+        statistics = Stats();
+        statistics.minMoisture = statistics.maxMoisture = cfg.initialMoisture;
+        recorded = false;
+    }
+
+    bool parseValvePins(const char *list, Config &config)
+    {
+        uint8_t pins[10];
+        for (int i = 0; i < 10; i++)
+        {
+            char *end;
+            long pin = std::strtol(list, &end, 10);
+            if (end == list || pin < 0 || pin > 63 || (i < 9 && *end != ','))
+                return false;
+            pins[i] = (uint8_t)pin;
+            list = end + (i < 9);
+        }
+        if (*list)
+            return false;
+        std::copy(pins, pins + 10, config.valvePins);
+        return true;
+    }
+
+    void setWeather(float temperature, float humidity, float lux)
+    {
+        recorded = true;
+        recordedTemperature = temperature;
+        recordedHumidity = humidity;
+        recordedLux = lux;
+    }
+
+    void step(uint32_t ms, uint32_t epoch)
+    {
+        currentEpoch = epoch;
+
+        bool pump = hal::digitalRead(cfg.pumpPin) == cfg.relayActive;
+        bool fed[10];
+        int fedBeds = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            fed[i] = pump && hal::digitalRead(cfg.valvePins[i]) == cfg.relayActive;
+            fedBeds += fed[i];
+        }
+        bool on = fedBeds > 0;
+        if (on && !pumping)
+        {
+            statistics.pumpCycles++;
+            pumpStartMs = hal::nowMs();
+        }
+        if (!on && pumping)
+            statistics.pumpOnMs += hal::nowMs() - pumpStartMs;
+        pumping = on;
+
+        float hours = ms / 3600000.0f;
+        float heat = std::max(0.0f, temperature() - 20) / 10;
+        float drain = (cfg.drainPerHour * (1 + heat) + cfg.sunDrainPerHour * sun()) * hours;
+        // The pump's flow is shared by the open beds: half the beds get twice the water each
+        float gain = on ? cfg.irrigationPerSecond * ms / 1000.0f * 10 / fedBeds : 0;
+
+        for (int i = 0; i < 10; i++)
+        {
+            // Drainage slows as the bed dries out
+            beds[i] -= drain * bedRate[i] * (0.3f + beds[i]);
+            if (fed[i])
+                beds[i] += gain * (1 - beds[i]);
+            beds[i] = std::min(1.0f, std::max(0.0f, beds[i]));
+        }
+
+        float avg = averageMoisture();
+        statistics.minMoisture = std::min(statistics.minMoisture, avg);
+        statistics.maxMoisture = std::max(statistics.maxMoisture, avg);
+    }
+
+    uint16_t soilRaw(uint8_t pin)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            if (cfg.soilPins[i] != pin)
+                continue;
+            int noise = cfg.noiseRaw ? (int)(nextRandom() % (2 * cfg.noiseRaw + 1)) - cfg.noiseRaw : 0;
+            int raw = (int)std::lround(cfg.dryRaw + (cfg.wetRaw - cfg.dryRaw) * beds[i]) + noise;
+            return (uint16_t)std::min(4095, std::max(0, raw));
+        }
+        return 0;
+    }
+
+    float moisture(int channel)
+    {
+        return beds[channel];
+    }
+
+    float averageMoisture()
+    {
+        float sum = 0;
+        for (int i = 0; i < 10; i++)
+            sum += beds[i];
+        return sum / 10;
+    }
+
+    bool watering()
+    {
+        return pumping;
+    }
+
+    // Diurnal cycle: coolest around 05:00, warmest around 14:00
+    float temperature()
+    {
+        if (recorded)
+            return recordedTemperature;
+        return 25 + 6 * std::sin((hourOfDay() - 8) / 24 * 2 * (float)M_PI);
+    }
+
+    float humidity()
+    {
+        if (recorded)
+            return recordedHumidity;
+        return 75 - 20 * std::sin((hourOfDay() - 8) / 24 * 2 * (float)M_PI) + (pumping ? 5 : 0);
+    }
+
+    float lux()
+    {
+        if (recorded)
+            return recordedLux;
+        return 45000 * sun();
+    }
+
+    const Stats &stats()
+    {
+        return statistics;
+    }
+}
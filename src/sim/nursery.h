@@ -0,0 +1,56 @@
+// Simulated plant beds behind the HAL: ten soil probes, the pump, one zone
+// valve per bed and the DHT22/BH1750 environment.
+//
+// Soil water drains continuously (faster in sun and heat) and a bed's water
+// rises while the pump relay and that bed's valve relay are both on. Probe readings go through the same
+// dry/wet ADC range as the real capacitive sensors, so main.cpp's calibration
+// and thresholds apply unchanged.
+#pragma once
+
+#include <cstdint>
+
+namespace nursery
+{
+    struct Config
+    {
+        // Must match PIN CONFIGURATION / RELAY CONTROL in main.cpp
+        uint8_t soilPins[10] = {12, 25, 26, 27, 32, 33, 34, 35, 36, 39};
+        uint8_t pumpPin = 19;
+        uint8_t valvePins[10] = {18, 18, 18, 18, 18, 18, 18, 18, 18, 18}; // zone valve feeding each bed
+        uint8_t relayActive = 0; // LOW
+
+        int dryRaw = 2662;              // ADC at 0% (default config.dry)
+        int wetRaw = 1269;              // ADC at 100% (default config.wet)
+        int noiseRaw = 12;              // +- ADC counts per sample
+        float initialMoisture = 0.45f;  // 0..1
+        float drainPerHour = 0.012f;    // at night, 20 C
+        float sunDrainPerHour = 0.035f; // extra at full sun
+        float irrigationPerSecond = 0.005f; // per bed with all 10 beds open
+        uint32_t seed = 1;
+    };
+
+    struct Stats
+    {
+        uint32_t pumpCycles = 0;
+        uint64_t pumpOnMs = 0;
+        float minMoisture = 1;
+        float maxMoisture = 0;
+    };
+
+    void configure(const Config &config);
+    bool parseValvePins(const char *list, Config &config); // "18,18,18,18,18,17,17,17,17,17"; false if not 10 pins
+    void step(uint32_t ms, uint32_t epoch); // called by hal::advance()
+
+    // Replaces the synthetic day/night cycle from now on, e.g. with rows of a
+    // recorded data log
+    void setWeather(float temperature, float humidity, float lux);
+
+    uint16_t soilRaw(uint8_t pin);          // one noisy ADC sample, 0 if pin is not a probe
+    float moisture(int channel);            // 0..1
+    float averageMoisture();
+    bool watering();
+    float temperature();
+    float humidity();
+    float lux();
+    const Stats &stats();
+}
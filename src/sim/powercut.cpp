@@ -0,0 +1,176 @@
+// `program powercut`: cuts the power in the middle of writeConfigFile() at
+// every byte and checks that the previous settings survive. For each N from 0
+// to the size of the new file:
+//   - a boot (child process) posts new /settings, and the power fails once N
+//     bytes of config.json.tmp are written (N = size: all written, not yet
+//     renamed)
+//   - the next boot must load the old settings: /config and config.json
+//     unchanged, nothing moved to config.json.bad
+// Then one save runs to completion and the next boot must load the new
+// settings. Exits 1 on the first mismatch.
+//
+//   program powercut
+//
+// Options:
+//   --fs DIR        LittleFS root (default sim_fs/powercut)
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+
+namespace
+{
+    const char *const tempFile = "/config.json.tmp";
+    const int powerCutExit = 4; // hal::checkPowerCut()
+
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program powercut [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "powercut: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        exit(1);
+    }
+
+    std::string hostFile(const std::string &fsRoot, const char *path)
+    {
+        std::ifstream in(fsRoot + path, std::ios::binary);
+        std::ostringstream content;
+        content << in.rdbuf();
+        return in ? content.str() : std::string();
+    }
+
+    bool hostExists(const std::string &fsRoot, const char *path)
+    {
+        struct stat st;
+        return stat((fsRoot + path).c_str(), &st) == 0;
+    }
+
+    // Boots the firmware on `fsRoot`. With `settings`, posts them with the
+    // power failing after `cutAt` bytes of config.json.tmp (-1 = no cut).
+    // Returns the exit code; `config` gets /config as the boot served it.
+    int boot(const std::string &fsRoot, const http::Params &settings, long cutAt, std::string *config)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            exit(1);
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            hal::setConsoleQuiet(true);
+            hal::setFsRoot(fsRoot);
+            setup();
+            std::string body;
+            if (!settings.empty())
+            {
+                hal::cutPowerAfter(tempFile, cutAt);
+                http::request("POST", "/settings", settings);
+            }
+            http::request("GET", "/config", http::Params(), http::Params(), &body);
+            if (write(fds[1], body.data(), body.size()) != (ssize_t)body.size())
+                std::_Exit(1);
+            std::_Exit(0); // sensorTask never returns; skip joining it
+        }
+        close(fds[1]);
+
+        config->clear();
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+            config->append(buffer, n);
+        close(fds[0]);
+        int status;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+}
+
+int runPowercut(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/powercut";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+
+    // Settings in place before the cuts, then the ones the cut save tries to write
+    const http::Params before = {{"threshold", "25"}, {"pumpDuration", "8000"}, {"zone1Duration", "30"},
+                                 {"slot1Days", "127"}};
+    const http::Params after = {{"threshold", "41"}, {"wateringMode", "1"}, {"pumpDuration", "12000"},
+                                {"measurementInterval", "120"}, {"zone1Duration", "45"}, {"slot1Days", "62"}};
+
+    std::string config;
+    check(boot(fsRoot, before, -1, &config) == 0, "saving the first settings");
+    std::string oldConfig;
+    check(boot(fsRoot, http::Params(), -1, &oldConfig) == 0 && oldConfig == config, "first settings after a reboot");
+    const std::string oldFile = hostFile(fsRoot, "/config.json");
+    check(!oldFile.empty(), "config.json missing");
+
+    long cuts = 0;
+    for (long cutAt = 0;; cutAt++)
+    {
+        int code = boot(fsRoot, after, cutAt, &config);
+        if (code == 0)
+            break; // the save finished before the cut
+        check(code == powerCutExit, "boot with the cut save crashed");
+        cuts++;
+
+        std::string label = "cut after " + std::to_string(cutAt) + " bytes";
+        check(hostFile(fsRoot, tempFile).size() == (size_t)cutAt, (label + ": config.json.tmp size").c_str());
+        check(boot(fsRoot, http::Params(), -1, &config) == 0, (label + ": reboot").c_str());
+        check(config == oldConfig, (label + ": old settings not loaded").c_str(), config);
+        check(hostFile(fsRoot, "/config.json") == oldFile, (label + ": config.json changed").c_str());
+        check(!hostExists(fsRoot, "/config.json.bad"), (label + ": config.json taken as damaged").c_str());
+        check(!hostExists(fsRoot, tempFile), (label + ": config.json.tmp not discarded").c_str());
+    }
+
+    // Every byte of the new file was a cut point, plus "written, not renamed"
+    const std::string newFile = hostFile(fsRoot, "/config.json");
+    check(newFile != oldFile && cuts == (long)newFile.size() + 1, "cut points do not cover the new config.json");
+    std::string newConfig = config;
+    check(boot(fsRoot, http::Params(), -1, &config) == 0 && config == newConfig && config != oldConfig,
+          "new settings after the completed save");
+
+    printf("config.json %zu -> %zu bytes: %ld power cuts, old settings loaded after each\n", oldFile.size(),
+           newFile.size(), cuts);
+    printf("completed save: new settings loaded\n");
+    printf("powercut: %d checks passed\n", checks);
+    return 0;
+}
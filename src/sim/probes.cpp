@@ -0,0 +1,215 @@
+// `program probes`: broken soil probes next to healthy ones in wet beds, in
+// MODE_MOISTURE with one measurement a second. From boot on:
+//   - probe 5, alone in zone 2, is disconnected: its ADC sits on the 3.3V
+//     rail and reads as bone dry (0%)
+//   - probe 6, alone in zone 3, is shorted to GND
+//   - probe 7 in zone 1 is stuck on one plausible dry value
+//   - probe 8 in zone 1 reads far below its bed, with noise
+// Checks that /status soilFaults flags each one (rail, rail, stuck, outlier),
+// that zones 2 and 3 report no soil value and zone 1 the average of its
+// healthy probes only, and that the pump never starts. Moving zone 2 onto
+// probes 1 to 4 must show in its soil value at once, before the next
+// measurement. Then the probes are repaired and every flag must clear, with
+// zones 2 and 3 back in control.
+// Exits 1 on the first mismatch.
+//
+//   program probes
+//   program probes --seconds 300
+//
+// Options:
+//   --seconds N     seconds per phase, broken and repaired (default 120)
+//   --fs DIR        LittleFS root (default sim_fs/probes)
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+#include "nursery.h"
+
+// From main.cpp
+void setup();
+void loop();
+
+namespace
+{
+    const uint8_t faultRail = 0x01;    // SOIL_FAULT_RAIL
+    const uint8_t faultStuck = 0x02;   // SOIL_FAULT_STUCK
+    const uint8_t faultOutlier = 0x08; // SOIL_FAULT_OUTLIER
+    const int stuckCycles = 20;        // SOIL_STUCK_CYCLES
+
+    const nursery::Config nurseryConfig; // soilPins[] in channel order
+    int seconds = 120;
+    bool broken = true;
+    uint32_t noise = 1;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program probes [--seconds N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "probes: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    // The nursery's probes, with channels 5 to 8 broken while `broken`
+    uint16_t probeSource(uint8_t pin)
+    {
+        if (broken)
+        {
+            noise = noise * 1103515245 + 12345;
+            if (pin == nurseryConfig.soilPins[4])
+                return 4095; // open input pulled to 3.3V
+            if (pin == nurseryConfig.soilPins[5])
+                return 0;
+            if (pin == nurseryConfig.soilPins[6])
+                return 2500; // ~6%, the same ADC average every time
+            if (pin == nurseryConfig.soilPins[7])
+                return 2450 + (noise >> 16) % 100; // ~10%, while its bed is at 40%
+        }
+        return nursery::soilRaw(pin);
+    }
+
+    JsonDocument status()
+    {
+        std::string body;
+        check(http::request("GET", "/status", http::Params(), http::Params(), &body) == 200, "GET /status", body);
+        JsonDocument doc;
+        check(!deserializeJson(doc, body.c_str(), body.size()), "/status not JSON", body);
+        return doc;
+    }
+
+    int zoneSoil(JsonDocument &doc, int zone)
+    {
+        for (JsonVariant z : doc["zones"].as<JsonArray>())
+            if (z["zone"].as<int>() == zone)
+                return z["soil"].as<int>();
+        check(false, "zone missing from /status", std::to_string(zone));
+        return -1;
+    }
+
+    std::string faultsOf(JsonDocument &doc)
+    {
+        std::string text;
+        for (JsonVariant fault : doc["soilFaults"].as<JsonArray>())
+            text += (text.empty() ? "[" : ",") + std::to_string(fault.as<int>());
+        return text + "]";
+    }
+
+    void run(int forSeconds)
+    {
+        for (int i = 0; i < forSeconds; i++)
+        {
+            loop();
+            hal::advance(1000);
+        }
+    }
+}
+
+int runProbes(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/probes";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--seconds"))
+            seconds = atoi(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (seconds < 2 * stuckCycles)
+        usage();
+
+    // Wet beds that do not dry out: a healthy probe never asks for water
+    nursery::Config bed;
+    bed.initialMoisture = 0.8f;
+    bed.drainPerHour = 0;
+    bed.sunDrainPerHour = 0;
+    nursery::configure(bed);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    hal::setAnalogSource(probeSource);
+    setup();
+
+    http::Params settings = {{"wateringMode", "1"},        {"measurementInterval", "1"},
+                             {"zone1Sensors", "1-4,7,8"},  {"zone2Enabled", "1"},
+                             {"zone2Sensors", "5"},        {"zone3Enabled", "1"},
+                             {"zone3Sensors", "6"}};
+    std::string body;
+    check(http::request("POST", "/settings", settings, http::Params(), &body) == 200, "POST /settings", body);
+
+    run(seconds);
+    JsonDocument doc = status();
+    JsonArray faults = doc["soilFaults"].as<JsonArray>();
+    std::string flags = faultsOf(doc);
+    check(faults[4].as<int>() & faultRail, "disconnected probe 5 not flagged", flags);
+    check(faults[5].as<int>() & faultRail, "shorted probe 6 not flagged", flags);
+    check(faults[6].as<int>() & faultStuck, "stuck probe 7 not flagged", flags);
+    check(faults[7].as<int>() & faultOutlier, "outlier probe 8 not flagged", flags);
+    for (int ch : {0, 1, 2, 3, 8, 9})
+        check(faults[ch].as<int>() == 0, "healthy probe flagged", "probe " + std::to_string(ch + 1) + ": " + flags);
+    check(doc["soilMoisture5"].as<int>() < doc["threshold"].as<int>(), "disconnected probe does not read dry");
+
+    int sum = 0;
+    for (int ch = 1; ch <= 4; ch++)
+        sum += doc["soilMoisture" + std::to_string(ch)].as<int>();
+    check(zoneSoil(doc, 1) == sum / 4, "zone 1 not the average of its healthy probes",
+          std::to_string(zoneSoil(doc, 1)) + " instead of " + std::to_string(sum / 4));
+    check(zoneSoil(doc, 2) == -1 && zoneSoil(doc, 3) == -1, "zone of a broken probe has a soil value");
+    check(nursery::stats().pumpCycles == 0, "pump started by a broken probe",
+          std::to_string(nursery::stats().pumpCycles) + " starts");
+    printf("%d s broken: soilFaults %s, probe 5 reads %d%% (threshold %d%%), zone soil %d/%d/%d, no pump start\n",
+           seconds, flags.c_str(), doc["soilMoisture5"].as<int>(), doc["threshold"].as<int>(), zoneSoil(doc, 1),
+           zoneSoil(doc, 2), zoneSoil(doc, 3));
+
+    // The clock stands still here: no new sensor snapshot, only new sensors
+    check(http::request("POST", "/settings", {{"zone2Sensors", "1-4"}}) == 200, "POST /settings zone2Sensors");
+    doc = status();
+    check(zoneSoil(doc, 2) == sum / 4, "zone 2 soil not updated after its sensors changed",
+          std::to_string(zoneSoil(doc, 2)) + " instead of " + std::to_string(sum / 4));
+    check(http::request("POST", "/settings", {{"zone2Sensors", "5"}}) == 200, "POST /settings zone2Sensors");
+    doc = status();
+    check(zoneSoil(doc, 2) == -1, "zone 2 soil not updated after its sensors changed back");
+
+    broken = false;
+    run(seconds);
+    doc = status();
+    flags = faultsOf(doc);
+    for (int ch = 0; ch < 10; ch++)
+        check(doc["soilFaults"][ch].as<int>() == 0, "flag not cleared after repair",
+              "probe " + std::to_string(ch + 1) + ": " + flags);
+    check(zoneSoil(doc, 2) == doc["soilMoisture5"].as<int>() && zoneSoil(doc, 3) == doc["soilMoisture6"].as<int>(),
+          "repaired probe not back in control");
+    check(nursery::stats().pumpCycles == 0, "pump started after repair");
+    printf("%d s repaired: soilFaults %s, zone soil %d/%d/%d\n", seconds, flags.c_str(), zoneSoil(doc, 1),
+           zoneSoil(doc, 2), zoneSoil(doc, 3));
+
+    printf("probes: %d checks passed\n", checks);
+    hal::setAnalogSource(nullptr);
+    fflush(stdout);
+    return 0;
+}
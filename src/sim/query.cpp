@@ -0,0 +1,272 @@
+// `program query`: /data/query latency against a data log of --records
+// records, one every 10 minutes (50k records: ~350 days in 49 segments).
+// Each query runs --repeat times; for every one:
+//   - each bucket's record count and temperature/soil1 min, avg and max
+//     must equal what the test computes from the values it saved
+//   - host time (median), response size, file opens and firmware heap per
+//     request are printed, next to /data/download of everything, the only
+//     way to get history before /data/query
+// Exits 1 on the first mismatch.
+//
+//   program query
+//   program query --records 100000 --repeat 5
+//
+// Options:
+//   --records N     records in the log (default 50000)
+//   --repeat N      runs of each query (default 10)
+//   --seed N        value seed (default 1)
+//   --fs DIR        LittleFS root (default sim_fs/query)
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+#include "sensor_data.h"
+
+// From main.cpp
+void setup();
+void setClockBase(uint32_t epoch, unsigned long at, int32_t drift);
+void publishSensorData();
+void saveDataRecord();
+extern SensorData data;
+
+namespace
+{
+    struct Options
+    {
+        long records = 50000;
+        int repeat = 10;
+        unsigned seed = 1;
+    } options;
+
+    const uint32_t recordSeconds = 600;
+    const uint32_t maxBuckets = 1000; // QUERY_MAX_BUCKETS
+
+    // What each saved record holds, in stored units
+    struct Saved
+    {
+        uint32_t epoch;
+        int temperature; // centi-degrees
+        int soil1;
+    };
+    std::vector<Saved> saved;
+
+    std::mt19937 rng;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program query [--records N] [--repeat N] [--seed N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "query: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    // Buckets as /data/query must return them for [from, to] in `step`s
+    struct Bucket
+    {
+        uint32_t start = 0;
+        long records = 0;
+        double min[2], sum[2], max[2];
+    };
+
+    std::vector<Bucket> expectedBuckets(uint32_t from, uint32_t to, uint32_t step)
+    {
+        std::vector<Bucket> buckets;
+        for (const Saved &s : saved)
+        {
+            if (s.epoch < from || s.epoch > to)
+                continue;
+            uint32_t start = from + (s.epoch - from) / step * step;
+            if (buckets.empty() || buckets.back().start != start)
+            {
+                buckets.push_back(Bucket());
+                buckets.back().start = start;
+            }
+            Bucket &b = buckets.back();
+            double values[2] = {s.temperature / 100.0, (double)s.soil1};
+            for (int i = 0; i < 2; i++)
+            {
+                b.min[i] = b.records ? std::min(b.min[i], values[i]) : values[i];
+                b.max[i] = b.records ? std::max(b.max[i], values[i]) : values[i];
+                b.sum[i] = (b.records ? b.sum[i] : 0) + values[i];
+            }
+            b.records++;
+        }
+        return buckets;
+    }
+
+    void checkBuckets(const char *label, const std::string &body, uint32_t from, uint32_t to, uint32_t step)
+    {
+        JsonDocument doc;
+        check(!deserializeJson(doc, body.c_str(), body.size()), (std::string(label) + ": not JSON").c_str(),
+              body.substr(0, 200));
+        check(doc["step"].as<uint32_t>() == step, (std::string(label) + ": step").c_str(),
+              std::to_string(doc["step"].as<uint32_t>()));
+        std::vector<Bucket> expected = expectedBuckets(from, to, step);
+        JsonArray buckets = doc["buckets"].as<JsonArray>();
+        check(buckets.size() == expected.size(), (std::string(label) + ": bucket count").c_str(),
+              std::to_string(buckets.size()) + " instead of " + std::to_string(expected.size()));
+        const char *names[2] = {"temperature", "soil1"};
+        for (size_t k = 0; k < expected.size(); k++)
+        {
+            const Bucket &want = expected[k];
+            JsonObject got = buckets[k].as<JsonObject>();
+            std::string at = std::string(label) + ", bucket " + std::to_string(k) + ": ";
+            check(got["t"].as<uint32_t>() == want.start && got["n"].as<long>() == want.records,
+                  (at + "start or record count").c_str());
+            for (int i = 0; i < 2; i++)
+            {
+                JsonArray triple = got[names[i]].as<JsonArray>();
+                double avg = want.sum[i] / want.records;
+                // Printed with two decimals; the firmware sums in float
+                bool ok = std::fabs(triple[0].as<double>() - want.min[i]) < 0.006 &&
+                          std::fabs(triple[1].as<double>() - avg) < 0.011 &&
+                          std::fabs(triple[2].as<double>() - want.max[i]) < 0.006;
+                check(ok, (at + names[i] + " min/avg/max").c_str());
+            }
+        }
+    }
+
+    struct Timing
+    {
+        double medianMs = 0;
+        size_t bytes = 0;
+        double opens = 0;
+        double allocations = 0;
+        double heapBytes = 0;
+    };
+
+    Timing time(const char *uri, const http::Params &args, std::string *body)
+    {
+        std::vector<double> runs;
+        Timing timing;
+        for (int i = 0; i < options.repeat; i++)
+        {
+            uint64_t opens = hal::fsStats().opens;
+            auto start = std::chrono::steady_clock::now();
+            int code = http::request("GET", uri, args, http::Params(), body);
+            runs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000);
+            check(code == 200, (std::string(uri) + " status").c_str(), std::to_string(code));
+            timing.opens += (hal::fsStats().opens - opens) / (double)options.repeat;
+            timing.allocations += http::lastServerHeap().allocations / (double)options.repeat;
+            timing.heapBytes += http::lastServerHeap().bytes / (double)options.repeat;
+        }
+        std::sort(runs.begin(), runs.end());
+        timing.medianMs = runs[runs.size() / 2];
+        timing.bytes = body->size();
+        return timing;
+    }
+
+    void printRow(const char *label, const Timing &timing, size_t buckets)
+    {
+        printf("  %-22s %9.2f %9zu %8zu %7.1f %7.0f %9.0f\n", label, timing.medianMs, timing.bytes, buckets,
+               timing.opens, timing.allocations, timing.heapBytes);
+    }
+
+    void query(const char *label, uint32_t from, uint32_t to, uint32_t step, uint32_t expectStep)
+    {
+        http::Params args = {{"from", String(from)}, {"to", String(to)}, {"fields", "temperature,soil1"}};
+        if (step)
+            args.push_back({"step", String(step)});
+        std::string body;
+        Timing timing = time("/data/query", args, &body);
+        checkBuckets(label, body, from, to, expectStep);
+        printRow(label, timing, expectedBuckets(from, to, expectStep).size());
+    }
+}
+
+int runQuery(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/query";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--records"))
+            options.records = atol(value);
+        else if (!strcmp(opt, "--repeat"))
+            options.repeat = atoi(value);
+        else if (!strcmp(opt, "--seed"))
+            options.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    // 150k records of 24 B stay within the largest storageBudgetKB
+    if (options.records < 1000 || options.records > 150000 || options.repeat < 1)
+        usage();
+    rng.seed(options.seed);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    setup();
+    http::Params settings = {{"storageBudgetKB", "4096"}, {"retentionDays", "3650"}};
+    check(http::request("POST", "/settings", settings) == 200, "POST /settings");
+
+    // As in `program tsdb`: sensorTask never runs, each record gets its time
+    // from setClockBase() and its values from `data`
+    const uint32_t start = DateTime(2025, 1, 1, 0, 0, 0).unixtime();
+    for (long i = 0; i < options.records; i++)
+    {
+        uint32_t epoch = start + i * recordSeconds;
+        data.temperature = std::uniform_int_distribution<int>(-1000, 4500)(rng) / 100.0f;
+        data.humidity = std::uniform_int_distribution<int>(2000, 9000)(rng) / 100.0f;
+        data.lux = std::uniform_int_distribution<int>(0, 5000000)(rng) / 100.0f;
+        for (int ch = 0; ch < SOIL_CHANNEL_COUNT; ch++)
+            data.soilMoisture[ch] = std::uniform_int_distribution<int>(0, 50)(rng);
+        publishSensorData();
+        setClockBase(epoch, millis(), 0);
+        saveDataRecord();
+        saved.push_back({epoch, (int)lroundf(data.temperature * 100.0f), data.soilMoisture[0]});
+    }
+    const uint32_t last = saved.back().epoch;
+    const uint32_t span = last - start;
+    printf("%ld records, one per %lu s (%.0f days)\n", options.records, (unsigned long)recordSeconds,
+           span / 86400.0);
+
+    printf("per request (median of %d):\n", options.repeat);
+    printf("  %-22s %9s %9s %8s %7s %7s %9s\n", "", "host ms", "bytes", "buckets", "opens", "allocs",
+           "heap B");
+    query("last 24 h, hourly", last - 86400, last, 3600, 3600);
+    query("last 7 days, default", last - 7 * 86400, last, 0, 7 * 86400 / 200 + 1);
+    query("first 24 h, hourly", start, start + 86400, 3600, 3600);
+    query("everything, default", start, last, 0, span / 200 + 1);
+    query("everything, max buckets", start, last, 1, span / maxBuckets + 1);
+
+    std::string csv;
+    Timing download = time("/data/download", http::Params(), &csv);
+    printRow("/data/download (all)", download, 0);
+
+    printf("query: %d checks passed\n", checks);
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,255 @@
+// `program ranges`: checks that /data/download resumes byte-exact. The data
+// log is filled with --records records, one a simulated minute (so every
+// field moves and row lengths vary), and the CSV is fetched whole as the
+// reference. Then, for --splits random split points, the part after the
+// split is fetched with Range + If-Range and must complete the part before it
+// to exactly the reference, like a browser resuming an interrupted download.
+// Also checked:
+//   - the chunked reply sent while the download index is still being built
+//   - Content-Length, bytes=a-b, bytes=-n and 416 past the end
+//   - ?from=&to= against the reference rows in that time span, and resuming those
+//   - a record added after the first request: If-Range no longer matches, so 200
+//   - segments dropped by the storage budget
+// Exits 1 on the first mismatch.
+//
+//   program ranges
+//   program ranges --records 20000 --splits 1000 --seed 7
+//
+// Options:
+//   --records N     data log records to create first (default 5000)
+//   --splits N      random split points per check (default 200)
+//   --seed N        split point seed (default 1)
+//   --fs DIR        LittleFS root (default sim_fs/ranges)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+void saveDataRecord();
+void serviceDownloadIndex();
+
+namespace
+{
+    struct Options
+    {
+        int records = 5000;
+        int splits = 200;
+        unsigned seed = 1;
+    } options;
+
+    std::mt19937 rng;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program ranges [--records N] [--splits N] [--seed N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, long a = -1, long b = -1)
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "ranges: FAILED %s", what);
+        if (a >= 0)
+            fprintf(stderr, " (%ld", a);
+        if (b >= 0)
+            fprintf(stderr, "-%ld", b);
+        fprintf(stderr, "%s\n", a >= 0 ? ")" : "");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    std::string header(const std::string &head, const char *name)
+    {
+        std::string key = std::string("\r\n") + name + ":";
+        const char *at = strcasestr(head.c_str(), key.c_str());
+        if (!at)
+            return std::string();
+        at += key.size();
+        while (*at == ' ')
+            at++;
+        return std::string(at, strcspn(at, "\r\n"));
+    }
+
+    struct Reply
+    {
+        int code = 0;
+        std::string head;
+        std::string body;
+    };
+
+    Reply get(const String &uri, const http::Params &headers = http::Params())
+    {
+        Reply reply;
+        reply.code = http::request("GET", uri, http::Params(), headers, &reply.body, &reply.head);
+        return reply;
+    }
+
+    Reply getRange(const String &uri, const std::string &range, const std::string &etag)
+    {
+        return get(uri, {{"Range", range.c_str()}, {"If-Range", etag.c_str()}});
+    }
+
+    unsigned long pick(unsigned long below)
+    {
+        return std::uniform_int_distribution<unsigned long>(0, below - 1)(rng);
+    }
+
+    // Resumes `reference` (served at `uri` with `etag`) at random byte
+    // offsets, plus random closed and suffix ranges
+    void checkResume(const String &uri, const std::string &reference, const std::string &etag)
+    {
+        size_t length = reference.size();
+        std::string total = "/" + std::to_string(length);
+        for (int i = 0; i < options.splits; i++)
+        {
+            size_t split = i == 0 ? 0 : i == 1 ? length - 1 : pick(length);
+            Reply rest = getRange(uri, "bytes=" + std::to_string(split) + "-", etag);
+            check(rest.code == 206, "resume: status", split);
+            check(header(rest.head, "Content-Range") == "bytes " + std::to_string(split) + "-" +
+                                                              std::to_string(length - 1) + total,
+                  "resume: Content-Range", split);
+            check(reference.substr(0, split) + rest.body == reference, "resume: bytes differ after split", split);
+
+            size_t first = pick(length), last = first + pick(length - first);
+            Reply part = getRange(uri, "bytes=" + std::to_string(first) + "-" + std::to_string(last), etag);
+            check(part.code == 206 && part.body == reference.substr(first, last - first + 1), "bytes=a-b", first, last);
+
+            size_t suffix = 1 + pick(length);
+            Reply tail = getRange(uri, "bytes=-" + std::to_string(suffix), etag);
+            check(tail.code == 206 && tail.body == reference.substr(length - suffix), "bytes=-n", suffix);
+        }
+
+        Reply past = getRange(uri, "bytes=" + std::to_string(length) + "-", etag);
+        check(past.code == 416 && header(past.head, "Content-Range") == "bytes *" + total, "416 past the end", length);
+    }
+
+    // Header plus the reference rows stamped from..to
+    std::string rowsBetween(const std::string &csv, uint32_t from, uint32_t to)
+    {
+        char lo[32], hi[32];
+        DateTime a(from), b(to);
+        snprintf(lo, sizeof(lo), "%04d-%02d-%02d %02d:%02d:%02d", a.year(), a.month(), a.day(), a.hour(), a.minute(), a.second());
+        snprintf(hi, sizeof(hi), "%04d-%02d-%02d %02d:%02d:%02d", b.year(), b.month(), b.day(), b.hour(), b.minute(), b.second());
+        size_t line = csv.find("\r\n") + 2;
+        std::string out = csv.substr(0, line);
+        while (line < csv.size())
+        {
+            size_t next = csv.find("\r\n", line) + 2;
+            std::string stamp = csv.substr(line, 19);
+            if (stamp >= lo && stamp <= hi)
+                out.append(csv, line, next - line);
+            line = next;
+        }
+        return out;
+    }
+}
+
+int runRanges(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/ranges";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--records"))
+            options.records = atoi(value);
+        else if (!strcmp(opt, "--splits"))
+            options.splits = atoi(value);
+        else if (!strcmp(opt, "--seed"))
+            options.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.records <= 0 || options.splits <= 1)
+        usage();
+    rng.seed(options.seed);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+
+    uint32_t start = DateTime(2025, 1, 1, 0, 0, 0).unixtime();
+    hal::rtcAdjust(start);
+    setup();
+    for (int i = 0; i < options.records; i++)
+    {
+        hal::advance(60000); // a measurement per minute: temperature, humidity and lux follow the day
+        saveDataRecord();
+    }
+
+    // Before the index is built the size is unknown: chunked, no ranges
+    Reply streamed = get("/data/download");
+    check(streamed.code == 200 && header(streamed.head, "Transfer-Encoding") == "chunked" &&
+              header(streamed.head, "Accept-Ranges").empty(),
+          "chunked download before the index is built");
+
+    for (int i = 0; i < options.records / 16 + 1000; i++)
+        serviceDownloadIndex();
+
+    Reply whole = get("/data/download");
+    std::string etag = header(whole.head, "ETag");
+    const std::string &csv = whole.body;
+    check(whole.code == 200 && header(whole.head, "Accept-Ranges") == "bytes" && !etag.empty(), "indexed download headers");
+    check(header(whole.head, "Content-Length") == std::to_string(csv.size()), "Content-Length", csv.size());
+    check(csv == streamed.body, "indexed and chunked downloads differ");
+    size_t rows = 0;
+    for (char c : csv)
+        rows += c == '\n';
+    check(rows == (size_t)options.records + 1, "row count", rows);
+    checkResume("/data/download", csv, etag);
+
+    // A time span, then resuming inside it
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t from = start + pick(options.records * 60);
+        uint32_t to = from + pick(options.records * 60 + 120);
+        String uri = "/data/download?from=" + String((unsigned long)from) + "&to=" + String((unsigned long)to);
+        Reply span = get(uri);
+        check(span.code == 200 && span.body == rowsBetween(csv, from, to), "?from=&to= rows", from, to);
+        checkResume(uri, span.body, header(span.head, "ETag"));
+    }
+
+    // A new record changes the download, so the old ETag must not splice
+    hal::advance(60000);
+    saveDataRecord();
+    Reply stale = getRange("/data/download", "bytes=100-", etag);
+    check(stale.code == 200 && header(stale.head, "ETag") != etag && stale.body.compare(0, csv.size(), csv) == 0 &&
+              stale.body.size() > csv.size(),
+          "If-Range after a new record");
+
+    // Oldest segments rotated out by the storage budget: the index follows
+    http::request("POST", "/settings", {{"storageBudgetKB", "64"}});
+    hal::advance(60000);
+    saveDataRecord();
+    Reply rotated = get("/data/download");
+    check(rotated.code == 200 && header(rotated.head, "Content-Length") == std::to_string(rotated.body.size()) &&
+              (options.records < 3000 || rotated.body.size() < stale.body.size()), // 64 KB holds under three 24 KB segments
+          "download after segments were dropped", rotated.body.size());
+    checkResume("/data/download", rotated.body, header(rotated.head, "ETag"));
+
+    printf("ranges: %d checks passed (%d records, %zu bytes of CSV, %d split points per download)\n", checks,
+           options.records, csv.size(), options.splits);
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,230 @@
+// `program sampler`: checks the cooperative soil sampler against the old
+// blocking readADC() (10 analogReads with delay(10), summed and divided by
+// 10) with a fake analogRead that gives every pin its own random samples:
+//   - with every channel on the "mean 10" filter, readSoilFiltered() after
+//     each serviceSoilSampler() round equals what readADC() would have
+//     returned for that pin's last 10 samples
+//   - a call takes no simulated time (no delay()), does at most one
+//     oversample burst per channel and averages under 100 us of host time,
+//     also at SOIL_OVERSAMPLE_MAX; printed next to the ~1 s the ten blocking
+//     readADC() calls took
+// Exits 1 on the first mismatch.
+//
+//   program sampler
+//   program sampler --rounds 100000 --seed 7
+//
+// Options:
+//   --rounds N      sampler rounds (default 20000)
+//   --seed N        sample seed (default 1)
+//   --fs DIR        LittleFS root (default sim_fs/sampler)
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+#include "nursery.h"
+
+// From main.cpp
+bool setupLittleFS();
+bool loadConfig();
+void createDefaultConfig();
+void setupWebServer();
+bool serviceSoilSampler();
+uint16_t readSoilFiltered(int channel);
+
+namespace
+{
+    const int channels = 10;       // SOIL_CHANNEL_COUNT
+    const int oversampleMax = 16;  // SOIL_OVERSAMPLE_MAX
+
+    struct Options
+    {
+        long rounds = 20000;
+        uint32_t seed = 1;
+    } options;
+
+    // Fake ADC: every read of a pin is a new random sample, remembered per channel
+    struct Source
+    {
+        uint32_t rng = 1;
+        uint64_t reads = 0;
+        std::deque<uint16_t> history[channels]; // newest last
+    } source;
+
+    const nursery::Config nurseryConfig; // soilPins[] in channel order
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program sampler [--rounds N] [--seed N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "sampler: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        exit(1);
+    }
+
+    uint16_t analogSource(uint8_t pin)
+    {
+        source.rng ^= source.rng << 13;
+        source.rng ^= source.rng >> 17;
+        source.rng ^= source.rng << 5;
+        uint16_t sample = source.rng % 4096;
+        const uint8_t *pins = nurseryConfig.soilPins;
+        int channel = std::find(pins, pins + channels, pin) - pins;
+        if (channel < channels)
+        {
+            source.history[channel].push_back(sample);
+            if (source.history[channel].size() > 10)
+                source.history[channel].pop_front();
+        }
+        source.reads++;
+        return sample;
+    }
+
+    // What the old readADC() returned for the same 10 samples
+    int blockingAverage(int channel)
+    {
+        long sum = 0;
+        for (uint16_t sample : source.history[channel])
+            sum += sample;
+        return sum / 10;
+    }
+
+    void apply(int mode, int window, int emaShift, int oversample)
+    {
+        http::Params args;
+        for (int ch = 1; ch <= channels; ch++)
+        {
+            String prefix = "filter" + String(ch);
+            args.push_back({prefix + "Mode", String(mode)});
+            args.push_back({prefix + "Window", String(window)});
+            args.push_back({prefix + "Ema", String(emaShift)});
+            args.push_back({prefix + "Oversample", String(oversample)});
+        }
+        std::string body;
+        check(http::request("POST", "/settings", args, http::Params(), &body) == 200, "POST /settings", body);
+    }
+
+    struct Timing
+    {
+        long calls = 0;
+        double seconds = 0;
+        double worst = 0;
+        uint64_t mostReads = 0;
+    };
+
+    // One serviceSoilSampler() call that is due; checks it stays cooperative
+    void timedRound(Timing &timing)
+    {
+        hal::advance(50); // SOIL_SAMPLE_PERIOD_MS
+        uint64_t simBefore = hal::nowMs(), readsBefore = source.reads;
+        auto start = std::chrono::steady_clock::now();
+        bool sampled = serviceSoilSampler();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        check(sampled, "a due round did not sample");
+        check(hal::nowMs() == simBefore, "serviceSoilSampler() waited",
+              std::to_string(hal::nowMs() - simBefore) + " ms");
+        timing.calls++;
+        timing.seconds += seconds;
+        timing.worst = std::max(timing.worst, seconds);
+        timing.mostReads = std::max(timing.mostReads, source.reads - readsBefore);
+    }
+}
+
+int runSampler(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/sampler";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--rounds"))
+            options.rounds = atol(value);
+        else if (!strcmp(opt, "--seed"))
+            options.seed = std::max(1UL, strtoul(value, nullptr, 10));
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.rounds < 10)
+        usage();
+    source.rng = options.seed;
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    setupLittleFS();
+    if (!loadConfig())
+    {
+        createDefaultConfig();
+        loadConfig();
+    }
+    setupWebServer();
+    hal::setAnalogSource(analogSource);
+
+    // Mean of the last 10 single samples, no EMA: the old readADC()
+    apply(0, 10, 0, 1);
+    for (std::deque<uint16_t> &history : source.history)
+        history.clear();
+    Timing mean;
+    long compared = 0;
+    for (long round = 1; round <= options.rounds; round++)
+    {
+        timedRound(mean);
+        if (round < 10)
+            continue; // the ring still holds samples from before apply()
+        for (int ch = 0; ch < channels; ch++)
+        {
+            int expected = blockingAverage(ch);
+            check(readSoilFiltered(ch) == expected, "average differs from readADC()",
+                  "channel " + std::to_string(ch + 1) + ", round " + std::to_string(round) + ": " +
+                      std::to_string(readSoilFiltered(ch)) + " instead of " + std::to_string(expected));
+            compared++;
+        }
+    }
+    check(mean.mostReads == channels, "more than one analogRead per channel", std::to_string(mean.mostReads));
+    printf("mean 10: %ld averages equal to readADC() over the same samples\n", compared);
+
+    // Heaviest setting: SOIL_OVERSAMPLE_MAX reads per channel and call
+    apply(1, 10, 6, oversampleMax);
+    Timing heavy;
+    for (long round = 0; round < options.rounds / 10; round++)
+        timedRound(heavy);
+    check(heavy.mostReads == (uint64_t)channels * oversampleMax, "oversample burst size",
+          std::to_string(heavy.mostReads));
+
+    // Means over thousands of calls; single worst calls include host preemption
+    check(mean.seconds / mean.calls < 100e-6 && heavy.seconds / heavy.calls < 100e-6, "host time per call",
+          std::to_string(heavy.seconds * 1e6 / heavy.calls) + " us");
+    printf("per serviceSoilSampler() call (blocking readADC() x10 pins: 100 analogReads, 1000 ms of delay):\n");
+    printf("  %-22s %4llu analogReads, 0 ms simulated, host %.2f us mean, %.1f us worst\n", "mean 10",
+           (unsigned long long)mean.mostReads, mean.seconds * 1e6 / mean.calls, mean.worst * 1e6);
+    printf("  %-22s %4llu analogReads, 0 ms simulated, host %.2f us mean, %.1f us worst\n", "median 10, ema, x16",
+           (unsigned long long)heavy.mostReads, heavy.seconds * 1e6 / heavy.calls, heavy.worst * 1e6);
+    printf("sampler: %d checks passed\n", checks);
+    hal::setAnalogSource(nullptr);
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,21 @@
+// SensorData as main.cpp declares it, for the native checks that fill the
+// firmware's `data` or read its snapshot directly. Keep the layout in step
+// with main.cpp.
+#pragma once
+
+#include <stdint.h>
+
+#define SOIL_CHANNEL_COUNT 10
+struct SensorData
+{
+    float temperature = 0.0f;
+    float humidity = 0.0f;
+    float lux = 0.0f;
+    int soilMoisture[SOIL_CHANNEL_COUNT] = {0};
+    uint16_t soilRaw[SOIL_CHANNEL_COUNT] = {0};
+    uint8_t soilFault[SOIL_CHANNEL_COUNT] = {0};
+    int32_t dhtAge = -1;
+    uint32_t dhtFailures = 0;
+    uint32_t dhtErrors = 0;
+    unsigned long lastMeasurement = 0;
+};
@@ -0,0 +1,165 @@
+// `program seqlock`: hammers the sensor snapshot seqlock from real threads.
+// One std::thread plays sensorTask: it fills `data` so that every field
+// follows from one counter and calls publishSensorData(). Reader threads call
+// readSensorSnapshot() meanwhile and check each copy:
+//   - every field belongs to the same write (no torn snapshot)
+//   - the generation returned matches that write, and never goes backwards
+// On x86 this catches a missing or misplaced odd/even marker; weaker memory
+// orderings need the ESP32 itself. Exits 1 on the first mismatch.
+//
+//   program seqlock
+//   program seqlock --writes 16000000 --readers 4
+//
+// Options:
+//   --writes N      publishSensorData() calls (default 10000000, at most 16000000)
+//   --readers N     reader threads (default 3)
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sensor_data.h"
+
+// From main.cpp
+extern SensorData data;
+void publishSensorData();
+uint32_t readSensorSnapshot(SensorData &out);
+
+namespace
+{
+    struct Options
+    {
+        long writes = 10000000;
+        int readers = 3;
+    } options;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program seqlock [--writes N] [--readers N]\n");
+        exit(2);
+    }
+
+    // Write number k, spread over every field; floats stay exact below 2^24
+    void fill(SensorData &out, uint32_t k)
+    {
+        out.temperature = (float)k;
+        out.humidity = (float)k + 0.5f;
+        out.lux = (float)k * 2;
+        for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+        {
+            out.soilMoisture[i] = (int)k + i;
+            out.soilRaw[i] = (uint16_t)(k + i);
+            out.soilFault[i] = (uint8_t)(k + i);
+        }
+        out.dhtAge = (int32_t)k;
+        out.dhtFailures = k;
+        out.dhtErrors = ~k;
+        out.lastMeasurement = k;
+    }
+
+    bool consistent(const SensorData &snapshot)
+    {
+        SensorData expected;
+        memset(static_cast<void *>(&expected), 0, sizeof(expected));
+        fill(expected, snapshot.dhtFailures);
+        return memcmp(&expected, &snapshot, sizeof(snapshot)) == 0;
+    }
+
+    struct Reader
+    {
+        long reads = 0;
+        long changes = 0; // reads that saw a newer write than the one before
+        std::string error;
+    };
+}
+
+int runSeqlock(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--writes"))
+            options.writes = atol(value);
+        else if (!strcmp(opt, "--readers"))
+            options.readers = atoi(value);
+        else
+            usage();
+    }
+    if (options.writes <= 0 || options.writes > 16000000 || options.readers <= 0)
+        usage();
+
+    // Same padding bytes in `data` and in fill()'s copies, so memcmp compares only fields
+    memset(static_cast<void *>(&data), 0, sizeof(data));
+    fill(data, 0);
+    publishSensorData();
+    SensorData first;
+    const uint32_t base = readSensorSnapshot(first); // generation of write 0
+
+    std::atomic<bool> done{false};
+    std::vector<Reader> readers(options.readers);
+    std::vector<std::thread> threads;
+    for (Reader &reader : readers)
+        threads.emplace_back([&reader, &done, base]()
+                             {
+            uint32_t last = 0;
+            SensorData snapshot;
+            while (!done.load(std::memory_order_relaxed) && reader.error.empty())
+            {
+                memset(static_cast<void *>(&snapshot), 0, sizeof(snapshot));
+                uint32_t generation = readSensorSnapshot(snapshot);
+                reader.reads++;
+                uint32_t k = snapshot.dhtFailures;
+                if (!consistent(snapshot))
+                    reader.error = "torn snapshot at write " + std::to_string(k);
+                else if (generation != base + k)
+                    reader.error = "generation " + std::to_string(generation) + " for write " + std::to_string(k);
+                else if (k < last)
+                    reader.error = "write " + std::to_string(k) + " read after " + std::to_string(last);
+                reader.changes += k != last;
+                last = k;
+            } });
+
+    std::thread writer([]()
+                       {
+        for (uint32_t k = 1; k <= (uint32_t)options.writes; k++)
+        {
+            fill(data, k);
+            publishSensorData();
+        } });
+    writer.join();
+    done = true;
+    for (std::thread &thread : threads)
+        thread.join();
+
+    long reads = 0, changes = 0;
+    for (Reader &reader : readers)
+    {
+        if (!reader.error.empty())
+        {
+            fprintf(stderr, "seqlock: FAILED %s\n", reader.error.c_str());
+            return 1;
+        }
+        reads += reader.reads;
+        changes += reader.changes;
+    }
+    SensorData final;
+    if (readSensorSnapshot(final) != base + options.writes || !consistent(final) ||
+        final.dhtFailures != (uint32_t)options.writes)
+    {
+        fprintf(stderr, "seqlock: FAILED last write not published\n");
+        return 1;
+    }
+    printf("%ld writes, %d readers: %ld snapshots read, %ld saw a newer write, none torn\n", options.writes,
+           options.readers, reads, changes);
+    printf("seqlock: passed\n");
+    fflush(stdout);
+    return 0;
+}
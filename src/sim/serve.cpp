@@ -0,0 +1,156 @@
+// `program serve`: the firmware's web server on 127.0.0.1 (a free port), with
+// the files of --web copied into its LittleFS, for a real browser. loop()
+// and the sensor task run in real time until --seconds have passed or the
+// process is killed. The first line printed is the URL of the dashboard;
+// scripts/first_paint.py reads it to time the page in a headless browser.
+//
+//   program serve
+//   program serve --web /tmp/old-dashboard --seconds 60
+//
+// Options:
+//   --web DIR       directory copied into LittleFS, one level of
+//                   subdirectories deep (default data, from scripts/build_web.py)
+//   --seconds N     stop after N s, 0 = run until killed (default 0)
+//   --fs DIR        LittleFS root (default sim_fs/serve)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "hal.h"
+
+// From main.cpp
+void setup();
+void loop();
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program serve [--web DIR] [--seconds N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    // Copies the files of host directory `from` to `to` in LittleFS; returns
+    // the number of files, -1 if `from` cannot be read
+    int copyTree(const std::string &from, const std::string &to, bool recurse)
+    {
+        DIR *dir = opendir(from.c_str());
+        if (!dir)
+            return -1;
+        int files = 0;
+        while (dirent *entry = readdir(dir))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            std::string source = from + "/" + entry->d_name;
+            std::string target = to + "/" + entry->d_name;
+            struct stat info;
+            if (stat(source.c_str(), &info) != 0)
+                continue;
+            if (S_ISDIR(info.st_mode))
+            {
+                if (recurse && LittleFS.mkdir(target.c_str()))
+                    files += std::max(copyTree(source, target, false), 0);
+                continue;
+            }
+            FILE *in = fopen(source.c_str(), "rb");
+            File out = LittleFS.open(target.c_str(), "w");
+            if (!in || !out)
+            {
+                if (in)
+                    fclose(in);
+                continue;
+            }
+            uint8_t buffer[4096];
+            size_t got;
+            while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+                out.write(buffer, got);
+            fclose(in);
+            out.close();
+            files++;
+        }
+        closedir(dir);
+        return files;
+    }
+}
+
+int runServe(int argc, char **argv)
+{
+    std::string web = "data";
+    std::string fsRoot = "sim_fs/serve";
+    int seconds = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--web"))
+            web = value;
+        else if (!strcmp(opt, "--seconds"))
+            seconds = atoi(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (seconds < 0)
+        usage();
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    int files = copyTree(web, "", true);
+    if (files <= 0)
+    {
+        fprintf(stderr, "serve: no files in %s\n", web.c_str());
+        return 1;
+    }
+    hal::listenOnHost(true);
+    hal::rtcAdjust(DateTime(2025, 1, 1, 6, 0, 0).unixtime());
+    setup();
+    uint16_t port = hal::hostPort(80);
+    if (!port)
+    {
+        fprintf(stderr, "serve: the web server is not listening\n");
+        return 1;
+    }
+    printf("http://127.0.0.1:%u/\n", port);
+    printf("%d files from %s\n", files, web.c_str());
+    fflush(stdout);
+
+    // As in `program loadtest`, with a short sleep per loop() so a browser
+    // on the same host is not starved of CPU
+    auto start = Clock::now();
+    auto last = start;
+    while (!seconds || Clock::now() - start < std::chrono::seconds(seconds))
+    {
+        loop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto now = Clock::now();
+        uint32_t elapsed = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+        if (elapsed > 0)
+        {
+            hal::advance(elapsed);
+            last += std::chrono::milliseconds(elapsed);
+        }
+    }
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,243 @@
+// Entry point of the native build: runs the unmodified firmware (setup() and
+// loop() from main.cpp) against the simulated nursery, as fast as the host
+// allows, and prints the watering behaviour it produced.
+//
+//   .pio/build/native/program --days 7 --set wateringMode=2 --set threshold=35
+//
+// Options:
+//   --days N        simulated days to run (default 3, fractions allowed)
+//   --start TIME    RTC time at boot, "YYYY-MM-DD HH:MM:SS" (default 2025-01-01 06:00:00)
+//   --tick MS       simulated time per loop() call (default 10)
+//   --set KEY=VAL   POST /settings after setup(), repeatable
+//   --moisture F    initial soil water content 0..1 (default 0.45)
+//   --seed N        sensor noise / bed variation seed (default 1)
+//   --valves LIST   valve pin feeding each of the 10 beds (default all 18, i.e. zone 1)
+//   --report MIN    minutes between progress lines, 0 = none (default 60)
+//   --fs DIR        host directory used as LittleFS (default sim_fs)
+//   --fresh         erase the filesystem before boot
+//   --serial        show the firmware's Serial output
+//
+// `program bench ...` compares the WateringMode policies instead, see bench.cpp.
+// `program config ...` checks /config and /settings against the field table, see config.cpp.
+// `program events` checks the /events stream, see events.cpp.
+// `program filters ...` compares soil ADC filter settings, see filters.cpp.
+// `program loadtest ...` measures /status latency during downloads, see loadtest.cpp.
+// `program logger ...` measures loop() latency with staged against per-line log writes, see logger.cpp.
+// `program powercut` cuts the power at every byte of a config save, see powercut.cpp.
+// `program probes ...` checks that broken soil probes are flagged and kept out of control, see probes.cpp.
+// `program query ...` measures /data/query latency on a 50k-record log, see query.cpp.
+// `program ranges ...` checks resuming /data/download with Range, see ranges.cpp.
+// `program sampler ...` checks the soil sampler against the old blocking readADC(), see sampler.cpp.
+// `program schedule` checks schedule slots across power cuts, see schedule.cpp.
+// `program seqlock ...` checks the sensor snapshot seqlock from real threads, see seqlock.cpp.
+// `program serve ...` serves a dashboard directory to a real browser, see serve.cpp.
+// `program status ...` measures /status size, heap use and time per request, see status.cpp.
+// `program storage ...` checks the storage budget and retention over weeks, see storage.cpp.
+// `program tsdb ...` round-trips a year of hourly records through /data/download, see tsdb.cpp.
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hal.h"
+#include "http_client.h"
+#include "nursery.h"
+
+void setup();
+void loop();
+int runBench(int argc, char **argv);
+int runConfig(int argc, char **argv);
+int runEvents(int argc, char **argv);
+int runFilters(int argc, char **argv);
+int runLoadtest(int argc, char **argv);
+int runLogger(int argc, char **argv);
+int runPowercut(int argc, char **argv);
+int runProbes(int argc, char **argv);
+int runQuery(int argc, char **argv);
+int runRanges(int argc, char **argv);
+int runSampler(int argc, char **argv);
+int runSchedule(int argc, char **argv);
+int runSeqlock(int argc, char **argv);
+int runServe(int argc, char **argv);
+int runStatus(int argc, char **argv);
+int runStorage(int argc, char **argv);
+int runTsdb(int argc, char **argv);
+
+namespace
+{
+    [[noreturn]] void usage(const char *program)
+    {
+        fprintf(stderr,
+                "usage: %s [--days N] [--start \"YYYY-MM-DD HH:MM:SS\"] [--tick MS] [--set KEY=VAL]...\n"
+                "          [--moisture F] [--seed N] [--valves LIST] [--report MIN] [--fs DIR] [--fresh] [--serial]\n",
+                program);
+        exit(2);
+    }
+
+    void printState(const char *label)
+    {
+        DateTime now(hal::rtcEpoch());
+        printf("%04d-%02d-%02d %02d:%02d:%02d  %-8s soil %5.1f%%  lux %7.0f  pump %-3s  cycles %lu\n",
+               now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second(), label,
+               nursery::averageMoisture() * 100, nursery::lux(), nursery::watering() ? "ON" : "off",
+               (unsigned long)nursery::stats().pumpCycles);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "bench"))
+        return runBench(argc - 1, argv + 1);
+    if (argc > 1 && !strcmp(argv[1], "config"))
+        std::_Exit(runConfig(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "events"))
+        std::_Exit(runEvents(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "filters"))
+        return runFilters(argc - 1, argv + 1);
+    if (argc > 1 && !strcmp(argv[1], "loadtest"))
+    {
+        int code = runLoadtest(argc - 1, argv + 1);
+        std::_Exit(code); // sensorTask never returns; skip joining it
+    }
+    if (argc > 1 && !strcmp(argv[1], "logger"))
+        std::_Exit(runLogger(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "powercut"))
+        return runPowercut(argc - 1, argv + 1);
+    if (argc > 1 && !strcmp(argv[1], "probes"))
+        std::_Exit(runProbes(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "query"))
+        std::_Exit(runQuery(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "ranges"))
+        std::_Exit(runRanges(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "sampler"))
+        std::_Exit(runSampler(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "schedule"))
+        return runSchedule(argc - 1, argv + 1);
+    if (argc > 1 && !strcmp(argv[1], "seqlock"))
+        std::_Exit(runSeqlock(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "serve"))
+        std::_Exit(runServe(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "status"))
+        std::_Exit(runStatus(argc - 1, argv + 1));
+    if (argc > 1 && !strcmp(argv[1], "storage"))
+        return runStorage(argc - 1, argv + 1);
+    if (argc > 1 && !strcmp(argv[1], "tsdb"))
+        std::_Exit(runTsdb(argc - 1, argv + 1));
+
+    double days = 3;
+    uint32_t tick = 10;
+    uint32_t reportMinutes = 60;
+    uint32_t start = DateTime(2025, 1, 1, 6, 0, 0).unixtime();
+    bool fresh = false;
+    bool serial = false;
+    http::Params settings;
+    nursery::Config bed;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(opt, "--fresh"))
+            fresh = true;
+        else if (!strcmp(opt, "--serial"))
+            serial = true;
+        else if (!value)
+            usage(argv[0]);
+        else
+        {
+            i++;
+            if (!strcmp(opt, "--days"))
+                days = atof(value);
+            else if (!strcmp(opt, "--tick"))
+                tick = max(1, atoi(value));
+            else if (!strcmp(opt, "--report"))
+                reportMinutes = atoi(value);
+            else if (!strcmp(opt, "--moisture"))
+                bed.initialMoisture = atof(value);
+            else if (!strcmp(opt, "--seed"))
+                bed.seed = strtoul(value, nullptr, 10);
+            else if (!strcmp(opt, "--valves"))
+            {
+                if (!nursery::parseValvePins(value, bed))
+                    usage(argv[0]);
+            }
+            else if (!strcmp(opt, "--fs"))
+                hal::setFsRoot(value);
+            else if (!strcmp(opt, "--start"))
+            {
+                int y, mo, d, h = 0, mi = 0, s = 0;
+                if (sscanf(value, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &s) < 3)
+                    usage(argv[0]);
+                start = DateTime(y, mo, d, h, mi, s).unixtime();
+            }
+            else if (!strcmp(opt, "--set"))
+            {
+                const char *eq = strchr(value, '=');
+                if (!eq)
+                    usage(argv[0]);
+                settings.push_back({String(std::string(value, eq - value)), String(eq + 1)});
+            }
+            else
+                usage(argv[0]);
+        }
+    }
+
+    hal::rtcAdjust(start);
+    hal::setConsoleQuiet(!serial);
+    nursery::configure(bed);
+    if (fresh && LittleFS.begin())
+        LittleFS.format();
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    setup();
+    if (!settings.empty())
+    {
+        std::string body;
+        int code = http::request("POST", "/settings", settings, http::Params(), &body);
+        printf("POST /settings -> %d %s\n", code, body.c_str());
+    }
+    printState("boot");
+
+    uint64_t end = hal::nowMs() + (uint64_t)(days * 86400000.0);
+    uint64_t reportEvery = (uint64_t)reportMinutes * 60000;
+    uint64_t nextReport = hal::nowMs() + reportEvery;
+    bool wasWatering = false;
+    while (hal::nowMs() < end)
+    {
+        loop();
+        hal::advance(tick);
+
+        if (nursery::watering() != wasWatering)
+        {
+            wasWatering = nursery::watering();
+            printState(wasWatering ? "pump on" : "pump off");
+        }
+        if (reportEvery && hal::nowMs() >= nextReport)
+        {
+            nextReport += reportEvery;
+            printState("");
+        }
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    const nursery::Stats &stats = nursery::stats();
+    printf("\n%.2f simulated days in %.1f s wall (%.0fx real time)\n", days, wall, days * 86400 / max(wall, 1e-3));
+    printf("pump cycles %lu, pump on %.1f min, soil %.1f%%..%.1f%%\n",
+           (unsigned long)stats.pumpCycles, stats.pumpOnMs / 60000.0,
+           stats.minMoisture * 100, stats.maxMoisture * 100);
+
+    printf("I2C transactions %llu (%.0f per hour)\n", (unsigned long long)Wire.transactions,
+           Wire.transactions / (days * 24));
+
+    std::string info;
+    http::request("GET", "/data/info", http::Params(), http::Params(), &info);
+    printf("/data/info %s\n", info.c_str());
+    fflush(stdout);
+    std::_Exit(0); // sensorTask never returns; skip joining it
+}
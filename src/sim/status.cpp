@@ -0,0 +1,176 @@
+// `program status`: /status with every zone enabled and every soil probe
+// flagged, the biggest body the simulator can reach.
+//   - the body must fit the static cache (STATUS_CACHE_SIZE) and come back 200
+//   - a learned zone gain reset by /settings shows at once, not after the
+//     next sensor snapshot (no 304 for the old ETag)
+//   - heap allocations and host time per GET /status: first the old path,
+//     which rendered a JsonDocument on every request (the cache is dropped
+//     before each one; the old handler's String came on top of that), then
+//     a cache hit, a 304 Not Modified and a re-render after the state changed
+// Exits 1 on the first mismatch.
+//
+//   program status
+//   program status --calls 10000
+//
+// Options:
+//   --calls N       requests per row (default 2000)
+//   --fs DIR        LittleFS root (default sim_fs/status)
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "StatusCache.h"
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+void loop();
+
+namespace
+{
+    const int zoneCount = 4; // ZONE_COUNT_MAX
+
+    int calls = 2000;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program status [--calls N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "status: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    // Every probe on the 3.3V rail: all channels get SOIL_FAULT_RAIL
+    uint16_t railedProbe(uint8_t)
+    {
+        return 4095;
+    }
+
+    std::string etagOf(const std::string &headers)
+    {
+        size_t at = headers.find("ETag: ");
+        if (at == std::string::npos)
+            return std::string();
+        at += 6;
+        return headers.substr(at, headers.find('\r', at) - at);
+    }
+
+    void changeThreshold()
+    {
+        static int flip = 0;
+        http::request("POST", "/settings", {{"threshold", String(20 + flip++ % 2)}});
+    }
+
+    // `calls` GET /status, each after `prepare` (if any)
+    void row(const char *label, const http::Params &headers, int expected, void (*prepare)())
+    {
+        uint64_t allocations = 0, bytes = 0;
+        double seconds = 0;
+        for (int i = 0; i < calls; i++)
+        {
+            if (prepare)
+                prepare();
+            auto start = std::chrono::steady_clock::now();
+            int code = http::request("GET", "/status", http::Params(), headers);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            check(code == expected, (std::string(label) + ": status code").c_str(), std::to_string(code));
+            allocations += http::lastServerHeap().allocations;
+            bytes += http::lastServerHeap().bytes;
+        }
+        printf("  %-10s %6.1f allocations %8.0f bytes %7.1f us per call\n", label, allocations / (double)calls,
+               bytes / (double)calls, seconds * 1e6 / calls);
+    }
+}
+
+int runStatus(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/status";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--calls"))
+            calls = atoi(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (calls <= 0)
+        usage();
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    hal::setAnalogSource(railedProbe);
+    File learned = LittleFS.open("/learn.json", "w"); // LEARN_FILE
+    learned.print("{\"gain\":[0.5,0,0,0]}");
+    learned.close();
+    setup();
+
+    http::Params zones;
+    for (int z = 1; z <= zoneCount; z++)
+        zones.push_back({"zone" + String(z) + "Enabled", "1"});
+    check(http::request("POST", "/settings", zones) == 200, "POST /settings");
+    for (int i = 0; i < 600; i++) // a few measurements, so the faults show
+    {
+        loop();
+        hal::advance(1000);
+    }
+
+    std::string body, headers;
+    int code = http::request("GET", "/status", http::Params(), http::Params(), &body, &headers);
+    check(code == 200, "GET /status", body);
+    check(body.size() < STATUS_CACHE_SIZE, "body does not fit the cache", std::to_string(body.size()) + " bytes");
+    check(body.find("\"soilFaults\":[1,1,1,1,1,1,1,1,1,1]") != std::string::npos, "probes not flagged", body);
+    size_t zonesShown = 0;
+    for (size_t at = body.find("{\"zone\":"); at != std::string::npos; at = body.find("{\"zone\":", at + 1))
+        zonesShown++;
+    check(zonesShown == zoneCount, "not every zone shown", body);
+    printf("/status with %d zones and %d flagged probes: %zu bytes of a %zu-byte cache\n", zoneCount, 10,
+           body.size(), (size_t)STATUS_CACHE_SIZE);
+
+    std::string etag = etagOf(headers);
+    check(!etag.empty(), "no ETag");
+
+    // Another valve forgets the gain; sensorTask does not run in between
+    check(body.find("\"gain\":0.5") != std::string::npos, "learned gain not shown", body);
+    check(http::request("POST", "/settings", {{"zone1Pin", "14"}}) == 200, "POST /settings zone1Pin");
+    code = http::request("GET", "/status", http::Params(), {{"If-None-Match", String(etag.c_str())}}, &body,
+                         &headers);
+    check(code == 200 && body.find("\"gain\":0.5") == std::string::npos, "reset gain served from the old cache",
+          std::to_string(code) + " " + body);
+    printf("firmware heap and host time per GET /status (%d calls each):\n", calls);
+    row("before", http::Params(), 200, invalidateStatusCache);
+    http::request("GET", "/status", http::Params(), http::Params(), &body, &headers);
+    etag = etagOf(headers);
+    check(!etag.empty(), "no ETag");
+    row("hit", http::Params(), 200, nullptr);
+    row("304", {{"If-None-Match", String(etag.c_str())}}, 304, nullptr);
+    row("render", http::Params(), 200, changeThreshold);
+
+    printf("status: %d checks passed\n", checks);
+    fflush(stdout);
+    return 0;
+}
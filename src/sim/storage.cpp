@@ -0,0 +1,241 @@
+// `program storage`: runs the storage manager for weeks on a small budget
+// and checks the steady state. One record a minute, each boot a child
+// process on the same LittleFS directory:
+//   - every simulated hour, the segments and daily logs on disk stay within
+//     storageBudgetKB, and the running totals /data/info reports match them;
+//     its fsUsed, kept without walking the filesystem, stays within 4 KB of
+//     LittleFS.usedBytes()
+//   - after boot no directory is listed again; file opens per record saved
+//     are printed
+//   - a segment file is then deleted from the middle, and after a reboot
+//     with retentionDays=1 the budget and the retention still hold: the
+//     oldest record is at most one segment older than the cutoff
+// Exits 1 on the first mismatch.
+//
+//   program storage
+//   program storage --days 60 --budget 256
+//
+// Options:
+//   --days N        simulated days before the gap (default 10)
+//   --budget KB     storageBudgetKB (default 512)
+//   --fs DIR        LittleFS root (default sim_fs/storage)
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+
+// From main.cpp
+void setup();
+void loop();
+
+namespace
+{
+    struct Options
+    {
+        double days = 10;
+        long budgetKB = 512;
+    } options;
+
+    const uint32_t recordSeconds = 60;
+    const uint32_t segmentRecords = 1024; // DATA_SEGMENT_RECORDS
+
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program storage [--days N] [--budget KB] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "storage: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        fflush(stdout);
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    // Segment files on the host, oldest first
+    std::vector<std::string> segmentFiles(const std::string &fsRoot)
+    {
+        std::vector<std::string> files;
+        if (DIR *dir = opendir((fsRoot + "/tsdb").c_str()))
+        {
+            while (dirent *entry = readdir(dir))
+                if (strstr(entry->d_name, ".seg"))
+                    files.push_back(fsRoot + "/tsdb/" + entry->d_name);
+            closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // Bytes of segments and daily logs as they are on the host directory
+    uint64_t diskBytes(const std::string &fsRoot, int *logFiles)
+    {
+        uint64_t total = 0;
+        struct stat st;
+        for (const std::string &path : segmentFiles(fsRoot))
+            if (stat(path.c_str(), &st) == 0)
+                total += st.st_size;
+        *logFiles = 0;
+        if (DIR *dir = opendir(fsRoot.c_str()))
+        {
+            while (dirent *entry = readdir(dir))
+                if (!strncmp(entry->d_name, "log_", 4) && stat((fsRoot + "/" + entry->d_name).c_str(), &st) == 0)
+                {
+                    total += st.st_size;
+                    (*logFiles)++;
+                }
+            closedir(dir);
+        }
+        return total;
+    }
+
+    uint32_t parseTime(const char *text)
+    {
+        int y, mo, d, h, mi, s;
+        if (!text || sscanf(text, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &s) != 6)
+            return 0;
+        return DateTime(y, mo, d, h, mi, s).unixtime();
+    }
+
+    // One boot at `start` for `days`, checked every simulated hour
+    void run(const std::string &fsRoot, const char *label, uint32_t start, double days, int retentionDays)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            exit(1);
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            hal::setConsoleQuiet(true);
+            hal::setFsRoot(fsRoot);
+            hal::rtcAdjust(start);
+            setup();
+            http::Params settings = {{"storageBudgetKB", String(options.budgetKB)},
+                                     {"retentionDays", String(retentionDays)},
+                                     {"measurementInterval", String(recordSeconds)},
+                                     {"dataLogInterval", String(recordSeconds)}};
+            check(http::request("POST", "/settings", settings) == 200, "POST /settings");
+
+            const uint64_t budget = options.budgetKB * 1024;
+            const hal::FsStats atBoot = hal::fsStats();
+            uint64_t peak = 0, final = 0;
+            int hours = (int)(days * 24), logFiles = 0;
+            uint32_t records = 0;
+            for (int hour = 1; hour <= hours; hour++)
+            {
+                for (int second = 0; second < 3600; second++)
+                {
+                    loop();
+                    hal::advance(1000);
+                }
+
+                final = diskBytes(fsRoot, &logFiles);
+                peak = std::max(peak, final);
+                std::string body;
+                http::request("GET", "/data/info", http::Params(), http::Params(), &body);
+                JsonDocument info;
+                deserializeJson(info, body.c_str(), body.size());
+                uint64_t counted = info["storage"]["dataBytes"].as<uint64_t>() + info["storage"]["logBytes"].as<uint64_t>();
+                std::string at = label + std::string(", hour ") + std::to_string(hour) + ": ";
+                check(counted == final, (at + "totals differ from the files").c_str(),
+                      "counted " + std::to_string(counted) + ", on disk " + std::to_string(final));
+                check(info["storage"]["logFiles"].as<int>() == logFiles, (at + "log file count").c_str());
+                int64_t fsUsed = info["storage"]["fsUsed"].as<int64_t>(), walked = LittleFS.usedBytes();
+                check(std::llabs(fsUsed - walked) <= 4096, (at + "fsUsed differs from LittleFS.usedBytes()").c_str(),
+                      std::to_string(fsUsed) + " instead of " + std::to_string(walked));
+                check(final <= budget, (at + "over budget").c_str(), std::to_string(final) + " bytes");
+
+                uint32_t cutoff = hal::rtcEpoch() - retentionDays * 86400U;
+                uint32_t first = parseTime(info["firstRecord"].as<const char *>());
+                check(first + segmentRecords * recordSeconds >= cutoff, (at + "record older than the retention").c_str(),
+                      info["firstRecord"].as<const char *>() ? info["firstRecord"].as<const char *>() : "");
+                records = info["records"].as<uint32_t>();
+            }
+
+            hal::FsStats used = hal::fsStats();
+            uint64_t saved = (uint64_t)(hours * 3600 / recordSeconds);
+            check(used.listings == atBoot.listings, "directory listed after boot",
+                  std::to_string(used.listings - atBoot.listings) + " listings");
+            printf("%s: %.0f days, %llu records saved, %u kept in %zu segments + %d log files\n", label, days,
+                   (unsigned long long)saved, records, segmentFiles(fsRoot).size(), logFiles);
+            printf("  on disk: peak %.1f KB, now %.1f KB of %ld KB budget\n", peak / 1024.0, final / 1024.0,
+                   options.budgetKB);
+            printf("  after boot: %llu directory listings, %.2f file opens per record saved\n",
+                   (unsigned long long)(used.listings - atBoot.listings), (used.opens - atBoot.opens) / (double)saved);
+            fflush(stdout);
+            std::_Exit(write(fds[1], &checks, sizeof(checks)) == sizeof(checks) ? 0 : 1);
+        }
+        close(fds[1]);
+        int childChecks = 0;
+        if (read(fds[0], &childChecks, sizeof(childChecks)) != sizeof(childChecks))
+            childChecks = 0;
+        close(fds[0]);
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            exit(1);
+        checks = childChecks; // the child started from this count
+    }
+}
+
+int runStorage(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/storage";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--days"))
+            options.days = atof(value);
+        else if (!strcmp(opt, "--budget"))
+            options.budgetKB = atol(value);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.days < 1 || options.budgetKB < 64)
+        usage();
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+
+    uint32_t start = DateTime(2025, 1, 1, 6, 0, 0).unixtime();
+    run(fsRoot, "steady state", start, options.days, 3650);
+
+    // A segment lost from the middle, e.g. removed by hand
+    std::vector<std::string> segments = segmentFiles(fsRoot);
+    check(segments.size() >= 3, "too few segments to leave a gap");
+    unlink(segments[1].c_str());
+    printf("deleted %s\n", segments[1].substr(fsRoot.size()).c_str());
+    run(fsRoot, "after the gap", start + (uint32_t)(options.days * 86400), 2, 1);
+
+    printf("storage: %d checks passed\n", checks);
+    return 0;
+}
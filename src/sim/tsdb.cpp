@@ -0,0 +1,207 @@
+// `program tsdb`: round trip of the binary data log, one record an hour for
+// a year (--days). Every record is saved through saveDataRecord() from a
+// snapshot with known values, then /data/download must give back, row for
+// row:
+//   - the same time stamp and soil values
+//   - temperature, humidity and lux rounded to centi-units, as stored
+// and the rows outside the range of the encoding (below -327 C, soil > 255)
+// come back clamped. Prints the bytes on flash next to the CSV lines the
+// old /data_log.csv stored for the same records.
+// Exits 1 on the first mismatch.
+//
+//   program tsdb
+//   program tsdb --days 30 --seed 7
+//
+// Options:
+//   --days N        days of hourly records (default 365)
+//   --seed N        value seed (default 1)
+//   --fs DIR        LittleFS root (default sim_fs/tsdb)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RTClib.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "http_client.h"
+#include "sensor_data.h"
+
+// From main.cpp
+void setup();
+void setClockBase(uint32_t epoch, unsigned long at, int32_t drift);
+void publishSensorData();
+void saveDataRecord();
+extern SensorData data;
+
+namespace
+{
+    struct Options
+    {
+        int days = 365;
+        unsigned seed = 1;
+    } options;
+
+    std::mt19937 rng;
+    int checks = 0;
+
+    [[noreturn]] void usage()
+    {
+        fprintf(stderr, "usage: program tsdb [--days N] [--seed N] [--fs DIR]\n");
+        exit(2);
+    }
+
+    void check(bool ok, const char *what, const std::string &detail = std::string())
+    {
+        checks++;
+        if (ok)
+            return;
+        fprintf(stderr, "tsdb: FAILED %s\n%s%s", what, detail.c_str(), detail.empty() ? "" : "\n");
+        std::_Exit(1); // sensorTask never returns; skip joining it
+    }
+
+    double uniform(double lo, double hi)
+    {
+        return std::uniform_real_distribution<double>(lo, hi)(rng);
+    }
+
+    // Centi-units as stored, printed like the CSV
+    std::string centi(float value)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.2f", lroundf(value * 100.0f) / 100.0f);
+        return text;
+    }
+
+    // The CSV row one saved snapshot must come back as
+    std::string expectedRow(uint32_t epoch, const SensorData &snapshot)
+    {
+        DateTime t(epoch);
+        char stamp[32];
+        snprintf(stamp, sizeof(stamp), "%04d-%02d-%02d %02d:%02d:%02d", t.year(), t.month(), t.day(), t.hour(),
+                 t.minute(), t.second());
+        std::string row = stamp;
+        row += "," + centi(snapshot.temperature) + "," + centi(snapshot.humidity) + "," + centi(snapshot.lux);
+        for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+            row += "," + std::to_string(snapshot.soilMoisture[i] > 255 ? 255 : snapshot.soilMoisture[i]);
+        return row + ",0"; // no pump runs: the pump never starts here
+    }
+
+    uint64_t segmentBytes(const std::string &fsRoot, int *segments)
+    {
+        uint64_t total = 0;
+        *segments = 0;
+        if (DIR *dir = opendir((fsRoot + "/tsdb").c_str()))
+        {
+            struct stat st;
+            while (dirent *entry = readdir(dir))
+                if (strstr(entry->d_name, ".seg") && stat((fsRoot + "/tsdb/" + entry->d_name).c_str(), &st) == 0)
+                {
+                    total += st.st_size;
+                    (*segments)++;
+                }
+            closedir(dir);
+        }
+        return total;
+    }
+}
+
+int runTsdb(int argc, char **argv)
+{
+    std::string fsRoot = "sim_fs/tsdb";
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+            usage();
+        if (!strcmp(opt, "--days"))
+            options.days = atoi(value);
+        else if (!strcmp(opt, "--seed"))
+            options.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(opt, "--fs"))
+            fsRoot = value;
+        else
+            usage();
+    }
+    if (options.days < 1 || options.days > 3650)
+        usage();
+    rng.seed(options.seed);
+
+    hal::setConsoleQuiet(true);
+    ::mkdir("sim_fs", 0755);
+    ::mkdir(fsRoot.c_str(), 0755);
+    hal::setFsRoot(fsRoot);
+    if (LittleFS.begin())
+        LittleFS.format();
+    setup();
+    http::Params settings = {{"storageBudgetKB", "4096"}, {"retentionDays", "3650"}};
+    check(http::request("POST", "/settings", settings) == 200, "POST /settings");
+
+    // sensorTask never runs: the simulated clock stands still, and each
+    // record gets its time from setClockBase() and its values from `data`
+    const uint32_t start = DateTime(2025, 1, 1, 0, 0, 0).unixtime();
+    const int hours = options.days * 24;
+    std::vector<std::string> expected;
+    for (int hour = 0; hour < hours; hour++)
+    {
+        uint32_t epoch = start + hour * 3600U;
+        data.temperature = (float)uniform(-20, 50);
+        data.humidity = (float)uniform(0, 100);
+        data.lux = (float)uniform(0, 100000);
+        for (int i = 0; i < SOIL_CHANNEL_COUNT; i++)
+            data.soilMoisture[i] = (int)uniform(0, 51);
+        if (hour == 1) // outside int16 centi-degrees and uint8 soil: clamped, not wrapped
+        {
+            data.temperature = -400;
+            data.soilMoisture[0] = 300;
+        }
+        publishSensorData();
+        setClockBase(epoch, millis(), 0);
+        saveDataRecord();
+
+        std::string row = expectedRow(epoch, data);
+        if (hour == 1)
+            row.replace(row.find(",-400.00,"), 9, ",-327.68,");
+        expected.push_back(row);
+    }
+
+    std::string body;
+    check(http::request("GET", "/data/download", http::Params(), http::Params(), &body) == 200,
+          "GET /data/download");
+    std::istringstream csv(body);
+    std::string line;
+    std::getline(csv, line); // header
+    size_t rows = 0;
+    while (std::getline(csv, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        check(rows < expected.size(), "more rows than records saved", line);
+        check(line == expected[rows], ("row " + std::to_string(rows + 1)).c_str(),
+              "got      " + line + "\nexpected " + expected[rows]);
+        rows++;
+    }
+    check(rows == expected.size(), "rows missing from /data/download",
+          std::to_string(rows) + " of " + std::to_string(expected.size()));
+    printf("%d days of hourly records: %zu rows back from /data/download, all equal\n", options.days, rows);
+
+    int segments;
+    uint64_t binary = segmentBytes(fsRoot, &segments);
+    uint64_t text = body.size(); // the old file: the same header and lines, appended with println()
+    printf("on flash: %llu B in %d segments (%.1f B per record), old CSV %llu B (%.1f B per record): %.1fx smaller\n",
+           (unsigned long long)binary, segments, binary / (double)hours, (unsigned long long)text,
+           text / (double)hours, text / (double)binary);
+    printf("tsdb: %d checks passed\n", checks);
+    fflush(stdout);
+    return 0;
+}